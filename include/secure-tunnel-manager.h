@@ -0,0 +1,124 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_SECURE_TUNNEL_MANAGER_H
+#define ST_SECURE_TUNNEL_MANAGER_H
+
+// Tunnel manager for hosting in another process. Link the
+// secure-tunnel-manager static library; the aws-greengrass-secure-tunnel
+// executable is a thin wrapper around it.
+
+#include "secure-tunnel.h"
+#include <gg/buffer.h>
+#include <gg/error.h>
+#include <gg/object.h>
+#include <sys/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// localproxy process the manager needs started
+typedef struct {
+    int exe_fd; // localproxy executable, for fexecve
+    const char *const *args; // NULL terminated, args[0] is the program name
+    const char *access_token; // Set as AWSIOT_TUNNEL_ACCESS_TOKEN
+    int output_fd; // Becomes stdout and stderr
+    // Write end of a close-on-exec pipe. The child writes its errno to it if
+    // it fails to start localproxy.
+    int status_fd;
+    int netns_fd; // Network namespace to join before exec, or -1
+} SecureTunnelSpawn;
+
+// Starts spawn as a child of the calling process, so the manager can reap it
+// with waitpid. pidfd may be set to -1. Returning GG_ERR_UNSUPPORTED makes the
+// manager start the process itself. The service's latency class, if any, is
+// applied to the returned pid afterwards.
+typedef GgError (*SecureTunnelSpawnFn)(
+    void *ctx, const SecureTunnelSpawn *spawn, pid_t *pid, int *pidfd
+);
+
+// Values match the tunnel journal's event types
+typedef enum {
+    SECURE_TUNNEL_OPENED = 1,
+    SECURE_TUNNEL_REJECTED = 2,
+    SECURE_TUNNEL_EXITED = 3,
+} SecureTunnelEventType;
+
+typedef struct {
+    SecureTunnelEventType type;
+    const char *reason; // Reject reason, such as "capacity"; NULL otherwise
+    int slot; // -1 when no slot was allocated
+    const char *service;
+    const char *thing_name;
+    uint16_t port;
+    int exit_status; // Wait status, or -1 if localproxy never ran
+    int64_t lifetime_ms;
+} SecureTunnelEvent;
+
+// Called on manager threads, possibly with internal locks held. Must not call
+// back into the manager.
+typedef void (*SecureTunnelNotifyFn)(
+    void *ctx, const SecureTunnelEvent *event
+);
+
+typedef struct {
+    // NULL starts localproxy through the launcher if
+    // secure_tunnel_manager_start_launcher succeeded, or by forking the host
+    // process otherwise
+    SecureTunnelSpawnFn spawn;
+    SecureTunnelNotifyFn notify; // NULL if the host needs no events
+    void *ctx;
+} SecureTunnelHooks;
+
+typedef struct {
+    const SecureTunnelConfig *config;
+    SecureTunnelHooks hooks;
+} SecureTunnelManager;
+
+// Forks the single-threaded helper that starts localproxy without forking the
+// host process. Must be called before the process starts any other thread,
+// including those of the Greengrass SDK. Optional; it stays running for the
+// rest of the process and serves every later manager.
+GgError secure_tunnel_manager_start_launcher(void);
+
+// Binds the tunnel manager to config and hooks, which must outlive it, and
+// opens the journal and host budget file named in config. Tunnel slots and
+// launch limits are per process, so only one manager can be initialized.
+GgError secure_tunnel_manager_init(
+    SecureTunnelManager *manager,
+    const SecureTunnelConfig *config,
+    const SecureTunnelHooks *hooks
+);
+
+// Subscribes to tunnel notifications and configuration updates over
+// Greengrass IPC, as the standalone component does.
+GgError secure_tunnel_manager_subscribe(SecureTunnelManager *manager);
+
+// Handles a tunnel notification the host received itself. topic is the
+// $aws/things/<thing>/tunnels/notify topic it arrived on.
+GgError secure_tunnel_manager_notify(
+    SecureTunnelManager *manager, GgBuffer topic, GgBuffer payload
+);
+
+// Applies component configuration keys, as on a configuration update.
+GgError secure_tunnel_manager_configure(
+    SecureTunnelManager *manager, GgMap config
+);
+
+// Returns the number of tunnels starting or running.
+size_t secure_tunnel_manager_active(SecureTunnelManager *manager);
+
+// Detaches the hooks, closes the journal and host budget file and lets
+// another manager be initialized. Returns GG_ERR_BUSY while tunnels are
+// starting or running; stop delivering notifications and wait for
+// secure_tunnel_manager_active to reach zero first. IPC subscriptions last for
+// the rest of the process, so a subscribed manager returns GG_ERR_UNSUPPORTED.
+GgError secure_tunnel_manager_deinit(SecureTunnelManager *manager);
+
+#endif // ST_SECURE_TUNNEL_MANAGER_H
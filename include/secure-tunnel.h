@@ -18,6 +18,19 @@ typedef struct {
     GgBuffer thing_name;
     GgBuffer region;
     GgBuffer artifact_path;
+    GgBuffer control_socket_path; // Empty disables the control socket
+    GgBuffer journal_path; // Empty disables the tunnel journal
+    GgBuffer gateway_things; // Comma separated, "+" for all things
+    GgBuffer status_topic; // Empty disables tunnel status publishing
+    GgBuffer control_topic; // Empty disables remote tunnel commands
+    GgBuffer host_budget_path; // Empty disables the host-wide tunnel budget
+    // Direct MQTT connection for tunnel notifications. Empty endpoint uses
+    // Greengrass IPC.
+    GgBuffer mqtt_endpoint;
+    GgBuffer mqtt_client_id; // Empty uses <thing name>-secure-tunnel
+    GgBuffer mqtt_cert_path;
+    GgBuffer mqtt_key_path;
+    GgBuffer mqtt_root_ca_path;
     int max_concurrent_tunnels;
     int tunnel_timeout_seconds;
 } SecureTunnelConfig;
@@ -0,0 +1,379 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "host_budget.h"
+#include "launch_limiter.h"
+#include "remote_control.h"
+#include "secure-tunnel.h"
+#include "startup.h"
+#include "status_publisher.h"
+#include "subscriptions.h"
+#include "tunnel.h"
+#include "tunnel_settings.h"
+#include <gg/arena.h>
+#include <gg/buffer.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/ipc/client.h>
+#include <gg/log.h>
+#include <gg/object.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Longest tunnel launches wait for the first configuration load
+#define CONFIG_LOAD_HOLD_MS 10000
+#define CONFIG_MAX_GATEWAY_THINGS \
+    (TUNNEL_MAX_GATEWAY_THINGS * (TUNNEL_MAX_THING_NAME_LEN + 1))
+#define CONFIG_MAX_STRING CONFIG_MAX_GATEWAY_THINGS
+#define CONFIG_MAX_PATH 1024
+#define CONFIG_MAX_ENDPOINT 263 // host:port
+
+// A string key that changes what the component subscribes or publishes to.
+// These are read here rather than passed on the recipe's run command, where a
+// change would restart the component and end every open tunnel.
+typedef struct {
+    GgBuffer key;
+    char *applied; // Null terminated
+    char *next; // Value being applied
+    size_t size;
+    bool loaded; // applied holds a value
+} ConfigString;
+
+#define CONFIG_STRING(name, key_name, max_len) \
+    static char name##_applied[(max_len) + 1]; \
+    static char name##_next[(max_len) + 1]; \
+    static ConfigString name = { .key = GG_STR(key_name), \
+                                 .applied = name##_applied, \
+                                 .next = name##_next, \
+                                 .size = (max_len) + 1 }
+
+CONFIG_STRING(gateway_things_key, "gatewayThings", CONFIG_MAX_GATEWAY_THINGS);
+CONFIG_STRING(status_topic_key, "statusTopic", STATUS_MAX_TOPIC - 1);
+CONFIG_STRING(host_budget_key, "hostBudgetFile", CONFIG_MAX_PATH);
+CONFIG_STRING(control_topic_key, "controlTopic", REMOTE_MAX_TOPIC);
+CONFIG_STRING(mqtt_endpoint_key, "mqttEndpoint", CONFIG_MAX_ENDPOINT);
+CONFIG_STRING(mqtt_client_id_key, "mqttClientId", TUNNEL_MAX_THING_NAME_LEN);
+CONFIG_STRING(mqtt_cert_key, "mqttCertPath", CONFIG_MAX_PATH);
+CONFIG_STRING(mqtt_key_key, "mqttKeyPath", CONFIG_MAX_PATH);
+CONFIG_STRING(mqtt_root_ca_key, "mqttRootCaPath", CONFIG_MAX_PATH);
+
+static pthread_mutex_t reload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reload_cond = PTHREAD_COND_INITIALIZER;
+static bool reload_pending = false;
+
+static void request_reload(void) {
+    GG_MTX_SCOPE_GUARD(&reload_mutex);
+    reload_pending = true;
+    pthread_cond_signal(&reload_cond);
+}
+
+// Runs on the IPC thread, so the configuration is read from the reload thread
+// instead of making a blocking IPC call here.
+static void on_config_update(
+    void *ctx,
+    GgBuffer component_name,
+    GgList key_path,
+    GgIpcSubscriptionHandle handle
+) {
+    (void) ctx;
+    (void) component_name;
+    (void) key_path;
+    (void) handle;
+    request_reload();
+}
+
+// Fetches only the keys tunnel_settings_update reads, so the arena is bounded
+// by the settings' maxima rather than by the rest of the configuration
+static GgError read_settings_config(GgArena *arena, GgKV *pairs, GgMap *map) {
+    size_t count = 0;
+    for (size_t i = 0; i < TUNNEL_SETTINGS_KEY_COUNT; i++) {
+        GgBuffer key = TUNNEL_SETTINGS_KEYS[i];
+        GgObject value;
+        GgError ret = ggipc_get_config(
+            (GgBufList) { .bufs = &key, .len = 1 }, NULL, arena, &value
+        );
+        if (ret == GG_ERR_NOENTRY) {
+            continue;
+        }
+        if (ret != GG_ERR_OK) {
+            GG_LOGE(
+                "Failed to read configuration key %.*s: %d",
+                (int) key.len,
+                key.data,
+                ret
+            );
+            return ret;
+        }
+        pairs[count++] = gg_kv(key, value);
+    }
+    *map = (GgMap) { .pairs = pairs, .len = count };
+    return GG_ERR_OK;
+}
+
+// Reads entry's key into entry->next, or fallback when it is unset. Until a
+// value has been applied, fallback is also used when the configuration cannot
+// be read. Returns false when the value cannot be read.
+static bool load_config_string(ConfigString *entry, GgBuffer fallback) {
+    static uint8_t arena_mem[CONFIG_MAX_STRING];
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    GgObject value;
+    GgError ret = ggipc_get_config(
+        (GgBufList) { .bufs = &entry->key, .len = 1 }, NULL, &arena, &value
+    );
+    GgBuffer str = fallback;
+    if (ret == GG_ERR_OK && gg_obj_type(value) == GG_TYPE_BUF) {
+        str = gg_obj_into_buf(value);
+    } else if (ret == GG_ERR_OK) {
+        ret = GG_ERR_INVALID;
+    }
+    if (ret != GG_ERR_OK && ret != GG_ERR_NOENTRY) {
+        GG_LOGE(
+            "Failed to read configuration key %.*s: %d",
+            (int) entry->key.len,
+            entry->key.data,
+            ret
+        );
+        if (entry->loaded) {
+            return false;
+        }
+        str = fallback;
+    }
+    if (str.len >= entry->size) {
+        GG_LOGE(
+            "Configuration key %.*s is too long",
+            (int) entry->key.len,
+            entry->key.data
+        );
+        return false;
+    }
+
+    memcpy(entry->next, str.data, str.len);
+    entry->next[str.len] = '\0';
+    return true;
+}
+
+static bool config_string_changed(const ConfigString *entry) {
+    return !entry->loaded || strcmp(entry->next, entry->applied) != 0;
+}
+
+// Loads entry, returning false when the value cannot be read or matches the
+// applied one
+static bool read_config_string(ConfigString *entry, GgBuffer fallback) {
+    return load_config_string(entry, fallback) && config_string_changed(entry);
+}
+
+// Records entry->next as applied after it took effect
+static void commit_config_string(ConfigString *entry) {
+    memcpy(entry->applied, entry->next, entry->size);
+    entry->loaded = true;
+}
+
+static void reload_gateway_things(const SecureTunnelConfig *config) {
+    ConfigString *things = &gateway_things_key;
+    if (!read_config_string(things, config->gateway_things)) {
+        return;
+    }
+    if (update_gateway_subscriptions(
+            config, gg_buffer_from_null_term(things->next)
+        )
+        != GG_ERR_OK) {
+        GG_LOGE("Rejected gatewayThings update, keeping subscriptions");
+        return;
+    }
+    commit_config_string(things);
+}
+
+static void reload_status_topic(const SecureTunnelConfig *config) {
+    ConfigString *topic = &status_topic_key;
+    if (!read_config_string(topic, config->status_topic)) {
+        return;
+    }
+    if (status_publisher_set_topic(
+            gg_buffer_from_null_term(topic->next),
+            config->thing_name,
+            STATUS_BATCH_MS
+        )
+        != GG_ERR_OK) {
+        GG_LOGE("Rejected statusTopic update, keeping status topic");
+        return;
+    }
+    commit_config_string(topic);
+}
+
+static void reload_host_budget(const SecureTunnelConfig *config) {
+    ConfigString *path = &host_budget_key;
+    if (!read_config_string(path, config->host_budget_path)) {
+        return;
+    }
+    // The manager opened the startup path already
+    GgBuffer next = gg_buffer_from_null_term(path->next);
+    if (!path->loaded && gg_buffer_eq(next, config->host_budget_path)) {
+        commit_config_string(path);
+        return;
+    }
+    if (next.len == 0) {
+        host_budget_close();
+        GG_LOGI("Host tunnel budget disabled; only local limits apply");
+    } else if (host_budget_open(path->next) != GG_ERR_OK) {
+        GG_LOGE("Rejected hostBudgetFile update, keeping budget file");
+        return;
+    }
+    commit_config_string(path);
+}
+
+static void reload_control_topic(const SecureTunnelConfig *config) {
+    ConfigString *topic = &control_topic_key;
+    if (!read_config_string(topic, config->control_topic)) {
+        return;
+    }
+    if (remote_control_set_topic(gg_buffer_from_null_term(topic->next))
+        != GG_ERR_OK) {
+        GG_LOGE("Rejected controlTopic update, keeping control topic");
+        return;
+    }
+    commit_config_string(topic);
+}
+
+// The mqtt* keys describe one connection, so they are applied together
+static void reload_mqtt_settings(const SecureTunnelConfig *config) {
+    ConfigString *const keys[] = { &mqtt_endpoint_key,
+                                   &mqtt_client_id_key,
+                                   &mqtt_cert_key,
+                                   &mqtt_key_key,
+                                   &mqtt_root_ca_key };
+    const GgBuffer fallbacks[] = { config->mqtt_endpoint,
+                                   config->mqtt_client_id,
+                                   config->mqtt_cert_path,
+                                   config->mqtt_key_path,
+                                   config->mqtt_root_ca_path };
+    size_t count = sizeof(keys) / sizeof(keys[0]);
+    bool changed = false;
+    bool startup = true; // Matches what subscribing used at startup
+    for (size_t i = 0; i < count; i++) {
+        if (!load_config_string(keys[i], fallbacks[i])) {
+            return;
+        }
+        GgBuffer next = gg_buffer_from_null_term(keys[i]->next);
+        changed = changed || config_string_changed(keys[i]);
+        startup = startup && gg_buffer_eq(next, fallbacks[i]);
+    }
+    if (!changed) {
+        return;
+    }
+
+    if (mqtt_endpoint_key.loaded || !startup) {
+        MqttTransportOptions options = {
+            .endpoint = mqtt_endpoint_key.next,
+            .client_id = mqtt_client_id_key.next,
+            .cert_path = mqtt_cert_key.next,
+            .key_path = mqtt_key_key.next,
+            .root_ca_path = mqtt_root_ca_key.next,
+        };
+        if (update_notification_transport(config, &options) != GG_ERR_OK) {
+            GG_LOGE("Rejected MQTT connection update, keeping connection");
+            return;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        commit_config_string(keys[i]);
+    }
+}
+
+// Applies the keys that change what the component subscribes or publishes to,
+// or which files it shares with other instances
+static void reload_string_settings(const SecureTunnelConfig *config) {
+    reload_gateway_things(config);
+    reload_status_topic(config);
+    reload_host_budget(config);
+    reload_control_topic(config);
+    reload_mqtt_settings(config);
+}
+
+static void reload_tunnel_settings(const SecureTunnelConfig *config) {
+    static uint8_t arena_mem[TUNNEL_SETTINGS_CONFIG_SIZE];
+    static GgKV pairs[TUNNEL_SETTINGS_KEY_COUNT];
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    GgMap component_config;
+
+    GgError ret = read_settings_config(&arena, pairs, &component_config);
+    if (ret != GG_ERR_OK) {
+        return;
+    }
+
+    // Unset keys fall back to the startup arguments, so every reload yields
+    // the same result for the same configuration.
+    TunnelSettings settings;
+    tunnel_settings_from_args(config, &settings);
+    ret = tunnel_settings_update(component_config, &settings);
+    if (ret != GG_ERR_OK) {
+        GG_LOGE("Rejected configuration update, keeping current settings");
+        return;
+    }
+
+    tunnel_apply_settings(&settings);
+    startup_mark(STARTUP_CONFIG);
+}
+
+static void *config_reload_thread(void *arg) {
+    const SecureTunnelConfig *config = (const SecureTunnelConfig *) arg;
+
+    // Settings only available through configuration, such as
+    // serviceMappings, apply whether or not updates can be subscribed to.
+    // Gateway destinations are in place before their things are subscribed.
+    reload_tunnel_settings(config);
+    reload_string_settings(config);
+    launch_limiter_release();
+
+    GgIpcSubscriptionHandle sub_handle;
+    GgError ret = ggipc_subscribe_to_configuration_update(
+        NULL, (GgBufList) { 0 }, on_config_update, NULL, &sub_handle
+    );
+    if (ret != GG_ERR_OK) {
+        // Without hot reload the component keeps the settings loaded above
+        GG_LOGE("Failed to subscribe to configuration updates: %d", ret);
+        return NULL;
+    }
+    GG_LOGI("Subscribed to component configuration updates");
+    // Picks up changes made between the first load and the subscription
+    request_reload();
+
+    while (true) {
+        {
+            GG_MTX_SCOPE_GUARD(&reload_mutex);
+            while (!reload_pending) {
+                pthread_cond_wait(&reload_cond, &reload_mutex);
+            }
+            reload_pending = false;
+        }
+        reload_tunnel_settings(config);
+        reload_string_settings(config);
+    }
+
+    return NULL;
+}
+
+void hold_launches_for_config(void) {
+    launch_limiter_hold(CONFIG_LOAD_HOLD_MS);
+}
+
+GgError subscribe_to_config_updates(const SecureTunnelConfig *config) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, config_reload_thread, (void *) config)
+        != 0) {
+        GG_LOGE("Failed to create configuration reload thread");
+        launch_limiter_release();
+        return GG_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+    return GG_ERR_OK;
+}
@@ -0,0 +1,329 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "control_socket.h"
+#include "log_ring.h"
+#include "startup.h"
+#include "tunnel.h"
+#include "tunnel_settings.h"
+#include <errno.h>
+#include <gg/buffer.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CONTROL_MAX_COMMAND 128
+#define CONTROL_MAX_REPLY 4096
+#define CONTROL_READ_TIMEOUT_SECONDS 5
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+} ReplyWriter;
+
+__attribute__((format(printf, 2, 3))) static void reply(
+    ReplyWriter *writer, const char *fmt, ...
+) {
+    if (writer->len >= writer->size) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int written = vsnprintf(
+        &writer->buf[writer->len], writer->size - writer->len, fmt, ap
+    );
+    va_end(ap);
+    if (written > 0) {
+        size_t room = writer->size - writer->len - 1;
+        writer->len += (size_t) written < room ? (size_t) written : room;
+    }
+}
+
+static bool take_word(GgBuffer *line, GgBuffer *word) {
+    while (line->len > 0 && line->data[0] == ' ') {
+        *line = gg_buffer_substr(*line, 1, SIZE_MAX);
+    }
+    size_t end = 0;
+    while (end < line->len && line->data[end] != ' ') {
+        end++;
+    }
+    *word = gg_buffer_substr(*line, 0, end);
+    *line = gg_buffer_substr(*line, end, SIZE_MAX);
+    return word->len > 0;
+}
+
+static void handle_list(ReplyWriter *writer) {
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    size_t count = tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+    for (size_t i = 0; i < count; i++) {
+        reply(
+            writer,
+            "%d %s %d %lld %lld %llu %llu %lld %s\n",
+            tunnels[i].slot,
+            tunnels[i].service,
+            (int) tunnels[i].pid,
+            (long long) tunnels[i].age_seconds,
+            (long long) tunnels[i].remaining_seconds,
+            (unsigned long long) tunnels[i].read_bytes,
+            (unsigned long long) tunnels[i].written_bytes,
+            (long long) tunnels[i].idle_seconds,
+            tunnels[i].thing_name
+        );
+    }
+    reply(writer, "OK\n");
+}
+
+static void reply_path(
+    ReplyWriter *writer, int slot, const char *side, const TcpPathMetrics *path
+) {
+    if (path->connections == 0) {
+        return;
+    }
+    reply(
+        writer,
+        "%d %s %u %u %u %u %u %llu\n",
+        slot,
+        side,
+        path->connections,
+        path->rtt_us,
+        path->rttvar_us,
+        path->retransmits,
+        path->cwnd,
+        (unsigned long long) path->bytes_in_flight
+    );
+}
+
+static void handle_metrics(ReplyWriter *writer) {
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    size_t count = tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+    for (size_t i = 0; i < count; i++) {
+        reply_path(writer, tunnels[i].slot, "cloud", &tunnels[i].net.cloud);
+        reply_path(writer, tunnels[i].slot, "local", &tunnels[i].net.local);
+    }
+    reply(writer, "OK\n");
+}
+
+static void handle_close(ReplyWriter *writer, GgBuffer arg) {
+    int64_t slot = -1;
+    if (gg_str_to_int64(arg, &slot) != GG_ERR_OK || slot < 0
+        || slot >= TUNNEL_MAX_SLOTS) {
+        reply(writer, "ERR invalid slot\n");
+        return;
+    }
+    GgError ret = tunnel_close((int) slot);
+    switch (ret) {
+    case GG_ERR_OK:
+        reply(writer, "OK\n");
+        break;
+    case GG_ERR_NOENTRY:
+        reply(writer, "ERR no tunnel in slot\n");
+        break;
+    case GG_ERR_BUSY:
+        reply(writer, "ERR tunnel still starting\n");
+        break;
+    default:
+        reply(writer, "ERR %s\n", gg_strerror(ret));
+        break;
+    }
+}
+
+static void handle_drain(ReplyWriter *writer, GgBuffer arg) {
+    if (gg_buffer_eq(arg, GG_STR("ON"))) {
+        tunnel_set_draining(true);
+    } else if (gg_buffer_eq(arg, GG_STR("OFF"))) {
+        tunnel_set_draining(false);
+    } else {
+        reply(writer, "ERR expected ON or OFF\n");
+        return;
+    }
+    reply(writer, "OK\n");
+}
+
+static void handle_status(ReplyWriter *writer) {
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    size_t count = tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+    LogRingStats logs;
+    log_ring_stats(&logs);
+    reply(
+        writer,
+        "active %zu\ndraining %s\nlog_dropped %" PRIu64
+        "\nlog_suppressed %" PRIu64 "\nOK\n",
+        count,
+        tunnel_is_draining() ? "on" : "off",
+        logs.dropped,
+        logs.suppressed
+    );
+}
+
+static void handle_startup(ReplyWriter *writer) {
+    for (int phase = 0; phase < STARTUP_PHASE_COUNT; phase++) {
+        int64_t ms = startup_phase_ms((StartupPhase) phase);
+        if (ms >= 0) {
+            reply(
+                writer,
+                "%s %lld\n",
+                startup_phase_name((StartupPhase) phase),
+                (long long) ms
+            );
+        }
+    }
+    reply(writer, "OK\n");
+}
+
+size_t control_handle_command(GgBuffer command, char *out, size_t out_size) {
+    ReplyWriter writer = { .buf = out, .size = out_size };
+    while (command.len > 0
+           && (command.data[command.len - 1] == '\n'
+               || command.data[command.len - 1] == '\r')) {
+        command.len--;
+    }
+
+    GgBuffer verb;
+    GgBuffer arg;
+    if (!take_word(&command, &verb)) {
+        reply(&writer, "ERR empty command\n");
+        return writer.len;
+    }
+    bool has_arg = take_word(&command, &arg);
+    GgBuffer extra;
+    if (take_word(&command, &extra)) {
+        reply(&writer, "ERR too many arguments\n");
+        return writer.len;
+    }
+
+    if (gg_buffer_eq(verb, GG_STR("LIST")) && !has_arg) {
+        handle_list(&writer);
+    } else if (gg_buffer_eq(verb, GG_STR("METRICS")) && !has_arg) {
+        handle_metrics(&writer);
+    } else if (gg_buffer_eq(verb, GG_STR("STATUS")) && !has_arg) {
+        handle_status(&writer);
+    } else if (gg_buffer_eq(verb, GG_STR("STARTUP")) && !has_arg) {
+        handle_startup(&writer);
+    } else if (gg_buffer_eq(verb, GG_STR("CLOSE")) && has_arg) {
+        handle_close(&writer, arg);
+    } else if (gg_buffer_eq(verb, GG_STR("DRAIN")) && has_arg) {
+        handle_drain(&writer, arg);
+    } else {
+        reply(&writer, "ERR unknown command\n");
+    }
+    return writer.len;
+}
+
+static void serve_client(int client) {
+    struct timeval timeout = { .tv_sec = CONTROL_READ_TIMEOUT_SECONDS };
+    (void) setsockopt(
+        client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)
+    );
+
+    char line[CONTROL_MAX_COMMAND];
+    size_t len = 0;
+    while (true) {
+        ssize_t got = read(client, &line[len], sizeof(line) - len);
+        if (got <= 0) {
+            return;
+        }
+        size_t start = 0;
+        size_t end = len + (size_t) got;
+        for (size_t i = len; i < end; i++) {
+            if (line[i] != '\n') {
+                continue;
+            }
+            char out[CONTROL_MAX_REPLY];
+            size_t out_len = control_handle_command(
+                (GgBuffer) { .data = (uint8_t *) &line[start],
+                             .len = i - start },
+                out,
+                sizeof(out)
+            );
+            if (write(client, out, out_len) != (ssize_t) out_len) {
+                return;
+            }
+            start = i + 1;
+        }
+        len = end - start;
+        memmove(line, &line[start], len);
+        if (len == sizeof(line)) {
+            (void) write(client, "ERR command too long\n", 21);
+            return;
+        }
+    }
+}
+
+static void *control_socket_thread(void *arg) {
+    int server = (int) (intptr_t) arg;
+    while (true) {
+        int client = accept4(server, NULL, NULL, SOCK_CLOEXEC);
+        if (client == -1) {
+            if (errno != EINTR) {
+                GG_LOGW("Control socket accept failed: %d", errno);
+                usleep(100000);
+            }
+            continue;
+        }
+        serve_client(client);
+        close(client);
+    }
+    return NULL;
+}
+
+GgError control_socket_start(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    size_t path_len = strlen(path);
+    if (path_len == 0 || path_len >= sizeof(addr.sun_path)) {
+        GG_LOGE("Invalid control socket path");
+        return GG_ERR_INVALID;
+    }
+    memcpy(addr.sun_path, path, path_len);
+
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server == -1) {
+        GG_LOGE("Failed to create control socket: %d", errno);
+        return GG_ERR_FAILURE;
+    }
+
+    // A previous instance may have left its socket behind
+    (void) unlink(path);
+    // bind creates the socket file with the mode of the unbound socket, so it
+    // is never reachable by other users, without touching the process umask
+    if (fchmod(server, 0600) != 0
+        || bind(server, (struct sockaddr *) &addr, sizeof(addr)) != 0
+        || listen(server, 4) != 0) {
+        GG_LOGE("Failed to listen on control socket %s: %d", path, errno);
+        close(server);
+        return GG_ERR_FAILURE;
+    }
+
+    pthread_t thread;
+    if (pthread_create(
+            &thread, NULL, control_socket_thread, (void *) (intptr_t) server
+        )
+        != 0) {
+        GG_LOGE("Failed to create control socket thread");
+        close(server);
+        return GG_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+    GG_LOGI("Control socket listening on %s", path);
+    return GG_ERR_OK;
+}
@@ -0,0 +1,28 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_CONTROL_SOCKET_H
+#define ST_CONTROL_SOCKET_H
+
+#include <gg/buffer.h>
+#include <gg/error.h>
+#include <stddef.h>
+
+#define CONTROL_SOCKET_DEFAULT_PATH "secure-tunnel.sock"
+
+// Runs one line-based control command and writes the reply into out, always
+// ending with an "OK" or "ERR <reason>" line. Returns the reply length.
+size_t control_handle_command(GgBuffer command, char *out, size_t out_size);
+
+// Listens on a Unix domain socket at path (owner access only) and serves
+// control commands from a background thread.
+GgError control_socket_start(const char *path);
+
+#endif // ST_CONTROL_SOCKET_H
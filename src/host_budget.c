@@ -0,0 +1,134 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "host_budget.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+static pthread_mutex_t budget_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int budget_fd = -1;
+// OFD locks do not conflict with locks on the same open file description, so
+// reservations this instance holds are tracked here. They outlive the file
+// they were taken in, since running tunnels still release them.
+static uint64_t budget_held[HOST_BUDGET_MAX_TUNNELS / 64];
+static int budget_hint = 0;
+static bool budget_error_logged = false;
+
+static bool is_held(int index) {
+    return (budget_held[index / 64] & (1ULL << (index % 64))) != 0;
+}
+
+// Caller holds budget_mutex
+static bool lock_byte(int index, short type) {
+    struct flock lock = {
+        .l_type = type,
+        .l_whence = SEEK_SET,
+        .l_start = index,
+        .l_len = 1,
+    };
+    return fcntl(budget_fd, F_OFD_SETLK, &lock) == 0;
+}
+
+GgError host_budget_open(const char *path) {
+    // Close-on-exec so localproxy children never keep reservations alive
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+    if (fd == -1) {
+        GG_LOGE("Failed to open host tunnel budget file %s: %d", path, errno);
+        return GG_ERR_FAILURE;
+    }
+
+    GG_MTX_SCOPE_GUARD(&budget_mutex);
+    // Closed first, so reopening the same file can take its bytes again
+    if (budget_fd != -1) {
+        close(budget_fd);
+    }
+    budget_fd = fd;
+
+    // Running tunnels move to the new file where it has room for them. The
+    // rest still count locally until they exit.
+    int unlocked = 0;
+    for (int i = 0; i < HOST_BUDGET_MAX_TUNNELS; i++) {
+        if (is_held(i) && !lock_byte(i, F_WRLCK)) {
+            unlocked++;
+        }
+    }
+    GG_LOGI("Using host tunnel budget file %s", path);
+    if (unlocked > 0) {
+        GG_LOGW(
+            "%d running tunnels are not counted in the new budget file",
+            unlocked
+        );
+    }
+    return GG_ERR_OK;
+}
+
+bool host_budget_acquire(int max, int *reservation) {
+    *reservation = -1;
+    GG_MTX_SCOPE_GUARD(&budget_mutex);
+    if (budget_fd == -1 || max <= 0) {
+        return true;
+    }
+    if (max > HOST_BUDGET_MAX_TUNNELS) {
+        max = HOST_BUDGET_MAX_TUNNELS;
+    }
+
+    for (int i = 0; i < max; i++) {
+        int index = (budget_hint + i) % max;
+        if (is_held(index)) {
+            continue;
+        }
+        if (lock_byte(index, F_WRLCK)) {
+            budget_held[index / 64] |= 1ULL << (index % 64);
+            budget_hint = index + 1;
+            *reservation = index;
+            return true;
+        }
+        if (errno != EAGAIN && errno != EACCES) {
+            // Fail open rather than refuse every tunnel
+            if (!budget_error_logged) {
+                GG_LOGE("Failed to lock host tunnel budget file: %d", errno);
+                budget_error_logged = true;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void host_budget_release(int reservation) {
+    if (reservation < 0 || reservation >= HOST_BUDGET_MAX_TUNNELS) {
+        return;
+    }
+    GG_MTX_SCOPE_GUARD(&budget_mutex);
+    if (!is_held(reservation)) {
+        return;
+    }
+    // Unlocking a byte this file description does not hold is a no-op
+    if (budget_fd != -1) {
+        (void) lock_byte(reservation, F_UNLCK);
+    }
+    budget_held[reservation / 64] &= ~(1ULL << (reservation % 64));
+}
+
+void host_budget_close(void) {
+    GG_MTX_SCOPE_GUARD(&budget_mutex);
+    if (budget_fd == -1) {
+        return;
+    }
+    close(budget_fd);
+    budget_fd = -1;
+}
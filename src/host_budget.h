@@ -0,0 +1,38 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_HOST_BUDGET_H
+#define ST_HOST_BUDGET_H
+
+#include <gg/error.h>
+#include <stdbool.h>
+
+#define HOST_BUDGET_MAX_TUNNELS 1024
+
+// Opens the lock file shared by every component instance on the host. Each
+// tunnel holds an open file description lock on one byte of it, so the
+// kernel releases a crashed instance's reservations when it exits. Called
+// again to switch files; running tunnels keep their slots in the new file
+// where it has room for them.
+GgError host_budget_open(const char *path);
+
+// Reserves one of max host-wide tunnel slots, returning its index in
+// reservation. Without a lock file or with max 0 every call succeeds with
+// reservation -1. Returns false when other instances hold all max slots.
+bool host_budget_acquire(int max, int *reservation);
+
+// Releases a reservation from host_budget_acquire. -1 is ignored.
+void host_budget_release(int reservation);
+
+// Closes the lock file, so other instances stop counting this one's tunnels.
+// Until the next host_budget_open only local limits apply.
+void host_budget_close(void);
+
+#endif // ST_HOST_BUDGET_H
@@ -0,0 +1,389 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "journal.h"
+#include "journal_format.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Records are synced once this many are pending or after the interval,
+// whichever comes first, to keep flash writes batched.
+#define JOURNAL_FLUSH_BATCH 32
+#define JOURNAL_FLUSH_INTERVAL_SECONDS 5
+// Records appended to a full journal wait here for the flusher to rotate it
+#define JOURNAL_OVERFLOW_RECORDS 64
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    uint32_t capacity;
+    uint32_t next_index;
+    uint32_t next_seq;
+} JournalMapping;
+
+// Appends only take journal_mutex, which is never held across I/O, since
+// tunnel events are emitted under tunnel_mutex. journal_sync_mutex is held
+// by whoever syncs, rotates or replaces the mapping, so it stays mapped while
+// msync runs. It is taken before journal_mutex.
+static pthread_mutex_t journal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t journal_sync_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t journal_cond;
+static pthread_once_t journal_once = PTHREAD_ONCE_INIT;
+static bool flusher_running = false;
+
+static char journal_path[256];
+static JournalMapping journal = { 0 };
+static uint32_t dirty_from = 0; // First record index not yet synced
+static JournalRecord overflow[JOURNAL_OVERFLOW_RECORDS];
+static uint32_t overflow_count = 0;
+static uint32_t overflow_dropped = 0;
+static bool rotate_requested = false;
+
+static JournalRecord *record_at(const JournalMapping *mapping, uint32_t index) {
+    size_t offset
+        = sizeof(JournalHeader) + (size_t) index * sizeof(JournalRecord);
+    return (JournalRecord *) (void *) &mapping->data[offset];
+}
+
+static bool header_valid(const JournalHeader *header, size_t file_size) {
+    return memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)) == 0
+        && header->version == JOURNAL_VERSION
+        && header->record_size == sizeof(JournalRecord)
+        && header->capacity > 0
+        && file_size
+        == sizeof(JournalHeader)
+            + (size_t) header->capacity * sizeof(JournalRecord);
+}
+
+// Finds where appending resumes after a restart
+static void recover_position(JournalMapping *mapping) {
+    mapping->next_index = 0;
+    mapping->next_seq = 1;
+    while (mapping->next_index < mapping->capacity) {
+        const JournalRecord *record = record_at(mapping, mapping->next_index);
+        if (record->seq == 0
+            || record->checksum != journal_record_checksum(record)) {
+            break;
+        }
+        mapping->next_seq = record->seq + 1;
+        mapping->next_index++;
+    }
+}
+
+// Maps the journal at journal_path into mapping. Caller holds
+// journal_sync_mutex.
+static GgError map_journal(uint32_t capacity, JournalMapping *mapping) {
+    int fd = open(journal_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        GG_LOGE("Failed to open journal %s: %d", journal_path, errno);
+        return GG_ERR_FAILURE;
+    }
+    GG_CLEANUP(cleanup_close, fd);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return GG_ERR_FAILURE;
+    }
+
+    JournalHeader header = { 0 };
+    bool existing = st.st_size >= (off_t) sizeof(header)
+        && pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header)
+        && header_valid(&header, (size_t) st.st_size);
+    if (!existing) {
+        if (st.st_size > 0) {
+            GG_LOGW(
+                "Journal %s is not recognized, starting over", journal_path
+            );
+        }
+        header = (JournalHeader) { .version = JOURNAL_VERSION,
+                                   .record_size = sizeof(JournalRecord),
+                                   .capacity = capacity };
+        memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+        size_t size
+            = sizeof(header) + (size_t) capacity * sizeof(JournalRecord);
+        // Reserve the blocks now so appends through the mapping cannot fail
+        // with SIGBUS on a full filesystem.
+        if (ftruncate(fd, 0) != 0
+            || posix_fallocate(fd, 0, (off_t) size) != 0
+            || pwrite(fd, &header, sizeof(header), 0)
+                != (ssize_t) sizeof(header)) {
+            GG_LOGE("Failed to initialize journal %s", journal_path);
+            return GG_ERR_FAILURE;
+        }
+    }
+
+    size_t size
+        = sizeof(header) + (size_t) header.capacity * sizeof(JournalRecord);
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        GG_LOGE("Failed to map journal %s: %d", journal_path, errno);
+        return GG_ERR_FAILURE;
+    }
+    *mapping = (JournalMapping) {
+        .data = map, .size = size, .capacity = header.capacity
+    };
+    recover_position(mapping);
+    return GG_ERR_OK;
+}
+
+// Syncs records [from, to) of data to storage
+static bool sync_range(uint8_t *data, uint32_t from, uint32_t to) {
+    if (from >= to) {
+        return true;
+    }
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t start
+        = sizeof(JournalHeader) + (size_t) from * sizeof(JournalRecord);
+    size_t end = sizeof(JournalHeader) + (size_t) to * sizeof(JournalRecord);
+    start -= start % (size_t) page_size;
+    if (msync(&data[start], end - start, MS_SYNC) != 0) {
+        GG_LOGW("Failed to sync journal: %d", errno);
+        return false;
+    }
+    return true;
+}
+
+// Syncs the records appended so far without holding journal_mutex, so
+// appends continue meanwhile. Caller holds journal_sync_mutex.
+static void sync_dirty(void) {
+    uint8_t *data;
+    uint32_t from;
+    uint32_t to;
+    {
+        GG_MTX_SCOPE_GUARD(&journal_mutex);
+        data = journal.data;
+        from = dirty_from;
+        to = journal.next_index;
+    }
+    if (data == NULL || !sync_range(data, from, to)) {
+        return;
+    }
+    GG_MTX_SCOPE_GUARD(&journal_mutex);
+    dirty_from = to;
+}
+
+// Moves the full journal to "<path>.1" and continues in a new one, starting
+// with the records held back meanwhile. Caller holds journal_sync_mutex.
+static void rotate_journal(void) {
+    char rotated[sizeof(journal_path) + 2];
+    snprintf(rotated, sizeof(rotated), "%s.1", journal_path);
+    uint32_t capacity;
+    {
+        GG_MTX_SCOPE_GUARD(&journal_mutex);
+        capacity = journal.capacity;
+    }
+
+    // Appends go to the overflow while the journal is full, so the old
+    // mapping no longer changes once synced
+    sync_dirty();
+    if (rename(journal_path, rotated) != 0) {
+        GG_LOGE("Failed to rotate journal: %d", errno);
+        return;
+    }
+    JournalMapping fresh;
+    if (map_journal(capacity, &fresh) != GG_ERR_OK) {
+        return;
+    }
+
+    JournalMapping old;
+    uint32_t dropped;
+    {
+        GG_MTX_SCOPE_GUARD(&journal_mutex);
+        old = journal;
+        journal = fresh;
+        journal.next_seq = old.next_seq; // Keep sequence numbers increasing
+        uint32_t moved = overflow_count < journal.capacity ? overflow_count
+                                                           : journal.capacity;
+        memcpy(record_at(&journal, 0), overflow, moved * sizeof(overflow[0]));
+        memmove(
+            overflow,
+            &overflow[moved],
+            (overflow_count - moved) * sizeof(overflow[0])
+        );
+        overflow_count -= moved;
+        journal.next_index = moved;
+        dirty_from = 0;
+        dropped = overflow_dropped;
+        overflow_dropped = 0;
+    }
+    munmap(old.data, old.size);
+    GG_LOGI("Rotated tunnel journal to %s", rotated);
+    if (dropped > 0) {
+        GG_LOGW("Dropped %u journal records while rotating", dropped);
+    }
+}
+
+// Rotates the journal if it filled up, then syncs it. Caller holds
+// journal_sync_mutex.
+static void flush_pending(void) {
+    bool full;
+    {
+        GG_MTX_SCOPE_GUARD(&journal_mutex);
+        full = overflow_count > 0;
+        rotate_requested = false;
+    }
+    if (full) {
+        rotate_journal();
+    }
+    sync_dirty();
+}
+
+// Caller holds journal_sync_mutex
+static void unmap_journal(void) {
+    flush_pending();
+    JournalMapping old;
+    uint32_t from;
+    {
+        GG_MTX_SCOPE_GUARD(&journal_mutex);
+        old = journal;
+        from = dirty_from;
+        journal = (JournalMapping) { 0 };
+        overflow_count = 0;
+    }
+    if (old.data != NULL) {
+        (void) sync_range(old.data, from, old.next_index);
+        munmap(old.data, old.size);
+    }
+}
+
+static void install_mapping(const JournalMapping *mapping) {
+    GG_MTX_SCOPE_GUARD(&journal_mutex);
+    journal = *mapping;
+    dirty_from = mapping->next_index;
+}
+
+static void *journal_flush_thread(void *arg) {
+    (void) arg;
+    while (true) {
+        {
+            GG_MTX_SCOPE_GUARD(&journal_mutex);
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += JOURNAL_FLUSH_INTERVAL_SECONDS;
+            while (!rotate_requested
+                   && journal.next_index - dirty_from < JOURNAL_FLUSH_BATCH) {
+                if (pthread_cond_timedwait(
+                        &journal_cond, &journal_mutex, &deadline
+                    )
+                    == ETIMEDOUT) {
+                    break;
+                }
+            }
+        }
+        GG_MTX_SCOPE_GUARD(&journal_sync_mutex);
+        flush_pending();
+    }
+    return NULL;
+}
+
+static void start_flusher(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&journal_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, journal_flush_thread, NULL) != 0) {
+        GG_LOGW("Failed to create journal flush thread");
+        return;
+    }
+    pthread_detach(thread);
+    flusher_running = true;
+}
+
+GgError journal_open(const char *path, uint32_t capacity) {
+    if (capacity == 0 || strlen(path) >= sizeof(journal_path)) {
+        return GG_ERR_INVALID;
+    }
+    pthread_once(&journal_once, start_flusher);
+
+    GG_MTX_SCOPE_GUARD(&journal_sync_mutex);
+    unmap_journal();
+    strcpy(journal_path, path);
+    JournalMapping mapping;
+    GgError ret = map_journal(capacity, &mapping);
+    if (ret != GG_ERR_OK) {
+        return ret;
+    }
+    GG_LOGI(
+        "Tunnel journal %s holds %u of %u records",
+        journal_path,
+        mapping.next_index,
+        mapping.capacity
+    );
+
+    install_mapping(&mapping);
+    return GG_ERR_OK;
+}
+
+void journal_append(const JournalRecord *record) {
+    GG_MTX_SCOPE_GUARD(&journal_mutex);
+    if (journal.data == NULL) {
+        return;
+    }
+
+    JournalRecord entry = *record;
+    if (entry.wall_ms == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        entry.wall_ms = (uint64_t) now.tv_sec * 1000U
+            + (uint64_t) now.tv_nsec / 1000000U;
+    }
+
+    if (journal.next_index >= journal.capacity) {
+        // Without the flusher the overflow waits for journal_flush
+        if (overflow_count == JOURNAL_OVERFLOW_RECORDS) {
+            overflow_dropped++;
+            return;
+        }
+        entry.seq = journal.next_seq++;
+        entry.checksum = journal_record_checksum(&entry);
+        overflow[overflow_count++] = entry;
+        rotate_requested = true;
+        if (flusher_running) {
+            pthread_cond_signal(&journal_cond);
+        }
+        return;
+    }
+
+    entry.seq = journal.next_seq++;
+    entry.checksum = journal_record_checksum(&entry);
+    memcpy(record_at(&journal, journal.next_index), &entry, sizeof(entry));
+    journal.next_index++;
+
+    if (flusher_running
+        && journal.next_index - dirty_from >= JOURNAL_FLUSH_BATCH) {
+        pthread_cond_signal(&journal_cond);
+    }
+}
+
+void journal_flush(void) {
+    GG_MTX_SCOPE_GUARD(&journal_sync_mutex);
+    flush_pending();
+}
+
+void journal_close(void) {
+    GG_MTX_SCOPE_GUARD(&journal_sync_mutex);
+    unmap_journal();
+}
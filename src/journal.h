@@ -0,0 +1,37 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_JOURNAL_H
+#define ST_JOURNAL_H
+
+#include "journal_format.h"
+#include <gg/error.h>
+#include <stdint.h>
+
+#define JOURNAL_DEFAULT_PATH "secure-tunnel.journal"
+#define JOURNAL_DEFAULT_CAPACITY 8192 // 1.5 MiB of records
+
+// Maps the journal at path, creating it with room for capacity records if
+// needed, and starts the background flusher. When full, the flusher moves the
+// journal to "<path>.1" and starts a new one; records appended meanwhile are
+// held in memory.
+GgError journal_open(const char *path, uint32_t capacity);
+
+// Appends a record, filling in seq, checksum and wall_ms if unset. Never waits
+// for storage. Does nothing when no journal is open.
+void journal_append(const JournalRecord *record);
+
+// Synchronously writes appended records to storage.
+void journal_flush(void);
+
+// Flushes and unmaps the journal.
+void journal_close(void);
+
+#endif // ST_JOURNAL_H
@@ -0,0 +1,64 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_JOURNAL_FORMAT_H
+#define ST_JOURNAL_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On-disk layout shared by the component and the journal reader. All fields
+// are in host byte order; the journal is not meant to move between devices.
+
+#define JOURNAL_MAGIC "STJRNL01"
+// Version 2 widened thing_name to the longest thing name. Older journals are
+// not read; the component starts a new one over them.
+#define JOURNAL_VERSION 2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t reserved[11];
+} JournalHeader;
+
+// seq is 1-based and 0 marks an unused record. checksum covers the record
+// with the checksum field zeroed, so torn writes can be skipped.
+typedef struct {
+    uint64_t wall_ms;
+    uint32_t seq;
+    uint32_t checksum;
+    uint16_t type; // TunnelEventType
+    uint16_t reason; // TunnelRejectReason
+    int32_t exit_status;
+    uint32_t lifetime_s;
+    uint16_t port;
+    uint8_t slot; // UINT8_MAX when no slot was allocated
+    uint8_t reserved;
+    char service[32];
+    char thing_name[128];
+} JournalRecord;
+
+_Static_assert(sizeof(JournalHeader) == 64, "journal header size");
+_Static_assert(sizeof(JournalRecord) == 192, "journal record size");
+
+static inline uint32_t journal_record_checksum(const JournalRecord *record) {
+    JournalRecord copy = *record;
+    copy.checksum = 0;
+    const uint8_t *bytes = (const uint8_t *) &copy;
+    uint32_t hash = 2166136261U; // FNV-1a
+    for (size_t i = 0; i < sizeof(copy); i++) {
+        hash = (hash ^ bytes[i]) * 16777619U;
+    }
+    return hash;
+}
+
+#endif // ST_JOURNAL_FORMAT_H
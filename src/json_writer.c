@@ -0,0 +1,46 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "json_writer.h"
+#include <gg/buffer.h>
+#include <gg/error.h>
+#include <gg/vector.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+void json_append_fmt(GgByteVec *vec, GgError *ret, const char *fmt, ...) {
+    char buf[128];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len < 0 || (size_t) len >= sizeof(buf)) {
+        *ret = GG_ERR_RANGE;
+        return;
+    }
+    gg_byte_vec_chain_append(ret, vec, (GgBuffer) { .data = (uint8_t *) buf,
+                                                    .len = (size_t) len });
+}
+
+void json_append_string(GgByteVec *vec, GgError *ret, const char *str) {
+    gg_byte_vec_chain_append(ret, vec, GG_STR("\""));
+    for (const char *c = str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            gg_byte_vec_chain_append(ret, vec, GG_STR("\\"));
+        } else if ((unsigned char) *c < 0x20) {
+            continue;
+        }
+        gg_byte_vec_chain_append(
+            ret, vec, (GgBuffer) { .data = (uint8_t *) c, .len = 1 }
+        );
+    }
+    gg_byte_vec_chain_append(ret, vec, GG_STR("\""));
+}
@@ -0,0 +1,31 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_JSON_WRITER_H
+#define ST_JSON_WRITER_H
+
+#include <gg/error.h>
+#include <gg/vector.h>
+
+// Both append to vec and set *ret on overflow, like gg_byte_vec_chain_append,
+// so a message can be built without checking every step.
+
+// Appends formatted text of at most 127 bytes
+__attribute__((format(printf, 3, 4))) void json_append_fmt(
+    GgByteVec *vec, GgError *ret, const char *fmt, ...
+);
+
+// Appends str as a JSON string, dropping control characters
+void json_append_string(GgByteVec *vec, GgError *ret, const char *str);
+
+// Longest output of json_append_string for a string of len bytes
+#define JSON_STRING_MAX(len) (2 * (len) + 2)
+
+#endif // ST_JSON_WRITER_H
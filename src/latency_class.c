@@ -0,0 +1,125 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "latency_class.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// From linux/ioprio.h, which older kernel headers lack
+#define LATENCY_IOPRIO_WHO_PROCESS 1
+#define LATENCY_IOPRIO_CLASS_SHIFT 13
+
+static void keep_first_error(int *error) {
+    if (*error == 0) {
+        *error = errno;
+    }
+}
+
+// Nice level, IO priority and affinity are per thread
+static int apply_to_thread(const LatencyClass *latency, pid_t tid) {
+    int error = 0;
+    if (latency->renice
+        && setpriority(PRIO_PROCESS, (id_t) tid, latency->nice) != 0) {
+        keep_first_error(&error);
+    }
+
+    if (latency->io_class != LATENCY_IO_INHERIT) {
+        int ioprio = (latency->io_class << LATENCY_IOPRIO_CLASS_SHIFT)
+            | latency->io_level;
+        if (syscall(SYS_ioprio_set, LATENCY_IOPRIO_WHO_PROCESS, tid, ioprio)
+            != 0) {
+            keep_first_error(&error);
+        }
+    }
+
+    if (latency->cpus != 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (size_t cpu = 0; cpu < 64; cpu++) {
+            if ((latency->cpus & (UINT64_C(1) << cpu)) != 0) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        if (sched_setaffinity(tid, sizeof(cpus), &cpus) != 0) {
+            keep_first_error(&error);
+        }
+    }
+    return error;
+}
+
+// Writes pid (0 for the caller) to the cgroup's process list
+static int join_cgroup(const char *cgroup, pid_t pid) {
+    static const char PROCS[] = "/cgroup.procs";
+    char path[sizeof(((LatencyClass *) 0)->cgroup) + sizeof(PROCS)];
+    size_t len = strnlen(cgroup, sizeof(((LatencyClass *) 0)->cgroup));
+    memcpy(path, cgroup, len);
+    memcpy(&path[len], PROCS, sizeof(PROCS));
+
+    char buf[16] = "0";
+    size_t buf_len = 1;
+    if (pid != 0) {
+        buf_len = (size_t) snprintf(buf, sizeof(buf), "%d", (int) pid);
+    }
+
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno;
+    }
+    int error = write(fd, buf, buf_len) == (ssize_t) buf_len ? 0 : errno;
+    close(fd);
+    return error;
+}
+
+int latency_class_apply(const LatencyClass *latency, pid_t pid) {
+    if (!latency->set) {
+        return 0;
+    }
+
+    // Moving the process first lets threads it creates meanwhile inherit the
+    // cgroup
+    int error = 0;
+    if (latency->cgroup[0] != '\0') {
+        error = join_cgroup(latency->cgroup, pid);
+    }
+
+    if (pid == 0) {
+        int thread_error = apply_to_thread(latency, 0);
+        return error != 0 ? error : thread_error;
+    }
+
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/task", (int) pid);
+    DIR *tasks = opendir(path);
+    if (tasks == NULL) {
+        int thread_error = apply_to_thread(latency, pid);
+        return error != 0 ? error : thread_error;
+    }
+    for (struct dirent *entry = readdir(tasks); entry != NULL;
+         entry = readdir(tasks)) {
+        pid_t tid = (pid_t) strtol(entry->d_name, NULL, 10);
+        if (tid > 0) {
+            int thread_error = apply_to_thread(latency, tid);
+            error = error != 0 ? error : thread_error;
+        }
+    }
+    closedir(tasks);
+    return error;
+}
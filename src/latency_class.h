@@ -0,0 +1,45 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_LATENCY_CLASS_H
+#define ST_LATENCY_CLASS_H
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Values of the kernel's IOPRIO_CLASS_*
+typedef enum {
+    LATENCY_IO_INHERIT = 0,
+    LATENCY_IO_REALTIME = 1,
+    LATENCY_IO_BEST_EFFORT = 2,
+    LATENCY_IO_IDLE = 3,
+} LatencyIoClass;
+
+// Scheduling treatment of a service's localproxy processes
+typedef struct {
+    bool set; // False leaves everything inherited from the component
+    bool renice;
+    int8_t nice;
+    uint8_t io_class; // LatencyIoClass
+    uint8_t io_level; // 0 (highest) to 7 within the IO class
+    uint64_t cpus; // Bit per allowed CPU, 0 keeps the inherited affinity
+    // cgroup v2 directory the process joins, or empty. Lets a firewall rule
+    // mark the tunnel's traffic, e.g. with a DSCP class.
+    char cgroup[128];
+} LatencyClass;
+
+// Applies latency to pid, or to the calling process if pid is 0. Every step
+// is attempted; returns 0 or the errno of the first one that failed. With pid
+// 0 only async-signal-safe calls are made, so it may run between fork and
+// exec.
+int latency_class_apply(const LatencyClass *latency, pid_t pid);
+
+#endif // ST_LATENCY_CLASS_H
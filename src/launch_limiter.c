@@ -0,0 +1,328 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "launch_limiter.h"
+#include "pressure.h"
+#include "tunnel.h"
+#include "tunnel_clock.h"
+#include "tunnel_events.h"
+#include "tunnel_settings.h"
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LAUNCH_DROP_LOG_INTERVAL 100
+#define LAUNCH_PRESSURE_RECHECK_MS 500
+
+// The bucket is tracked as the time at which it will be full again, so taking
+// a token is a single compare-and-swap. It follows the tunnel clock.
+static _Atomic int64_t bucket_full_at_ms = 0;
+static _Atomic int64_t token_interval_ms = 0;
+static _Atomic int64_t burst_tolerance_ms = 0;
+static _Atomic int coalesce_window_ms = 0;
+static _Atomic int pressure_defer_ms = 0;
+// Launches wait until then while settings are loaded, 0 when not held. It
+// follows the system clock like the coalescing windows.
+static _Atomic int64_t hold_until_ms = 0;
+static _Atomic uint64_t dropped_notifications = 0;
+
+typedef struct {
+    bool used;
+    int64_t due_ms;
+    int64_t defer_until_ms; // Held while under pressure until then
+    const SecureTunnelConfig *config;
+    TunnelCreationContext request;
+} PendingLaunch;
+
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond;
+static pthread_once_t dispatcher_once = PTHREAD_ONCE_INIT;
+static _Atomic bool dispatcher_running = false;
+static PendingLaunch pending[TUNNEL_MAX_SLOTS];
+
+void launch_limiter_configure(
+    int launches_per_minute, int burst, int coalesce_ms
+) {
+    int64_t interval = launches_per_minute > 0 ? 60000 / launches_per_minute
+                                               : 0;
+    int64_t tolerance = burst > 1 ? interval * (burst - 1) : 0;
+    atomic_store_explicit(&burst_tolerance_ms, tolerance, memory_order_relaxed);
+    // A new rate starts with a full bucket
+    if (atomic_exchange_explicit(
+            &token_interval_ms, interval, memory_order_relaxed
+        )
+        != interval) {
+        atomic_store_explicit(&bucket_full_at_ms, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(
+        &coalesce_window_ms, coalesce_ms, memory_order_relaxed
+    );
+}
+
+void launch_limiter_set_pressure_defer(int defer_ms) {
+    atomic_store_explicit(&pressure_defer_ms, defer_ms, memory_order_relaxed);
+}
+
+void launch_limiter_hold(int hold_ms) {
+    atomic_store_explicit(
+        &hold_until_ms,
+        tunnel_clock_system_ms() + hold_ms,
+        memory_order_relaxed
+    );
+}
+
+void launch_limiter_release(void) {
+    atomic_store_explicit(&hold_until_ms, 0, memory_order_relaxed);
+    GG_MTX_SCOPE_GUARD(&pending_mutex);
+    if (atomic_load_explicit(&dispatcher_running, memory_order_acquire)) {
+        pthread_cond_signal(&pending_cond);
+    }
+}
+
+bool launch_limiter_peek(void) {
+    int64_t interval
+        = atomic_load_explicit(&token_interval_ms, memory_order_relaxed);
+    if (interval == 0) {
+        return true;
+    }
+    int64_t tolerance
+        = atomic_load_explicit(&burst_tolerance_ms, memory_order_relaxed);
+    int64_t full_at
+        = atomic_load_explicit(&bucket_full_at_ms, memory_order_relaxed);
+    return full_at - tolerance <= tunnel_clock_now_ms();
+}
+
+bool launch_limiter_acquire(void) {
+    int64_t interval
+        = atomic_load_explicit(&token_interval_ms, memory_order_relaxed);
+    if (interval == 0) {
+        return true;
+    }
+    int64_t tolerance
+        = atomic_load_explicit(&burst_tolerance_ms, memory_order_relaxed);
+    int64_t now = tunnel_clock_now_ms();
+    int64_t full_at
+        = atomic_load_explicit(&bucket_full_at_ms, memory_order_relaxed);
+    int64_t next;
+
+    do {
+        int64_t base = full_at > now ? full_at : now;
+        if (base - tolerance > now) {
+            return false;
+        }
+        next = base + interval;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &bucket_full_at_ms,
+        &full_at,
+        next,
+        memory_order_relaxed,
+        memory_order_relaxed
+    ));
+    return true;
+}
+
+void launch_limiter_refund(void) {
+    int64_t interval
+        = atomic_load_explicit(&token_interval_ms, memory_order_relaxed);
+    if (interval == 0) {
+        return;
+    }
+    // An earlier full time than now just means a full bucket
+    atomic_fetch_sub_explicit(
+        &bucket_full_at_ms, interval, memory_order_relaxed
+    );
+}
+
+void launch_limiter_record_drop(void) {
+    uint64_t count
+        = atomic_fetch_add_explicit(
+              &dropped_notifications, 1, memory_order_relaxed
+          )
+        + 1;
+    if (count % LAUNCH_DROP_LOG_INTERVAL == 1) {
+        GG_LOGW(
+            "Dropping tunnel notifications over the launch rate limit (%llu "
+            "dropped so far)",
+            (unsigned long long) count
+        );
+    }
+}
+
+// Caller holds pending_mutex
+static PendingLaunch *next_due(void) {
+    PendingLaunch *earliest = NULL;
+    for (size_t i = 0; i < TUNNEL_MAX_SLOTS; i++) {
+        if (pending[i].used
+            && (earliest == NULL || pending[i].due_ms < earliest->due_ms)) {
+            earliest = &pending[i];
+        }
+    }
+    return earliest;
+}
+
+static void *dispatcher_thread(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&pending_mutex);
+
+    while (true) {
+        PendingLaunch *entry = next_due();
+        if (entry == NULL) {
+            pthread_cond_wait(&pending_cond, &pending_mutex);
+            continue;
+        }
+        // Coalescing windows are short and wait on pending_cond, so they
+        // follow the system clock rather than the tunnel clock
+        int64_t now = tunnel_clock_system_ms();
+        int64_t due_ms = entry->due_ms;
+        int64_t hold_ms
+            = atomic_load_explicit(&hold_until_ms, memory_order_relaxed);
+        if (hold_ms > due_ms) {
+            due_ms = hold_ms;
+        }
+        PressureResource resource;
+        if (due_ms <= now && entry->defer_until_ms > now
+            && pressure_active(&resource)) {
+            entry->due_ms = now + LAUNCH_PRESSURE_RECHECK_MS;
+            continue;
+        }
+        if (due_ms > now) {
+            struct timespec due = { .tv_sec = due_ms / 1000,
+                                    .tv_nsec = (due_ms % 1000) * 1000000 };
+            (void) pthread_cond_timedwait(&pending_cond, &pending_mutex, &due);
+            continue;
+        }
+
+        PendingLaunch launch = *entry;
+        entry->used = false;
+        pthread_mutex_unlock(&pending_mutex);
+        GgError ret = tunnel_launch(&launch.request, launch.config);
+        if (ret != GG_ERR_OK) {
+            GG_LOGE(
+                "Failed to launch coalesced tunnel for service %s: %d",
+                launch.request.service,
+                ret
+            );
+        }
+        pthread_mutex_lock(&pending_mutex);
+    }
+
+    return NULL;
+}
+
+static void start_dispatcher(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pending_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, dispatcher_thread, NULL) != 0) {
+        GG_LOGE("Failed to create launch dispatcher thread");
+        return;
+    }
+    pthread_detach(thread);
+    atomic_store_explicit(&dispatcher_running, true, memory_order_release);
+}
+
+GgError launch_limiter_submit(
+    const TunnelCreationContext *request, const SecureTunnelConfig *config
+) {
+    int window
+        = atomic_load_explicit(&coalesce_window_ms, memory_order_relaxed);
+    int defer = atomic_load_explicit(&pressure_defer_ms, memory_order_relaxed);
+    PressureResource resource;
+    if (defer > 0 && pressure_active(&resource)) {
+        GG_LOGW(
+            "Deferring tunnel launch for service %s under %s pressure",
+            request->service,
+            pressure_resource_name(resource)
+        );
+    } else {
+        defer = 0;
+    }
+    bool held = atomic_load_explicit(&hold_until_ms, memory_order_relaxed)
+        > tunnel_clock_system_ms();
+    if (held) {
+        GG_LOGI(
+            "Holding tunnel launch for service %s until settings are loaded",
+            request->service
+        );
+    }
+    if (window > 0 || defer > 0 || held) {
+        pthread_once(&dispatcher_once, start_dispatcher);
+    }
+    if ((window == 0 && defer == 0 && !held)
+        || !atomic_load_explicit(&dispatcher_running, memory_order_acquire)) {
+        TunnelCreationContext launch = *request;
+        return tunnel_launch(&launch, config);
+    }
+
+    GG_MTX_SCOPE_GUARD(&pending_mutex);
+    PendingLaunch *free_entry = NULL;
+    for (size_t i = 0; i < TUNNEL_MAX_SLOTS; i++) {
+        PendingLaunch *entry = &pending[i];
+        if (!entry->used) {
+            free_entry = free_entry != NULL ? free_entry : entry;
+        } else if (window > 0
+                   && strcmp(entry->request.service, request->service) == 0
+                   && strcmp(entry->request.thing_name, request->thing_name)
+                       == 0) {
+            // Only a coalescing window merges requests; entries parked by a
+            // hold or a pressure defer each launch their own tunnel
+            tunnel_event_emit(&(TunnelEvent) {
+                .type = TUNNEL_EVENT_REJECT,
+                .reason = TUNNEL_REJECT_COALESCED,
+                .slot = -1,
+                .service = entry->request.service,
+                .thing_name = entry->request.thing_name,
+                .exit_status = -1,
+            });
+            // Keep the original deadline so a steady stream still launches
+            entry->request = *request;
+            entry->config = config;
+            GG_LOGI(
+                "Coalesced tunnel notification for service %s, keeping the "
+                "newest access token",
+                request->service
+            );
+            return GG_ERR_OK;
+        }
+    }
+
+    if (free_entry == NULL) {
+        GG_LOGE("Too many tunnel launches pending");
+        tunnel_event_emit(&(TunnelEvent) {
+            .type = TUNNEL_EVENT_REJECT,
+            .reason = TUNNEL_REJECT_PENDING_FULL,
+            .slot = -1,
+            .service = request->service,
+            .thing_name = request->thing_name,
+            .exit_status = -1,
+        });
+        return GG_ERR_NOMEM;
+    }
+    int64_t now = tunnel_clock_system_ms();
+    *free_entry = (PendingLaunch) {
+        .used = true,
+        .due_ms = now + window,
+        .defer_until_ms = defer > 0 ? now + defer : 0,
+        .config = config,
+        .request = *request,
+    };
+    pthread_cond_signal(&pending_cond);
+    return GG_ERR_OK;
+}
@@ -0,0 +1,57 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_LAUNCH_LIMITER_H
+#define ST_LAUNCH_LIMITER_H
+
+#include "secure-tunnel.h"
+#include "tunnel.h"
+#include <gg/error.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// A launches_per_minute of 0 disables rate limiting; a coalesce_ms of 0
+// disables coalescing.
+void launch_limiter_configure(
+    int launches_per_minute, int burst, int coalesce_ms
+);
+
+// Launches submitted while the host is under pressure are held for up to
+// defer_ms, and launched as soon as the pressure clears. 0 launches them
+// immediately, so that admission rejects them.
+void launch_limiter_set_pressure_defer(int defer_ms);
+
+// Holds every launch for up to hold_ms, for settings that are still being
+// loaded. launch_limiter_release lets held launches go ahead at once.
+void launch_limiter_hold(int hold_ms);
+
+void launch_limiter_release(void);
+
+// Returns whether a launch token is currently available without taking it.
+// Lock-free, so it can reject notifications before they are decoded.
+bool launch_limiter_peek(void);
+
+// Takes a launch token if one is available.
+bool launch_limiter_acquire(void);
+
+// Returns a token taken by launch_limiter_acquire for a launch that failed.
+void launch_limiter_refund(void);
+
+// Counts a notification dropped by launch_limiter_peek and logs periodically.
+void launch_limiter_record_drop(void);
+
+// Launches request, or holds it for the coalescing window or while the host is
+// under pressure. A newer request for the same thing and service replaces a
+// held one, so only the newest access token of a burst is launched.
+GgError launch_limiter_submit(
+    const TunnelCreationContext *request, const SecureTunnelConfig *config
+);
+
+#endif // ST_LAUNCH_LIMITER_H
@@ -0,0 +1,436 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "launcher.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <linux/sched.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define LAUNCHER_ARGS_SIZE 1024
+// Executable, output and exec status, optionally followed by a network
+// namespace and a control socket in that order
+#define LAUNCHER_REQUEST_FDS 3
+#define LAUNCHER_MAX_REQUEST_FDS 5
+#define LAUNCHER_SOCKET_FD 3
+
+// Optional descriptors sent with a request
+#define LAUNCH_HAS_NETNS 0x1U
+#define LAUNCH_HAS_CONTROL 0x2U
+
+typedef struct {
+    char access_token[1024];
+    uint32_t argc;
+    char args[LAUNCHER_ARGS_SIZE]; // argc null terminated strings
+    LatencyClass latency;
+    uint32_t fd_flags;
+} LaunchRequest;
+
+typedef struct {
+    int32_t pid; // -1 if the process could not be started
+    int32_t error;
+} LaunchReply;
+
+static pthread_mutex_t launcher_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int launcher_fd = -1;
+static pid_t launcher_pid = 0;
+
+static bool send_with_fds(
+    int sock, const void *data, size_t len, const int *fds, size_t fd_count
+) {
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * LAUNCHER_MAX_REQUEST_FDS)];
+        struct cmsghdr align;
+    } control = { 0 };
+    struct iovec iov = { .iov_base = (void *) data, .iov_len = len };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    if (fd_count > 0) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fd_count);
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+    return sent == (ssize_t) len;
+}
+
+// Returns the message length, 0 at EOF or -1 on error. Up to max_fds received
+// descriptors are stored in fds and counted in fd_count.
+static ssize_t recv_with_fds(
+    int sock,
+    void *data,
+    size_t len,
+    int *fds,
+    size_t max_fds,
+    size_t *fd_count,
+    int flags
+) {
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * LAUNCHER_MAX_REQUEST_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = data, .iov_len = len };
+    struct msghdr msg = { .msg_iov = &iov,
+                          .msg_iovlen = 1,
+                          .msg_control = control.buf,
+                          .msg_controllen = sizeof(control.buf) };
+
+    ssize_t received;
+    do {
+        received = recvmsg(sock, &msg, flags);
+    } while (received == -1 && errno == EINTR);
+
+    *fd_count = 0;
+    if (received < 0) {
+        return received;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (*fd_count < max_fds) {
+                fds[(*fd_count)++] = fd;
+            } else {
+                close(fd);
+            }
+        }
+    }
+    if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return received;
+}
+
+static bool pack_request(
+    const char *const *args, const char *access_token, LaunchRequest *request
+) {
+    size_t token_len = strlen(access_token);
+    if (token_len >= sizeof(request->access_token)) {
+        return false;
+    }
+    memcpy(request->access_token, access_token, token_len + 1);
+
+    size_t offset = 0;
+    for (; args[request->argc] != NULL; request->argc++) {
+        size_t len = strlen(args[request->argc]) + 1;
+        if (request->argc == LAUNCHER_MAX_ARGS
+            || len > sizeof(request->args) - offset) {
+            return false;
+        }
+        memcpy(&request->args[offset], args[request->argc], len);
+        offset += len;
+    }
+    return true;
+}
+
+static bool unpack_request(LaunchRequest *request, char **argv) {
+    if (request->argc == 0 || request->argc > LAUNCHER_MAX_ARGS) {
+        return false;
+    }
+    request->access_token[sizeof(request->access_token) - 1] = '\0';
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < request->argc; i++) {
+        char *end = memchr(
+            &request->args[offset], '\0', sizeof(request->args) - offset
+        );
+        if (end == NULL) {
+            return false;
+        }
+        argv[i] = &request->args[offset];
+        offset = (size_t) (end - request->args) + 1;
+    }
+    argv[request->argc] = NULL;
+    return true;
+}
+
+__attribute__((noreturn)) static void exec_child(
+    pid_t component,
+    LaunchRequest *request,
+    char **argv,
+    const int *fds
+) {
+    // The process is the component's child, so this follows the component
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != component) {
+        _exit(1);
+    }
+
+    size_t next_fd = LAUNCHER_REQUEST_FDS;
+    if ((request->fd_flags & LAUNCH_HAS_NETNS) != 0
+        && setns(fds[next_fd++], CLONE_NEWNET) != 0) {
+        int setns_errno = errno;
+        (void) write(fds[2], &setns_errno, sizeof(setns_errno));
+        _exit(1);
+    }
+    // Replaces the launcher socket, which the child has no use for
+    if ((request->fd_flags & LAUNCH_HAS_CONTROL) != 0
+        && dup2(fds[next_fd], LAUNCHER_CONTROL_FD) == -1) {
+        int dup_errno = errno;
+        (void) write(fds[2], &dup_errno, sizeof(dup_errno));
+        _exit(1);
+    }
+
+    // Best effort; the component checks the result after exec
+    (void) latency_class_apply(&request->latency, 0);
+
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    setenv("AWSIOT_TUNNEL_ACCESS_TOKEN", request->access_token, 1);
+    fexecve(fds[0], argv, environ);
+
+    int exec_errno = errno;
+    (void) write(fds[2], &exec_errno, sizeof(exec_errno));
+    _exit(1);
+}
+
+// Starts the process as a sibling of the launcher, i.e. a child of the
+// component. Returns its pidfd, or -1 with reply->error set.
+static int spawn(
+    pid_t component,
+    LaunchRequest *request,
+    const int *fds,
+    size_t fd_count,
+    LaunchReply *reply
+) {
+    char *argv[LAUNCHER_MAX_ARGS + 1];
+    size_t expected_fds = LAUNCHER_REQUEST_FDS;
+    if ((request->fd_flags & LAUNCH_HAS_NETNS) != 0) {
+        expected_fds++;
+    }
+    if ((request->fd_flags & LAUNCH_HAS_CONTROL) != 0) {
+        expected_fds++;
+    }
+    if (fd_count != expected_fds || !unpack_request(request, argv)) {
+        reply->error = EINVAL;
+        return -1;
+    }
+    // The exec status pipe must close on exec to report success, and the
+    // control socket is only kept as LAUNCHER_CONTROL_FD
+    for (size_t i = 1; i < fd_count; i++) {
+        (void) fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    int pidfd = -1;
+    struct clone_args args = {
+        .flags = CLONE_PARENT | CLONE_PIDFD,
+        .pidfd = (uint64_t) (uintptr_t) &pidfd,
+    };
+    long pid = syscall(SYS_clone3, &args, sizeof(args));
+    if (pid == 0) {
+        exec_child(component, request, argv, fds);
+    }
+    if (pid < 0) {
+        reply->error = errno;
+        return -1;
+    }
+    reply->pid = (int32_t) pid;
+    return pidfd;
+}
+
+__attribute__((noreturn)) static void launcher_main(int sock) {
+    pid_t component = getppid();
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != component) {
+        _exit(0);
+    }
+    (void) prctl(PR_SET_NAME, "st-launcher");
+
+    // Keep stdio for children that fail before exec, drop everything else
+    if (sock != LAUNCHER_SOCKET_FD) {
+        if (dup3(sock, LAUNCHER_SOCKET_FD, O_CLOEXEC) == -1) {
+            _exit(1);
+        }
+        sock = LAUNCHER_SOCKET_FD;
+    }
+    close_range(LAUNCHER_SOCKET_FD + 1, ~0U, 0);
+
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+
+    while (true) {
+        LaunchRequest request;
+        int fds[LAUNCHER_MAX_REQUEST_FDS];
+        size_t fd_count = 0;
+        ssize_t len = recv_with_fds(
+            sock,
+            &request,
+            sizeof(request),
+            fds,
+            LAUNCHER_MAX_REQUEST_FDS,
+            &fd_count,
+            0
+        );
+        if (len <= 0) {
+            _exit(len == 0 ? 0 : 1); // The component closed its end
+        }
+
+        LaunchReply reply = { .pid = -1, .error = EINVAL };
+        int pidfd = -1;
+        if ((size_t) len == sizeof(request)
+            && fd_count >= LAUNCHER_REQUEST_FDS) {
+            pidfd = spawn(component, &request, fds, fd_count, &reply);
+        }
+        for (size_t i = 0; i < fd_count; i++) {
+            close(fds[i]);
+        }
+        explicit_bzero(request.access_token, sizeof(request.access_token));
+
+        bool sent = send_with_fds(
+            sock, &reply, sizeof(reply), &pidfd, pidfd >= 0 ? 1 : 0
+        );
+        if (pidfd >= 0) {
+            close(pidfd);
+        }
+        if (!sent) {
+            _exit(1);
+        }
+    }
+}
+
+GgError launcher_start(void) {
+    int socks[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks) != 0) {
+        GG_LOGE("Failed to create launcher socket: %d", errno);
+        return GG_ERR_FAILURE;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(socks[0]);
+        launcher_main(socks[1]);
+    }
+    close(socks[1]);
+    if (pid < 0) {
+        GG_LOGE("Failed to fork launcher: %d", errno);
+        close(socks[0]);
+        return GG_ERR_FAILURE;
+    }
+
+    GG_MTX_SCOPE_GUARD(&launcher_mutex);
+    launcher_fd = socks[0];
+    launcher_pid = pid;
+    GG_LOGI("Started localproxy launcher (pid %d)", (int) pid);
+    return GG_ERR_OK;
+}
+
+// Caller holds launcher_mutex
+static void stop_launcher(void) {
+    GG_LOGW("localproxy launcher stopped; starting localproxy directly");
+    close(launcher_fd);
+    launcher_fd = -1;
+    (void) kill(launcher_pid, SIGKILL);
+    (void) waitpid(launcher_pid, NULL, 0);
+}
+
+GgError launcher_spawn(
+    int exe_fd,
+    const char *const *args,
+    const char *access_token,
+    int output_fd,
+    int status_fd,
+    int netns_fd,
+    int control_fd,
+    const LatencyClass *latency,
+    pid_t *pid,
+    int *pidfd
+) {
+    static LaunchRequest request;
+    GG_MTX_SCOPE_GUARD(&launcher_mutex);
+    if (launcher_fd == -1) {
+        return GG_ERR_UNSUPPORTED;
+    }
+
+    memset(&request, 0, sizeof(request));
+    if (!pack_request(args, access_token, &request)) {
+        GG_LOGE("localproxy arguments too long for the launcher");
+        return GG_ERR_RANGE;
+    }
+    if (latency != NULL) {
+        request.latency = *latency;
+    }
+    int fds[LAUNCHER_MAX_REQUEST_FDS] = { exe_fd, output_fd, status_fd };
+    size_t request_fds = LAUNCHER_REQUEST_FDS;
+    if (netns_fd >= 0) {
+        request.fd_flags |= LAUNCH_HAS_NETNS;
+        fds[request_fds++] = netns_fd;
+    }
+    if (control_fd >= 0) {
+        request.fd_flags |= LAUNCH_HAS_CONTROL;
+        fds[request_fds++] = control_fd;
+    }
+    bool sent = send_with_fds(
+        launcher_fd, &request, sizeof(request), fds, request_fds
+    );
+    explicit_bzero(request.access_token, sizeof(request.access_token));
+    if (!sent) {
+        stop_launcher();
+        return GG_ERR_UNSUPPORTED;
+    }
+
+    LaunchReply reply;
+    int reply_fd = -1;
+    size_t fd_count = 0;
+    ssize_t len = recv_with_fds(
+        launcher_fd,
+        &reply,
+        sizeof(reply),
+        &reply_fd,
+        1,
+        &fd_count,
+        MSG_CMSG_CLOEXEC
+    );
+    if (len != (ssize_t) sizeof(reply)) {
+        if (fd_count > 0) {
+            close(reply_fd);
+        }
+        stop_launcher();
+        return GG_ERR_UNSUPPORTED;
+    }
+    if (reply.pid <= 0) {
+        GG_LOGE("Launcher failed to start localproxy: %d", (int) reply.error);
+        return GG_ERR_FAILURE;
+    }
+
+    *pid = (pid_t) reply.pid;
+    *pidfd = fd_count > 0 ? reply_fd : -1;
+    return GG_ERR_OK;
+}
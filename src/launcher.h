@@ -0,0 +1,50 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_LAUNCHER_H
+#define ST_LAUNCHER_H
+
+#include "latency_class.h"
+#include <gg/error.h>
+#include <sys/types.h>
+
+#define LAUNCHER_MAX_ARGS 24
+// Descriptor number a control socket passed to launcher_spawn gets in the
+// started process
+#define LAUNCHER_CONTROL_FD 3
+
+// Forks the single-threaded launcher helper. Must be called before the
+// component starts any other thread.
+GgError launcher_start(void);
+
+// Has the launcher start exe_fd with args and the access token in the
+// environment. stdout and stderr go to output_fd; status_fd is the write end
+// of a close-on-exec pipe that receives errno if exec fails. If netns_fd is
+// not -1 the process joins that network namespace before exec, if control_fd
+// is not -1 it is passed on as LAUNCHER_CONTROL_FD, and a non-NULL latency
+// class is applied before exec as well. The process is started as a child of
+// the calling process, so it is reaped with waitpid as usual.
+//
+// Returns GG_ERR_UNSUPPORTED if the launcher is not running, in which case the
+// caller starts the process itself.
+GgError launcher_spawn(
+    int exe_fd,
+    const char *const *args,
+    const char *access_token,
+    int output_fd,
+    int status_fd,
+    int netns_fd,
+    int control_fd,
+    const LatencyClass *latency,
+    pid_t *pid,
+    int *pidfd
+);
+
+#endif // ST_LAUNCHER_H
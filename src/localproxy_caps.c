@@ -0,0 +1,78 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "localproxy_caps.h"
+#include <gg/cleanup.h>
+#include <gg/log.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// localproxy has no version query, so its capabilities are read from string
+// literals in the binary: the command line option added with protocol V2, and
+// the protobuf field that V3 uses to multiplex connections.
+#define LOCALPROXY_V2_MARKER "destination-client-type"
+#define LOCALPROXY_V3_MARKER "connection_id"
+
+static pthread_mutex_t caps_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool caps_valid = false;
+static struct stat caps_stat;
+static LocalproxyProtocol caps_protocol;
+
+static bool same_file(const struct stat *a, const struct stat *b) {
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino
+        && a->st_size == b->st_size && a->st_mtim.tv_sec == b->st_mtim.tv_sec
+        && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+static bool contains(const void *data, size_t len, const char *marker) {
+    return memmem(data, len, marker, strlen(marker)) != NULL;
+}
+
+static LocalproxyProtocol scan_binary(int fd, size_t len) {
+    if (len == 0) {
+        return LOCALPROXY_PROTOCOL_V1;
+    }
+    void *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        GG_LOGW("Failed to map localproxy; assuming protocol V1 only");
+        return LOCALPROXY_PROTOCOL_V1;
+    }
+
+    LocalproxyProtocol protocol = LOCALPROXY_PROTOCOL_V1;
+    if (contains(data, len, LOCALPROXY_V2_MARKER)) {
+        protocol = contains(data, len, LOCALPROXY_V3_MARKER)
+            ? LOCALPROXY_PROTOCOL_V3
+            : LOCALPROXY_PROTOCOL_V2;
+    }
+    munmap(data, len);
+    return protocol;
+}
+
+LocalproxyProtocol localproxy_probe(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 0) {
+        return LOCALPROXY_PROTOCOL_V1;
+    }
+
+    GG_MTX_SCOPE_GUARD(&caps_mutex);
+    if (caps_valid && same_file(&st, &caps_stat)) {
+        return caps_protocol;
+    }
+    caps_protocol = scan_binary(fd, (size_t) st.st_size);
+    caps_stat = st;
+    caps_valid = true;
+    GG_LOGI("localproxy supports protocol up to V%d", (int) caps_protocol + 1);
+    return caps_protocol;
+}
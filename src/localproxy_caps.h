@@ -0,0 +1,25 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_LOCALPROXY_CAPS_H
+#define ST_LOCALPROXY_CAPS_H
+
+// Newest secure tunneling protocol a localproxy binary can speak
+typedef enum {
+    LOCALPROXY_PROTOCOL_V1, // No --destination-client-type option
+    LOCALPROXY_PROTOCOL_V2, // Several services, one connection each
+    LOCALPROXY_PROTOCOL_V3, // Several simultaneous connections per service
+} LocalproxyProtocol;
+
+// Inspects the localproxy binary open at fd without running it. The result is
+// cached until the file changes.
+LocalproxyProtocol localproxy_probe(int fd);
+
+#endif // ST_LOCALPROXY_CAPS_H
@@ -0,0 +1,403 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "log_ring.h"
+#include "tunnel_clock.h"
+#include <errno.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <inttypes.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define LOG_RATE_SITES 256 // The hash below yields 8 bits
+#define LOG_RATE_PROBES 8
+#define LOG_FLUSH_BATCH 64
+#define LOG_FLUSHER_IDLE_MS 1000
+#define LOG_FLUSH_TIMEOUT_MS 1000
+
+// Bounded multi-producer queue: a slot is free for the producer that claims
+// position pos when seq == pos, and holds a line for the flusher when
+// seq == pos + 1.
+typedef struct {
+    _Atomic uint32_t seq;
+    uint32_t len;
+    char text[LOG_RING_LINE_SIZE];
+} LogSlot;
+
+typedef struct {
+    _Atomic uintptr_t key; // 0 while unused
+    _Atomic int64_t window_ms;
+    _Atomic uint32_t count;
+    _Atomic uint32_t suppressed;
+} LogRateSite;
+
+static LogSlot log_ring[LOG_RING_SLOTS];
+static _Atomic uint32_t log_head = 0;
+static _Atomic uint32_t log_tail = 0; // Only advanced by the flusher
+static _Atomic bool log_started = false;
+static int log_fd = -1;
+
+// Set by producers, cleared by the flusher before it sleeps on it
+static _Atomic uint32_t log_wake = 0;
+
+static _Atomic uint64_t log_dropped = 0;
+static _Atomic uint64_t log_suppressed = 0;
+static LogRateSite log_rate_sites[LOG_RATE_SITES];
+
+static char level_char(GgLogLevel level) {
+    switch (level) {
+    case GG_LOG_ERROR:
+        return 'E';
+    case GG_LOG_WARN:
+        return 'W';
+    case GG_LOG_INFO:
+        return 'I';
+    case GG_LOG_DEBUG:
+        return 'D';
+    default:
+        return 'T';
+    }
+}
+
+// Returns the line length, always ending in a newline within size
+static uint32_t format_line(
+    char *buf,
+    size_t size,
+    GgLogLevel level,
+    const char *file,
+    int line,
+    const char *tag,
+    uint32_t suppressed,
+    const char *format,
+    va_list args
+) __attribute__((format(printf, 8, 0)));
+
+static uint32_t format_line(
+    char *buf,
+    size_t size,
+    GgLogLevel level,
+    const char *file,
+    int line,
+    const char *tag,
+    uint32_t suppressed,
+    const char *format,
+    va_list args
+) {
+    size_t max = size - 1; // Room for the newline
+    int len = snprintf(
+        buf, max, "[%c][%s] %s:%d: ", level_char(level), tag, file, line
+    );
+    size_t used = len > 0 ? (size_t) len : 0;
+    if (used < max) {
+        len = vsnprintf(&buf[used], max - used, format, args);
+        used += len > 0 ? (size_t) len : 0;
+    }
+    if (suppressed > 0 && used < max) {
+        len = snprintf(
+            &buf[used],
+            max - used,
+            " (%" PRIu32 " similar messages suppressed)",
+            suppressed
+        );
+        used += len > 0 ? (size_t) len : 0;
+    }
+    if (used > max - 1) {
+        used = max - 1; // Truncated
+    }
+    buf[used++] = '\n';
+    return (uint32_t) used;
+}
+
+static bool write_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        size_t left = (size_t) written;
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *) iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+// Returns false once the call site used up its budget for the window. When a
+// new window starts, suppressed receives the lines held back in the last one.
+static bool rate_allow(LogRateSite *site, uint32_t *suppressed) {
+    int64_t now = tunnel_clock_system_ms();
+    int64_t window
+        = atomic_load_explicit(&site->window_ms, memory_order_relaxed);
+    if (now - window >= LOG_RATE_WINDOW_MS
+        && atomic_compare_exchange_strong_explicit(
+            &site->window_ms,
+            &window,
+            now,
+            memory_order_relaxed,
+            memory_order_relaxed
+        )) {
+        atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+        *suppressed = atomic_exchange_explicit(
+            &site->suppressed, 0, memory_order_relaxed
+        );
+    }
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed)
+        >= LOG_RATE_BURST) {
+        atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&log_suppressed, 1, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+// Call sites share a small open-addressed table; when it is full the site is
+// not limited.
+static bool rate_check(const char *file, int line, uint32_t *suppressed) {
+    uintptr_t key = ((uintptr_t) file ^ ((uintptr_t) line << 20)) | 1U;
+    // Fibonacci hashing: the top bits of the product mix in every key bit
+    size_t start = (size_t) (((uint64_t) key * 0x9E3779B97F4A7C15U) >> 56);
+    for (size_t probe = 0; probe < LOG_RATE_PROBES; probe++) {
+        LogRateSite *site = &log_rate_sites[(start + probe) % LOG_RATE_SITES];
+        uintptr_t current
+            = atomic_load_explicit(&site->key, memory_order_relaxed);
+        if (current == 0) {
+            atomic_compare_exchange_strong_explicit(
+                &site->key,
+                &current,
+                key,
+                memory_order_relaxed,
+                memory_order_relaxed
+            );
+            current = atomic_load_explicit(&site->key, memory_order_relaxed);
+        }
+        if (current == key) {
+            return rate_allow(site, suppressed);
+        }
+    }
+    return true;
+}
+
+static void wake_flusher(void) {
+    // Ordered after the slot's seq store, which the flusher checks after
+    // clearing log_wake
+    if (atomic_exchange_explicit(&log_wake, 1, memory_order_seq_cst) == 0) {
+        (void) syscall(SYS_futex, &log_wake, FUTEX_WAKE_PRIVATE, 1, NULL);
+    }
+}
+
+void log_ring_vlog(
+    GgLogLevel level,
+    const char *file,
+    int line,
+    const char *tag,
+    const char *format,
+    va_list args
+) {
+    uint32_t suppressed = 0;
+    if (!rate_check(file, line, &suppressed)) {
+        return;
+    }
+
+    if (!atomic_load_explicit(&log_started, memory_order_acquire)) {
+        char buf[LOG_RING_LINE_SIZE];
+        uint32_t len = format_line(
+            buf, sizeof(buf), level, file, line, tag, suppressed, format, args
+        );
+        struct iovec iov = { .iov_base = buf, .iov_len = len };
+        (void) write_all(STDERR_FILENO, &iov, 1);
+        return;
+    }
+
+    uint32_t pos = atomic_load_explicit(&log_head, memory_order_relaxed);
+    LogSlot *slot;
+    while (true) {
+        slot = &log_ring[pos & (LOG_RING_SLOTS - 1)];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t) (seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &log_head,
+                    &pos,
+                    pos + 1,
+                    memory_order_relaxed,
+                    memory_order_relaxed
+                )) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The flusher is behind by a whole ring
+            atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+            wake_flusher();
+            return;
+        } else {
+            pos = atomic_load_explicit(&log_head, memory_order_relaxed);
+        }
+    }
+
+    slot->len = format_line(
+        slot->text,
+        sizeof(slot->text),
+        level,
+        file,
+        line,
+        tag,
+        suppressed,
+        format,
+        args
+    );
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    wake_flusher();
+}
+
+// Writes every line that is ready. Returns whether any was.
+static bool flush_ready(void) {
+    uint32_t tail = atomic_load_explicit(&log_tail, memory_order_relaxed);
+    struct iovec iov[LOG_FLUSH_BATCH];
+    int count = 0;
+    while (count < LOG_FLUSH_BATCH) {
+        LogSlot *slot = &log_ring[(tail + (uint32_t) count)
+                                  & (LOG_RING_SLOTS - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire)
+            != tail + (uint32_t) count + 1) {
+            break;
+        }
+        iov[count] = (struct iovec) { .iov_base = slot->text,
+                                      .iov_len = slot->len };
+        count++;
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    // A failing output loses the lines rather than stalling producers
+    (void) write_all(log_fd, iov, count);
+    for (int i = 0; i < count; i++) {
+        uint32_t pos = tail + (uint32_t) i;
+        atomic_store_explicit(
+            &log_ring[pos & (LOG_RING_SLOTS - 1)].seq,
+            pos + LOG_RING_SLOTS,
+            memory_order_release
+        );
+    }
+    atomic_store_explicit(
+        &log_tail, tail + (uint32_t) count, memory_order_release
+    );
+    return true;
+}
+
+static void report_drops(uint64_t *reported) {
+    uint64_t dropped = atomic_load_explicit(&log_dropped, memory_order_relaxed);
+    if (dropped == *reported) {
+        return;
+    }
+    char buf[LOG_RING_LINE_SIZE];
+    int len = snprintf(
+        buf,
+        sizeof(buf),
+        "[W][%s] %s:%d: Dropped %" PRIu64 " log messages\n",
+        GG_MODULE,
+        __FILE__,
+        __LINE__,
+        dropped - *reported
+    );
+    if (len > 0 && (size_t) len < sizeof(buf)) {
+        struct iovec iov = { .iov_base = buf, .iov_len = (size_t) len };
+        (void) write_all(log_fd, &iov, 1);
+    }
+    *reported = dropped;
+}
+
+static void *flusher_thread(void *arg) {
+    (void) arg;
+    uint64_t reported = 0;
+    while (true) {
+        while (flush_ready()) { }
+        report_drops(&reported);
+
+        atomic_store_explicit(&log_wake, 0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        uint32_t tail = atomic_load_explicit(&log_tail, memory_order_relaxed);
+        if (atomic_load_explicit(
+                &log_ring[tail & (LOG_RING_SLOTS - 1)].seq,
+                memory_order_acquire
+            )
+            == tail + 1) {
+            continue;
+        }
+        struct timespec timeout = { .tv_sec = LOG_FLUSHER_IDLE_MS / 1000 };
+        (void) syscall(
+            SYS_futex, &log_wake, FUTEX_WAIT_PRIVATE, 0, &timeout, NULL, 0
+        );
+    }
+    return NULL;
+}
+
+GgError log_ring_start(int fd) {
+    static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+    GG_MTX_SCOPE_GUARD(&start_mutex);
+    if (atomic_load(&log_started)) {
+        return GG_ERR_OK;
+    }
+    for (uint32_t i = 0; i < LOG_RING_SLOTS; i++) {
+        atomic_store_explicit(&log_ring[i].seq, i, memory_order_relaxed);
+    }
+    log_fd = fd;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, flusher_thread, NULL) != 0) {
+        return GG_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+    atomic_store_explicit(&log_started, true, memory_order_release);
+    return GG_ERR_OK;
+}
+
+void log_ring_flush(void) {
+    if (!atomic_load_explicit(&log_started, memory_order_acquire)) {
+        return;
+    }
+    uint32_t head = atomic_load_explicit(&log_head, memory_order_acquire);
+    int64_t deadline = tunnel_clock_system_ms() + LOG_FLUSH_TIMEOUT_MS;
+    while ((int32_t) (atomic_load_explicit(&log_tail, memory_order_acquire)
+                      - head)
+               < 0
+           && tunnel_clock_system_ms() < deadline) {
+        wake_flusher();
+        struct timespec pause = { .tv_nsec = 1000000 };
+        nanosleep(&pause, NULL);
+    }
+}
+
+void log_ring_stats(LogRingStats *stats) {
+    stats->dropped = atomic_load_explicit(&log_dropped, memory_order_relaxed);
+    stats->suppressed
+        = atomic_load_explicit(&log_suppressed, memory_order_relaxed);
+}
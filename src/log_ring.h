@@ -0,0 +1,54 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_LOG_RING_H
+#define ST_LOG_RING_H
+
+#include <gg/error.h>
+#include <gg/log.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#define LOG_RING_SLOTS 128 // Must be a power of two
+#define LOG_RING_LINE_SIZE 256
+// Lines a single call site may log per window before the rest are suppressed
+#define LOG_RATE_BURST 10
+#define LOG_RATE_WINDOW_MS 10000
+
+typedef struct {
+    uint64_t dropped; // Lines lost because the ring was full
+    uint64_t suppressed; // Lines held back by the per call site rate limit
+} LogRingStats;
+
+// Starts a thread that writes queued log lines to fd. Must run after any
+// thread that blocks signals for its children has been set up, as the
+// flusher inherits the caller's signal mask.
+GgError log_ring_start(int fd);
+
+// Formats a log line into the ring without blocking; the line is dropped and
+// counted if the ring is full. Each call site (file and line) may log
+// LOG_RATE_BURST lines per LOG_RATE_WINDOW_MS, and the next line it logs
+// after a window with suppressed lines reports how many. Before
+// log_ring_start the line is written to stderr directly.
+void log_ring_vlog(
+    GgLogLevel level,
+    const char *file,
+    int line,
+    const char *tag,
+    const char *format,
+    va_list args
+) __attribute__((format(printf, 5, 0)));
+
+// Waits up to a second for lines queued so far to be written.
+void log_ring_flush(void);
+
+void log_ring_stats(LogRingStats *stats);
+
+#endif // ST_LOG_RING_H
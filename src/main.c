@@ -8,13 +8,21 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include "control_socket.h"
+#include "journal.h"
+#include "log_ring.h"
+#include "secure-tunnel-manager.h"
 #include "secure-tunnel.h"
+#include "startup.h"
+#include "trace.h"
 #include <argp.h>
 #include <gg/buffer.h>
 #include <gg/error.h>
 #include <gg/log.h>
 #include <gg/sdk.h>
 #include <gg/utils.h>
+#include <unistd.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +39,62 @@ static struct argp_option opts[] = {
     { "max-tunnels", 'm', "count", 0, "Maximum concurrent tunnels", 0 },
     { "timeout", 'T', "seconds", 0, "Tunnel timeout in seconds", 0 },
     { "artifact-path", 'a', "path", 0, "Path to aws-local-proxy binary", 0 },
+    { "gateway-things",
+      'g',
+      "things",
+      0,
+      "Comma separated things to serve as a gateway, or + for all",
+      0 },
+    { "status-topic",
+      's',
+      "topic",
+      0,
+      "IoT Core topic for tunnel status messages (empty to disable)",
+      0 },
+    { "control-topic",
+      'k',
+      "topic",
+      0,
+      "IoT Core topic for remote tunnel commands (empty to disable)",
+      0 },
+    { "journal",
+      'j',
+      "path",
+      0,
+      "Binary tunnel event journal (empty to disable)",
+      0 },
+    { "host-budget-file",
+      'b',
+      "path",
+      0,
+      "Lock file shared by instances for hostMaxTunnels (empty to disable)",
+      0 },
+    { "mqtt-endpoint",
+      'e',
+      "host[:port]",
+      0,
+      "Receive tunnel notifications over a direct MQTT connection",
+      0 },
+    { "mqtt-client-id",
+      'i',
+      "id",
+      0,
+      "MQTT client ID (default: <thing name>-secure-tunnel)",
+      0 },
+    { "mqtt-cert", 'C', "path", 0, "Device certificate for direct MQTT", 0 },
+    { "mqtt-key", 'K', "path", 0, "Private key for direct MQTT", 0 },
+    { "mqtt-root-ca",
+      'R',
+      "path",
+      0,
+      "Root CA for direct MQTT (default: system trust store)",
+      0 },
+    { "control-socket",
+      'c',
+      "path",
+      0,
+      "Unix socket for local tunnel control (empty to disable)",
+      0 },
     { "version", 'v', 0, 0, "Show version information", 0 },
     { 0 }
 };
@@ -101,6 +165,39 @@ static error_t arg_parser(int key, char *arg, struct argp_state *state) {
     case 'a':
         args->artifact_path = gg_buffer_from_null_term(arg);
         break;
+    case 'g':
+        args->gateway_things = gg_buffer_from_null_term(arg);
+        break;
+    case 's':
+        args->status_topic = gg_buffer_from_null_term(arg);
+        break;
+    case 'k':
+        args->control_topic = gg_buffer_from_null_term(arg);
+        break;
+    case 'j':
+        args->journal_path = gg_buffer_from_null_term(arg);
+        break;
+    case 'b':
+        args->host_budget_path = gg_buffer_from_null_term(arg);
+        break;
+    case 'e':
+        args->mqtt_endpoint = gg_buffer_from_null_term(arg);
+        break;
+    case 'i':
+        args->mqtt_client_id = gg_buffer_from_null_term(arg);
+        break;
+    case 'C':
+        args->mqtt_cert_path = gg_buffer_from_null_term(arg);
+        break;
+    case 'K':
+        args->mqtt_key_path = gg_buffer_from_null_term(arg);
+        break;
+    case 'R':
+        args->mqtt_root_ca_path = gg_buffer_from_null_term(arg);
+        break;
+    case 'c':
+        args->control_socket_path = gg_buffer_from_null_term(arg);
+        break;
     case 'v':
         printf(SEC_TUN_VERSION "\n");
 
@@ -139,13 +236,54 @@ static error_t arg_parser(int key, char *arg, struct argp_state *state) {
 
 static struct argp argp = { opts, arg_parser, 0, doc, 0, 0, 0 };
 
+// Replaces the SDK's logger, which writes synchronously, so that a slow
+// console or a throttled journald never holds up tunnel admission
+void gg_log(
+    GgLogLevel level,
+    const char *file,
+    int line,
+    const char *tag,
+    const char *format,
+    ...
+) {
+    va_list args;
+    va_start(args, format);
+    log_ring_vlog(level, file, line, tag, format, args);
+    va_end(args);
+}
+
 int main(int argc, char *argv[]) {
-    static SecureTunnelConfig args = { 0 };
+    startup_mark(STARTUP_MAIN);
+    static SecureTunnelConfig args = {
+        .control_socket_path = GG_STR(CONTROL_SOCKET_DEFAULT_PATH),
+        .journal_path = GG_STR(JOURNAL_DEFAULT_PATH),
+    };
 
     // NOLINTNEXTLINE(concurrency-mt-unsafe)
     argp_parse(&argp, argc, argv, 0, 0, &args);
+    startup_mark(STARTUP_ARGS);
+
+    // Forked while this process is still small and single-threaded
+    if (secure_tunnel_manager_start_launcher() != GG_ERR_OK) {
+        GG_LOGW("localproxy launcher unavailable; forking directly");
+    }
+    startup_mark(STARTUP_LAUNCHER);
+
+    // Before any other thread exists so SIGUSR1 stays blocked in all of them
+    if (trace_init() != GG_ERR_OK) {
+        GG_LOGW("Tunnel tracing export unavailable");
+    }
+
+    if (log_ring_start(STDERR_FILENO) == GG_ERR_OK) {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe)
+        atexit(log_ring_flush);
+    } else {
+        GG_LOGW("Asynchronous logging unavailable; logging synchronously");
+    }
+    startup_mark(STARTUP_LOGGING);
 
     gg_sdk_init();
+    startup_mark(STARTUP_SDK);
 
     GG_LOGI("Starting Secure Tunnel component");
     GG_LOGI(
@@ -154,11 +292,23 @@ int main(int argc, char *argv[]) {
     GG_LOGI("Max concurrent tunnels: %d", args.max_concurrent_tunnels);
     GG_LOGI("Tunnel timeout: %d seconds", args.tunnel_timeout_seconds);
 
-    if (run_secure_tunnel(&args) != GG_ERR_OK) {
+    static SecureTunnelManager manager;
+    if (secure_tunnel_manager_init(&manager, &args, NULL) != GG_ERR_OK) {
+        GG_LOGE("Failed to run secure tunnel");
+        return 1;
+    }
+    startup_mark(STARTUP_MANAGER);
+    if (secure_tunnel_manager_subscribe(&manager) != GG_ERR_OK) {
         GG_LOGE("Failed to run secure tunnel");
         return 1;
     }
 
+    if (args.control_socket_path.len > 0
+        && control_socket_start((const char *) args.control_socket_path.data)
+            != GG_ERR_OK) {
+        GG_LOGW("Local tunnel control unavailable");
+    }
+
     // Keep subscription alive
     GG_LOGI("Secure tunnel running, waiting for notifications...");
     while (true) {
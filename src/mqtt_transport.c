@@ -0,0 +1,702 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "mqtt_transport.h"
+#include "startup.h"
+#include "tunnel_clock.h"
+#include <errno.h>
+#include <gg/buffer.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Room for the old and the new gateway things while they change
+#define MQTT_MAX_SUBSCRIPTIONS 40
+#define MQTT_MAX_TOPIC 256
+#define MQTT_MAX_PACKET 8192
+#define MQTT_KEEPALIVE_S 60
+#define MQTT_IO_TIMEOUT_S 30
+#define MQTT_BACKOFF_MAX_S 64
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_PINGREQ 0xC0
+
+// AWS IoT Core serves MQTT with client certificates on port 443 under this
+// ALPN protocol
+static const uint8_t IOT_CORE_ALPN[] = "\x0ex-amzn-mqtt-ca";
+
+typedef struct {
+    char topic[MQTT_MAX_TOPIC];
+    size_t len;
+    MqttMessageCallback callback;
+    void *ctx;
+} MqttSubscription;
+
+typedef struct {
+    int fd;
+    SSL *ssl; // NULL for a plain TCP connection
+} MqttConnection;
+
+// The subscription table changes when gateway things are reconfigured, and
+// the options when the mqtt* keys are. Each change reconnects, since the clean
+// session then holds exactly the new set.
+static pthread_mutex_t transport_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t transport_cond; // Signalled when the options change
+static MqttSubscription subscriptions[MQTT_MAX_SUBSCRIPTIONS];
+static size_t subscription_count = 0;
+static bool resubscribe_requested = false;
+static int connection_fd = -1; // Shut down to end the live connection early
+static char option_host[256];
+static char option_port[8];
+static char option_client_id[128];
+static SSL_CTX *option_tls_ctx = NULL;
+static bool transport_enabled = false;
+static bool options_changed = false;
+
+// Topics the live connection subscribed to, used only by the transport thread
+static MqttSubscription subscribed[MQTT_MAX_SUBSCRIPTIONS];
+static size_t subscribed_count = 0;
+
+// The options the live connection was made with, used only by the transport
+// thread. It holds its own reference to tls_ctx.
+static char broker_host[sizeof(option_host)];
+static char broker_port[sizeof(option_port)];
+static char client_id[sizeof(option_client_id)];
+static SSL_CTX *tls_ctx = NULL;
+
+static bool transport_started = false; // Only used by mqtt_transport_start
+
+static uint8_t packet[MQTT_MAX_PACKET];
+
+// Matches a topic against a filter with + and # wildcards
+static bool topic_matches(GgBuffer filter, GgBuffer topic) {
+    size_t f = 0;
+    size_t t = 0;
+    while (f < filter.len) {
+        if (filter.data[f] == '#') {
+            return true;
+        }
+        if (filter.data[f] == '+') {
+            while (t < topic.len && topic.data[t] != '/') {
+                t++;
+            }
+            f++;
+            continue;
+        }
+        if (t >= topic.len || filter.data[f] != topic.data[t]) {
+            return false;
+        }
+        f++;
+        t++;
+    }
+    return t == topic.len;
+}
+
+static void connection_close(MqttConnection *conn) {
+    if (conn->ssl != NULL) {
+        SSL_free(conn->ssl);
+        conn->ssl = NULL;
+    }
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+}
+
+static bool connection_write(
+    MqttConnection *conn, const uint8_t *data, size_t len
+) {
+    while (len > 0) {
+        ssize_t written;
+        if (conn->ssl != NULL) {
+            int ret = SSL_write(conn->ssl, data, (int) len);
+            written = ret > 0 ? ret : -1;
+        } else {
+            written = send(conn->fd, data, len, MSG_NOSIGNAL);
+            if (written == -1 && errno == EINTR) {
+                continue;
+            }
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        len -= (size_t) written;
+    }
+    return true;
+}
+
+static bool connection_read(MqttConnection *conn, uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t got;
+        if (conn->ssl != NULL) {
+            int ret = SSL_read(conn->ssl, data, (int) len);
+            got = ret > 0 ? ret : -1;
+        } else {
+            got = recv(conn->fd, data, len, 0);
+            if (got == -1 && errno == EINTR) {
+                continue;
+            }
+        }
+        if (got <= 0) {
+            return false;
+        }
+        data += got;
+        len -= (size_t) got;
+    }
+    return true;
+}
+
+// Waits up to timeout_ms for the start of the next packet
+static bool connection_readable(MqttConnection *conn, int timeout_ms) {
+    if (conn->ssl != NULL && SSL_pending(conn->ssl) > 0) {
+        return true;
+    }
+    struct pollfd pfd = { .fd = conn->fd, .events = POLLIN };
+    int ret;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret == -1 && errno == EINTR);
+    return ret > 0;
+}
+
+static size_t encode_remaining_length(uint8_t *out, size_t len) {
+    size_t count = 0;
+    do {
+        uint8_t byte = (uint8_t) (len % 128);
+        len /= 128;
+        out[count++] = len > 0 ? (uint8_t) (byte | 0x80) : byte;
+    } while (len > 0);
+    return count;
+}
+
+static size_t put_string(uint8_t *out, const char *str, size_t len) {
+    out[0] = (uint8_t) (len >> 8);
+    out[1] = (uint8_t) len;
+    memcpy(&out[2], str, len);
+    return len + 2;
+}
+
+// Sends a packet whose body is body_len bytes of body
+static bool send_packet(
+    MqttConnection *conn, uint8_t type, const uint8_t *body, size_t body_len
+) {
+    uint8_t header[5] = { type };
+    size_t header_len = 1 + encode_remaining_length(&header[1], body_len);
+    return connection_write(conn, header, header_len)
+        && (body_len == 0 || connection_write(conn, body, body_len));
+}
+
+// Reads one packet into packet. Oversized packets are skipped and reported
+// with a length of SIZE_MAX.
+static bool read_packet(MqttConnection *conn, uint8_t *type, size_t *len) {
+    if (!connection_read(conn, type, 1)) {
+        return false;
+    }
+    size_t remaining = 0;
+    for (size_t shift = 0;; shift += 7) {
+        uint8_t byte;
+        if (shift > 21 || !connection_read(conn, &byte, 1)) {
+            return false;
+        }
+        remaining |= (size_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    if (remaining <= sizeof(packet)) {
+        *len = remaining;
+        return connection_read(conn, packet, remaining);
+    }
+    GG_LOGW("Skipping %zu byte MQTT packet", remaining);
+    while (remaining > 0) {
+        size_t chunk = remaining < sizeof(packet) ? remaining : sizeof(packet);
+        if (!connection_read(conn, packet, chunk)) {
+            return false;
+        }
+        remaining -= chunk;
+    }
+    *len = SIZE_MAX;
+    return true;
+}
+
+static bool open_socket(MqttConnection *conn) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC,
+                              .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addrs = NULL;
+    int ret = getaddrinfo(broker_host, broker_port, &hints, &addrs);
+    if (ret != 0) {
+        GG_LOGW("Failed to resolve %s: %s", broker_host, gai_strerror(ret));
+        return false;
+    }
+    for (struct addrinfo *addr = addrs; addr != NULL; addr = addr->ai_next) {
+        int fd = socket(
+            addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol
+        );
+        if (fd == -1) {
+            continue;
+        }
+        if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+            conn->fd = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(addrs);
+    if (conn->fd == -1) {
+        GG_LOGW("Failed to connect to %s:%s", broker_host, broker_port);
+        return false;
+    }
+
+    // A stalled broker fails the connection instead of the transport thread
+    struct timeval timeout = { .tv_sec = MQTT_IO_TIMEOUT_S };
+    (void) setsockopt(
+        conn->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)
+    );
+    (void) setsockopt(
+        conn->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)
+    );
+    int one = 1;
+    (void) setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return true;
+}
+
+static bool start_tls(MqttConnection *conn) {
+    conn->ssl = SSL_new(tls_ctx);
+    if (conn->ssl == NULL || SSL_set_fd(conn->ssl, conn->fd) != 1
+        || SSL_set_tlsext_host_name(conn->ssl, broker_host) != 1
+        || SSL_set1_host(conn->ssl, broker_host) != 1) {
+        GG_LOGE("Failed to set up TLS connection");
+        return false;
+    }
+    if (strcmp(broker_port, "443") == 0
+        && SSL_set_alpn_protos(
+               conn->ssl, IOT_CORE_ALPN, sizeof(IOT_CORE_ALPN) - 1
+           ) != 0) {
+        GG_LOGE("Failed to set MQTT ALPN protocol");
+        return false;
+    }
+    if (SSL_connect(conn->ssl) != 1) {
+        GG_LOGW(
+            "TLS handshake with %s failed: %s",
+            broker_host,
+            ERR_reason_error_string(ERR_get_error())
+        );
+        return false;
+    }
+    return true;
+}
+
+static bool mqtt_connect(MqttConnection *conn) {
+    size_t id_len = strlen(client_id);
+    uint8_t body[12 + sizeof(client_id)] = {
+        0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, MQTT_KEEPALIVE_S
+    };
+    size_t len = 10 + put_string(&body[10], client_id, id_len);
+    if (!send_packet(conn, MQTT_CONNECT, body, len)) {
+        return false;
+    }
+
+    uint8_t type;
+    if (!connection_readable(conn, MQTT_IO_TIMEOUT_S * 1000)
+        || !read_packet(conn, &type, &len)) {
+        GG_LOGW("No CONNACK from %s", broker_host);
+        return false;
+    }
+    if ((type & 0xF0) != MQTT_CONNACK || len != 2 || packet[1] != 0) {
+        GG_LOGW(
+            "MQTT connection refused by %s: %u",
+            broker_host,
+            len == 2 ? packet[1] : 0xFFU
+        );
+        return false;
+    }
+    return true;
+}
+
+static bool mqtt_subscribe_all(MqttConnection *conn) {
+    {
+        GG_MTX_SCOPE_GUARD(&transport_mutex);
+        memcpy(subscribed, subscriptions, sizeof(subscribed));
+        subscribed_count = subscription_count;
+        resubscribe_requested = false;
+    }
+
+    // One topic per SUBSCRIBE stays below AWS IoT Core's per-request limit
+    for (size_t i = 0; i < subscribed_count; i++) {
+        uint16_t packet_id = (uint16_t) (i + 1);
+        uint8_t body[MQTT_MAX_TOPIC + 5] = { (uint8_t) (packet_id >> 8),
+                                             (uint8_t) packet_id };
+        const MqttSubscription *sub = &subscribed[i];
+        size_t len = 2 + put_string(&body[2], sub->topic, sub->len);
+        body[len++] = 1; // QoS 1
+        if (!send_packet(conn, MQTT_SUBSCRIBE, body, len)) {
+            return false;
+        }
+    }
+    GG_LOGI(
+        "Subscribed to %zu topics on %s over MQTT",
+        subscribed_count,
+        broker_host
+    );
+    return true;
+}
+
+static void dispatch_publish(MqttConnection *conn, uint8_t type, size_t len) {
+    uint8_t qos = (uint8_t) ((type >> 1) & 0x03);
+    size_t topic_len = len >= 2 ? ((size_t) packet[0] << 8) | packet[1] : 0;
+    size_t offset = 2 + topic_len + (qos > 0 ? 2 : 0);
+    if (len < 2 || offset > len) {
+        GG_LOGW("Malformed MQTT PUBLISH");
+        return;
+    }
+    GgBuffer topic = { .data = &packet[2], .len = topic_len };
+    GgBuffer payload = { .data = &packet[offset], .len = len - offset };
+
+    // Acknowledged first, so a slow launch does not make the broker resend
+    if (qos > 0) {
+        uint8_t ack[2] = { packet[2 + topic_len], packet[3 + topic_len] };
+        (void) send_packet(conn, MQTT_PUBACK, ack, sizeof(ack));
+    }
+
+    for (size_t i = 0; i < subscribed_count; i++) {
+        GgBuffer filter = { .data = (uint8_t *) subscribed[i].topic,
+                            .len = subscribed[i].len };
+        if (topic_matches(filter, topic)) {
+            subscribed[i].callback(subscribed[i].ctx, topic, payload);
+            return;
+        }
+    }
+}
+
+// Serves one connection until it fails
+static void run_connection(MqttConnection *conn) {
+    int64_t last_sent = tunnel_clock_system_ms();
+    int64_t last_received = last_sent;
+
+    while (true) {
+        int64_t now = tunnel_clock_system_ms();
+        if (now - last_received > 2 * MQTT_KEEPALIVE_S * 1000LL) {
+            GG_LOGW("MQTT broker %s stopped responding", broker_host);
+            return;
+        }
+        int64_t ping_due = last_sent + MQTT_KEEPALIVE_S * 1000LL / 2;
+        if (now >= ping_due) {
+            if (!send_packet(conn, MQTT_PINGREQ, NULL, 0)) {
+                return;
+            }
+            last_sent = now;
+            continue;
+        }
+        if (!connection_readable(conn, (int) (ping_due - now))) {
+            continue;
+        }
+
+        uint8_t type;
+        size_t len;
+        if (!read_packet(conn, &type, &len)) {
+            return;
+        }
+        last_received = tunnel_clock_system_ms();
+        if (len == SIZE_MAX) {
+            continue;
+        }
+        switch (type & 0xF0) {
+        case MQTT_PUBLISH:
+            dispatch_publish(conn, type, len);
+            last_sent = tunnel_clock_system_ms();
+            break;
+        case MQTT_SUBACK:
+            if (len >= 3 && packet[2] == 0x80) {
+                GG_LOGE("MQTT broker refused a tunnel notification topic");
+            } else if (len >= 3
+                       && (((size_t) packet[0] << 8) | packet[1])
+                           == subscribed_count) {
+                // Only the first connection's acknowledgement counts
+                startup_mark(STARTUP_READY);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Waits until the transport is enabled and takes the options to connect with
+static void take_options(void) {
+    GG_MTX_SCOPE_GUARD(&transport_mutex);
+    while (!transport_enabled) {
+        pthread_cond_wait(&transport_cond, &transport_mutex);
+    }
+    options_changed = false;
+    memcpy(broker_host, option_host, sizeof(broker_host));
+    memcpy(broker_port, option_port, sizeof(broker_port));
+    memcpy(client_id, option_client_id, sizeof(client_id));
+    if (tls_ctx != option_tls_ctx) {
+        SSL_CTX_free(tls_ctx);
+        tls_ctx = option_tls_ctx;
+        if (tls_ctx != NULL) {
+            SSL_CTX_up_ref(tls_ctx);
+        }
+    }
+}
+
+// Sleeps before the next connection attempt, unless the options change
+static void wait_before_retry(unsigned seconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += seconds;
+    GG_MTX_SCOPE_GUARD(&transport_mutex);
+    while (!options_changed) {
+        if (pthread_cond_timedwait(&transport_cond, &transport_mutex, &deadline)
+            == ETIMEDOUT) {
+            return;
+        }
+    }
+}
+
+static void *transport_thread(void *arg) {
+    (void) arg;
+    unsigned backoff = 1;
+
+    while (true) {
+        take_options();
+        MqttConnection conn = { .fd = -1 };
+        if (open_socket(&conn)) {
+            GG_MTX_SCOPE_GUARD(&transport_mutex);
+            connection_fd = conn.fd;
+            // The options changed while connecting
+            if (options_changed) {
+                (void) shutdown(conn.fd, SHUT_RDWR);
+            }
+        }
+        bool connected = conn.fd >= 0 && (tls_ctx == NULL || start_tls(&conn))
+            && mqtt_connect(&conn) && mqtt_subscribe_all(&conn);
+        if (connected) {
+            backoff = 1;
+            run_connection(&conn);
+        }
+
+        bool reconnect;
+        {
+            GG_MTX_SCOPE_GUARD(&transport_mutex);
+            connection_fd = -1;
+            reconnect = options_changed || (connected && resubscribe_requested);
+        }
+        connection_close(&conn);
+        if (reconnect) {
+            GG_LOGI("Reconnecting to %s to apply changes", broker_host);
+            backoff = 1;
+            continue;
+        }
+        if (connected) {
+            GG_LOGW("MQTT connection to %s lost", broker_host);
+        }
+
+        wait_before_retry(backoff);
+        backoff = backoff < MQTT_BACKOFF_MAX_S ? backoff * 2 : backoff;
+    }
+
+    return NULL;
+}
+
+static GgError load_tls_credentials(
+    const MqttTransportOptions *options, SSL_CTX **ctx
+) {
+    *ctx = SSL_CTX_new(TLS_client_method());
+    if (*ctx == NULL) {
+        return GG_ERR_NOMEM;
+    }
+    bool loaded
+        = SSL_CTX_set_min_proto_version(*ctx, TLS1_2_VERSION) == 1
+        && SSL_CTX_use_certificate_chain_file(*ctx, options->cert_path) == 1
+        && SSL_CTX_use_PrivateKey_file(
+               *ctx, options->key_path, SSL_FILETYPE_PEM
+           ) == 1
+        && (options->root_ca_path[0] == '\0'
+                ? SSL_CTX_set_default_verify_paths(*ctx)
+                : SSL_CTX_load_verify_locations(
+                      *ctx, options->root_ca_path, NULL
+                  ))
+            == 1;
+    if (!loaded) {
+        GG_LOGE(
+            "Failed to load MQTT TLS credentials: %s",
+            ERR_reason_error_string(ERR_get_error())
+        );
+        SSL_CTX_free(*ctx);
+        *ctx = NULL;
+        return GG_ERR_CONFIG;
+    }
+    SSL_CTX_set_verify(*ctx, SSL_VERIFY_PEER, NULL);
+    return GG_ERR_OK;
+}
+
+// Ends the live connection so the next one subscribes to the changed table.
+// Caller holds transport_mutex.
+static void request_resubscribe(void) {
+    resubscribe_requested = true;
+    if (connection_fd >= 0) {
+        (void) shutdown(connection_fd, SHUT_RDWR);
+    }
+}
+
+// Ends the live connection, or the wait before the next one, so the changed
+// options take effect. Caller holds transport_mutex.
+static void request_reconnect(void) {
+    options_changed = true;
+    if (connection_fd >= 0) {
+        (void) shutdown(connection_fd, SHUT_RDWR);
+    }
+    pthread_cond_broadcast(&transport_cond);
+}
+
+GgError mqtt_transport_subscribe(
+    GgBuffer topic_filter, MqttMessageCallback callback, void *ctx
+) {
+    if (topic_filter.len == 0 || topic_filter.len >= MQTT_MAX_TOPIC) {
+        return GG_ERR_RANGE;
+    }
+    GG_MTX_SCOPE_GUARD(&transport_mutex);
+    if (subscription_count >= MQTT_MAX_SUBSCRIPTIONS) {
+        return GG_ERR_NOMEM;
+    }
+    MqttSubscription *sub = &subscriptions[subscription_count++];
+    memcpy(sub->topic, topic_filter.data, topic_filter.len);
+    sub->len = topic_filter.len;
+    sub->callback = callback;
+    sub->ctx = ctx;
+    request_resubscribe();
+    return GG_ERR_OK;
+}
+
+GgError mqtt_transport_unsubscribe(GgBuffer topic_filter) {
+    GG_MTX_SCOPE_GUARD(&transport_mutex);
+    for (size_t i = 0; i < subscription_count; i++) {
+        GgBuffer filter = { .data = (uint8_t *) subscriptions[i].topic,
+                            .len = subscriptions[i].len };
+        if (gg_buffer_eq(filter, topic_filter)) {
+            memmove(
+                &subscriptions[i],
+                &subscriptions[i + 1],
+                (subscription_count - i - 1) * sizeof(subscriptions[0])
+            );
+            subscription_count--;
+            request_resubscribe();
+            return GG_ERR_OK;
+        }
+    }
+    return GG_ERR_NOENTRY;
+}
+
+GgError mqtt_transport_start(const MqttTransportOptions *options) {
+    bool tls = options->cert_path[0] != '\0';
+    const char *colon = strrchr(options->endpoint, ':');
+    size_t host_len
+        = colon != NULL ? (size_t) (colon - options->endpoint)
+                        : strlen(options->endpoint);
+    char host[sizeof(option_host)];
+    char port[sizeof(option_port)];
+    int written = snprintf(
+        port,
+        sizeof(port),
+        "%s",
+        colon != NULL ? colon + 1 : (tls ? MQTT_TLS_PORT : MQTT_PLAIN_PORT)
+    );
+    if (host_len == 0 || host_len >= sizeof(host) || written <= 0
+        || (size_t) written >= sizeof(port)
+        || strlen(options->client_id) >= sizeof(option_client_id)) {
+        GG_LOGE("Invalid MQTT endpoint: %s", options->endpoint);
+        return GG_ERR_INVALID;
+    }
+    memcpy(host, options->endpoint, host_len);
+    host[host_len] = '\0';
+
+    // Loaded before the live connection is touched, so bad credentials
+    // leave it running
+    SSL_CTX *ctx = NULL;
+    if (tls) {
+        GgError ret = load_tls_credentials(options, &ctx);
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    } else {
+        GG_LOGW(
+            "Connecting to MQTT broker %s without TLS; only use this for a "
+            "local broker",
+            host
+        );
+    }
+
+    if (!transport_started) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&transport_cond, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+
+    {
+        GG_MTX_SCOPE_GUARD(&transport_mutex);
+        memcpy(option_host, host, sizeof(option_host));
+        memcpy(option_port, port, sizeof(option_port));
+        memcpy(
+            option_client_id,
+            options->client_id,
+            strlen(options->client_id) + 1
+        );
+        // The transport thread holds its own reference while it uses one
+        SSL_CTX_free(option_tls_ctx);
+        option_tls_ctx = ctx;
+        transport_enabled = true;
+        request_reconnect();
+    }
+
+    if (transport_started) {
+        return GG_ERR_OK;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, transport_thread, NULL) != 0) {
+        GG_LOGE("Failed to create MQTT transport thread");
+        return GG_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+    transport_started = true;
+    return GG_ERR_OK;
+}
+
+void mqtt_transport_stop(void) {
+    GG_MTX_SCOPE_GUARD(&transport_mutex);
+    if (transport_enabled) {
+        transport_enabled = false;
+        request_reconnect();
+    }
+}
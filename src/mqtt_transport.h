@@ -0,0 +1,57 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_MQTT_TRANSPORT_H
+#define ST_MQTT_TRANSPORT_H
+
+#include <gg/buffer.h>
+#include <gg/error.h>
+
+#define MQTT_TLS_PORT "8883"
+#define MQTT_PLAIN_PORT "1883"
+
+// Null terminated strings describing the broker connection
+typedef struct {
+    const char *endpoint; // host, or host:port
+    const char *client_id;
+    // Device certificate chain and key. Empty connects without TLS, which is
+    // only meant for a local broker.
+    const char *cert_path;
+    const char *key_path;
+    const char *root_ca_path; // Empty uses the system trust store
+} MqttTransportOptions;
+
+// Called on the transport thread for each message on a subscribed topic
+typedef void (*MqttMessageCallback)(
+    void *ctx, GgBuffer topic, GgBuffer payload
+);
+
+// Registers a QoS 1 subscription. Subscriptions are made on every connection;
+// one registered after mqtt_transport_start reconnects to take effect.
+GgError mqtt_transport_subscribe(
+    GgBuffer topic_filter, MqttMessageCallback callback, void *ctx
+);
+
+// Removes the subscription registered for topic_filter, reconnecting if the
+// transport is running.
+GgError mqtt_transport_unsubscribe(GgBuffer topic_filter);
+
+// Connects to the broker from a background thread and keeps reconnecting with
+// backoff whenever the connection is lost. Fails only if the options are
+// invalid or the TLS credentials cannot be loaded. Called again when the
+// options change: the transport reconnects with the new ones, keeping its
+// subscriptions, and a failed call leaves the previous options in effect.
+GgError mqtt_transport_start(const MqttTransportOptions *options);
+
+// Closes the connection until the next mqtt_transport_start. Subscriptions
+// are kept.
+void mqtt_transport_stop(void);
+
+#endif // ST_MQTT_TRANSPORT_H
@@ -0,0 +1,226 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "pressure.h"
+#include "tunnel.h"
+#include "tunnel_clock.h"
+#include "tunnel_settings.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <gg/cleanup.h>
+#include <gg/log.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Unprivileged PSI triggers need a window that is a multiple of 2 seconds
+#define PRESSURE_WINDOW_US 2000000
+#define PRESSURE_HOLD_MS 4000
+
+static pthread_mutex_t pressure_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t monitor_once = PTHREAD_ONCE_INIT;
+static int wake_pipe[2] = { -1, -1 };
+// Requested thresholds, applied by the monitor when the generation changes
+static int pressure_percent[PRESSURE_RESOURCE_COUNT];
+static uint32_t pressure_generation = 0;
+
+static _Atomic int pressure_nice = 0;
+static _Atomic int64_t pressure_until_ms[PRESSURE_RESOURCE_COUNT];
+
+bool pressure_active(PressureResource *resource) {
+    int64_t now = tunnel_clock_system_ms();
+    for (int i = 0; i < PRESSURE_RESOURCE_COUNT; i++) {
+        if (atomic_load_explicit(&pressure_until_ms[i], memory_order_relaxed)
+            > now) {
+            *resource = (PressureResource) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Only raises nice values: lowering them again needs CAP_SYS_NICE. Tunnels in
+// a latency class keep the priority it gave them.
+static void renice_tunnels(int nice) {
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    size_t count = tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+    for (size_t i = 0; i < count; i++) {
+        if (tunnels[i].pid <= 0 || tunnels[i].latency_class) {
+            continue;
+        }
+        errno = 0;
+        int current = getpriority(PRIO_PROCESS, (id_t) tunnels[i].pid);
+        if (errno == 0 && current < nice) {
+            (void) setpriority(PRIO_PROCESS, (id_t) tunnels[i].pid, nice);
+        }
+    }
+}
+
+static void on_pressure(PressureResource resource, int percent) {
+    int64_t now = tunnel_clock_system_ms();
+    int64_t until = atomic_exchange_explicit(
+        &pressure_until_ms[resource],
+        now + PRESSURE_HOLD_MS,
+        memory_order_relaxed
+    );
+    if (until <= now) {
+        GG_LOGW(
+            "%s pressure above %d%%; holding back new tunnels",
+            pressure_resource_name(resource),
+            percent
+        );
+    }
+    int nice = atomic_load_explicit(&pressure_nice, memory_order_relaxed);
+    if (nice > 0) {
+        renice_tunnels(nice);
+    }
+}
+
+static int arm_trigger(PressureResource resource, int percent) {
+    char path[32];
+    snprintf(
+        path,
+        sizeof(path),
+        "/proc/pressure/%s",
+        pressure_resource_name(resource)
+    );
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        GG_LOGW(
+            "PSI unavailable for %s: %d",
+            pressure_resource_name(resource),
+            errno
+        );
+        return -1;
+    }
+    char trigger[48];
+    int len = snprintf(
+        trigger,
+        sizeof(trigger),
+        "some %d %d",
+        percent * (PRESSURE_WINDOW_US / 100),
+        PRESSURE_WINDOW_US
+    );
+    if (write(fd, trigger, (size_t) len + 1) == -1) {
+        GG_LOGW(
+            "Failed to arm PSI trigger for %s: %d",
+            pressure_resource_name(resource),
+            errno
+        );
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void *pressure_monitor_thread(void *arg) {
+    (void) arg;
+    int fds[PRESSURE_RESOURCE_COUNT] = { -1, -1, -1 };
+    int percent[PRESSURE_RESOURCE_COUNT] = { 0 };
+    uint32_t armed_generation = 0;
+
+    while (true) {
+        pthread_mutex_lock(&pressure_mutex);
+        bool changed = armed_generation != pressure_generation;
+        armed_generation = pressure_generation;
+        memcpy(percent, pressure_percent, sizeof(percent));
+        pthread_mutex_unlock(&pressure_mutex);
+
+        if (changed) {
+            for (int i = 0; i < PRESSURE_RESOURCE_COUNT; i++) {
+                if (fds[i] != -1) {
+                    close(fds[i]);
+                }
+                fds[i] = percent[i] > 0
+                    ? arm_trigger((PressureResource) i, percent[i])
+                    : -1;
+                atomic_store_explicit(
+                    &pressure_until_ms[i], 0, memory_order_relaxed
+                );
+            }
+        }
+
+        struct pollfd pfds[PRESSURE_RESOURCE_COUNT + 1]
+            = { { .fd = wake_pipe[0], .events = POLLIN } };
+        for (int i = 0; i < PRESSURE_RESOURCE_COUNT; i++) {
+            pfds[i + 1] = (struct pollfd) { .fd = fds[i], .events = POLLPRI };
+        }
+        if (poll(pfds, PRESSURE_RESOURCE_COUNT + 1, -1) == -1) {
+            continue;
+        }
+
+        if ((pfds[0].revents & POLLIN) != 0) {
+            char drain[16];
+            (void) read(wake_pipe[0], drain, sizeof(drain));
+        }
+        for (int i = 0; i < PRESSURE_RESOURCE_COUNT; i++) {
+            if ((pfds[i + 1].revents & POLLERR) != 0) {
+                GG_LOGW(
+                    "PSI trigger for %s stopped",
+                    pressure_resource_name((uint32_t) i)
+                );
+                close(fds[i]);
+                fds[i] = -1;
+            } else if ((pfds[i + 1].revents & POLLPRI) != 0) {
+                on_pressure((PressureResource) i, percent[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void start_monitor(void) {
+    if (pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        GG_LOGE("Failed to create pressure monitor pipe");
+        return;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, pressure_monitor_thread, NULL) != 0) {
+        GG_LOGE("Failed to create pressure monitor thread");
+        return;
+    }
+    pthread_detach(thread);
+}
+
+void pressure_configure(const int percent[PRESSURE_RESOURCE_COUNT], int nice) {
+    atomic_store_explicit(&pressure_nice, nice, memory_order_relaxed);
+
+    bool enabled = false;
+    for (int i = 0; i < PRESSURE_RESOURCE_COUNT; i++) {
+        enabled = enabled || percent[i] > 0;
+    }
+    if (enabled) {
+        pthread_once(&monitor_once, start_monitor);
+    }
+
+    GG_MTX_SCOPE_GUARD(&pressure_mutex);
+    if (memcmp(pressure_percent, percent, sizeof(pressure_percent)) == 0) {
+        return;
+    }
+    memcpy(pressure_percent, percent, sizeof(pressure_percent));
+    pressure_generation++;
+    if (wake_pipe[1] != -1) {
+        (void) write(wake_pipe[1], "", 1);
+    } else {
+        // No monitor yet, so no trigger can be armed
+        for (int i = 0; i < PRESSURE_RESOURCE_COUNT; i++) {
+            atomic_store_explicit(
+                &pressure_until_ms[i], 0, memory_order_relaxed
+            );
+        }
+    }
+}
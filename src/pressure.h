@@ -0,0 +1,45 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_PRESSURE_H
+#define ST_PRESSURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    PRESSURE_CPU,
+    PRESSURE_MEMORY,
+    PRESSURE_IO,
+    PRESSURE_RESOURCE_COUNT,
+} PressureResource;
+
+// Arms a PSI trigger for every resource with a non-zero percent: the resource
+// counts as under pressure once some task stalled on it for that share of a
+// 2 second window, and until no trigger fired for two windows. While under
+// pressure, running localproxy processes outside a latency class are reniced
+// to nice if it is non-zero. Triggers are re-armed only when the percentages
+// change.
+void pressure_configure(const int percent[PRESSURE_RESOURCE_COUNT], int nice);
+
+// Returns whether a resource is under pressure and stores the first one in
+// resource. Lock-free.
+bool pressure_active(PressureResource *resource);
+
+static inline const char *pressure_resource_name(uint32_t resource) {
+    static const char *const NAMES[PRESSURE_RESOURCE_COUNT] = {
+        [PRESSURE_CPU] = "cpu",
+        [PRESSURE_MEMORY] = "memory",
+        [PRESSURE_IO] = "io",
+    };
+    return resource < PRESSURE_RESOURCE_COUNT ? NAMES[resource] : "unknown";
+}
+
+#endif // ST_PRESSURE_H
@@ -0,0 +1,402 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "proxy_host.h"
+#include "launcher.h"
+#include "tunnel_settings.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <gg/buffer.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROXY_HOST_LOG_LEVEL "2" // 2=warnings/errors, 4=debug
+#define PROXY_HOST_MESSAGE_MAX 1536
+
+typedef struct {
+    uint64_t id; // Names the tunnel in messages; slots are reused
+    bool open;
+    bool exited;
+    int status;
+    uint64_t read_bytes;
+    uint64_t written_bytes;
+} HostedTunnel;
+
+static pthread_mutex_t host_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_cond;
+static pthread_once_t host_cond_once = PTHREAD_ONCE_INIT;
+static int host_fd = -1;
+static pid_t host_pid = 0;
+static uint64_t next_tunnel_id = 1;
+static HostedTunnel hosted[TUNNEL_MAX_SLOTS];
+
+static void init_host_cond(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&host_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static bool build_host_path(GgBuffer artifact_path, char *path, size_t len) {
+    int written = snprintf(
+        path,
+        len,
+        "%.*s/" PROXY_HOST_BINARY,
+        (int) artifact_path.len,
+        artifact_path.data
+    );
+    return written > 0 && (size_t) written < len;
+}
+
+bool proxy_host_present(GgBuffer artifact_path) {
+    char path[512];
+    return build_host_path(artifact_path, path, sizeof(path))
+        && faccessat(AT_FDCWD, path, X_OK, 0) == 0;
+}
+
+// Returns the open tunnel with id, or NULL for one that was already waited
+// for or abandoned. Caller holds host_mutex.
+static HostedTunnel *find_tunnel(uint64_t id) {
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        if (hosted[slot].open && hosted[slot].id == id) {
+            return &hosted[slot];
+        }
+    }
+    return NULL;
+}
+
+// Applies one message from the host. Caller holds host_mutex.
+static void handle_host_message(char *message) {
+    unsigned long long id = 0;
+    long long first = 0;
+    long long second = 0;
+    HostedTunnel *tunnel = NULL;
+    if (sscanf(message, "EXIT %llu %lld", &id, &first) == 2) {
+        tunnel = find_tunnel(id);
+        if (tunnel != NULL && !tunnel->exited) {
+            tunnel->exited = true;
+            tunnel->status = first >= 0 && first <= 255
+                ? (int) first << 8
+                : 1 << 8;
+        }
+    } else if (sscanf(message, "STATS %llu %lld %lld", &id, &first, &second)
+               == 3) {
+        tunnel = find_tunnel(id);
+        if (tunnel != NULL) {
+            tunnel->read_bytes = (uint64_t) first;
+            tunnel->written_bytes = (uint64_t) second;
+        }
+    } else {
+        GG_LOGW("Ignoring unknown localproxy host message");
+    }
+}
+
+// Marks every tunnel the host still serves as ended. Caller holds host_mutex.
+static void end_hosted_tunnels(int status) {
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        if (hosted[slot].open && !hosted[slot].exited) {
+            hosted[slot].exited = true;
+            hosted[slot].status = status;
+        }
+    }
+    pthread_cond_broadcast(&host_cond);
+}
+
+static void *host_reader_thread(void *arg) {
+    int fd = (int) (intptr_t) arg;
+    char message[PROXY_HOST_MESSAGE_MAX];
+    pid_t pid;
+    {
+        // start_host publishes the pid before releasing host_mutex
+        GG_MTX_SCOPE_GUARD(&host_mutex);
+        pid = host_pid;
+    }
+
+    while (true) {
+        ssize_t len = recv(fd, message, sizeof(message) - 1, 0);
+        if (len == -1 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            break;
+        }
+        message[len] = '\0';
+        GG_MTX_SCOPE_GUARD(&host_mutex);
+        handle_host_message(message);
+        pthread_cond_broadcast(&host_cond);
+    }
+
+    // The host is gone, and so are the tunnels it served. An abandoned host
+    // was already detached, and a new one may be running.
+    {
+        GG_MTX_SCOPE_GUARD(&host_mutex);
+        if (host_fd == fd) {
+            GG_LOGW("localproxy host exited");
+            end_hosted_tunnels(1 << 8);
+            host_fd = -1;
+            host_pid = 0;
+        }
+    }
+    close(fd);
+    (void) waitpid(pid, NULL, 0);
+    return NULL;
+}
+
+// Forks the host from this process when the launcher is unavailable
+static pid_t fork_host(
+    int exe_fd, const char *const *args, int control_fd, int status_fd
+) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() == 1) {
+            _exit(1);
+        }
+        // dup2 clears close-on-exec for the host's end only
+        if (dup2(control_fd, LAUNCHER_CONTROL_FD) == -1) {
+            _exit(1);
+        }
+        sigset_t none;
+        sigemptyset(&none);
+        pthread_sigmask(SIG_SETMASK, &none, NULL);
+        fexecve(exe_fd, (char *const *) args, environ);
+        int exec_errno = errno;
+        (void) write(status_fd, &exec_errno, sizeof(exec_errno));
+        _exit(1);
+    }
+    return pid;
+}
+
+// Starts the host through the launcher like localproxy, executing the opened
+// file rather than its path. Returns the host's pid, or -1.
+static pid_t spawn_host(int exe_fd, int control_fd) {
+    const char *const args[] = { PROXY_HOST_BINARY,
+                                 "--control-fd",
+                                 "3", // LAUNCHER_CONTROL_FD
+                                 "-v",
+                                 PROXY_HOST_LOG_LEVEL,
+                                 NULL };
+    int exec_pipe[2];
+    if (pipe2(exec_pipe, O_CLOEXEC) != 0) {
+        GG_LOGE("Failed to create localproxy host pipe: %d", errno);
+        return -1;
+    }
+
+    pid_t pid = -1;
+    int pidfd = -1;
+    if (launcher_spawn(
+            exe_fd,
+            args,
+            "",
+            STDERR_FILENO,
+            exec_pipe[1],
+            -1,
+            control_fd,
+            NULL,
+            &pid,
+            &pidfd
+        )
+        == GG_ERR_OK) {
+        // The reader thread reaps the host with waitpid
+        if (pidfd >= 0) {
+            close(pidfd);
+        }
+    } else {
+        pid = fork_host(exe_fd, args, control_fd, exec_pipe[1]);
+    }
+    close(exec_pipe[1]);
+    GG_CLEANUP(cleanup_close, exec_pipe[0]);
+    if (pid < 0) {
+        GG_LOGE("Failed to fork localproxy host");
+        return -1;
+    }
+
+    int exec_errno = 0;
+    ssize_t len;
+    do {
+        len = read(exec_pipe[0], &exec_errno, sizeof(exec_errno));
+    } while (len == -1 && errno == EINTR);
+    if (len > 0) {
+        GG_LOGE("Failed to exec localproxy host: %d", exec_errno);
+        (void) waitpid(pid, NULL, 0);
+        return -1;
+    }
+    return pid;
+}
+
+// Caller holds host_mutex
+static GgError start_host(GgBuffer artifact_path) {
+    char path[512];
+    if (!build_host_path(artifact_path, path, sizeof(path))) {
+        GG_LOGE("Failed to build localproxy host path");
+        return GG_ERR_FAILURE;
+    }
+    int exe_fd = open(path, O_RDONLY);
+    if (exe_fd == -1) {
+        GG_LOGE("Failed to open localproxy host: %d", errno);
+        return GG_ERR_FAILURE;
+    }
+    GG_CLEANUP(cleanup_close, exe_fd);
+
+    int socks[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks) != 0) {
+        GG_LOGE("Failed to create localproxy host socket: %d", errno);
+        return GG_ERR_FAILURE;
+    }
+    pid_t pid = spawn_host(exe_fd, socks[1]);
+    close(socks[1]);
+    if (pid < 0) {
+        close(socks[0]);
+        return GG_ERR_FAILURE;
+    }
+
+    pthread_t thread;
+    if (pthread_create(
+            &thread, NULL, host_reader_thread, (void *) (intptr_t) socks[0]
+        )
+        != 0) {
+        GG_LOGE("Failed to create localproxy host reader thread");
+        close(socks[0]);
+        (void) kill(pid, SIGKILL);
+        (void) waitpid(pid, NULL, 0);
+        return GG_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+    host_fd = socks[0];
+    host_pid = pid;
+    GG_LOGI("Started localproxy host (pid %d)", (int) pid);
+    return GG_ERR_OK;
+}
+
+// Caller holds host_mutex
+static GgError send_message(const char *message, size_t len) {
+    if (host_fd == -1
+        || send(host_fd, message, len, MSG_NOSIGNAL) != (ssize_t) len) {
+        GG_LOGE("Failed to send to localproxy host");
+        return GG_ERR_FAILURE;
+    }
+    return GG_ERR_OK;
+}
+
+GgError proxy_host_open(
+    GgBuffer artifact_path,
+    int slot,
+    const char *access_token,
+    const char *region,
+    const char *destination,
+    bool multiplex,
+    pid_t *pid
+) {
+    pthread_once(&host_cond_once, init_host_cond);
+    GG_MTX_SCOPE_GUARD(&host_mutex);
+    uint64_t id = next_tunnel_id;
+    char message[PROXY_HOST_MESSAGE_MAX];
+    int len = snprintf(
+        message,
+        sizeof(message),
+        "OPEN %" PRIu64 " %s %s %s %s",
+        id,
+        region,
+        destination,
+        multiplex ? "auto" : "V1",
+        access_token
+    );
+    if (len < 0 || (size_t) len >= sizeof(message)) {
+        explicit_bzero(message, sizeof(message));
+        return GG_ERR_RANGE;
+    }
+
+    if (host_fd == -1) {
+        GgError ret = start_host(artifact_path);
+        if (ret != GG_ERR_OK) {
+            explicit_bzero(message, sizeof(message));
+            return ret;
+        }
+    }
+    next_tunnel_id++;
+    hosted[slot] = (HostedTunnel) { .id = id, .open = true };
+    GgError ret = send_message(message, (size_t) len);
+    explicit_bzero(message, sizeof(message));
+    if (ret != GG_ERR_OK) {
+        hosted[slot].open = false;
+        return ret;
+    }
+    *pid = host_pid;
+    return GG_ERR_OK;
+}
+
+bool proxy_host_wait(int slot, int64_t deadline_ms, int *status) {
+    struct timespec deadline = {
+        .tv_sec = deadline_ms / 1000,
+        .tv_nsec = (long) (deadline_ms % 1000) * 1000000,
+    };
+    GG_MTX_SCOPE_GUARD(&host_mutex);
+    while (!hosted[slot].exited) {
+        if (deadline_ms < 0) {
+            pthread_cond_wait(&host_cond, &host_mutex);
+        } else if (pthread_cond_timedwait(&host_cond, &host_mutex, &deadline)
+                   == ETIMEDOUT) {
+            return false;
+        }
+    }
+    *status = hosted[slot].status;
+    hosted[slot].open = false;
+    return true;
+}
+
+void proxy_host_stats(int slot, uint64_t *read_bytes, uint64_t *written_bytes) {
+    GG_MTX_SCOPE_GUARD(&host_mutex);
+    *read_bytes = hosted[slot].read_bytes;
+    *written_bytes = hosted[slot].written_bytes;
+}
+
+GgError proxy_host_close(int slot) {
+    GG_MTX_SCOPE_GUARD(&host_mutex);
+    if (!hosted[slot].open || hosted[slot].exited) {
+        return GG_ERR_NOENTRY;
+    }
+    char message[32];
+    int len = snprintf(
+        message, sizeof(message), "CLOSE %" PRIu64, hosted[slot].id
+    );
+    return send_message(message, (size_t) len);
+}
+
+void proxy_host_abandon(int slot) {
+    GG_MTX_SCOPE_GUARD(&host_mutex);
+    if (!hosted[slot].open || hosted[slot].exited || host_fd == -1) {
+        return;
+    }
+    // A host that ignores CLOSE cannot be trusted with its other tunnels, so
+    // it is killed like a localproxy that ignores SIGTERM. Its reader thread
+    // reaps it; the next proxy_host_open starts a new one.
+    GG_LOGE("Killing unresponsive localproxy host (pid %d)", (int) host_pid);
+    (void) kill(host_pid, SIGKILL);
+    (void) shutdown(host_fd, SHUT_RDWR);
+    host_fd = -1;
+    host_pid = 0;
+    end_hosted_tunnels(SIGKILL);
+}
@@ -0,0 +1,75 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_PROXY_HOST_H
+#define ST_PROXY_HOST_H
+
+#include <gg/error.h>
+#include <gg/object.h>
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// A localproxy host serves many tunnels from one long-lived process. When the
+// localproxyHost setting is enabled it is started from the artifact directory
+// as
+//
+//   localproxy-host --control-fd 3 -v <log level>
+//
+// and exchanges one text message per datagram over the SOCK_SEQPACKET socket
+// on fd 3. The component sends
+//
+//   OPEN <id> <region> <destination> <auto|V1> <access token>
+//   CLOSE <id>
+//
+// where id is a decimal number the component never reuses while the host
+// runs and destination is a localproxy -d value. The host replies
+//
+//   STATS <id> <bytes read> <bytes written>   (at least every 10 seconds)
+//   EXIT <id> <exit code>                     (once per OPEN)
+//
+// STATS drive the idle timeout, so a tunnel without them counts as idle.
+// Messages for an id that already ended are ignored.
+//
+// The host exits when the socket is closed, so it never outlives the
+// component.
+#define PROXY_HOST_BINARY "localproxy-host"
+
+// Returns whether the artifact directory holds an executable localproxy host
+bool proxy_host_present(GgBuffer artifact_path);
+
+// Hands a tunnel to the host, starting the host first if it is not running.
+// host_pid receives the pid of the host process.
+GgError proxy_host_open(
+    GgBuffer artifact_path,
+    int slot,
+    const char *access_token,
+    const char *region,
+    const char *destination,
+    bool multiplex,
+    pid_t *host_pid
+);
+
+// Waits until the tunnel in slot ends or deadline_ms passes (-1 waits
+// indefinitely). Returns true with the wait status of the tunnel if it ended;
+// the slot is then free for the next proxy_host_open.
+bool proxy_host_wait(int slot, int64_t deadline_ms, int *status);
+
+// Latest traffic counters the host reported for slot
+void proxy_host_stats(int slot, uint64_t *read_bytes, uint64_t *written_bytes);
+
+// Asks the host to close the tunnel in slot
+GgError proxy_host_close(int slot);
+
+// Kills a host that failed to close the tunnel in slot. Every tunnel it served
+// ends as killed by SIGKILL, and the next proxy_host_open starts a new host.
+void proxy_host_abandon(int slot);
+
+#endif // ST_PROXY_HOST_H
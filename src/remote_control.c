@@ -0,0 +1,368 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "remote_control.h"
+#include "json_writer.h"
+#include "tunnel.h"
+#include "tunnel_settings.h"
+#include <gg/arena.h>
+#include <gg/buffer.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/flags.h>
+#include <gg/ipc/client.h>
+#include <gg/json_decode.h>
+#include <gg/log.h>
+#include <gg/map.h>
+#include <gg/object.h>
+#include <gg/vector.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REMOTE_QUEUE_LEN 4
+#define REMOTE_MAX_COMMAND 512
+#define REMOTE_MAX_REQUEST_ID 64
+// Longest list entry: field names and numbers, plus the escaped names
+#define REMOTE_MAX_LIST_ENTRY \
+    (256 + JSON_STRING_MAX(64) + JSON_STRING_MAX(TUNNEL_MAX_THING_NAME_LEN))
+#define REMOTE_MAX_RESPONSE \
+    (128 + JSON_STRING_MAX(REMOTE_MAX_REQUEST_ID) \
+     + TUNNEL_MAX_SLOTS * REMOTE_MAX_LIST_ENTRY)
+#define REMOTE_RESPONSE_SUFFIX "/response"
+
+typedef struct {
+    size_t len;
+    uint8_t data[REMOTE_MAX_COMMAND];
+    // Replies go to the topic the command arrived on, even after a change
+    size_t topic_len;
+    uint8_t topic[REMOTE_MAX_TOPIC];
+} RemoteCommand;
+
+// Commands are run on their own thread: replying needs a blocking IPC call,
+// which cannot be made from the subscription callback.
+static pthread_mutex_t remote_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t remote_cond = PTHREAD_COND_INITIALIZER;
+static RemoteCommand remote_queue[REMOTE_QUEUE_LEN];
+static size_t remote_head = 0;
+static size_t remote_count = 0;
+
+// Only used by remote_control_set_topic
+static bool remote_started = false;
+static bool remote_subscribed = false;
+static GgIpcSubscriptionHandle remote_handle;
+
+static void reply_error(GgByteVec *vec, GgError *ret, const char *error) {
+    gg_byte_vec_chain_append(
+        ret, vec, GG_STR("\"result\":\"error\",\"error\":")
+    );
+    json_append_string(vec, ret, error);
+}
+
+static void handle_list(GgByteVec *vec, GgError *ret) {
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    size_t count = tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+    gg_byte_vec_chain_append(
+        ret, vec, GG_STR("\"result\":\"ok\",\"tunnels\":[")
+    );
+    for (size_t i = 0; i < count; i++) {
+        json_append_fmt(
+            vec,
+            ret,
+            "%s{\"slot\":%d,\"service\":",
+            i > 0 ? "," : "",
+            tunnels[i].slot
+        );
+        json_append_string(vec, ret, tunnels[i].service);
+        gg_byte_vec_chain_append(ret, vec, GG_STR(",\"thing\":"));
+        json_append_string(vec, ret, tunnels[i].thing_name);
+        json_append_fmt(
+            vec,
+            ret,
+            ",\"pid\":%d,\"ageSeconds\":%lld,\"remainingSeconds\":%lld",
+            (int) tunnels[i].pid,
+            (long long) tunnels[i].age_seconds,
+            (long long) tunnels[i].remaining_seconds
+        );
+        json_append_fmt(
+            vec,
+            ret,
+            ",\"readBytes\":%llu,\"writtenBytes\":%llu,\"idleSeconds\":%lld}",
+            (unsigned long long) tunnels[i].read_bytes,
+            (unsigned long long) tunnels[i].written_bytes,
+            (long long) tunnels[i].idle_seconds
+        );
+    }
+    gg_byte_vec_chain_append(ret, vec, GG_STR("]"));
+}
+
+static void handle_close(GgByteVec *vec, GgError *ret, const GgObject *slot) {
+    if (slot == NULL || gg_obj_into_i64(*slot) < 0
+        || gg_obj_into_i64(*slot) >= TUNNEL_MAX_SLOTS) {
+        reply_error(vec, ret, "invalid slot");
+        return;
+    }
+    GgError err = tunnel_close((int) gg_obj_into_i64(*slot));
+    switch (err) {
+    case GG_ERR_OK:
+        gg_byte_vec_chain_append(ret, vec, GG_STR("\"result\":\"ok\""));
+        break;
+    case GG_ERR_NOENTRY:
+        reply_error(vec, ret, "no tunnel in slot");
+        break;
+    case GG_ERR_BUSY:
+        reply_error(vec, ret, "tunnel still starting");
+        break;
+    default:
+        reply_error(vec, ret, gg_strerror(err));
+        break;
+    }
+}
+
+// Tunnels whose localproxy has not started yet cannot be closed; they are
+// reported so the caller can retry.
+static void handle_close_all(GgByteVec *vec, GgError *ret) {
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    size_t count = tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+    int closed = 0;
+    int starting = 0;
+    for (size_t i = 0; i < count; i++) {
+        GgError err = tunnel_close(tunnels[i].slot);
+        if (err == GG_ERR_OK) {
+            closed++;
+        } else if (err == GG_ERR_BUSY) {
+            starting++;
+        }
+    }
+    json_append_fmt(
+        vec,
+        ret,
+        "\"result\":\"ok\",\"closed\":%d,\"starting\":%d",
+        closed,
+        starting
+    );
+}
+
+typedef struct {
+    GgBuffer command;
+    GgBuffer request_id; // Empty when not given
+    const GgObject *slot; // NULL when not given
+} RemoteRequest;
+
+static GgError parse_request(
+    GgBuffer payload, GgArena *arena, RemoteRequest *request
+) {
+    GgObject obj = { 0 };
+    GgError ret = gg_json_decode_destructive(payload, arena, &obj);
+    if (ret != GG_ERR_OK || gg_obj_type(obj) != GG_TYPE_MAP) {
+        return GG_ERR_PARSE;
+    }
+
+    GgObject *command = NULL;
+    GgObject *request_id = NULL;
+    GgObject *slot = NULL;
+    ret = gg_map_validate(
+        gg_obj_into_map(obj),
+        GG_MAP_SCHEMA(
+            { GG_STR("command"), GG_REQUIRED, GG_TYPE_BUF, &command },
+            { GG_STR("requestId"), GG_OPTIONAL, GG_TYPE_BUF, &request_id },
+            { GG_STR("slot"), GG_OPTIONAL, GG_TYPE_I64, &slot }
+        )
+    );
+    if (ret != GG_ERR_OK) {
+        return ret;
+    }
+    request->command = gg_obj_into_buf(*command);
+    if (request_id != NULL) {
+        request->request_id = gg_obj_into_buf(*request_id);
+    }
+    request->slot = slot;
+    return GG_ERR_OK;
+}
+
+// Runs one command and writes its JSON reply into vec
+// Opens the reply object, echoing the request id if there was one
+static void append_request_id(
+    GgByteVec *vec, GgError *ret, GgBuffer request_id
+) {
+    gg_byte_vec_chain_append(ret, vec, GG_STR("{"));
+    if (request_id.len > 0) {
+        char id[REMOTE_MAX_REQUEST_ID + 1] = { 0 };
+        memcpy(
+            id,
+            request_id.data,
+            request_id.len < REMOTE_MAX_REQUEST_ID ? request_id.len
+                                                   : REMOTE_MAX_REQUEST_ID
+        );
+        gg_byte_vec_chain_append(ret, vec, GG_STR("\"requestId\":"));
+        json_append_string(vec, ret, id);
+        gg_byte_vec_chain_append(ret, vec, GG_STR(","));
+    }
+}
+
+static GgError handle_command(GgBuffer payload, GgByteVec *vec) {
+    uint8_t arena_mem[1024];
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    RemoteRequest request = { 0 };
+    bool valid = parse_request(payload, &arena, &request) == GG_ERR_OK;
+
+    GgError ret = GG_ERR_OK;
+    append_request_id(vec, &ret, request.request_id);
+    if (!valid) {
+        reply_error(vec, &ret, "invalid command");
+    } else if (gg_buffer_eq(request.command, GG_STR("list"))) {
+        handle_list(vec, &ret);
+    } else if (gg_buffer_eq(request.command, GG_STR("close"))) {
+        handle_close(vec, &ret, request.slot);
+    } else if (gg_buffer_eq(request.command, GG_STR("closeAll"))) {
+        handle_close_all(vec, &ret);
+    } else {
+        reply_error(vec, &ret, "unknown command");
+    }
+    gg_byte_vec_chain_append(&ret, vec, GG_STR("}"));
+
+    if (ret != GG_ERR_OK) {
+        // The caller still gets an answer to wait on
+        GG_LOGE("Remote tunnel command reply does not fit in a message");
+        vec->buf.len = 0;
+        ret = GG_ERR_OK;
+        append_request_id(vec, &ret, request.request_id);
+        reply_error(vec, &ret, "reply too large");
+        gg_byte_vec_chain_append(&ret, vec, GG_STR("}"));
+    }
+    return ret;
+}
+
+static void on_command(
+    void *ctx, GgBuffer topic, GgBuffer payload, GgIpcSubscriptionHandle handle
+) {
+    (void) ctx;
+    (void) handle;
+    GG_MTX_SCOPE_GUARD(&remote_mutex);
+    if (payload.len > REMOTE_MAX_COMMAND || topic.len > REMOTE_MAX_TOPIC
+        || remote_count == REMOTE_QUEUE_LEN) {
+        GG_LOGW("Dropping remote tunnel command");
+        return;
+    }
+    RemoteCommand *command
+        = &remote_queue[(remote_head + remote_count) % REMOTE_QUEUE_LEN];
+    memcpy(command->data, payload.data, payload.len);
+    command->len = payload.len;
+    memcpy(command->topic, topic.data, topic.len);
+    command->topic_len = topic.len;
+    remote_count++;
+    pthread_cond_signal(&remote_cond);
+}
+
+static void take_command(RemoteCommand *command) {
+    GG_MTX_SCOPE_GUARD(&remote_mutex);
+    while (remote_count == 0) {
+        pthread_cond_wait(&remote_cond, &remote_mutex);
+    }
+    *command = remote_queue[remote_head];
+    remote_head = (remote_head + 1) % REMOTE_QUEUE_LEN;
+    remote_count--;
+}
+
+static void *remote_control_thread(void *arg) {
+    (void) arg;
+    static RemoteCommand command;
+    static uint8_t response_mem[REMOTE_MAX_RESPONSE];
+    static uint8_t
+        topic_mem[REMOTE_MAX_TOPIC + sizeof(REMOTE_RESPONSE_SUFFIX) - 1];
+
+    while (true) {
+        take_command(&command);
+        GgBuffer topic = { .data = topic_mem,
+                           .len = command.topic_len
+                               + sizeof(REMOTE_RESPONSE_SUFFIX) - 1 };
+        memcpy(topic_mem, command.topic, command.topic_len);
+        memcpy(
+            &topic_mem[command.topic_len],
+            REMOTE_RESPONSE_SUFFIX,
+            sizeof(REMOTE_RESPONSE_SUFFIX) - 1
+        );
+
+        GgByteVec response = GG_BYTE_VEC(response_mem);
+        if (handle_command(
+                (GgBuffer) { .data = command.data, .len = command.len },
+                &response
+            )
+            != GG_ERR_OK) {
+            GG_LOGE("Failed to build remote tunnel command reply");
+            continue;
+        }
+        // QoS 1: callers wait for the reply rather than polling
+        GgError ret = ggipc_publish_to_iot_core(topic, response.buf, 1);
+        if (ret != GG_ERR_OK) {
+            GG_LOGW(
+                "Failed to publish remote tunnel command reply: %s",
+                gg_strerror(ret)
+            );
+        }
+    }
+
+    return NULL;
+}
+
+static void unsubscribe_commands(void) {
+    if (remote_subscribed) {
+        ggipc_close_subscription(remote_handle);
+        remote_subscribed = false;
+    }
+}
+
+GgError remote_control_set_topic(GgBuffer topic) {
+    if (topic.len > REMOTE_MAX_TOPIC
+        || memchr(topic.data, '+', topic.len) != NULL
+        || memchr(topic.data, '#', topic.len) != NULL) {
+        GG_LOGE("Invalid remote tunnel control topic");
+        return GG_ERR_INVALID;
+    }
+    if (topic.len == 0) {
+        unsubscribe_commands();
+        GG_LOGI("Remote tunnel commands disabled");
+        return GG_ERR_OK;
+    }
+
+    // The new topic is subscribed before the old one is dropped, so commands
+    // keep arriving throughout the change
+    GgIpcSubscriptionHandle handle;
+    GgError ret
+        = ggipc_subscribe_to_iot_core(topic, 1, on_command, NULL, &handle);
+    if (ret != GG_ERR_OK) {
+        GG_LOGE("Failed to subscribe to remote tunnel commands: %d", ret);
+        return ret;
+    }
+
+    // Commands queue until the thread starts
+    if (!remote_started) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, remote_control_thread, NULL) != 0) {
+            GG_LOGE("Failed to create remote tunnel control thread");
+            ggipc_close_subscription(handle);
+            return GG_ERR_FAILURE;
+        }
+        pthread_detach(thread);
+        remote_started = true;
+    }
+
+    unsubscribe_commands();
+    remote_handle = handle;
+    remote_subscribed = true;
+    GG_LOGI(
+        "Accepting remote tunnel commands on %.*s",
+        (int) topic.len,
+        topic.data
+    );
+    return GG_ERR_OK;
+}
@@ -0,0 +1,36 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_REMOTE_CONTROL_H
+#define ST_REMOTE_CONTROL_H
+
+#include <gg/buffer.h>
+#include <gg/error.h>
+
+#define REMOTE_MAX_TOPIC 256
+
+// Subscribes to JSON tunnel commands on topic and publishes each reply to
+// "<topic>/response". Commands:
+//
+//   {"requestId": "<id>", "command": "list"}
+//   {"requestId": "<id>", "command": "close", "slot": <slot>}
+//   {"requestId": "<id>", "command": "closeAll"}
+//
+// requestId is optional and echoed in the reply. Replies carry "result" of
+// "ok" or "error" with an "error" message; list adds "tunnels" and closeAll
+// adds the number of tunnels "closed" and still "starting". Must be called
+// after the IPC connection is established.
+//
+// Called again when the topic changes; an empty topic stops accepting
+// commands. Commands already received are answered on the topic they arrived
+// on. Not safe to call from more than one thread at a time.
+GgError remote_control_set_topic(GgBuffer topic);
+
+#endif // ST_REMOTE_CONTROL_H
@@ -14,11 +14,20 @@
 #include <gg/log.h>
 
 GgError run_secure_tunnel(const SecureTunnelConfig *config) {
+    // Notifications can arrive as soon as the subscriptions are acknowledged,
+    // before the configuration is read
+    hold_launches_for_config();
     GgError ret = subscribe_to_aws_tunnel_tokens(config);
     if (ret != GG_ERR_OK) {
         GG_LOGE("Failed to subscribe to aws for tunnel tokens");
         return GG_ERR_FAILURE;
     }
 
+    // Without hot reload the component still works with its startup settings
+    ret = subscribe_to_config_updates(config);
+    if (ret != GG_ERR_OK) {
+        GG_LOGW("Configuration updates unavailable, using startup settings");
+    }
+
     return GG_ERR_OK;
 }
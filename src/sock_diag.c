@@ -0,0 +1,310 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "sock_diag.h"
+#include "tunnel_clock.h"
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <gg/cleanup.h>
+#include <gg/log.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define LISTENER_SNAPSHOT_MAX_AGE_MS 5000
+// A missing port is re-checked against a fresh snapshot unless the current
+// one is newer than this, so a service that just started is not rejected.
+#define LISTENER_SNAPSHOT_MISS_AGE_MS 250
+// localproxy holds one websocket and a connection per tunneled stream
+#define PROCESS_MAX_SOCKETS 64
+
+typedef void (*SocketVisitor)(
+    const struct nlmsghdr *nlh, const struct inet_diag_msg *diag, void *ctx
+);
+
+typedef struct {
+    uint32_t inodes[PROCESS_MAX_SOCKETS];
+    size_t inode_count;
+    uint16_t dest_port;
+    TunnelNetMetrics metrics;
+} ProcessSockets;
+
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t snapshot_ports[65536 / 64];
+static int64_t snapshot_taken_ms = INT64_MIN / 2;
+static bool snapshot_valid = false;
+static bool snapshot_warned = false;
+
+// Wildcard and loopback listeners accept connections to localhost
+static bool accepts_localhost(const struct inet_diag_msg *diag) {
+    const uint32_t *addr = diag->id.idiag_src;
+    if (diag->idiag_family == AF_INET) {
+        return addr[0] == htonl(INADDR_ANY)
+            || (ntohl(addr[0]) >> 24) == IN_LOOPBACKNET;
+    }
+    if (addr[0] != 0 || addr[1] != 0) {
+        return false;
+    }
+    if (addr[2] == 0) {
+        return addr[3] == 0 || addr[3] == htonl(1); // :: or ::1
+    }
+    return addr[2] == htonl(0xFFFF) // IPv4-mapped loopback
+        && (ntohl(addr[3]) >> 24) == IN_LOOPBACKNET;
+}
+
+static bool dump_sockets(
+    int fd,
+    uint8_t family,
+    uint32_t states,
+    uint8_t extensions,
+    SocketVisitor visit,
+    void *ctx
+) {
+    struct {
+        struct nlmsghdr nlh;
+        struct inet_diag_req_v2 req;
+    } request = {
+        .nlh = { .nlmsg_len = sizeof(request),
+                 .nlmsg_type = SOCK_DIAG_BY_FAMILY,
+                 .nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP },
+        .req = { .sdiag_family = family,
+                 .sdiag_protocol = IPPROTO_TCP,
+                 .idiag_ext = extensions,
+                 .idiag_states = states },
+    };
+    if (send(fd, &request, sizeof(request), 0) != (ssize_t) sizeof(request)) {
+        return false;
+    }
+
+    alignas(struct nlmsghdr) uint8_t buf[8192];
+    while (true) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len == -1 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            return false;
+        }
+        size_t remaining = (size_t) len;
+        for (struct nlmsghdr *nlh = (struct nlmsghdr *) buf;
+             NLMSG_OK(nlh, remaining);
+             nlh = NLMSG_NEXT(nlh, remaining)) {
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                return true;
+            }
+            size_t min_len = NLMSG_LENGTH(sizeof(struct inet_diag_msg));
+            if (nlh->nlmsg_type == NLMSG_ERROR || nlh->nlmsg_len < min_len) {
+                return false;
+            }
+            visit(nlh, NLMSG_DATA(nlh), ctx);
+        }
+    }
+}
+
+static void add_listener(
+    const struct nlmsghdr *nlh, const struct inet_diag_msg *diag, void *ctx
+) {
+    (void) nlh;
+    uint64_t *ports = ctx;
+    if (accepts_localhost(diag)) {
+        uint16_t port = ntohs(diag->id.idiag_sport);
+        ports[port / 64] |= 1ULL << (port % 64);
+    }
+}
+
+static bool dump_listeners(int fd, uint8_t family, uint64_t *ports) {
+    return dump_sockets(fd, family, 1U << TCP_LISTEN, 0, add_listener, ports);
+}
+
+// Caller holds snapshot_mutex
+static void refresh_snapshot(void) {
+    snapshot_taken_ms = tunnel_clock_system_ms();
+    memset(snapshot_ports, 0, sizeof(snapshot_ports));
+
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    bool ok = fd != -1 && dump_listeners(fd, AF_INET, snapshot_ports)
+        && dump_listeners(fd, AF_INET6, snapshot_ports);
+    if (fd != -1) {
+        close(fd);
+    }
+    if (!ok && !snapshot_warned) {
+        GG_LOGW("Cannot read listening sockets through sock_diag: %d", errno);
+        snapshot_warned = true;
+    }
+    snapshot_valid = ok;
+}
+
+ListenerState sock_diag_local_listener(uint16_t port) {
+    GG_MTX_SCOPE_GUARD(&snapshot_mutex);
+    int64_t age = tunnel_clock_system_ms() - snapshot_taken_ms;
+    if (age >= LISTENER_SNAPSHOT_MAX_AGE_MS) {
+        refresh_snapshot();
+    } else if (snapshot_valid
+               && (snapshot_ports[port / 64] & (1ULL << (port % 64))) == 0
+               && age >= LISTENER_SNAPSHOT_MISS_AGE_MS) {
+        refresh_snapshot();
+    }
+
+    if (!snapshot_valid) {
+        return LISTENER_UNKNOWN;
+    }
+    return (snapshot_ports[port / 64] & (1ULL << (port % 64))) != 0
+        ? LISTENER_PRESENT
+        : LISTENER_ABSENT;
+}
+
+// Collects the inodes of the sockets among pid's open descriptors
+static bool read_socket_inodes(pid_t pid, ProcessSockets *sockets) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/fd", (int) pid);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return false;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL
+           && sockets->inode_count < PROCESS_MAX_SOCKETS) {
+        char target[64];
+        ssize_t len = readlinkat(
+            dirfd(dir), entry->d_name, target, sizeof(target) - 1
+        );
+        if (len <= 0) {
+            continue;
+        }
+        target[len] = '\0';
+        unsigned int inode = 0;
+        if (sscanf(target, "socket:[%u]", &inode) == 1) {
+            sockets->inodes[sockets->inode_count++] = inode;
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+static bool read_tcp_info(
+    const struct nlmsghdr *nlh,
+    const struct inet_diag_msg *diag,
+    struct tcp_info *info
+) {
+    size_t len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*diag));
+    const uint8_t *attrs = (const uint8_t *) (diag + 1);
+    size_t pos = 0;
+    while (len - pos >= sizeof(struct rtattr)) {
+        const struct rtattr *attr = (const struct rtattr *) &attrs[pos];
+        if (attr->rta_len < sizeof(struct rtattr)
+            || attr->rta_len > len - pos) {
+            return false;
+        }
+        if (attr->rta_type == INET_DIAG_INFO) {
+            // Older kernels send a shorter tcp_info; the rest stays zero
+            size_t payload = RTA_PAYLOAD(attr);
+            memcpy(
+                info,
+                RTA_DATA(attr),
+                payload < sizeof(*info) ? payload : sizeof(*info)
+            );
+            return true;
+        }
+        pos += RTA_ALIGN(attr->rta_len);
+        if (pos > len) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static void add_path_sample(TcpPathMetrics *path, const struct tcp_info *info) {
+    if (path->connections == 0 || info->tcpi_rtt > path->rtt_us) {
+        path->rtt_us = info->tcpi_rtt;
+        path->rttvar_us = info->tcpi_rttvar;
+    }
+    if (path->connections == 0 || info->tcpi_snd_cwnd < path->cwnd) {
+        path->cwnd = info->tcpi_snd_cwnd;
+    }
+    path->retransmits += info->tcpi_total_retrans;
+    // Same estimate as the kernel's tcp_packets_in_flight
+    int64_t segments = (int64_t) info->tcpi_unacked - info->tcpi_sacked
+        - info->tcpi_lost + info->tcpi_retrans;
+    if (segments > 0) {
+        path->bytes_in_flight += (uint64_t) segments * info->tcpi_snd_mss;
+    }
+    path->connections++;
+}
+
+static void add_connection(
+    const struct nlmsghdr *nlh, const struct inet_diag_msg *diag, void *ctx
+) {
+    ProcessSockets *sockets = ctx;
+    bool held = false;
+    for (size_t i = 0; i < sockets->inode_count && !held; i++) {
+        held = sockets->inodes[i] == diag->idiag_inode;
+    }
+    struct tcp_info info = { 0 };
+    if (!held || !read_tcp_info(nlh, diag, &info)) {
+        return;
+    }
+    add_path_sample(
+        ntohs(diag->id.idiag_dport) == sockets->dest_port
+            ? &sockets->metrics.local
+            : &sockets->metrics.cloud,
+        &info
+    );
+}
+
+static bool dump_connections(
+    int fd, uint8_t family, ProcessSockets *sockets
+) {
+    return dump_sockets(
+        fd,
+        family,
+        1U << TCP_ESTABLISHED,
+        1U << (INET_DIAG_INFO - 1),
+        add_connection,
+        sockets
+    );
+}
+
+bool sock_diag_process_metrics(
+    pid_t pid, uint16_t dest_port, TunnelNetMetrics *metrics
+) {
+    ProcessSockets sockets = { .dest_port = dest_port };
+    if (!read_socket_inodes(pid, &sockets)) {
+        return false;
+    }
+    if (sockets.inode_count > 0) {
+        int fd = socket(
+            AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG
+        );
+        if (fd == -1) {
+            return false;
+        }
+        bool ok = dump_connections(fd, AF_INET, &sockets)
+            && dump_connections(fd, AF_INET6, &sockets);
+        close(fd);
+        if (!ok) {
+            return false;
+        }
+    }
+    *metrics = sockets.metrics;
+    return true;
+}
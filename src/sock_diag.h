@@ -0,0 +1,54 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_SOCK_DIAG_H
+#define ST_SOCK_DIAG_H
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    LISTENER_UNKNOWN, // Listening sockets could not be read
+    LISTENER_ABSENT,
+    LISTENER_PRESENT,
+} ListenerState;
+
+// Reports whether a TCP socket listens on port and accepts connections to
+// localhost. Answers from a snapshot of listening sockets taken through
+// netlink sock_diag, refreshed when it is older than a few seconds or when
+// the port is missing from it.
+ListenerState sock_diag_local_listener(uint16_t port);
+
+// tcp_info of one side of a tunnel. With several connections the RTT is that
+// of the slowest one, the window the smallest, and the rest are totals.
+typedef struct {
+    uint32_t connections;
+    uint32_t rtt_us; // Smoothed round trip time
+    uint32_t rttvar_us;
+    uint32_t retransmits; // Segments retransmitted over the connection life
+    uint32_t cwnd; // Congestion window in segments
+    uint64_t bytes_in_flight; // Sent and not yet acknowledged
+} TcpPathMetrics;
+
+typedef struct {
+    TcpPathMetrics cloud; // Websocket to the secure tunneling service
+    TcpPathMetrics local; // Connections to the destination service
+} TunnelNetMetrics;
+
+// Samples tcp_info through sock_diag for the established TCP connections pid
+// holds open. Connections to dest_port count as local, all others as cloud.
+// Only sockets in the caller's network namespace are seen. Returns false if
+// pid's descriptors or the socket dump could not be read.
+bool sock_diag_process_metrics(
+    pid_t pid, uint16_t dest_port, TunnelNetMetrics *metrics
+);
+
+#endif // ST_SOCK_DIAG_H
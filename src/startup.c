@@ -0,0 +1,151 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "startup.h"
+#include <fcntl.h>
+#include <gg/cleanup.h>
+#include <gg/log.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Field of /proc/self/stat after the command name holding the start time
+#define STAT_STARTTIME_FIELD 20
+
+static const char *const PHASE_NAMES[STARTUP_PHASE_COUNT] = {
+    [STARTUP_MAIN] = "main",
+    [STARTUP_ARGS] = "args",
+    [STARTUP_LAUNCHER] = "launcher",
+    [STARTUP_LOGGING] = "logging",
+    [STARTUP_SDK] = "sdk",
+    [STARTUP_MANAGER] = "manager",
+    [STARTUP_IPC] = "ipc",
+    [STARTUP_READY] = "ready",
+    [STARTUP_PREFLIGHT] = "preflight",
+    [STARTUP_CONFIG] = "config",
+};
+
+static pthread_mutex_t startup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int64_t process_start_ms = -1;
+static int64_t phase_ms[STARTUP_PHASE_COUNT];
+static uint32_t reached_mask = 0;
+
+// The kernel reports process start times on the boot clock
+static int64_t boottime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// Returns when this process was started in boottime_ms, or -1. The kernel
+// keeps it in clock ticks, so it is only accurate to a tick.
+static int64_t read_process_start_ms(void) {
+    int fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    char buf[1024];
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) {
+        return -1;
+    }
+    buf[len] = '\0';
+
+    // The command name may contain spaces, so fields are counted after it
+    char *field = strrchr(buf, ')');
+    for (int i = 0; field != NULL && i < STAT_STARTTIME_FIELD; i++) {
+        field = strchr(field + 1, ' ');
+    }
+    long ticks_per_second = sysconf(_SC_CLK_TCK);
+    if (field == NULL || ticks_per_second <= 0) {
+        return -1;
+    }
+    long long start_ticks = strtoll(field + 1, NULL, 10);
+    return start_ticks * 1000 / ticks_per_second;
+}
+
+// Writes the phases reached so far, in order, as "name ms" pairs
+static void describe_phases(char *out, size_t size) {
+    size_t len = 0;
+    out[0] = '\0';
+    GG_MTX_SCOPE_GUARD(&startup_mutex);
+    for (int phase = 0; phase < STARTUP_PHASE_COUNT && len < size; phase++) {
+        if ((reached_mask & (1U << phase)) == 0) {
+            continue;
+        }
+        int written = snprintf(
+            &out[len],
+            size - len,
+            "%s%s %lld",
+            len > 0 ? ", " : "",
+            PHASE_NAMES[phase],
+            (long long) phase_ms[phase]
+        );
+        if (written < 0) {
+            return;
+        }
+        len += (size_t) written;
+    }
+}
+
+void startup_mark(StartupPhase phase) {
+    if (phase < 0 || phase >= STARTUP_PHASE_COUNT) {
+        return;
+    }
+    int64_t now = boottime_ms();
+    int64_t elapsed;
+    {
+        GG_MTX_SCOPE_GUARD(&startup_mutex);
+        if ((reached_mask & (1U << phase)) != 0) {
+            return;
+        }
+        if (process_start_ms < 0) {
+            process_start_ms = read_process_start_ms();
+        }
+        // Without procfs, times count from the first mark instead
+        if (process_start_ms < 0 || process_start_ms > now) {
+            process_start_ms = now;
+        }
+        elapsed = now - process_start_ms;
+        phase_ms[phase] = elapsed;
+        reached_mask |= 1U << phase;
+    }
+
+    if (phase == STARTUP_READY) {
+        char phases[256];
+        describe_phases(phases, sizeof(phases));
+        GG_LOGI(
+            "Ready for tunnel notifications %lld ms after process start",
+            (long long) elapsed
+        );
+        GG_LOGI("Startup phases (ms): %s", phases);
+    }
+}
+
+int64_t startup_phase_ms(StartupPhase phase) {
+    if (phase < 0 || phase >= STARTUP_PHASE_COUNT) {
+        return -1;
+    }
+    GG_MTX_SCOPE_GUARD(&startup_mutex);
+    return (reached_mask & (1U << phase)) != 0 ? phase_ms[phase] : -1;
+}
+
+const char *startup_phase_name(StartupPhase phase) {
+    if (phase < 0 || phase >= STARTUP_PHASE_COUNT) {
+        return "unknown";
+    }
+    return PHASE_NAMES[phase];
+}
@@ -0,0 +1,42 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_STARTUP_H
+#define ST_STARTUP_H
+
+#include <stdint.h>
+
+// Startup milestones, in the order main reaches them. Preflight and config
+// finish concurrently with the others; tunnel launches are held until config.
+typedef enum {
+    STARTUP_MAIN, // Process loaded and main entered
+    STARTUP_ARGS,
+    STARTUP_LAUNCHER,
+    STARTUP_LOGGING,
+    STARTUP_SDK,
+    STARTUP_MANAGER, // Journal and host budget file opened
+    STARTUP_IPC, // Greengrass IPC connection accepted
+    STARTUP_READY, // Tunnel notification subscriptions acknowledged
+    STARTUP_PREFLIGHT, // localproxy artifact checked and probed
+    STARTUP_CONFIG, // Component configuration first applied
+    STARTUP_PHASE_COUNT,
+} StartupPhase;
+
+// Records when phase finished. Only the first mark of a phase counts. Marking
+// STARTUP_READY logs the time from process start and each phase so far.
+void startup_mark(StartupPhase phase);
+
+// Returns milliseconds from process start until phase finished, or -1 if it
+// has not.
+int64_t startup_phase_ms(StartupPhase phase);
+
+const char *startup_phase_name(StartupPhase phase);
+
+#endif // ST_STARTUP_H
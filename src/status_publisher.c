@@ -0,0 +1,313 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "status_publisher.h"
+#include "json_writer.h"
+#include "tunnel.h"
+#include "tunnel_clock.h"
+#include "tunnel_events.h"
+#include <gg/buffer.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/ipc/client.h>
+#include <gg/log.h>
+#include <gg/vector.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STATUS_MAX_EVENTS 32
+#define STATUS_MAX_THING_NAME 128
+#define STATUS_MAX_SERVICE 32
+// Longest event: field names and numbers, plus the escaped names
+#define STATUS_MAX_ENTRY \
+    (160 + JSON_STRING_MAX(STATUS_MAX_SERVICE) \
+     + JSON_STRING_MAX(STATUS_MAX_THING_NAME))
+// Longest rejection count: reason name, separators and a 32-bit count
+#define STATUS_MAX_REJECTED_ENTRY 64
+#define STATUS_MAX_PAYLOAD \
+    (128 + JSON_STRING_MAX(STATUS_MAX_THING_NAME) \
+     + STATUS_MAX_EVENTS * STATUS_MAX_ENTRY \
+     + TUNNEL_REJECT_REASON_COUNT * STATUS_MAX_REJECTED_ENTRY)
+
+typedef struct {
+    int64_t wall_ms;
+    TunnelEventType type;
+    int slot;
+    char service[STATUS_MAX_SERVICE];
+    char thing_name[STATUS_MAX_THING_NAME];
+    int exit_status;
+    int64_t lifetime_ms;
+} StatusEntry;
+
+// Opens and exits are kept individually; rejections are only counted so a
+// storm of rejected notifications costs no more than a single one.
+typedef struct {
+    size_t count;
+    StatusEntry events[STATUS_MAX_EVENTS];
+    uint32_t rejected[TUNNEL_REJECT_REASON_COUNT];
+    uint32_t dropped;
+} StatusBatch;
+
+static pthread_mutex_t status_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t status_cond;
+static atomic_bool status_enabled = false;
+// Guarded by status_mutex
+static StatusBatch status_batch;
+static bool status_pending = false;
+static int64_t status_first_ms = 0;
+static char status_topic[STATUS_MAX_TOPIC];
+static size_t status_topic_len = 0;
+static bool status_started = false;
+
+// Written once before the publisher thread starts
+static char status_thing[STATUS_MAX_THING_NAME];
+static int64_t status_batch_ms = STATUS_BATCH_MS;
+
+static int64_t wall_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void copy_field(char *dst, size_t size, const char *src) {
+    if (src != NULL) {
+        strncpy(dst, src, size - 1);
+        dst[size - 1] = '\0';
+    } else {
+        dst[0] = '\0';
+    }
+}
+
+void status_publisher_record(const TunnelEvent *event) {
+    if (!atomic_load_explicit(&status_enabled, memory_order_acquire)) {
+        return;
+    }
+
+    GG_MTX_SCOPE_GUARD(&status_mutex);
+    if (event->type == TUNNEL_EVENT_REJECT) {
+        if ((unsigned) event->reason < TUNNEL_REJECT_REASON_COUNT) {
+            status_batch.rejected[event->reason]++;
+        }
+    } else if (status_batch.count < STATUS_MAX_EVENTS) {
+        StatusEntry *entry = &status_batch.events[status_batch.count++];
+        *entry = (StatusEntry) {
+            .wall_ms = wall_ms(),
+            .type = event->type,
+            .slot = event->slot,
+            .exit_status = event->exit_status,
+            .lifetime_ms = event->lifetime_ms,
+        };
+        copy_field(entry->service, sizeof(entry->service), event->service);
+        copy_field(
+            entry->thing_name, sizeof(entry->thing_name), event->thing_name
+        );
+    } else {
+        status_batch.dropped++;
+    }
+
+    if (!status_pending) {
+        status_pending = true;
+        status_first_ms = tunnel_clock_system_ms();
+        pthread_cond_signal(&status_cond);
+    }
+}
+
+static void append_event(
+    GgByteVec *vec, GgError *ret, const StatusEntry *entry
+) {
+    json_append_fmt(
+        vec,
+        ret,
+        "{\"type\":\"%s\",\"time\":%lld,\"slot\":%d,\"service\":",
+        entry->type == TUNNEL_EVENT_OPEN ? "open" : "exit",
+        (long long) entry->wall_ms,
+        entry->slot
+    );
+    json_append_string(vec, ret, entry->service);
+    gg_byte_vec_chain_append(ret, vec, GG_STR(",\"thing\":"));
+    json_append_string(vec, ret, entry->thing_name);
+
+    if (entry->type == TUNNEL_EVENT_EXIT) {
+        if (entry->exit_status >= 0 && WIFSIGNALED(entry->exit_status)) {
+            json_append_fmt(
+                vec, ret, ",\"signal\":%d", WTERMSIG(entry->exit_status)
+            );
+        } else {
+            // -1 when localproxy could not be started
+            json_append_fmt(
+                vec,
+                ret,
+                ",\"exitCode\":%d",
+                entry->exit_status >= 0 ? WEXITSTATUS(entry->exit_status) : -1
+            );
+        }
+        json_append_fmt(
+            vec,
+            ret,
+            ",\"lifetimeSeconds\":%lld",
+            (long long) (entry->lifetime_ms / 1000)
+        );
+    }
+    gg_byte_vec_chain_append(ret, vec, GG_STR("}"));
+}
+
+static GgError format_batch(const StatusBatch *batch, GgByteVec *vec) {
+    // Read from the tunnel table, so tunnels opened before the publisher
+    // started are counted too
+    static TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    size_t active = tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+
+    GgError ret = GG_ERR_OK;
+    gg_byte_vec_chain_append(&ret, vec, GG_STR("{\"thing\":"));
+    json_append_string(vec, &ret, status_thing);
+    json_append_fmt(vec, &ret, ",\"active\":%zu,\"events\":[", active);
+    for (size_t i = 0; i < batch->count; i++) {
+        if (i > 0) {
+            gg_byte_vec_chain_append(&ret, vec, GG_STR(","));
+        }
+        append_event(vec, &ret, &batch->events[i]);
+    }
+
+    gg_byte_vec_chain_append(&ret, vec, GG_STR("],\"rejected\":{"));
+    bool first = true;
+    for (uint32_t reason = 0; reason < TUNNEL_REJECT_REASON_COUNT; reason++) {
+        if (batch->rejected[reason] == 0) {
+            continue;
+        }
+        json_append_fmt(
+            vec,
+            &ret,
+            "%s\"%s\":%u",
+            first ? "" : ",",
+            tunnel_reject_reason_name(reason),
+            batch->rejected[reason]
+        );
+        first = false;
+    }
+    json_append_fmt(vec, &ret, "},\"droppedEvents\":%u}", batch->dropped);
+    return ret;
+}
+
+// Waits until a batch has been open for status_batch_ms and takes it
+static void take_batch(StatusBatch *batch) {
+    GG_MTX_SCOPE_GUARD(&status_mutex);
+    while (true) {
+        if (!status_pending) {
+            pthread_cond_wait(&status_cond, &status_mutex);
+            continue;
+        }
+        int64_t due_ms = status_first_ms + status_batch_ms;
+        if (due_ms > tunnel_clock_system_ms()) {
+            struct timespec due = { .tv_sec = due_ms / 1000,
+                                    .tv_nsec = (due_ms % 1000) * 1000000 };
+            (void) pthread_cond_timedwait(&status_cond, &status_mutex, &due);
+            continue;
+        }
+        break;
+    }
+
+    *batch = status_batch;
+    status_batch = (StatusBatch) { 0 };
+    status_pending = false;
+}
+
+static void *status_publisher_thread(void *arg) {
+    (void) arg;
+    static StatusBatch batch;
+    static uint8_t payload_mem[STATUS_MAX_PAYLOAD];
+    static uint8_t topic_mem[STATUS_MAX_TOPIC];
+
+    while (true) {
+        take_batch(&batch);
+        // The topic may have changed since the batch was started
+        GgBuffer topic = { .data = topic_mem };
+        {
+            GG_MTX_SCOPE_GUARD(&status_mutex);
+            memcpy(topic_mem, status_topic, status_topic_len);
+            topic.len = status_topic_len;
+        }
+        if (topic.len == 0) {
+            continue;
+        }
+        GgByteVec payload = GG_BYTE_VEC(payload_mem);
+        if (format_batch(&batch, &payload) != GG_ERR_OK) {
+            GG_LOGE("Tunnel status batch does not fit in a message");
+            continue;
+        }
+        // QoS 0: a lost batch is superseded by the next one's active count
+        GgError ret = ggipc_publish_to_iot_core(topic, payload.buf, 0);
+        if (ret != GG_ERR_OK) {
+            GG_LOGW("Failed to publish tunnel status: %s", gg_strerror(ret));
+        }
+    }
+
+    return NULL;
+}
+
+// Caller holds status_mutex
+static GgError start_publisher_thread(GgBuffer thing_name, int64_t batch_ms) {
+    memcpy(status_thing, thing_name.data, thing_name.len);
+    status_thing[thing_name.len] = '\0';
+    status_batch_ms = batch_ms;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&status_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, status_publisher_thread, NULL) != 0) {
+        GG_LOGE("Failed to create tunnel status publisher thread");
+        return GG_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+    status_started = true;
+    return GG_ERR_OK;
+}
+
+GgError status_publisher_set_topic(
+    GgBuffer topic, GgBuffer thing_name, int64_t batch_ms
+) {
+    if (topic.len >= sizeof(status_topic)
+        || thing_name.len >= sizeof(status_thing)) {
+        GG_LOGE("Invalid tunnel status topic");
+        return GG_ERR_INVALID;
+    }
+
+    GG_MTX_SCOPE_GUARD(&status_mutex);
+    if (topic.len == 0) {
+        atomic_store_explicit(&status_enabled, false, memory_order_release);
+        status_topic_len = 0;
+        status_batch = (StatusBatch) { 0 };
+        status_pending = false;
+        GG_LOGI("Tunnel status publishing disabled");
+        return GG_ERR_OK;
+    }
+
+    if (!status_started) {
+        GgError ret = start_publisher_thread(thing_name, batch_ms);
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    }
+    memcpy(status_topic, topic.data, topic.len);
+    status_topic_len = topic.len;
+    atomic_store_explicit(&status_enabled, true, memory_order_release);
+    GG_LOGI(
+        "Publishing tunnel status to %.*s", (int) topic.len, topic.data
+    );
+    return GG_ERR_OK;
+}
@@ -0,0 +1,33 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_STATUS_PUBLISHER_H
+#define ST_STATUS_PUBLISHER_H
+
+#include "tunnel_events.h"
+#include <gg/buffer.h>
+#include <gg/error.h>
+
+#define STATUS_BATCH_MS 5000
+#define STATUS_MAX_TOPIC 256
+
+// Publishes tunnel lifecycle events to topic. Events are collected for
+// batch_ms after the first one arrives and sent as a single message. Called
+// again when the topic changes: later batches go to the new topic, and an
+// empty topic stops publishing. thing_name and batch_ms are taken from the
+// call that starts publishing.
+GgError status_publisher_set_topic(
+    GgBuffer topic, GgBuffer thing_name, int64_t batch_ms
+);
+
+// Adds an event to the current batch. Never blocks on IPC.
+void status_publisher_record(const TunnelEvent *event);
+
+#endif // ST_STATUS_PUBLISHER_H
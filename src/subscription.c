@@ -8,98 +8,449 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include "launch_limiter.h"
+#include "mqtt_transport.h"
 #include "secure-tunnel.h"
+#include "startup.h"
 #include "subscriptions.h"
+#include "trace.h"
 #include "tunnel.h"
+#include "tunnel_notification_parser.h"
+#include "tunnel_settings.h"
 #include <gg/arena.h>
 #include <gg/buffer.h>
+#include <gg/cleanup.h>
 #include <gg/error.h>
 #include <gg/ipc/client.h>
 #include <gg/json_decode.h>
 #include <gg/log.h>
 #include <gg/object.h>
 #include <gg/vector.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
-static void on_tunnel_notification(
-    void *ctx, GgBuffer topic, GgBuffer payload, GgIpcSubscriptionHandle handle
+GgError deliver_tunnel_notification(
+    const SecureTunnelConfig *config, GgBuffer topic, GgBuffer payload
 ) {
-    const SecureTunnelConfig *config = (const SecureTunnelConfig *) ctx;
-    (void) handle;
+    // Shed notification storms before paying for decoding and validation
+    if (!launch_limiter_peek()) {
+        launch_limiter_record_drop();
+        return GG_ERR_RETRY;
+    }
+
     GG_LOGI(
         "Received tunnel aws tunnel token on topic: %.*s",
         (int) topic.len,
         topic.data
     );
 
+    static pthread_mutex_t arena_mutex = PTHREAD_MUTEX_INITIALIZER;
     static uint8_t arena_mem[4096];
+    GG_MTX_SCOPE_GUARD(&arena_mutex);
     GgArena arena = gg_arena_init(GG_BUF(arena_mem));
     GgObject notification = { 0 };
 
     GgError ret = gg_json_decode_destructive(payload, &arena, &notification);
     if (ret != GG_ERR_OK) {
         GG_LOGE("Failed to parse tunnel notification JSON: %d", ret);
-        return;
+        return ret;
     }
+    trace_record_current(TRACE_JSON_DECODE);
 
     if (gg_obj_type(notification) != GG_TYPE_MAP) {
         GG_LOGE("Invalid notification format");
-        return;
+        return GG_ERR_INVALID;
+    }
+
+    GgBuffer thing_name;
+    if (parse_thing_from_topic(topic, &thing_name) != GG_ERR_OK) {
+        GG_LOGE("Unexpected tunnel notification topic");
+        return GG_ERR_INVALID;
     }
 
     GG_LOGI("Successfully parsed tunnel notification JSON");
-    if (handle_tunnel_notification(gg_obj_into_map(notification), config)
-        != GG_ERR_OK) {
+    return handle_tunnel_notification_for_thing(
+        gg_obj_into_map(notification), thing_name, config
+    );
+}
+
+// Shared by the IPC and direct MQTT transports
+static void on_tunnel_message(void *ctx, GgBuffer topic, GgBuffer payload) {
+    const SecureTunnelConfig *config = (const SecureTunnelConfig *) ctx;
+    (void) trace_begin();
+    trace_record_current(TRACE_IPC_CALLBACK);
+
+    GgError ret = deliver_tunnel_notification(config, topic, payload);
+    if (ret != GG_ERR_OK && ret != GG_ERR_RETRY) {
         GG_LOGE("Failed to handle aws tunnel token notification");
     }
 }
 
-static GgError build_tunnel_topic(
-    const SecureTunnelConfig *config, GgByteVec *topic
+static void on_tunnel_notification(
+    void *ctx, GgBuffer topic, GgBuffer payload, GgIpcSubscriptionHandle handle
 ) {
-    if (config->thing_name.len == 0) {
+    (void) handle;
+    on_tunnel_message(ctx, topic, payload);
+}
+
+static GgError build_tunnel_topic(GgBuffer thing_name, GgByteVec *topic) {
+    if (thing_name.len == 0) {
         return GG_ERR_INVALID;
     }
     GgError ret = gg_byte_vec_append(topic, GG_STR("$aws/things/"));
-    gg_byte_vec_chain_append(&ret, topic, config->thing_name);
+    gg_byte_vec_chain_append(&ret, topic, thing_name);
     gg_byte_vec_chain_append(&ret, topic, GG_STR("/tunnels/notify"));
     return ret;
 }
 
-GgError subscribe_to_aws_tunnel_tokens(const SecureTunnelConfig *config) {
+// A thing whose notify topic is subscribed to
+typedef struct {
+    char name[TUNNEL_MAX_THING_NAME_LEN];
+    size_t len;
+    bool direct; // Subscribed over direct MQTT rather than IPC
+    GgIpcSubscriptionHandle handle; // Unused over direct MQTT
+} ThingSubscription;
+
+// Changed by the startup and configuration reload threads. Holds the old and
+// the new things while the gateway things or the transport change.
+static pthread_mutex_t subscription_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ThingSubscription subscribed[2 * (TUNNEL_MAX_GATEWAY_THINGS + 1)];
+static size_t subscribed_count = 0;
+static bool subscribe_direct = false; // Transport for new subscriptions
+
+// Caller holds subscription_mutex
+static GgError subscribe_for_thing(
+    const SecureTunnelConfig *config, GgBuffer thing_name
+) {
     uint8_t topic_memory[256];
-    GgByteVec tunnel_token_sub_topic = GG_BYTE_VEC(topic_memory);
+    GgByteVec topic = GG_BYTE_VEC(topic_memory);
 
-    GgError ret = build_tunnel_topic(config, &tunnel_token_sub_topic);
+    GgError ret = build_tunnel_topic(thing_name, &topic);
     if (ret != GG_ERR_OK) {
         return ret;
     }
+    if (thing_name.len >= TUNNEL_MAX_THING_NAME_LEN
+        || subscribed_count == sizeof(subscribed) / sizeof(subscribed[0])) {
+        return GG_ERR_RANGE;
+    }
+    ThingSubscription *entry = &subscribed[subscribed_count];
+    memcpy(entry->name, thing_name.data, thing_name.len);
+    entry->len = thing_name.len;
+    entry->direct = subscribe_direct;
 
-    GG_LOGI("Connecting to Greengrass IPC");
-    ret = ggipc_connect();
+    GG_LOGI(
+        "Subscribing to IoT Core topic: %.*s",
+        (int) topic.buf.len,
+        topic.buf.data
+    );
+    if (entry->direct) {
+        ret = mqtt_transport_subscribe(
+            topic.buf, on_tunnel_message, (void *) config
+        );
+    } else {
+        ret = ggipc_subscribe_to_iot_core(
+            topic.buf,
+            1, // QoS 1
+            on_tunnel_notification,
+            (void *) config,
+            &entry->handle
+        );
+    }
     if (ret != GG_ERR_OK) {
-        GG_LOGE("Failed to connect to Greengrass IPC: %d", ret);
+        GG_LOGE("Failed to subscribe to tunnel notifications: %d", ret);
         return ret;
     }
+    subscribed_count++;
+    return GG_ERR_OK;
+}
+
+// Caller holds subscription_mutex
+static void unsubscribe_thing(size_t index) {
+    ThingSubscription *entry = &subscribed[index];
+    GgBuffer thing_name = { .data = (uint8_t *) entry->name,
+                            .len = entry->len };
+    uint8_t topic_memory[256];
+    GgByteVec topic = GG_BYTE_VEC(topic_memory);
+    if (build_tunnel_topic(thing_name, &topic) == GG_ERR_OK) {
+        GG_LOGI(
+            "Unsubscribing from IoT Core topic: %.*s",
+            (int) topic.buf.len,
+            topic.buf.data
+        );
+    }
+    if (entry->direct) {
+        (void) mqtt_transport_unsubscribe(topic.buf);
+    } else {
+        ggipc_close_subscription(entry->handle);
+    }
+    subscribed[index] = subscribed[--subscribed_count];
+}
+
+// Splits the comma separated gateway thing list. The component's own thing is
+// always served; a "+" entry replaces all other subscriptions, since
+// overlapping subscriptions would deliver each notification twice.
+static bool contains_thing(
+    const GgBuffer *things, size_t count, GgBuffer thing
+) {
+    for (size_t i = 0; i < count; i++) {
+        if (gg_buffer_eq(things[i], thing)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static GgError collect_gateway_things(
+    const SecureTunnelConfig *config,
+    GgBuffer gateway_things,
+    GgBuffer *things,
+    size_t *count
+) {
+    things[0] = config->thing_name;
+    *count = 1;
+
+    GgBuffer rest = gateway_things;
+    while (rest.len > 0) {
+        uint8_t *comma = memchr(rest.data, ',', rest.len);
+        size_t len = comma != NULL ? (size_t) (comma - rest.data) : rest.len;
+        GgBuffer thing = gg_buffer_substr(rest, 0, len);
+        rest = gg_buffer_substr(rest, comma != NULL ? len + 1 : len, SIZE_MAX);
+
+        // A repeated thing would be subscribed, and each notification
+        // delivered, twice
+        if (thing.len == 0 || contains_thing(things, *count, thing)) {
+            continue;
+        }
+        if (gg_buffer_eq(thing, GG_STR("+"))) {
+            things[0] = thing;
+            *count = 1;
+            return GG_ERR_OK;
+        }
+        if (memchr(thing.data, '/', thing.len) != NULL
+            || memchr(thing.data, '#', thing.len) != NULL
+            || memchr(thing.data, '+', thing.len) != NULL) {
+            GG_LOGE("Invalid gateway thing name: %.*s", (int) len, thing.data);
+            return GG_ERR_INVALID;
+        }
+        if (*count > TUNNEL_MAX_GATEWAY_THINGS) {
+            GG_LOGE(
+                "Gateway things cannot exceed %d entries",
+                TUNNEL_MAX_GATEWAY_THINGS
+            );
+            return GG_ERR_RANGE;
+        }
+        things[(*count)++] = thing;
+    }
+    return GG_ERR_OK;
+}
+
+// An empty client ID in options uses <thing name>-secure-tunnel
+static GgError start_direct_mqtt(
+    const SecureTunnelConfig *config, const MqttTransportOptions *options
+) {
+    char client_id[TUNNEL_MAX_THING_NAME_LEN + 16];
+    int len = options->client_id[0] != '\0'
+        ? snprintf(client_id, sizeof(client_id), "%s", options->client_id)
+        : snprintf(
+              client_id,
+              sizeof(client_id),
+              "%.*s-secure-tunnel",
+              (int) config->thing_name.len,
+              config->thing_name.data
+          );
+    if (len <= 0 || (size_t) len >= sizeof(client_id)) {
+        GG_LOGE("MQTT client ID is too long");
+        return GG_ERR_RANGE;
+    }
 
+    MqttTransportOptions resolved = *options;
+    resolved.client_id = client_id;
     GG_LOGI(
-        "Subscribing to IoT Core topic: %.*s",
-        (int) tunnel_token_sub_topic.buf.len,
-        tunnel_token_sub_topic.buf.data
+        "Receiving tunnel notifications from %s over MQTT as %s",
+        resolved.endpoint,
+        client_id
     );
-    GgIpcSubscriptionHandle sub_handle;
-    ret = ggipc_subscribe_to_iot_core(
-        tunnel_token_sub_topic.buf,
-        1, // QoS 1
-        on_tunnel_notification,
-        (void *) config,
-        &sub_handle
+    return mqtt_transport_start(&resolved);
+}
+
+// argv strings are null terminated
+static const char *config_string(GgBuffer value) {
+    return value.len > 0 ? (const char *) value.data : "";
+}
+
+static void *preflight_thread(void *arg) {
+    const SecureTunnelConfig *config = (const SecureTunnelConfig *) arg;
+    if (tunnel_preflight_artifact(config) == GG_ERR_OK) {
+        startup_mark(STARTUP_PREFLIGHT);
+    }
+    return NULL;
+}
+
+GgError subscribe_to_aws_tunnel_tokens(const SecureTunnelConfig *config) {
+    if (config->thing_name.len == 0) {
+        return GG_ERR_INVALID;
+    }
+
+    // Reading the localproxy artifact needs no IPC, so it runs while the
+    // connection and subscriptions are set up
+    pthread_t preflight;
+    if (pthread_create(&preflight, NULL, preflight_thread, (void *) config)
+        == 0) {
+        pthread_detach(preflight);
+    } else {
+        GG_LOGW("Failed to create artifact preflight thread");
+    }
+
+    GgBuffer things[TUNNEL_MAX_GATEWAY_THINGS + 1];
+    size_t thing_count = 0;
+    GgError ret = collect_gateway_things(
+        config, config->gateway_things, things, &thing_count
     );
     if (ret != GG_ERR_OK) {
-        GG_LOGE("Failed to subscribe to tunnel notifications: %d", ret);
         return ret;
     }
 
+    // Over a direct MQTT connection, IPC is only needed for configuration
+    // updates and status messages
+    bool direct = config->mqtt_endpoint.len > 0;
+    GG_LOGI("Connecting to Greengrass IPC");
+    ret = ggipc_connect();
+    if (ret != GG_ERR_OK && !direct) {
+        GG_LOGE("Failed to connect to Greengrass IPC: %d", ret);
+        return ret;
+    }
+    if (ret != GG_ERR_OK) {
+        GG_LOGW("Greengrass IPC unavailable; notifications still use MQTT");
+    } else {
+        startup_mark(STARTUP_IPC);
+    }
+
+    {
+        GG_MTX_SCOPE_GUARD(&subscription_mutex);
+        subscribe_direct = direct;
+        for (size_t i = 0; i < thing_count; i++) {
+            ret = subscribe_for_thing(config, things[i]);
+            if (ret != GG_ERR_OK) {
+                return ret;
+            }
+        }
+    }
+
+    // A direct connection is ready once the broker acknowledges the topics
+    if (direct) {
+        MqttTransportOptions options = {
+            .endpoint = config_string(config->mqtt_endpoint),
+            .client_id = config_string(config->mqtt_client_id),
+            .cert_path = config_string(config->mqtt_cert_path),
+            .key_path = config_string(config->mqtt_key_path),
+            .root_ca_path = config_string(config->mqtt_root_ca_path),
+        };
+        GG_MTX_SCOPE_GUARD(&subscription_mutex);
+        ret = start_direct_mqtt(config, &options);
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    } else {
+        startup_mark(STARTUP_READY);
+    }
+
     GG_LOGI("Successfully subscribed to tunnel notifications");
     return GG_ERR_OK;
 }
+
+static bool is_subscribed(GgBuffer thing) {
+    for (size_t i = 0; i < subscribed_count; i++) {
+        GgBuffer name = { .data = (uint8_t *) subscribed[i].name,
+                          .len = subscribed[i].len };
+        if (gg_buffer_eq(name, thing)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+GgError update_gateway_subscriptions(
+    const SecureTunnelConfig *config, GgBuffer gateway_things
+) {
+    GgBuffer things[TUNNEL_MAX_GATEWAY_THINGS + 1];
+    size_t thing_count = 0;
+    GgError ret = collect_gateway_things(
+        config, gateway_things, things, &thing_count
+    );
+    if (ret != GG_ERR_OK) {
+        return ret;
+    }
+
+    // New topics are subscribed before old ones are dropped, so no
+    // notification is missed while switching to or from "+"
+    GG_MTX_SCOPE_GUARD(&subscription_mutex);
+    for (size_t i = 0; i < thing_count; i++) {
+        if (!is_subscribed(things[i])) {
+            ret = subscribe_for_thing(config, things[i]);
+            if (ret != GG_ERR_OK) {
+                return ret;
+            }
+        }
+    }
+    for (size_t i = subscribed_count; i > 0; i--) {
+        GgBuffer name = { .data = (uint8_t *) subscribed[i - 1].name,
+                          .len = subscribed[i - 1].len };
+        if (!contains_thing(things, thing_count, name)) {
+            unsubscribe_thing(i - 1);
+        }
+    }
+    return GG_ERR_OK;
+}
+
+GgError update_notification_transport(
+    const SecureTunnelConfig *config, const MqttTransportOptions *options
+) {
+    bool direct = options->endpoint[0] != '\0';
+    GG_MTX_SCOPE_GUARD(&subscription_mutex);
+    bool was_direct = subscribe_direct;
+    if (direct) {
+        // Reconnects with the new options when already connected
+        GgError ret = start_direct_mqtt(config, options);
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    }
+    if (direct == was_direct) {
+        return GG_ERR_OK;
+    }
+
+    // Every thing is subscribed on the new transport before the old
+    // subscriptions are dropped, so no notification is missed while switching
+    GG_LOGI(
+        "Moving tunnel notifications to %s",
+        direct ? "direct MQTT" : "Greengrass IPC"
+    );
+    size_t old_count = subscribed_count;
+    subscribe_direct = direct;
+    for (size_t i = 0; i < old_count; i++) {
+        GgBuffer name = { .data = (uint8_t *) subscribed[i].name,
+                          .len = subscribed[i].len };
+        GgError ret = subscribe_for_thing(config, name);
+        if (ret != GG_ERR_OK) {
+            while (subscribed_count > old_count) {
+                unsubscribe_thing(subscribed_count - 1);
+            }
+            subscribe_direct = was_direct;
+            if (direct) {
+                mqtt_transport_stop();
+            }
+            return ret;
+        }
+    }
+    for (size_t i = old_count; i > 0; i--) {
+        unsubscribe_thing(i - 1);
+    }
+    if (!direct) {
+        mqtt_transport_stop();
+    }
+    return GG_ERR_OK;
+}
@@ -11,9 +11,44 @@
 #ifndef ST_SUBSCRIPTIONS_H
 #define ST_SUBSCRIPTIONS_H
 
+#include "mqtt_transport.h"
 #include "secure-tunnel.h"
+#include <gg/buffer.h>
 #include <gg/error.h>
 
 GgError subscribe_to_aws_tunnel_tokens(const SecureTunnelConfig *config);
 
+// Subscribes to the notify topics of the things in gateway_things, a list as
+// in SecureTunnelConfig, and drops those of things no longer listed. On error
+// the subscriptions made so far are kept.
+GgError update_gateway_subscriptions(
+    const SecureTunnelConfig *config, GgBuffer gateway_things
+);
+
+// Receives tunnel notifications over a direct MQTT connection with options, or
+// over Greengrass IPC when its endpoint is empty. An empty client ID uses
+// "<thing name>-secure-tunnel". Switching transports subscribes every thing on
+// the new one before dropping the old subscriptions. On error the previous
+// transport stays in use.
+GgError update_notification_transport(
+    const SecureTunnelConfig *config, const MqttTransportOptions *options
+);
+
+// Decodes and admits a tunnel notification received on topic. Returns
+// GG_ERR_RETRY if it was shed by the launch rate limit.
+GgError deliver_tunnel_notification(
+    const SecureTunnelConfig *config, GgBuffer topic, GgBuffer payload
+);
+
+// Holds tunnel launches until subscribe_to_config_updates has loaded the
+// component configuration, so notifications received first are not admitted
+// with the startup arguments alone.
+void hold_launches_for_config(void);
+
+// Applies the current component configuration and keeps applying it to the
+// tunnel manager whenever it changes. Requires an IPC connection. The first
+// load and the subscription happen on the reload thread, so startup does not
+// wait for them; held launches go ahead once the first load finished.
+GgError subscribe_to_config_updates(const SecureTunnelConfig *config);
+
 #endif // ST_SUBSCRIPTIONS_H
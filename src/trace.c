@@ -0,0 +1,270 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "trace.h"
+#include <fcntl.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_RING_SIZE 1024 // Must be a power of two
+#define TRACE_SPAN_LOOKBACK 64
+
+// seq holds the ring index + 1 once the entry is fully written and is zeroed
+// while a writer fills it in, so readers can detect torn entries.
+typedef struct {
+    _Atomic uint64_t seq;
+    _Atomic uint64_t ts_ns;
+    _Atomic uint32_t trace_id;
+    _Atomic uint32_t point;
+} TraceEntry;
+
+typedef struct {
+    uint64_t ts_ns;
+    uint32_t trace_id;
+    uint32_t point;
+} TraceEvent;
+
+static TraceEntry trace_ring[TRACE_RING_SIZE];
+static _Atomic uint64_t trace_head = 0;
+static _Atomic uint32_t trace_next_id = 0;
+static _Thread_local uint32_t trace_current_id = 0;
+
+static pthread_mutex_t trace_export_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceEvent trace_snapshot_buf[TRACE_RING_SIZE];
+
+static const char *const TRACE_POINT_NAMES[TRACE_POINT_COUNT] = {
+    [TRACE_IPC_CALLBACK] = "ipc_callback",
+    [TRACE_JSON_DECODE] = "json_decode",
+    [TRACE_VALIDATE] = "validate",
+    [TRACE_SLOT_ALLOC] = "slot_alloc",
+    [TRACE_DISPATCH] = "dispatch",
+    [TRACE_FORK] = "fork",
+    [TRACE_EXEC] = "exec",
+    [TRACE_FIRST_OUTPUT] = "first_output",
+    [TRACE_EXIT] = "exit",
+};
+
+static uint64_t trace_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000U + (uint64_t) now.tv_nsec;
+}
+
+uint32_t trace_begin(void) {
+    uint32_t id
+        = atomic_fetch_add_explicit(&trace_next_id, 1, memory_order_relaxed)
+        + 1;
+    if (id == 0) {
+        id = 1; // 0 means "no trace" after the counter wraps
+    }
+    trace_current_id = id;
+    return id;
+}
+
+uint32_t trace_current(void) {
+    return trace_current_id;
+}
+
+void trace_record(uint32_t trace_id, TracePoint point) {
+    if (trace_id == 0) {
+        return;
+    }
+    uint64_t idx
+        = atomic_fetch_add_explicit(&trace_head, 1, memory_order_relaxed);
+    TraceEntry *entry = &trace_ring[idx & (TRACE_RING_SIZE - 1)];
+
+    atomic_store_explicit(&entry->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&entry->ts_ns, trace_now_ns(), memory_order_relaxed);
+    atomic_store_explicit(&entry->trace_id, trace_id, memory_order_relaxed);
+    atomic_store_explicit(
+        &entry->point, (uint32_t) point, memory_order_relaxed
+    );
+    atomic_store_explicit(&entry->seq, idx + 1, memory_order_release);
+}
+
+void trace_record_current(TracePoint point) {
+    trace_record(trace_current_id, point);
+}
+
+// Copies consistent entries, oldest first. Caller holds trace_export_mutex.
+static size_t trace_snapshot(void) {
+    uint64_t head = atomic_load_explicit(&trace_head, memory_order_acquire);
+    uint64_t start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    size_t count = 0;
+
+    for (uint64_t idx = start; idx < head; idx++) {
+        TraceEntry *entry = &trace_ring[idx & (TRACE_RING_SIZE - 1)];
+        uint64_t seq = atomic_load_explicit(&entry->seq, memory_order_acquire);
+        TraceEvent event = {
+            .ts_ns = atomic_load_explicit(&entry->ts_ns, memory_order_relaxed),
+            .trace_id
+            = atomic_load_explicit(&entry->trace_id, memory_order_relaxed),
+            .point = atomic_load_explicit(&entry->point, memory_order_relaxed),
+        };
+        atomic_thread_fence(memory_order_acquire);
+        if (seq != idx + 1
+            || atomic_load_explicit(&entry->seq, memory_order_relaxed) != seq
+            || event.point >= TRACE_POINT_COUNT) {
+            continue; // Overwritten or still being written
+        }
+        trace_snapshot_buf[count++] = event;
+    }
+    return count;
+}
+
+static const TraceEvent *find_previous(size_t index) {
+    size_t stop = index > TRACE_SPAN_LOOKBACK ? index - TRACE_SPAN_LOOKBACK : 0;
+    for (size_t i = index; i > stop; i--) {
+        if (trace_snapshot_buf[i - 1].trace_id
+            == trace_snapshot_buf[index].trace_id) {
+            return &trace_snapshot_buf[i - 1];
+        }
+    }
+    return NULL;
+}
+
+// Each point becomes a span from the previous point of the same tunnel, with
+// one row (tid) per trace ID.
+static GgError export_snapshot(int fd, size_t count) {
+    int pid = (int) getpid();
+    if (dprintf(fd, "[") < 0) {
+        return GG_ERR_FAILURE;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const TraceEvent *event = &trace_snapshot_buf[i];
+        const TraceEvent *prev = find_previous(i);
+        const char *sep = i == 0 ? "" : ",";
+        int ret;
+        if (prev == NULL) {
+            ret = dprintf(
+                fd,
+                "%s\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,"
+                "\"tid\":%u,\"ts\":%.3f}",
+                sep,
+                TRACE_POINT_NAMES[event->point],
+                pid,
+                event->trace_id,
+                (double) event->ts_ns / 1000.0
+            );
+        } else {
+            ret = dprintf(
+                fd,
+                "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                sep,
+                TRACE_POINT_NAMES[event->point],
+                pid,
+                event->trace_id,
+                (double) prev->ts_ns / 1000.0,
+                (double) (event->ts_ns - prev->ts_ns) / 1000.0
+            );
+        }
+        if (ret < 0) {
+            return GG_ERR_FAILURE;
+        }
+    }
+    return dprintf(fd, "\n]\n") < 0 ? GG_ERR_FAILURE : GG_ERR_OK;
+}
+
+GgError trace_export_chrome(int fd) {
+    GG_MTX_SCOPE_GUARD(&trace_export_mutex);
+    return export_snapshot(fd, trace_snapshot());
+}
+
+static void log_trace_summary(size_t count) {
+    uint64_t total_ns[TRACE_POINT_COUNT] = { 0 };
+    uint32_t samples[TRACE_POINT_COUNT] = { 0 };
+
+    for (size_t i = 0; i < count; i++) {
+        const TraceEvent *prev = find_previous(i);
+        if (prev != NULL) {
+            uint32_t point = trace_snapshot_buf[i].point;
+            total_ns[point] += trace_snapshot_buf[i].ts_ns - prev->ts_ns;
+            samples[point]++;
+        }
+    }
+
+    GG_LOGI("Trace buffer holds %zu events", count);
+    for (int point = 0; point < TRACE_POINT_COUNT; point++) {
+        if (samples[point] > 0) {
+            GG_LOGI(
+                "Trace %s: avg %.1f us since previous point (%u samples)",
+                TRACE_POINT_NAMES[point],
+                (double) total_ns[point] / samples[point] / 1000.0,
+                samples[point]
+            );
+        }
+    }
+}
+
+static void export_to_file(void) {
+    int fd = open(
+        TRACE_EXPORT_PATH, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644
+    );
+    if (fd == -1) {
+        GG_LOGE("Failed to open %s for trace export", TRACE_EXPORT_PATH);
+        return;
+    }
+    GG_CLEANUP(cleanup_close, fd);
+
+    GG_MTX_SCOPE_GUARD(&trace_export_mutex);
+    size_t count = trace_snapshot();
+    log_trace_summary(count);
+    if (export_snapshot(fd, count) != GG_ERR_OK) {
+        GG_LOGE("Failed to write trace export");
+        return;
+    }
+    GG_LOGI("Exported tunnel trace to %s", TRACE_EXPORT_PATH);
+}
+
+static void *trace_signal_thread(void *arg) {
+    (void) arg;
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+
+    while (true) {
+        int sig = 0;
+        if (sigwait(&set, &sig) == 0 && sig == SIGUSR1) {
+            export_to_file();
+        }
+    }
+
+    return NULL;
+}
+
+GgError trace_init(void) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+        GG_LOGE("Failed to block SIGUSR1");
+        return GG_ERR_FAILURE;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, trace_signal_thread, NULL) != 0) {
+        GG_LOGE("Failed to create trace export thread");
+        return GG_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+    return GG_ERR_OK;
+}
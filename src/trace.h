@@ -0,0 +1,53 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_TRACE_H
+#define ST_TRACE_H
+
+#include <gg/error.h>
+#include <stdint.h>
+
+#define TRACE_EXPORT_PATH "secure-tunnel-trace.json"
+
+typedef enum {
+    TRACE_IPC_CALLBACK,
+    TRACE_JSON_DECODE,
+    TRACE_VALIDATE,
+    TRACE_SLOT_ALLOC,
+    TRACE_DISPATCH,
+    TRACE_FORK,
+    TRACE_EXEC,
+    TRACE_FIRST_OUTPUT,
+    TRACE_EXIT,
+    TRACE_POINT_COUNT,
+} TracePoint;
+
+// Starts a new trace on the calling thread and returns its ID. Points recorded
+// with trace_record_current on this thread belong to it.
+uint32_t trace_begin(void);
+
+// Returns the trace started on the calling thread, or 0 if none.
+uint32_t trace_current(void);
+
+// Records a timestamped point into the ring buffer. Lock-free and safe to call
+// from any thread.
+void trace_record(uint32_t trace_id, TracePoint point);
+
+void trace_record_current(TracePoint point);
+
+// Writes the buffered points as Chrome trace-event JSON.
+GgError trace_export_chrome(int fd);
+
+// Blocks SIGUSR1 and starts a thread that exports the trace to
+// TRACE_EXPORT_PATH whenever the signal arrives. Must run before any other
+// thread is created so the signal mask is inherited.
+GgError trace_init(void);
+
+#endif // ST_TRACE_H
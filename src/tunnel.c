@@ -1,7 +1,21 @@
 
 #include "tunnel.h"
 #include "secure-tunnel.h"
+#include "secure-tunnel-manager.h"
 #include "tunnel_notification_parser.h"
+#include "host_budget.h"
+#include "latency_class.h"
+#include "launch_limiter.h"
+#include "launcher.h"
+#include "localproxy_caps.h"
+#include "pressure.h"
+#include "proxy_host.h"
+#include "sock_diag.h"
+#include "trace.h"
+#include "tunnel_clock.h"
+#include "tunnel_events.h"
+#include "tunnel_settings.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <gg/buffer.h>
 #include <gg/cleanup.h>
@@ -9,22 +23,108 @@
 #include <gg/file.h>
 #include <gg/log.h>
 #include <gg/vector.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define LOCALPROXY_LOG_LEVEL "2" // 2=warnings/errors, 4=debug
+#define LOCALPROXY_STOP_GRACE_MS 5000
+#define TUNNEL_SAMPLE_INTERVAL_MS 10000
+// Keepalives and localproxy's own log output stay below this per sample
+#define TUNNEL_IDLE_MIN_BYTES 4096
 
 static pthread_mutex_t tunnel_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int active_tunnels = 0;
-static TunnelCreationContext tunnel_contexts[20];
+static TunnelCreationContext tunnel_contexts[TUNNEL_MAX_SLOTS];
 static uint32_t tunnel_slots_mask = 0;
 static const SecureTunnelConfig *tunnel_config = NULL;
+// Guarded by tunnel_mutex. Until a configuration update is applied the limits
+// come from the command line arguments.
+static TunnelSettings tunnel_settings;
+static bool tunnel_settings_applied = false;
+static atomic_bool tunnel_draining = false;
+static _Atomic(const SecureTunnelHooks *) tunnel_hooks = NULL;
+static pthread_once_t timeout_monitor_once = PTHREAD_ONCE_INIT;
+
+// What tunnel_list reports about a slot. Kept apart from the context so the
+// access token is never copied to reader threads.
+typedef struct {
+    char service[64];
+    char thing_name[TUNNEL_MAX_THING_NAME_LEN];
+    pid_t pid;
+    bool latency_class;
+    int timeout_seconds;
+    int64_t started_ms;
+    uint64_t read_bytes;
+    uint64_t written_bytes;
+    int64_t active_ms;
+    TunnelNetMetrics net;
+    bool stopping;
+} TunnelSnapshot;
+
+// Copy of the slot table for readers that must not contend with admission.
+// Written under tunnel_mutex; tunnel_table_seq is odd while an update is in
+// progress.
+static _Atomic uint32_t tunnel_table_seq = 0;
+static TunnelSnapshot tunnel_table[TUNNEL_MAX_SLOTS];
+static uint32_t tunnel_table_mask = 0;
+
+// Tunnel lifetimes follow the tunnel clock, which tests may replace
+static int64_t monotonic_ms(void) {
+    return tunnel_clock_now_ms();
+}
+
+// Sample at least twice per idle timeout so it is not overshot by much
+static int64_t sample_interval_ms(const TunnelCreationContext *ctx) {
+    int64_t idle_ms = ctx->idle_timeout_seconds * 1000LL;
+    return idle_ms > 0 && idle_ms / 2 < TUNNEL_SAMPLE_INTERVAL_MS
+        ? idle_ms / 2
+        : TUNNEL_SAMPLE_INTERVAL_MS;
+}
+
+// Samples fall on multiples of the interval, so tunnels sampled at the same
+// interval share one monitor wakeup
+static int64_t sample_due_ms(const TunnelCreationContext *ctx, int64_t now) {
+    int64_t interval = sample_interval_ms(ctx);
+    return (now / interval + 1) * interval;
+}
+
+// Caller holds tunnel_mutex
+static void publish_slot(int slot) {
+    const TunnelCreationContext *ctx = &tunnel_contexts[slot];
+    atomic_fetch_add_explicit(&tunnel_table_seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    TunnelSnapshot *snapshot = &tunnel_table[slot];
+    memcpy(snapshot->service, ctx->service, sizeof(snapshot->service));
+    memcpy(
+        snapshot->thing_name, ctx->thing_name, sizeof(snapshot->thing_name)
+    );
+    snapshot->pid = ctx->pid;
+    snapshot->latency_class = ctx->latency.set;
+    snapshot->timeout_seconds = ctx->timeout_seconds;
+    snapshot->started_ms = ctx->started_ms;
+    snapshot->read_bytes = ctx->read_bytes;
+    snapshot->written_bytes = ctx->written_bytes;
+    snapshot->active_ms = ctx->active_ms;
+    snapshot->net = ctx->net;
+    snapshot->stopping = ctx->stop_ms != 0;
+    tunnel_table_mask = tunnel_slots_mask;
+    atomic_fetch_add_explicit(&tunnel_table_seq, 1, memory_order_release);
+}
 
 static void cleanup_tunnel_slot(TunnelCreationContext **ctx) {
     if (*ctx != NULL) {
@@ -32,15 +132,60 @@ static void cleanup_tunnel_slot(TunnelCreationContext **ctx) {
         active_tunnels--;
         int slot = (int) (*ctx - tunnel_contexts);
         tunnel_slots_mask &= ~(1U << slot);
-        GG_LOGI("Tunnel closed (active tunnels: %d)", active_tunnels);
+        publish_slot(slot);
+        host_budget_release((*ctx)->host_reservation);
+
+        // Under tunnel_mutex so it cannot overtake the tunnel's open event
+        tunnel_event_emit(&(TunnelEvent) {
+            .type = TUNNEL_EVENT_EXIT,
+            .slot = slot,
+            .service = (*ctx)->service,
+            .thing_name = (*ctx)->thing_name,
+            .port = (*ctx)->port,
+            .exit_status = (*ctx)->exit_status,
+            .lifetime_ms = monotonic_ms() - (*ctx)->started_ms,
+        });
+        GG_LOGI(
+            "Tunnel closed after reading %llu and writing %llu bytes (active "
+            "tunnels: %d)",
+            (unsigned long long) (*ctx)->read_bytes,
+            (unsigned long long) (*ctx)->written_bytes,
+            active_tunnels
+        );
         *ctx = NULL;
     }
 }
 
-static int prepare_localproxy_fd(void) {
+// Hands the running tunnel in slot to the monitor, which samples its traffic
+// from now on. Caller holds tunnel_mutex.
+static void watch_slot(int slot) {
+    TunnelCreationContext *ctx = &tunnel_contexts[slot];
+    ctx->next_sample_ms = sample_due_ms(ctx, monotonic_ms());
+    ctx->stop_ms = 0;
+    ctx->killed = false;
+    tunnel_clock_wake();
+}
+
+// Makes the running localproxy visible to tunnel_close, tunnel_list and the
+// monitor. Must be cleared before the child is reaped so its pid cannot be
+// reused.
+static void set_slot_process(
+    const TunnelCreationContext *ctx, pid_t pid, int pidfd
+) {
+    int slot = (int) (ctx - tunnel_contexts);
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    tunnel_contexts[slot].pid = pid;
+    tunnel_contexts[slot].pidfd = pidfd;
+    if (pid != 0) {
+        watch_slot(slot);
+    }
+    publish_slot(slot);
+}
+
+static int prepare_localproxy_fd(GgBuffer artifact_path) {
     char localproxy_path[512];
     GgByteVec path_vec = GG_BYTE_VEC(localproxy_path);
-    GgError ret = gg_byte_vec_append(&path_vec, tunnel_config->artifact_path);
+    GgError ret = gg_byte_vec_append(&path_vec, artifact_path);
     gg_byte_vec_chain_append(&ret, &path_vec, GG_STR("/localproxy"));
     if (ret != GG_ERR_OK) {
         GG_LOGE("Failed to build localproxy path");
@@ -65,10 +210,297 @@ static int prepare_localproxy_fd(void) {
     return fd;
 }
 
-static void execute_localproxy(
-    int localproxy_fd, const char *const *args, const char *access_token
+typedef struct {
+    pid_t pid;
+    int pidfd;
+    int output_fd;
+    uint32_t trace_id;
+    bool output_seen;
+} LocalproxyProcess;
+
+// Forwards a chunk of localproxy output to our stdout. Returns false at EOF.
+static bool relay_output(LocalproxyProcess *proc) {
+    char buf[1024];
+    ssize_t len = read(proc->output_fd, buf, sizeof(buf));
+    if (len == -1 && errno == EINTR) {
+        return true;
+    }
+    if (len <= 0) {
+        return false;
+    }
+    if (!proc->output_seen) {
+        proc->output_seen = true;
+        trace_record(proc->trace_id, TRACE_FIRST_OUTPUT);
+    }
+    for (ssize_t off = 0; off < len;) {
+        ssize_t written = write(STDOUT_FILENO, &buf[off], (size_t) (len - off));
+        if (written <= 0 && errno != EINTR) {
+            break;
+        }
+        off += written > 0 ? written : 0;
+    }
+    return true;
+}
+
+// Relays output until localproxy exits
+static void wait_localproxy_exit(LocalproxyProcess *proc) {
+    while (proc->pidfd >= 0 || proc->output_fd >= 0) {
+        struct pollfd fds[2] = {
+            { .fd = proc->pidfd, .events = POLLIN },
+            { .fd = proc->output_fd, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            GG_LOGE("Failed to poll localproxy process: %d", errno);
+            return; // Fall back to a blocking waitpid
+        }
+        if (fds[1].revents != 0 && !relay_output(proc)) {
+            close(proc->output_fd);
+            proc->output_fd = -1;
+        }
+        if (fds[0].revents != 0) {
+            return;
+        }
+    }
+}
+
+// Caller holds tunnel_mutex, so the pid cannot have been reaped and reused
+static int signal_slot(const TunnelCreationContext *ctx, int sig) {
+    return ctx->pidfd >= 0
+        ? (int) syscall(SYS_pidfd_send_signal, ctx->pidfd, sig, NULL, 0)
+        : kill(ctx->pid, sig);
+}
+
+// Reads the bytes a process has moved through read and write calls. For
+// localproxy that is the traffic on its tunnel and destination sockets.
+static bool read_process_io(
+    pid_t pid, uint64_t *read_bytes, uint64_t *written_bytes
+) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/io", (int) pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    char buf[256];
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) {
+        return false;
+    }
+    buf[len] = '\0';
+
+    unsigned long long rchar = 0;
+    unsigned long long wchar = 0;
+    if (sscanf(buf, "rchar: %llu wchar: %llu", &rchar, &wchar) != 2) {
+        return false;
+    }
+    *read_bytes = rchar;
+    *written_bytes = wchar;
+    return true;
+}
+
+// Updates the traffic accounting of the tunnel in slot from its localproxy's
+// counters. Caller holds tunnel_mutex.
+static void sample_traffic(int slot, int64_t now) {
+    TunnelCreationContext *ctx = &tunnel_contexts[slot];
+    uint64_t read_bytes = 0;
+    uint64_t written_bytes = 0;
+    if (ctx->hosted) {
+        proxy_host_stats(slot, &read_bytes, &written_bytes);
+    } else if (!read_process_io(ctx->pid, &read_bytes, &written_bytes)) {
+        return;
+    }
+    if (read_bytes - ctx->read_bytes + written_bytes - ctx->written_bytes
+        >= TUNNEL_IDLE_MIN_BYTES) {
+        ctx->active_ms = now;
+    }
+    ctx->read_bytes = read_bytes;
+    ctx->written_bytes = written_bytes;
+}
+
+typedef struct {
+    int slot;
+    pid_t pid;
+    uint16_t port;
+} NetworkSample;
+
+// Publishes tcp_info of localproxy's websocket and destination connections
+static void sample_localproxy_network(const NetworkSample *sample) {
+    TunnelNetMetrics net;
+    if (!sock_diag_process_metrics(sample->pid, sample->port, &net)) {
+        return;
+    }
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    // The tunnel may have ended while its sockets were read
+    if (tunnel_contexts[sample->slot].pid == sample->pid) {
+        tunnel_contexts[sample->slot].net = net;
+        publish_slot(sample->slot);
+    }
+}
+
+static int64_t tunnel_deadline_ms(const TunnelCreationContext *ctx) {
+    return ctx->started_ms + ctx->timeout_seconds * 1000LL;
+}
+
+// Returns whether the tunnel has reached its lifetime, or its idle timeout
+// as of a traffic sample taken now
+static bool tunnel_expired(
+    const TunnelCreationContext *ctx, int64_t now, bool sampled
+) {
+    if (now >= tunnel_deadline_ms(ctx)) {
+        GG_LOGI(
+            "Tunnel timeout of %d seconds reached, stopping localproxy",
+            ctx->timeout_seconds
+        );
+        return true;
+    }
+    if (sampled && ctx->idle_timeout_seconds > 0
+        && now - ctx->active_ms >= ctx->idle_timeout_seconds * 1000LL) {
+        GG_LOGI(
+            "Tunnel idle for %d seconds, stopping localproxy",
+            ctx->idle_timeout_seconds
+        );
+        return true;
+    }
+    return false;
+}
+
+// Asks the tunnel in slot to end, or ends it if it did not within
+// LOCALPROXY_STOP_GRACE_MS. Caller holds tunnel_mutex.
+static void stop_slot(int slot, int64_t now) {
+    TunnelCreationContext *ctx = &tunnel_contexts[slot];
+    if (ctx->stop_ms == 0) {
+        ctx->stop_ms = now;
+        if (ctx->hosted) {
+            (void) proxy_host_close(slot);
+        } else {
+            (void) signal_slot(ctx, SIGTERM);
+        }
+        return;
+    }
+
+    ctx->killed = true;
+    if (ctx->hosted) {
+        GG_LOGW(
+            "localproxy host did not close tunnel in slot %d, killing", slot
+        );
+        proxy_host_abandon(slot);
+    } else {
+        GG_LOGW("localproxy did not exit after SIGTERM, killing");
+        (void) signal_slot(ctx, SIGKILL);
+    }
+}
+
+// Samples the running tunnel in slot and enforces its timeouts. Returns when
+// the slot next needs the monitor. Caller holds tunnel_mutex.
+static int64_t monitor_slot(int slot, int64_t now, bool *sampled) {
+    TunnelCreationContext *ctx = &tunnel_contexts[slot];
+    *sampled = false;
+    if (ctx->stop_ms != 0) {
+        int64_t kill_ms = ctx->stop_ms + LOCALPROXY_STOP_GRACE_MS;
+        if (!ctx->killed && now >= kill_ms) {
+            stop_slot(slot, now);
+        }
+        return ctx->killed ? INT64_MAX : kill_ms;
+    }
+
+    bool sample_due = now >= ctx->next_sample_ms;
+    if (sample_due) {
+        sample_traffic(slot, now);
+        ctx->next_sample_ms = sample_due_ms(ctx, now);
+        *sampled = !ctx->hosted;
+    }
+    if (tunnel_expired(ctx, now, sample_due)) {
+        stop_slot(slot, now);
+        return now + LOCALPROXY_STOP_GRACE_MS;
+    }
+    int64_t deadline = tunnel_deadline_ms(ctx);
+    return ctx->next_sample_ms < deadline ? ctx->next_sample_ms : deadline;
+}
+
+// Returns when the monitor next needs to run
+static int64_t monitor_slots(
+    int64_t now, NetworkSample *samples, size_t *sample_count
+) {
+    int64_t next = INT64_MAX;
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        const TunnelCreationContext *ctx = &tunnel_contexts[slot];
+        if ((tunnel_slots_mask & (1U << slot)) == 0 || ctx->pid == 0) {
+            continue;
+        }
+        bool sampled;
+        int64_t due = monitor_slot(slot, now, &sampled);
+        next = due < next ? due : next;
+        if (sampled) {
+            samples[(*sample_count)++] = (NetworkSample) {
+                .slot = slot, .pid = ctx->pid, .port = ctx->port
+            };
+        }
+        publish_slot(slot);
+    }
+    return next;
+}
+
+static int64_t monitor_tick(int64_t now) {
+    NetworkSample samples[TUNNEL_MAX_SLOTS];
+    size_t sample_count = 0;
+    int64_t next = monitor_slots(now, samples, &sample_count);
+    // A sock_diag dump covers every connection in the namespace, so it runs
+    // without tunnel_mutex
+    for (size_t i = 0; i < sample_count; i++) {
+        sample_localproxy_network(&samples[i]);
+    }
+    return next;
+}
+
+// Enforces the lifetime and idle timeout of every running tunnel, so tunnel
+// workers only wait for localproxy to exit
+static void *monitor_thread(void *arg) {
+    (void) arg;
+    while (true) {
+        tunnel_clock_sleep_until(monitor_tick(monotonic_ms()));
+    }
+    return NULL;
+}
+
+static void start_timeout_monitor(void) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, monitor_thread, NULL) != 0) {
+        GG_LOGE("Failed to create tunnel monitor thread");
+        return;
+    }
+    pthread_detach(thread);
+}
+
+// Reads the child's exec result from a close-on-exec pipe: EOF means exec
+// succeeded, otherwise the child wrote its errno.
+static bool await_exec(int status_fd) {
+    int child_errno = 0;
+    ssize_t len;
+    do {
+        len = read(status_fd, &child_errno, sizeof(child_errno));
+    } while (len == -1 && errno == EINTR);
+    if (len > 0) {
+        GG_LOGE("Failed to exec localproxy: %d", child_errno);
+        return false;
+    }
+    return true;
+}
+
+// Forks localproxy from this process when the launcher is unavailable
+static pid_t fork_localproxy(
+    int localproxy_fd,
+    const char *const *args,
+    const char *access_token,
+    int output_fd,
+    int status_fd,
+    int netns_fd,
+    const LatencyClass *latency
 ) {
-    // Fork and execute localproxy
     pid_t pid = fork();
     if (pid == 0) {
         // Child process: kill localproxy if parent dies
@@ -79,6 +511,21 @@ static void execute_localproxy(
             _exit(1);
         }
 
+        if (netns_fd >= 0 && setns(netns_fd, CLONE_NEWNET) != 0) {
+            int setns_errno = errno;
+            (void) write(status_fd, &setns_errno, sizeof(setns_errno));
+            _exit(1);
+        }
+        (void) latency_class_apply(latency, 0);
+
+        // Signals blocked for the component's own handling threads
+        sigset_t none;
+        sigemptyset(&none);
+        pthread_sigmask(SIG_SETMASK, &none, NULL);
+
+        dup2(output_fd, STDOUT_FILENO);
+        dup2(output_fd, STDERR_FILENO);
+
         // Set access token via environment variable
         // NOLINTNEXTLINE(concurrency-mt-unsafe)
         setenv("AWSIOT_TUNNEL_ACCESS_TOKEN", access_token, 1);
@@ -86,117 +533,715 @@ static void execute_localproxy(
         // Execute localproxy
         fexecve(localproxy_fd, (char *const *) args, environ);
 
-        GG_LOGE("Failed to exec localproxy");
+        int exec_errno = errno;
+        (void) write(status_fd, &exec_errno, sizeof(exec_errno));
         _exit(1);
+    }
+    return pid;
+}
 
-    } else if (pid > 0) {
-        // Parent process: wait for completion
-        int status;
-        waitpid(pid, &status, 0);
+// The child cannot log, so a nice level it lacked CAP_SYS_NICE for is
+// reported here
+static void check_latency_class(const TunnelCreationContext *ctx, pid_t pid) {
+    if (!ctx->latency.renice) {
+        return;
+    }
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, (id_t) pid);
+    if (errno == 0 && nice != ctx->latency.nice) {
+        GG_LOGW(
+            "localproxy for service %s runs at nice %d instead of %d",
+            ctx->service,
+            nice,
+            (int) ctx->latency.nice
+        );
+    }
+}
 
-        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
-            GG_LOGI("Tunnel completed successfully");
-        } else {
-            GG_LOGW("Tunnel exited with status: %d", status);
+// Returns the localproxy wait status, or -1 if it could not be started
+static int execute_localproxy(
+    int localproxy_fd,
+    const char *const *args,
+    const char *access_token,
+    int netns_fd,
+    const TunnelCreationContext *ctx
+) {
+    int exec_pipe[2];
+    int output_pipe[2];
+    if (pipe2(exec_pipe, O_CLOEXEC) != 0) {
+        GG_LOGE("Failed to create localproxy pipes");
+        return -1;
+    }
+    if (pipe2(output_pipe, O_CLOEXEC) != 0) {
+        GG_LOGE("Failed to create localproxy pipes");
+        close(exec_pipe[0]);
+        close(exec_pipe[1]);
+        return -1;
+    }
+
+    // An embedding host may start localproxy itself; otherwise the launcher
+    // keeps fork cost independent of this process's size.
+    pid_t pid = 0;
+    int pidfd = -1;
+    const SecureTunnelHooks *hooks = atomic_load(&tunnel_hooks);
+    GgError ret = GG_ERR_UNSUPPORTED;
+    if (hooks != NULL && hooks->spawn != NULL) {
+        SecureTunnelSpawn spawn = {
+            .exe_fd = localproxy_fd,
+            .args = args,
+            .access_token = access_token,
+            .output_fd = output_pipe[1],
+            .status_fd = exec_pipe[1],
+            .netns_fd = netns_fd,
+        };
+        ret = hooks->spawn(hooks->ctx, &spawn, &pid, &pidfd);
+        if (ret != GG_ERR_OK && ret != GG_ERR_UNSUPPORTED) {
+            GG_LOGE("Host failed to start localproxy: %d", ret);
+            pid = -1;
         }
-    } else {
+        // The host started it, so the class can only be applied afterwards
+        int error = 0;
+        if (ret == GG_ERR_OK) {
+            error = latency_class_apply(&ctx->latency, pid);
+        }
+        if (error != 0) {
+            GG_LOGW(
+                "Failed to apply latency class for service %s: %d",
+                ctx->service,
+                error
+            );
+        }
+    }
+    if (ret == GG_ERR_UNSUPPORTED
+        && launcher_spawn(
+               localproxy_fd,
+               args,
+               access_token,
+               output_pipe[1],
+               exec_pipe[1],
+               netns_fd,
+               -1,
+               &ctx->latency,
+               &pid,
+               &pidfd
+           )
+            != GG_ERR_OK) {
+        pid = fork_localproxy(
+            localproxy_fd,
+            args,
+            access_token,
+            output_pipe[1],
+            exec_pipe[1],
+            netns_fd,
+            &ctx->latency
+        );
+        // glibc 2.35 has no pidfd_open wrapper, so the syscall is used
+        // directly
+        pidfd = pid > 0 ? (int) syscall(SYS_pidfd_open, pid, 0) : -1;
+    }
+
+    close(exec_pipe[1]);
+    close(output_pipe[1]);
+    GG_CLEANUP(cleanup_close, exec_pipe[0]);
+
+    if (pid < 0) {
         GG_LOGE("Failed to fork process");
+        close(output_pipe[0]);
+        return -1;
+    }
+
+    // Parent process: wait for completion
+    trace_record(ctx->trace_id, TRACE_FORK);
+    bool exec_ok = await_exec(exec_pipe[0]);
+    if (exec_ok) {
+        trace_record(ctx->trace_id, TRACE_EXEC);
+        check_latency_class(ctx, pid);
+    }
+
+    LocalproxyProcess proc = { .pid = pid,
+                               .pidfd = pidfd,
+                               .output_fd = output_pipe[0],
+                               .trace_id = ctx->trace_id };
+    set_slot_process(ctx, pid, pidfd);
+    wait_localproxy_exit(&proc);
+    set_slot_process(ctx, 0, -1);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+    trace_record(ctx->trace_id, TRACE_EXIT);
+
+    // Flush whatever localproxy wrote right before exiting
+    if (proc.output_fd >= 0) {
+        while (relay_output(&proc)) { }
+        close(proc.output_fd);
+    }
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        GG_LOGI("Tunnel completed successfully");
+    } else {
+        GG_LOGW("Tunnel exited with status: %d", status);
+    }
+    return exec_ok ? status : -1;
+}
+
+// Formats the localproxy -d value. Multiplexed tunnels name the service
+// their connections are for.
+static bool format_destination(
+    const TunnelCreationContext *ctx, bool multiplex, char *buf, size_t len
+) {
+    int written = multiplex
+        ? snprintf(buf, len, "%s=%s:%u", ctx->service, ctx->host, ctx->port)
+        : snprintf(buf, len, "%s:%u", ctx->host, ctx->port);
+    return written > 0 && (size_t) written < len;
+}
+
+static void set_slot_hosted(const TunnelCreationContext *ctx, pid_t host_pid) {
+    int slot = (int) (ctx - tunnel_contexts);
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    tunnel_contexts[slot].pid = host_pid;
+    tunnel_contexts[slot].hosted = host_pid != 0;
+    if (host_pid != 0) {
+        watch_slot(slot);
+    }
+    publish_slot(slot);
+}
+
+// Runs the tunnel in the shared localproxy host, which the monitor holds to
+// the same timeouts as a localproxy process. Returns the tunnel's wait status,
+// or -1 if the host could not take it.
+static int run_hosted_tunnel(const TunnelCreationContext *ctx) {
+    int slot = (int) (ctx - tunnel_contexts);
+    bool multiplex = ctx->client_type == TUNNEL_CLIENT_AUTO;
+    char dest_addr[144];
+    if (!format_destination(ctx, multiplex, dest_addr, sizeof(dest_addr))) {
+        GG_LOGE("Failed to format destination address");
+        return -1;
+    }
+
+    pid_t host_pid = 0;
+    if (proxy_host_open(
+            tunnel_config->artifact_path,
+            slot,
+            ctx->access_token,
+            ctx->region,
+            dest_addr,
+            multiplex,
+            &host_pid
+        )
+        != GG_ERR_OK) {
+        return -1;
     }
+    set_slot_hosted(ctx, host_pid);
+
+    // The monitor closes or abandons the tunnel once it expires
+    int status = -1;
+    (void) proxy_host_wait(slot, -1, &status);
+    set_slot_hosted(ctx, 0);
+    trace_record(ctx->trace_id, TRACE_EXIT);
+    return status;
 }
 
 static void *tunnel_worker(void *arg) {
     TunnelCreationContext *ctx = (TunnelCreationContext *) arg;
     GG_CLEANUP(cleanup_tunnel_slot, ctx);
+    trace_record(ctx->trace_id, TRACE_DISPATCH);
 
-    GG_LOGI("Starting tunnel for service: %s", ctx->service);
+    GG_LOGI(
+        "Starting tunnel for service: %s (thing: %s)",
+        ctx->service,
+        ctx->thing_name
+    );
 
     if (tunnel_config->artifact_path.len == 0) {
         return NULL;
     }
 
-    int localproxy_fd = prepare_localproxy_fd();
+    // The shared host runs in the component's network namespace and at its
+    // priority
+    if (ctx->proxy_host && ctx->netns[0] == '\0' && !ctx->latency.set
+        && proxy_host_present(tunnel_config->artifact_path)) {
+        GG_LOGI(
+            "Using localproxy host for service: %s on port %u",
+            ctx->service,
+            ctx->port
+        );
+        ctx->exit_status = run_hosted_tunnel(ctx);
+        return NULL;
+    }
+
+    int localproxy_fd = prepare_localproxy_fd(tunnel_config->artifact_path);
     if (localproxy_fd == -1) {
         return NULL;
     }
     GG_CLEANUP(cleanup_close, localproxy_fd);
 
-    char dest_addr[32];
-    int written
-        = snprintf(dest_addr, sizeof(dest_addr), "localhost:%u", ctx->port);
-    if (written < 0 || (size_t) written >= sizeof(dest_addr)) {
+    int netns_fd = -1;
+    if (ctx->netns[0] != '\0') {
+        netns_fd = open(ctx->netns, O_RDONLY | O_CLOEXEC);
+        if (netns_fd == -1) {
+            GG_LOGE(
+                "Failed to open network namespace %s for service %s: %d",
+                ctx->netns,
+                ctx->service,
+                errno
+            );
+            return NULL;
+        }
+    }
+    GG_CLEANUP(cleanup_close, netns_fd);
+
+    // V3 multiplexes connections to each named service; older protocols
+    // carry a single connection to an unnamed destination.
+    LocalproxyProtocol protocol = localproxy_probe(localproxy_fd);
+    bool multiplex = ctx->client_type == TUNNEL_CLIENT_AUTO
+        && protocol == LOCALPROXY_PROTOCOL_V3;
+
+    char dest_addr[144];
+    if (!format_destination(ctx, multiplex, dest_addr, sizeof(dest_addr))) {
         GG_LOGE("Failed to format destination address");
         return NULL;
     }
 
     // Prepare localproxy arguments (without access token)
-    const char *args[] = { "localproxy", "-r",      ctx->region,
-                           "-d",         dest_addr, "--destination-client-type",
-                           "V1",         "-v",      LOCALPROXY_LOG_LEVEL,
-                           NULL };
+    const char *args[10] = { "localproxy", "-r", ctx->region, "-d", dest_addr,
+                             "-v", LOCALPROXY_LOG_LEVEL };
+    size_t arg_count = 7;
+    if (!multiplex && protocol != LOCALPROXY_PROTOCOL_V1) {
+        args[arg_count++] = "--destination-client-type";
+        args[arg_count++] = "V1";
+    }
 
     GG_LOGI(
-        "Using localproxy for service: %s on port %u", ctx->service, ctx->port
+        "Using localproxy for service: %s on port %u (%s%s%s)",
+        ctx->service,
+        ctx->port,
+        multiplex ? "multiplexed" : "single connection",
+        netns_fd >= 0 ? ", network namespace " : "",
+        netns_fd >= 0 ? ctx->netns : ""
     );
 
-    execute_localproxy(localproxy_fd, args, ctx->access_token);
+    ctx->exit_status = execute_localproxy(
+        localproxy_fd, args, ctx->access_token, netns_fd, ctx
+    );
 
     return NULL;
 }
 
+// Resolves the destination host and port for request. Caller holds
+// tunnel_mutex.
+static GgError route_request(
+    const SecureTunnelConfig *config, TunnelCreationContext *request
+) {
+    GgBuffer thing_name = gg_buffer_from_null_term(request->thing_name);
+    const TunnelServiceMapping *services = tunnel_settings.services;
+    size_t service_count = tunnel_settings.service_count;
+    const char *host = "localhost";
+
+    if (!gg_buffer_eq(thing_name, config->thing_name)) {
+        const TunnelDestination *destination
+            = tunnel_settings_find_destination(&tunnel_settings, thing_name);
+        if (destination == NULL) {
+            GG_LOGE(
+                "No gateway destination configured for thing %s",
+                request->thing_name
+            );
+            return GG_ERR_NOENTRY;
+        }
+        host = destination->host;
+        if (destination->service_count > 0) {
+            services = destination->services;
+            service_count = destination->service_count;
+        }
+    }
+
+    request->port = get_port_from_service(
+        services, service_count, gg_buffer_from_null_term(request->service)
+    );
+    if (request->port == 0) {
+        GG_LOGE(
+            "Unsupported service %s for thing %s",
+            request->service,
+            request->thing_name
+        );
+        return GG_ERR_INVALID;
+    }
+    strcpy(request->host, host);
+
+    // Local services may live in another network namespace, e.g. a container
+    const char *netns = tunnel_settings_find_namespace(
+        &tunnel_settings, gg_buffer_from_null_term(request->service)
+    );
+    request->netns[0] = '\0';
+    if (netns != NULL && strcmp(host, "localhost") == 0) {
+        strcpy(request->netns, netns);
+    }
+
+    const LatencyClass *latency = tunnel_settings_find_latency(
+        &tunnel_settings, gg_buffer_from_null_term(request->service)
+    );
+    request->latency = latency != NULL ? *latency : (LatencyClass) { 0 };
+    return GG_ERR_OK;
+}
+
+// Checks that something listens on a local destination before localproxy is
+// spawned for it. Looking up the listener may dump sockets over netlink, so
+// this runs without tunnel_mutex.
+static bool destination_preflight(
+    const TunnelCreationContext *request, TunnelPreflight mode
+) {
+    // The listener snapshot only covers the component's network namespace
+    if (mode == TUNNEL_PREFLIGHT_OFF || strcmp(request->host, "localhost") != 0
+        || request->netns[0] != '\0'
+        || sock_diag_local_listener(request->port) != LISTENER_ABSENT) {
+        return true;
+    }
+    if (mode == TUNNEL_PREFLIGHT_REJECT) {
+        GG_LOGE(
+            "Nothing listens on port %u for service %s",
+            request->port,
+            request->service
+        );
+        return false;
+    }
+    GG_LOGW(
+        "Nothing listens on port %u for service %s; the tunnel will not "
+        "connect until it does",
+        request->port,
+        request->service
+    );
+    return true;
+}
+
+static GgError reject_request(
+    const TunnelCreationContext *request,
+    TunnelRejectReason reason,
+    GgError err
+) {
+    tunnel_event_emit(&(TunnelEvent) {
+        .type = TUNNEL_EVENT_REJECT,
+        .reason = reason,
+        .slot = -1,
+        .service = request->service,
+        .thing_name = request->thing_name,
+        .port = request->port,
+        .exit_status = -1,
+    });
+    return err;
+}
+
+// Caller holds tunnel_mutex
+static int count_thing_tunnels(const char *thing_name) {
+    int count = 0;
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        if ((tunnel_slots_mask & (1U << slot)) != 0
+            && strcmp(tunnel_contexts[slot].thing_name, thing_name) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
 GgError handle_tunnel_notification(
     GgMap notification, const SecureTunnelConfig *config
 ) {
+    return handle_tunnel_notification_for_thing(
+        notification, config->thing_name, config
+    );
+}
+
+GgError handle_tunnel_notification_for_thing(
+    GgMap notification, GgBuffer thing_name, const SecureTunnelConfig *config
+) {
+    TunnelCreationContext request
+        = { .pidfd = -1, .exit_status = -1, .host_reservation = -1 };
+    if (thing_name.len == 0 || thing_name.len >= sizeof(request.thing_name)) {
+        GG_LOGE("Invalid thing name for tunnel notification");
+        return reject_request(
+            &request, TUNNEL_REJECT_INVALID_NOTIFICATION, GG_ERR_INVALID
+        );
+    }
+    memcpy(request.thing_name, thing_name.data, thing_name.len);
+
+    if (atomic_load_explicit(&tunnel_draining, memory_order_relaxed)) {
+        GG_LOGW("Rejecting tunnel: component is draining");
+        return reject_request(&request, TUNNEL_REJECT_DRAINING, GG_ERR_BUSY);
+    }
+
+    GgError ret = parse_and_validate_notification(notification, &request);
+    if (ret != GG_ERR_OK) {
+        return reject_request(
+            &request, TUNNEL_REJECT_INVALID_NOTIFICATION, ret
+        );
+    }
+    request.trace_id = trace_current();
+    trace_record(request.trace_id, TRACE_VALIDATE);
+
+    return launch_limiter_submit(&request, config);
+}
+
+// Fills in the request's destination and the listener check it needs
+static GgError route_launch(
+    TunnelCreationContext *request,
+    const SecureTunnelConfig *config,
+    TunnelPreflight *preflight
+) {
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    pthread_once(&timeout_monitor_once, start_timeout_monitor);
     if (tunnel_config == NULL) {
         tunnel_config = config;
     }
+    if (!tunnel_settings_applied) {
+        tunnel_settings_from_args(config, &tunnel_settings);
+    }
 
-    TunnelCreationContext request = { 0 };
+    GgError ret = route_request(config, request);
+    if (ret != GG_ERR_OK) {
+        return reject_request(
+            request,
+            ret == GG_ERR_NOENTRY ? TUNNEL_REJECT_UNKNOWN_THING
+                                  : TUNNEL_REJECT_UNSUPPORTED_SERVICE,
+            ret
+        );
+    }
+    *preflight = tunnel_settings.destination_preflight;
+    return GG_ERR_OK;
+}
 
-    GgError ret = parse_and_validate_notification(notification, &request);
+GgError tunnel_launch(
+    TunnelCreationContext *request, const SecureTunnelConfig *config
+) {
+    TunnelPreflight preflight = TUNNEL_PREFLIGHT_OFF;
+    GgError ret = route_launch(request, config, &preflight);
     if (ret != GG_ERR_OK) {
         return ret;
     }
+    if (!destination_preflight(request, preflight)) {
+        return reject_request(
+            request, TUNNEL_REJECT_NO_LISTENER, GG_ERR_NOCONN
+        );
+    }
 
-    {
-        GG_MTX_SCOPE_GUARD(&tunnel_mutex);
-        if (active_tunnels >= config->max_concurrent_tunnels) {
-            GG_LOGE(
-                "Maximum concurrent tunnels reached (%d)",
-                config->max_concurrent_tunnels
-            );
-            return GG_ERR_NOMEM;
-        }
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    // Checked again for launches the launch limiter held back before drain
+    // mode was enabled
+    if (atomic_load_explicit(&tunnel_draining, memory_order_relaxed)) {
+        GG_LOGW("Rejecting tunnel: component is draining");
+        return reject_request(request, TUNNEL_REJECT_DRAINING, GG_ERR_BUSY);
+    }
 
-        // Find free slot using bitmask
-        uint32_t free_mask = ~tunnel_slots_mask;
-        if ((free_mask & 0xFFFFF)
-            == 0) { // Check if any of first 20 bits are free
-            GG_LOGE("No available tunnel slots");
-            return GG_ERR_NOMEM;
-        }
-        int slot = __builtin_ctz(free_mask);
-        tunnel_slots_mask |= (1U << slot); // Mark slot as occupied
+    request->timeout_seconds = tunnel_settings.tunnel_timeout_seconds;
+    request->idle_timeout_seconds = tunnel_settings.idle_timeout_seconds;
+    request->client_type = tunnel_settings.destination_client_type;
+    request->proxy_host = tunnel_settings.proxy_host;
+
+    if (tunnel_settings.max_tunnels_per_thing > 0
+        && count_thing_tunnels(request->thing_name)
+            >= tunnel_settings.max_tunnels_per_thing) {
+        GG_LOGE(
+            "Maximum tunnels for thing %s reached (%d)",
+            request->thing_name,
+            tunnel_settings.max_tunnels_per_thing
+        );
+        return reject_request(request, TUNNEL_REJECT_THING_LIMIT, GG_ERR_NOMEM);
+    }
+
+    if (active_tunnels >= tunnel_settings.max_concurrent_tunnels) {
+        GG_LOGE(
+            "Maximum concurrent tunnels reached (%d)",
+            tunnel_settings.max_concurrent_tunnels
+        );
+        return reject_request(request, TUNNEL_REJECT_CAPACITY, GG_ERR_NOMEM);
+    }
+
+    // Find free slot using bitmask
+    uint32_t free_mask = ~tunnel_slots_mask;
+    if ((free_mask & 0xFFFFF) == 0) { // Check if any of first 20 bits are free
+        GG_LOGE("No available tunnel slots");
+        return reject_request(request, TUNNEL_REJECT_CAPACITY, GG_ERR_NOMEM);
+    }
+
+    PressureResource resource;
+    if (pressure_active(&resource)) {
+        GG_LOGW(
+            "Rejecting tunnel for service %s under %s pressure",
+            request->service,
+            pressure_resource_name(resource)
+        );
+        return reject_request(request, TUNNEL_REJECT_PRESSURE, GG_ERR_RETRY);
+    }
+
+    // Shared with other component instances on this host
+    if (!host_budget_acquire(
+            tunnel_settings.host_max_tunnels, &request->host_reservation
+        )) {
+        GG_LOGE(
+            "Maximum tunnels on this host reached (%d)",
+            tunnel_settings.host_max_tunnels
+        );
+        return reject_request(request, TUNNEL_REJECT_HOST_BUDGET, GG_ERR_NOMEM);
+    }
+
+    // Only launches that would otherwise succeed spend a token
+    if (!launch_limiter_acquire()) {
+        GG_LOGW("Tunnel launch rate limit reached");
+        host_budget_release(request->host_reservation);
+        return reject_request(request, TUNNEL_REJECT_RATE_LIMIT, GG_ERR_RETRY);
+    }
+
+    int slot = __builtin_ctz(free_mask);
+    tunnel_slots_mask |= (1U << slot); // Mark slot as occupied
+    trace_record(request->trace_id, TRACE_SLOT_ALLOC);
 
-        // Store tunnel request in allocated slot
-        tunnel_contexts[slot] = request;
+    // Store tunnel request in allocated slot
+    request->started_ms = monotonic_ms();
+    request->active_ms = request->started_ms;
+    tunnel_contexts[slot] = *request;
+    publish_slot(slot);
 
-        pthread_t thread;
-        if (pthread_create(&thread, NULL, tunnel_worker, &tunnel_contexts[slot])
-            != 0) {
-            tunnel_slots_mask
-                &= ~(1U << slot); // Free slot on thread creation failure
-            GG_LOGE("Failed to create tunnel worker thread");
-            return GG_ERR_FAILURE;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, tunnel_worker, &tunnel_contexts[slot])
+        != 0) {
+        tunnel_slots_mask &= ~(1U << slot); // Free slot on thread failure
+        publish_slot(slot);
+        host_budget_release(request->host_reservation);
+        launch_limiter_refund();
+        GG_LOGE("Failed to create tunnel worker thread");
+        return reject_request(
+            request, TUNNEL_REJECT_SPAWN_FAILED, GG_ERR_FAILURE
+        );
+    }
+
+    pthread_detach(thread);
+    active_tunnels++;
+    tunnel_event_emit(&(TunnelEvent) {
+        .type = TUNNEL_EVENT_OPEN,
+        .slot = slot,
+        .service = request->service,
+        .thing_name = request->thing_name,
+        .port = request->port,
+        .exit_status = -1,
+    });
+    GG_LOGI(
+        "Started tunnel worker for service: %s (active tunnels: %d)",
+        tunnel_contexts[slot].service,
+        active_tunnels
+    );
+    return GG_ERR_OK;
+}
+
+GgError tunnel_preflight_artifact(const SecureTunnelConfig *config) {
+    int localproxy_fd = prepare_localproxy_fd(config->artifact_path);
+    if (localproxy_fd == -1) {
+        return GG_ERR_NOENTRY;
+    }
+    GG_CLEANUP(cleanup_close, localproxy_fd);
+    (void) localproxy_probe(localproxy_fd);
+    return GG_ERR_OK;
+}
+
+void tunnel_apply_settings(const TunnelSettings *settings) {
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    tunnel_settings = *settings;
+    tunnel_settings_applied = true;
+    launch_limiter_configure(
+        settings->launches_per_minute,
+        settings->launch_burst,
+        settings->launch_coalesce_ms
+    );
+    launch_limiter_set_pressure_defer(settings->pressure_defer_seconds * 1000);
+    pressure_configure(settings->pressure_percent, settings->pressure_nice);
+    GG_LOGI(
+        "Applied tunnel settings: max concurrent tunnels %d, timeout %d "
+        "seconds, %zu services (active tunnels: %d)",
+        settings->max_concurrent_tunnels,
+        settings->tunnel_timeout_seconds,
+        settings->service_count,
+        active_tunnels
+    );
+}
+
+size_t tunnel_list(TunnelInfo *tunnels, size_t max) {
+    TunnelSnapshot table[TUNNEL_MAX_SLOTS];
+    uint32_t mask;
+    uint32_t seq;
+
+    do {
+        seq = atomic_load_explicit(&tunnel_table_seq, memory_order_acquire);
+        if ((seq & 1U) != 0) {
+            sched_yield();
+            continue;
         }
+        memcpy(table, tunnel_table, sizeof(table));
+        mask = tunnel_table_mask;
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1U) != 0
+             || atomic_load_explicit(&tunnel_table_seq, memory_order_relaxed)
+                 != seq);
 
-        pthread_detach(thread);
-        active_tunnels++;
-        GG_LOGI(
-            "Started tunnel worker for service: %s (active tunnels: %d)",
-            tunnel_contexts[slot].service,
-            active_tunnels
+    int64_t now = monotonic_ms();
+    size_t count = 0;
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS && count < max; slot++) {
+        if ((mask & (1U << slot)) == 0) {
+            continue;
+        }
+        const TunnelSnapshot *snapshot = &table[slot];
+        int64_t age_ms = now - snapshot->started_ms;
+        TunnelInfo *info = &tunnels[count++];
+        info->slot = slot;
+        memcpy(info->service, snapshot->service, sizeof(info->service));
+        memcpy(
+            info->thing_name, snapshot->thing_name, sizeof(info->thing_name)
         );
+        info->pid = snapshot->pid;
+        info->latency_class = snapshot->latency_class;
+        info->age_seconds = age_ms / 1000;
+        info->remaining_seconds = snapshot->timeout_seconds - age_ms / 1000;
+        info->read_bytes = snapshot->read_bytes;
+        info->written_bytes = snapshot->written_bytes;
+        info->idle_seconds = (now - snapshot->active_ms) / 1000;
+        info->net = snapshot->net;
+        info->stopping = snapshot->stopping;
+    }
+    return count;
+}
+
+GgError tunnel_close(int slot) {
+    if (slot < 0 || slot >= TUNNEL_MAX_SLOTS) {
+        return GG_ERR_RANGE;
+    }
+
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    if ((tunnel_slots_mask & (1U << slot)) == 0) {
+        return GG_ERR_NOENTRY;
+    }
+    TunnelCreationContext *ctx = &tunnel_contexts[slot];
+    if (ctx->pid == 0) {
+        return GG_ERR_BUSY; // localproxy not started yet
     }
 
+    // Stopped like an expired tunnel, so the monitor kills it if it has not
+    // exited within the grace period. A repeated close leaves that running.
+    if (ctx->stop_ms == 0) {
+        stop_slot(slot, monotonic_ms());
+        publish_slot(slot);
+        tunnel_clock_wake();
+    }
+    GG_LOGI("Closing tunnel in slot %d (service: %s)", slot, ctx->service);
     return GG_ERR_OK;
 }
+
+void tunnel_set_hooks(const SecureTunnelHooks *hooks) {
+    atomic_store(&tunnel_hooks, hooks);
+}
+
+void tunnel_set_draining(bool draining) {
+    atomic_store_explicit(&tunnel_draining, draining, memory_order_relaxed);
+    GG_LOGI("Tunnel drain mode %s", draining ? "enabled" : "disabled");
+}
+
+bool tunnel_is_draining(void) {
+    return atomic_load_explicit(&tunnel_draining, memory_order_relaxed);
+}
@@ -11,20 +11,101 @@
 #ifndef ST_TUNNEL_H
 #define ST_TUNNEL_H
 
+#include "secure-tunnel-manager.h"
 #include "secure-tunnel.h"
+#include "sock_diag.h"
+#include "tunnel_settings.h"
 #include <gg/error.h>
 #include <gg/object.h>
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct {
     char access_token[1024];
     char region[64];
     char service[64];
+    char thing_name[TUNNEL_MAX_THING_NAME_LEN];
+    char host[64]; // localproxy destination host
+    char netns[64]; // Network namespace file for localproxy, or empty
+    LatencyClass latency;
     uint16_t port;
+    int timeout_seconds;
+    int idle_timeout_seconds; // 0 never closes the tunnel for inactivity
+    TunnelClientType client_type;
+    bool proxy_host; // localproxyHost setting at admission
+    uint32_t trace_id;
+    // Runtime state, guarded by tunnel_mutex
+    int64_t started_ms;
+    pid_t pid;
+    int pidfd;
+    bool hosted; // Served by the shared localproxy host process
+    int exit_status; // Wait status, or -1 if localproxy never ran
+    int host_reservation; // Host budget slot, or -1 when not counted
+    // Sampled by the monitor from localproxy's I/O counters
+    uint64_t read_bytes;
+    uint64_t written_bytes;
+    int64_t active_ms; // Last sample that saw traffic
+    int64_t next_sample_ms;
+    TunnelNetMetrics net; // tcp_info of localproxy's connections
+    int64_t stop_ms; // When the monitor asked localproxy to exit, or 0
+    bool killed; // Killed or abandoned after ignoring the stop
 } TunnelCreationContext;
 
+typedef struct {
+    int slot;
+    char service[64];
+    char thing_name[TUNNEL_MAX_THING_NAME_LEN];
+    pid_t pid; // 0 while localproxy is starting
+    bool latency_class; // Priority set by the service's latency class
+    int64_t age_seconds;
+    int64_t remaining_seconds;
+    uint64_t read_bytes;
+    uint64_t written_bytes;
+    int64_t idle_seconds;
+    TunnelNetMetrics net; // Not sampled for hosted tunnels
+    bool stopping; // Expired and asked to exit
+} TunnelInfo;
+
 GgError handle_tunnel_notification(
     GgMap notification, const SecureTunnelConfig *config
 );
 
+// Admits a tunnel opened for thing_name. Tunnels for the component's own thing
+// go to localhost; other things need a configured gateway destination.
+GgError handle_tunnel_notification_for_thing(
+    GgMap notification, GgBuffer thing_name, const SecureTunnelConfig *config
+);
+
+// Admits an already validated request and starts its worker. Consumes a
+// launch token only when every other admission check has passed.
+GgError tunnel_launch(
+    TunnelCreationContext *request, const SecureTunnelConfig *config
+);
+
+// Checks that the localproxy artifact can be opened and reads which protocols
+// it supports, so the first tunnel does not wait for the scan.
+GgError tunnel_preflight_artifact(const SecureTunnelConfig *config);
+
+// Replaces the limits used for future admissions. Running tunnels are not
+// affected.
+void tunnel_apply_settings(const TunnelSettings *settings);
+
+// Copies up to max active tunnels into tunnels without taking tunnel_mutex.
+size_t tunnel_list(TunnelInfo *tunnels, size_t max);
+
+// Asks the localproxy in slot to exit, and kills it if it has not within five
+// seconds. The slot is freed once it has exited.
+GgError tunnel_close(int slot);
+
+// Starts localproxy through hooks->spawn when it is set. hooks must stay valid
+// until replaced.
+void tunnel_set_hooks(const SecureTunnelHooks *hooks);
+
+// While draining, new tunnels are rejected and open ones run to completion.
+void tunnel_set_draining(bool draining);
+
+bool tunnel_is_draining(void);
+
 #endif // ST_TUNNEL_H
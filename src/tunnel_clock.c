@@ -0,0 +1,87 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "tunnel_clock.h"
+#include <errno.h>
+#include <gg/cleanup.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+static _Atomic(const TunnelClock *) tunnel_clock = NULL;
+
+static pthread_once_t system_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t system_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t system_cond;
+static bool system_woken = false;
+
+static void init_system_cond(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&system_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void tunnel_clock_set(const TunnelClock *clock) {
+    atomic_store_explicit(&tunnel_clock, clock, memory_order_release);
+}
+
+int64_t tunnel_clock_now_ms(void) {
+    const TunnelClock *clock
+        = atomic_load_explicit(&tunnel_clock, memory_order_acquire);
+    if (clock != NULL) {
+        return clock->now_ms(clock->ctx);
+    }
+    return tunnel_clock_system_ms();
+}
+
+void tunnel_clock_sleep_until(int64_t deadline_ms) {
+    const TunnelClock *clock
+        = atomic_load_explicit(&tunnel_clock, memory_order_acquire);
+    if (clock != NULL) {
+        clock->sleep_until(clock->ctx, deadline_ms);
+        return;
+    }
+
+    pthread_once(&system_once, init_system_cond);
+    struct timespec deadline = {
+        .tv_sec = deadline_ms / 1000,
+        .tv_nsec = (long) (deadline_ms % 1000) * 1000000,
+    };
+    GG_MTX_SCOPE_GUARD(&system_mutex);
+    while (!system_woken) {
+        if (deadline_ms == INT64_MAX) {
+            pthread_cond_wait(&system_cond, &system_mutex);
+        } else if (pthread_cond_timedwait(
+                       &system_cond, &system_mutex, &deadline
+                   )
+                   == ETIMEDOUT) {
+            break;
+        }
+    }
+    system_woken = false;
+}
+
+void tunnel_clock_wake(void) {
+    const TunnelClock *clock
+        = atomic_load_explicit(&tunnel_clock, memory_order_acquire);
+    if (clock != NULL) {
+        clock->wake(clock->ctx);
+        return;
+    }
+
+    pthread_once(&system_once, init_system_cond);
+    GG_MTX_SCOPE_GUARD(&system_mutex);
+    system_woken = true;
+    pthread_cond_signal(&system_cond);
+}
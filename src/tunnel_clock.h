@@ -0,0 +1,49 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_TUNNEL_CLOCK_H
+#define ST_TUNNEL_CLOCK_H
+
+#include <time.h>
+#include <stdint.h>
+
+// Time source for tunnel lifetimes, idle detection and launch rate limits.
+// Tests install a virtual clock to run days of tunnel churn in seconds.
+typedef struct {
+    // Milliseconds on a monotonic timeline
+    int64_t (*now_ms)(void *ctx);
+    // Blocks until now_ms reaches deadline_ms or wake is called. A wake while
+    // nothing sleeps makes the next sleep return at once.
+    void (*sleep_until)(void *ctx, int64_t deadline_ms);
+    void (*wake)(void *ctx);
+    void *ctx;
+} TunnelClock;
+
+// Replaces the system clock with clock, which must stay valid until replaced.
+// NULL restores CLOCK_MONOTONIC.
+void tunnel_clock_set(const TunnelClock *clock);
+
+int64_t tunnel_clock_now_ms(void);
+
+// CLOCK_MONOTONIC in milliseconds, for timing that keeps to real time even
+// under a virtual tunnel clock, such as log stamps, keepalives and caches
+static inline int64_t tunnel_clock_system_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Only the tunnel monitor sleeps on the clock. INT64_MAX sleeps until woken.
+void tunnel_clock_sleep_until(int64_t deadline_ms);
+
+// Makes the monitor recompute its deadlines, e.g. for a new tunnel
+void tunnel_clock_wake(void);
+
+#endif // ST_TUNNEL_CLOCK_H
@@ -0,0 +1,60 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "tunnel_events.h"
+#include "journal.h"
+#include "journal_format.h"
+#include "status_publisher.h"
+#include "tunnel_settings.h"
+#include <string.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+static _Atomic(TunnelEventObserver) event_observer = NULL;
+
+_Static_assert(
+    sizeof(((JournalRecord *) 0)->thing_name) == TUNNEL_MAX_THING_NAME_LEN,
+    "journal records hold the longest thing name"
+);
+
+static void copy_field(char *dst, size_t size, const char *src) {
+    if (src != NULL) {
+        strncpy(dst, src, size - 1);
+    }
+}
+
+static void journal_event(const TunnelEvent *event) {
+    JournalRecord record = {
+        .type = (uint16_t) event->type,
+        .reason = (uint16_t) event->reason,
+        .exit_status = event->exit_status,
+        .lifetime_s = event->lifetime_ms > 0
+            ? (uint32_t) (event->lifetime_ms / 1000)
+            : 0,
+        .port = event->port,
+        .slot = event->slot >= 0 ? (uint8_t) event->slot : UINT8_MAX,
+    };
+    copy_field(record.service, sizeof(record.service), event->service);
+    copy_field(record.thing_name, sizeof(record.thing_name), event->thing_name);
+    journal_append(&record);
+}
+
+void tunnel_events_set_observer(TunnelEventObserver observer) {
+    atomic_store(&event_observer, observer);
+}
+
+void tunnel_event_emit(const TunnelEvent *event) {
+    journal_event(event);
+    status_publisher_record(event);
+    TunnelEventObserver observer = atomic_load(&event_observer);
+    if (observer != NULL) {
+        observer(event);
+    }
+}
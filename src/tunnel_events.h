@@ -0,0 +1,82 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_TUNNEL_EVENTS_H
+#define ST_TUNNEL_EVENTS_H
+
+#include <stdint.h>
+
+// Values are stored in the journal; only append new entries.
+typedef enum {
+    TUNNEL_EVENT_OPEN = 1,
+    TUNNEL_EVENT_REJECT = 2,
+    TUNNEL_EVENT_EXIT = 3,
+} TunnelEventType;
+
+// Values are stored in the journal; only append new entries.
+typedef enum {
+    TUNNEL_REJECT_NONE = 0,
+    TUNNEL_REJECT_INVALID_NOTIFICATION = 1,
+    TUNNEL_REJECT_UNSUPPORTED_SERVICE = 2,
+    TUNNEL_REJECT_UNKNOWN_THING = 3,
+    TUNNEL_REJECT_THING_LIMIT = 4,
+    TUNNEL_REJECT_CAPACITY = 5,
+    TUNNEL_REJECT_RATE_LIMIT = 6,
+    TUNNEL_REJECT_DRAINING = 7,
+    TUNNEL_REJECT_PENDING_FULL = 8,
+    TUNNEL_REJECT_SPAWN_FAILED = 9,
+    TUNNEL_REJECT_NO_LISTENER = 10,
+    TUNNEL_REJECT_HOST_BUDGET = 11,
+    TUNNEL_REJECT_PRESSURE = 12,
+    TUNNEL_REJECT_COALESCED = 13,
+    TUNNEL_REJECT_REASON_COUNT,
+} TunnelRejectReason;
+
+typedef struct {
+    TunnelEventType type;
+    TunnelRejectReason reason; // TUNNEL_REJECT events only
+    int slot; // -1 when no slot was allocated
+    const char *service;
+    const char *thing_name;
+    uint16_t port;
+    int exit_status; // Wait status, or -1 if localproxy never ran
+    int64_t lifetime_ms;
+} TunnelEvent;
+
+static inline const char *tunnel_reject_reason_name(uint32_t reason) {
+    static const char *const NAMES[TUNNEL_REJECT_REASON_COUNT] = {
+        [TUNNEL_REJECT_NONE] = "none",
+        [TUNNEL_REJECT_INVALID_NOTIFICATION] = "invalid_notification",
+        [TUNNEL_REJECT_UNSUPPORTED_SERVICE] = "unsupported_service",
+        [TUNNEL_REJECT_UNKNOWN_THING] = "unknown_thing",
+        [TUNNEL_REJECT_THING_LIMIT] = "thing_limit",
+        [TUNNEL_REJECT_CAPACITY] = "capacity",
+        [TUNNEL_REJECT_RATE_LIMIT] = "rate_limit",
+        [TUNNEL_REJECT_DRAINING] = "draining",
+        [TUNNEL_REJECT_PENDING_FULL] = "pending_full",
+        [TUNNEL_REJECT_SPAWN_FAILED] = "spawn_failed",
+        [TUNNEL_REJECT_NO_LISTENER] = "no_listener",
+        [TUNNEL_REJECT_HOST_BUDGET] = "host_budget",
+        [TUNNEL_REJECT_PRESSURE] = "pressure",
+        [TUNNEL_REJECT_COALESCED] = "coalesced",
+    };
+    return reason < TUNNEL_REJECT_REASON_COUNT ? NAMES[reason] : "unknown";
+}
+
+typedef void (*TunnelEventObserver)(const TunnelEvent *event);
+
+// Also delivers events to observer, such as an embedding host. NULL removes it.
+void tunnel_events_set_observer(TunnelEventObserver observer);
+
+// Delivers a tunnel lifecycle event to every consumer. Safe to call from any
+// thread, including with tunnel_mutex held.
+void tunnel_event_emit(const TunnelEvent *event);
+
+#endif // ST_TUNNEL_EVENTS_H
@@ -0,0 +1,155 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "host_budget.h"
+#include "journal.h"
+#include "launcher.h"
+#include "secure-tunnel-manager.h"
+#include "secure-tunnel.h"
+#include "subscriptions.h"
+#include "trace.h"
+#include "tunnel.h"
+#include "tunnel_events.h"
+#include "tunnel_settings.h"
+#include <gg/buffer.h>
+#include <gg/cleanup.h>
+#include <gg/error.h>
+#include <gg/log.h>
+#include <gg/object.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+static pthread_mutex_t manager_mutex = PTHREAD_MUTEX_INITIALIZER;
+// The tunnel table is per process, so there is at most one manager
+static _Atomic(const SecureTunnelManager *) active_manager = NULL;
+static bool manager_subscribed = false;
+
+static void notify_host(const TunnelEvent *event) {
+    const SecureTunnelManager *manager = atomic_load(&active_manager);
+    if (manager == NULL || manager->hooks.notify == NULL) {
+        return;
+    }
+    SecureTunnelEvent host_event = {
+        .type = (SecureTunnelEventType) event->type,
+        .reason = event->type == TUNNEL_EVENT_REJECT
+            ? tunnel_reject_reason_name(event->reason)
+            : NULL,
+        .slot = event->slot,
+        .service = event->service,
+        .thing_name = event->thing_name,
+        .port = event->port,
+        .exit_status = event->exit_status,
+        .lifetime_ms = event->lifetime_ms,
+    };
+    manager->hooks.notify(manager->hooks.ctx, &host_event);
+}
+
+GgError secure_tunnel_manager_start_launcher(void) {
+    return launcher_start();
+}
+
+GgError secure_tunnel_manager_init(
+    SecureTunnelManager *manager,
+    const SecureTunnelConfig *config,
+    const SecureTunnelHooks *hooks
+) {
+    GG_MTX_SCOPE_GUARD(&manager_mutex);
+    if (atomic_load(&active_manager) != NULL) {
+        GG_LOGE("A tunnel manager is already running in this process");
+        return GG_ERR_BUSY;
+    }
+
+    *manager = (SecureTunnelManager) {
+        .config = config,
+        .hooks = hooks != NULL ? *hooks : (SecureTunnelHooks) { 0 },
+    };
+
+    // Paths from argv or the host are null terminated
+    if (config->journal_path.len > 0
+        && journal_open(
+               (const char *) config->journal_path.data,
+               JOURNAL_DEFAULT_CAPACITY
+           )
+            != GG_ERR_OK) {
+        GG_LOGW("Tunnel journal unavailable");
+    }
+
+    if (config->host_budget_path.len > 0
+        && host_budget_open((const char *) config->host_budget_path.data)
+            != GG_ERR_OK) {
+        GG_LOGW("Host tunnel budget unavailable; only local limits apply");
+    }
+
+    tunnel_set_hooks(&manager->hooks);
+    tunnel_events_set_observer(notify_host);
+    atomic_store(&active_manager, manager);
+    return GG_ERR_OK;
+}
+
+GgError secure_tunnel_manager_subscribe(SecureTunnelManager *manager) {
+    GgError ret = run_secure_tunnel(manager->config);
+    if (ret == GG_ERR_OK) {
+        GG_MTX_SCOPE_GUARD(&manager_mutex);
+        manager_subscribed = true;
+    }
+    return ret;
+}
+
+GgError secure_tunnel_manager_notify(
+    SecureTunnelManager *manager, GgBuffer topic, GgBuffer payload
+) {
+    (void) trace_begin();
+    return deliver_tunnel_notification(manager->config, topic, payload);
+}
+
+GgError secure_tunnel_manager_configure(
+    SecureTunnelManager *manager, GgMap config
+) {
+    // Unset keys fall back to the startup arguments, as on a reload
+    TunnelSettings settings;
+    tunnel_settings_from_args(manager->config, &settings);
+    GgError ret = tunnel_settings_update(config, &settings);
+    if (ret != GG_ERR_OK) {
+        GG_LOGE("Rejected configuration update, keeping current settings");
+        return ret;
+    }
+    tunnel_apply_settings(&settings);
+    return GG_ERR_OK;
+}
+
+size_t secure_tunnel_manager_active(SecureTunnelManager *manager) {
+    (void) manager;
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    return tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+}
+
+GgError secure_tunnel_manager_deinit(SecureTunnelManager *manager) {
+    GG_MTX_SCOPE_GUARD(&manager_mutex);
+    if (atomic_load(&active_manager) != manager) {
+        return GG_ERR_INVALID;
+    }
+    if (manager_subscribed) {
+        GG_LOGE("Tunnel manager subscriptions cannot be removed");
+        return GG_ERR_UNSUPPORTED;
+    }
+    // Running tunnels would still call the hooks and release budget slots
+    if (secure_tunnel_manager_active(manager) > 0) {
+        return GG_ERR_BUSY;
+    }
+
+    tunnel_events_set_observer(NULL);
+    tunnel_set_hooks(NULL);
+    atomic_store(&active_manager, NULL);
+    journal_close();
+    host_budget_close();
+    return GG_ERR_OK;
+}
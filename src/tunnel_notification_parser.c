@@ -1,4 +1,5 @@
 #include "tunnel_notification_parser.h"
+#include "tunnel_settings.h"
 #include <gg/buffer.h>
 #include <gg/flags.h>
 #include <gg/list.h>
@@ -7,16 +8,37 @@
 #include <string.h>
 #include <stdint.h>
 
-static uint16_t get_port_from_service(GgBuffer service) {
-    if (gg_buffer_eq(service, GG_STR("SSH"))) {
-        return 22;
-    }
-    if (gg_buffer_eq(service, GG_STR("VNC"))) {
-        return 5900;
+uint16_t get_port_from_service(
+    const TunnelServiceMapping *services, size_t count, GgBuffer service
+) {
+    for (size_t i = 0; i < count; i++) {
+        if (gg_buffer_eq(
+                service, gg_buffer_from_null_term((char *) services[i].name)
+            )) {
+            return services[i].port;
+        }
     }
     return 0; // unknown port
 }
 
+GgError parse_thing_from_topic(GgBuffer topic, GgBuffer *thing_name) {
+    GgBuffer prefix = GG_STR("$aws/things/");
+    GgBuffer suffix = GG_STR("/tunnels/notify");
+    if (topic.len <= prefix.len + suffix.len
+        || !gg_buffer_has_prefix(topic, prefix)
+        || !gg_buffer_has_suffix(topic, suffix)) {
+        return GG_ERR_INVALID;
+    }
+
+    GgBuffer name
+        = gg_buffer_substr(topic, prefix.len, topic.len - suffix.len);
+    if (memchr(name.data, '/', name.len) != NULL) {
+        return GG_ERR_INVALID;
+    }
+    *thing_name = name;
+    return GG_ERR_OK;
+}
+
 GgError parse_and_validate_notification(
     GgMap notification, TunnelCreationContext *request
 ) {
@@ -76,11 +98,5 @@ GgError parse_and_validate_notification(
     memcpy(request->service, service.data, service_len);
     request->service[service_len] = '\0';
 
-    request->port = get_port_from_service(service);
-    if (request->port == 0) {
-        GG_LOGE("Unsupported service: %.*s", (int) service.len, service.data);
-        return GG_ERR_INVALID;
-    }
-
     return GG_ERR_OK;
 }
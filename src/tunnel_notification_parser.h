@@ -12,11 +12,22 @@
 #define ST_TUNNEL_NOTIFICATION_PARSER_H
 
 #include "tunnel.h"
+#include "tunnel_settings.h"
+#include <gg/buffer.h>
 #include <gg/error.h>
 #include <gg/object.h>
+#include <stdint.h>
+
+// Extracts the thing name from a $aws/things/<thing>/tunnels/notify topic.
+GgError parse_thing_from_topic(GgBuffer topic, GgBuffer *thing_name);
 
 GgError parse_and_validate_notification(
     GgMap notification, TunnelCreationContext *request
 );
 
+// Returns the destination port mapped to service, or 0 if unsupported.
+uint16_t get_port_from_service(
+    const TunnelServiceMapping *services, size_t count, GgBuffer service
+);
+
 #endif
@@ -0,0 +1,829 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "tunnel_settings.h"
+#include <gg/buffer.h>
+#include <gg/flags.h>
+#include <gg/list.h>
+#include <gg/log.h>
+#include <gg/map.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TUNNEL_DEFAULT_LAUNCH_BURST 5
+
+static const TunnelServiceMapping DEFAULT_SERVICES[] = {
+    { .name = "SSH", .port = 22 },
+    { .name = "VNC", .port = 5900 },
+};
+
+// Interactive tunnels keep the component's CPU priority, which also exempts
+// them from pressureNice, and get first pick of disk IO. Bulk tunnels yield
+// both.
+static const struct {
+    const char *name;
+    LatencyClass latency;
+} LATENCY_PRESETS[] = {
+    { "interactive",
+      { .set = true, .io_class = LATENCY_IO_BEST_EFFORT, .io_level = 0 } },
+    { "bulk",
+      { .set = true,
+        .renice = true,
+        .nice = 10,
+        .io_class = LATENCY_IO_BEST_EFFORT,
+        .io_level = 7 } },
+};
+
+void tunnel_settings_from_args(
+    const SecureTunnelConfig *config, TunnelSettings *settings
+) {
+    *settings = (TunnelSettings) {
+        .max_concurrent_tunnels = config->max_concurrent_tunnels,
+        .tunnel_timeout_seconds = config->tunnel_timeout_seconds,
+        .service_count = sizeof(DEFAULT_SERVICES) / sizeof(DEFAULT_SERVICES[0]),
+        .launch_burst = TUNNEL_DEFAULT_LAUNCH_BURST,
+    };
+    memcpy(settings->services, DEFAULT_SERVICES, sizeof(DEFAULT_SERVICES));
+}
+
+// Greengrass may deliver numeric configuration as integers, floats or strings
+// depending on how the deployment was authored.
+static GgError read_int_setting(
+    GgObject obj, int64_t min, int64_t max, int64_t *value
+) {
+    int64_t val = 0;
+    switch (gg_obj_type(obj)) {
+    case GG_TYPE_I64:
+        val = gg_obj_into_i64(obj);
+        break;
+    case GG_TYPE_F64: {
+        double f = gg_obj_into_f64(obj);
+        // Casting NaN or a double outside the int64 range is undefined
+        if (!(f >= (double) INT64_MIN && f < -(double) INT64_MIN)
+            || f != (double) (int64_t) f) {
+            return GG_ERR_INVALID;
+        }
+        val = (int64_t) f;
+        break;
+    }
+    case GG_TYPE_BUF:
+        if (gg_str_to_int64(gg_obj_into_buf(obj), &val) != GG_ERR_OK) {
+            return GG_ERR_INVALID;
+        }
+        break;
+    default:
+        return GG_ERR_INVALID;
+    }
+
+    if (val < min || val > max) {
+        return GG_ERR_RANGE;
+    }
+    *value = val;
+    return GG_ERR_OK;
+}
+
+// Booleans may likewise arrive as "true" or "false"
+static GgError read_bool_setting(GgObject obj, bool *value) {
+    if (gg_obj_type(obj) == GG_TYPE_BOOLEAN) {
+        *value = gg_obj_into_bool(obj);
+        return GG_ERR_OK;
+    }
+    GgBuffer str = gg_obj_type(obj) == GG_TYPE_BUF
+        ? gg_obj_into_buf(obj)
+        : GG_STR("");
+    if (gg_buffer_eq(str, GG_STR("true"))) {
+        *value = true;
+    } else if (gg_buffer_eq(str, GG_STR("false"))) {
+        *value = false;
+    } else {
+        return GG_ERR_INVALID;
+    }
+    return GG_ERR_OK;
+}
+
+static GgError read_service_mappings(
+    GgMap mappings, TunnelServiceMapping *services, size_t *service_count
+) {
+    if (mappings.len == 0) {
+        GG_LOGE("serviceMappings must contain at least one service");
+        return GG_ERR_INVALID;
+    }
+    if (mappings.len > TUNNEL_MAX_SERVICE_MAPPINGS) {
+        GG_LOGE(
+            "serviceMappings cannot exceed %d entries (provided: %zu)",
+            TUNNEL_MAX_SERVICE_MAPPINGS,
+            mappings.len
+        );
+        return GG_ERR_RANGE;
+    }
+
+    size_t count = 0;
+    GG_MAP_FOREACH(pair, mappings) {
+        GgBuffer name = gg_kv_key(*pair);
+        TunnelServiceMapping *mapping = &services[count];
+
+        if (name.len == 0 || name.len >= sizeof(mapping->name)) {
+            GG_LOGE("Invalid service name length in serviceMappings");
+            return GG_ERR_INVALID;
+        }
+
+        int64_t port = 0;
+        if (read_int_setting(*gg_kv_val(pair), 1, UINT16_MAX, &port)
+            != GG_ERR_OK) {
+            GG_LOGE(
+                "Invalid port for service %.*s", (int) name.len, name.data
+            );
+            return GG_ERR_INVALID;
+        }
+
+        memcpy(mapping->name, name.data, name.len);
+        mapping->name[name.len] = '\0';
+        mapping->port = (uint16_t) port;
+        count++;
+    }
+    *service_count = count;
+    return GG_ERR_OK;
+}
+
+// Hosts end up in the localproxy destination argument, so only plain host
+// names and IPv4 addresses are accepted.
+static bool is_valid_host(GgBuffer host) {
+    if (host.len == 0 || host.len >= sizeof(((TunnelDestination *) 0)->host)
+        || host.data[0] == '-') {
+        return false;
+    }
+    for (size_t i = 0; i < host.len; i++) {
+        uint8_t c = host.data[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+              || (c >= '0' && c <= '9') || c == '.' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static GgError read_destination(
+    GgBuffer thing_name, GgObject obj, TunnelDestination *destination
+) {
+    if (thing_name.len == 0
+        || thing_name.len >= sizeof(destination->thing_name)) {
+        GG_LOGE("Invalid thing name length in gatewayDestinations");
+        return GG_ERR_INVALID;
+    }
+    if (gg_obj_type(obj) != GG_TYPE_MAP) {
+        GG_LOGE(
+            "gatewayDestinations entry for %.*s must be a map",
+            (int) thing_name.len,
+            thing_name.data
+        );
+        return GG_ERR_INVALID;
+    }
+
+    GgObject *host_obj = NULL;
+    GgObject *services_obj = NULL;
+    GgError ret = gg_map_validate(
+        gg_obj_into_map(obj),
+        GG_MAP_SCHEMA(
+            { GG_STR("host"), GG_REQUIRED, GG_TYPE_BUF, &host_obj },
+            { GG_STR("serviceMappings"),
+              GG_OPTIONAL,
+              GG_TYPE_MAP,
+              &services_obj }
+        )
+    );
+    if (ret != GG_ERR_OK || !is_valid_host(gg_obj_into_buf(*host_obj))) {
+        GG_LOGE(
+            "Invalid host for gateway destination %.*s",
+            (int) thing_name.len,
+            thing_name.data
+        );
+        return GG_ERR_INVALID;
+    }
+
+    *destination = (TunnelDestination) { 0 };
+    memcpy(destination->thing_name, thing_name.data, thing_name.len);
+    GgBuffer host = gg_obj_into_buf(*host_obj);
+    memcpy(destination->host, host.data, host.len);
+
+    if (services_obj != NULL) {
+        return read_service_mappings(
+            gg_obj_into_map(*services_obj),
+            destination->services,
+            &destination->service_count
+        );
+    }
+    return GG_ERR_OK;
+}
+
+static GgError read_destinations(GgMap destinations, TunnelSettings *settings) {
+    if (destinations.len > TUNNEL_MAX_GATEWAY_THINGS) {
+        GG_LOGE(
+            "gatewayDestinations cannot exceed %d entries (provided: %zu)",
+            TUNNEL_MAX_GATEWAY_THINGS,
+            destinations.len
+        );
+        return GG_ERR_RANGE;
+    }
+
+    size_t count = 0;
+    GG_MAP_FOREACH(pair, destinations) {
+        GgError ret = read_destination(
+            gg_kv_key(*pair), *gg_kv_val(pair), &settings->destinations[count]
+        );
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+        count++;
+    }
+    settings->destination_count = count;
+    return GG_ERR_OK;
+}
+
+static GgError read_pressure_thresholds(
+    GgMap thresholds, TunnelSettings *settings
+) {
+    int percent[PRESSURE_RESOURCE_COUNT] = { 0 };
+    GG_MAP_FOREACH(pair, thresholds) {
+        GgBuffer name = gg_kv_key(*pair);
+        uint32_t resource = 0;
+        while (resource < PRESSURE_RESOURCE_COUNT
+               && !gg_buffer_eq(
+                   name,
+                   gg_buffer_from_null_term(
+                       (char *) pressure_resource_name(resource)
+                   )
+               )) {
+            resource++;
+        }
+        if (resource == PRESSURE_RESOURCE_COUNT) {
+            GG_LOGE("launchPressureThresholds keys must be cpu, memory or io");
+            return GG_ERR_INVALID;
+        }
+
+        int64_t num = 0;
+        if (read_int_setting(*gg_kv_val(pair), 0, 100, &num) != GG_ERR_OK) {
+            GG_LOGE(
+                "launchPressureThresholds.%.*s must be a percentage",
+                (int) name.len,
+                name.data
+            );
+            return GG_ERR_RANGE;
+        }
+        percent[resource] = (int) num;
+    }
+    memcpy(settings->pressure_percent, percent, sizeof(percent));
+    return GG_ERR_OK;
+}
+
+// Each entry is a namespace file path, or the pid of a process (such as a
+// container's init) whose network namespace to join.
+static GgError read_namespaces(GgMap namespaces, TunnelSettings *settings) {
+    if (namespaces.len > TUNNEL_MAX_SERVICE_MAPPINGS) {
+        GG_LOGE(
+            "serviceNetworkNamespaces cannot exceed %d entries (provided: "
+            "%zu)",
+            TUNNEL_MAX_SERVICE_MAPPINGS,
+            namespaces.len
+        );
+        return GG_ERR_RANGE;
+    }
+
+    size_t count = 0;
+    GG_MAP_FOREACH(pair, namespaces) {
+        GgBuffer name = gg_kv_key(*pair);
+        GgObject val = *gg_kv_val(pair);
+        TunnelServiceNamespace *entry = &settings->namespaces[count];
+        if (name.len == 0 || name.len >= sizeof(entry->service)) {
+            GG_LOGE("Invalid service name length in serviceNetworkNamespaces");
+            return GG_ERR_INVALID;
+        }
+
+        *entry = (TunnelServiceNamespace) { 0 };
+        memcpy(entry->service, name.data, name.len);
+        int64_t pid = 0;
+        if (gg_obj_type(val) == GG_TYPE_BUF
+            && gg_obj_into_buf(val).len > 0
+            && gg_obj_into_buf(val).data[0] == '/') {
+            GgBuffer path = gg_obj_into_buf(val);
+            if (path.len >= sizeof(entry->path)
+                || memchr(path.data, '\0', path.len) != NULL) {
+                GG_LOGE(
+                    "Invalid network namespace path for service %.*s",
+                    (int) name.len,
+                    name.data
+                );
+                return GG_ERR_INVALID;
+            }
+            memcpy(entry->path, path.data, path.len);
+        } else if (read_int_setting(val, 1, INT32_MAX, &pid) == GG_ERR_OK) {
+            snprintf(
+                entry->path, sizeof(entry->path), "/proc/%d/ns/net", (int) pid
+            );
+        } else {
+            GG_LOGE(
+                "Network namespace for service %.*s must be an absolute path "
+                "or a pid",
+                (int) name.len,
+                name.data
+            );
+            return GG_ERR_INVALID;
+        }
+        count++;
+    }
+    settings->namespace_count = count;
+    return GG_ERR_OK;
+}
+
+const char *tunnel_settings_find_namespace(
+    const TunnelSettings *settings, GgBuffer service
+) {
+    for (size_t i = 0; i < settings->namespace_count; i++) {
+        if (gg_buffer_eq(
+                service,
+                gg_buffer_from_null_term(
+                    (char *) settings->namespaces[i].service
+                )
+            )) {
+            return settings->namespaces[i].path;
+        }
+    }
+    return NULL;
+}
+
+static GgError read_io_class(GgObject obj, LatencyClass *latency) {
+    GgBuffer name = gg_obj_type(obj) == GG_TYPE_BUF
+        ? gg_obj_into_buf(obj)
+        : GG_STR("");
+    if (gg_buffer_eq(name, GG_STR("realtime"))) {
+        latency->io_class = LATENCY_IO_REALTIME;
+    } else if (gg_buffer_eq(name, GG_STR("best-effort"))) {
+        latency->io_class = LATENCY_IO_BEST_EFFORT;
+    } else if (gg_buffer_eq(name, GG_STR("idle"))) {
+        latency->io_class = LATENCY_IO_IDLE;
+    } else {
+        return GG_ERR_INVALID;
+    }
+    return GG_ERR_OK;
+}
+
+static GgError read_cpus(GgObject obj, LatencyClass *latency) {
+    if (gg_obj_type(obj) != GG_TYPE_LIST) {
+        return GG_ERR_INVALID;
+    }
+    uint64_t cpus = 0;
+    GG_LIST_FOREACH(item, gg_obj_into_list(obj)) {
+        int64_t cpu = 0;
+        if (read_int_setting(*item, 0, 63, &cpu) != GG_ERR_OK) {
+            return GG_ERR_RANGE;
+        }
+        cpus |= UINT64_C(1) << cpu;
+    }
+    if (cpus == 0) {
+        return GG_ERR_INVALID;
+    }
+    latency->cpus = cpus;
+    return GG_ERR_OK;
+}
+
+static GgError read_cgroup(GgObject obj, LatencyClass *latency) {
+    GgBuffer path = gg_obj_type(obj) == GG_TYPE_BUF
+        ? gg_obj_into_buf(obj)
+        : GG_STR("");
+    if (path.len == 0 || path.data[0] != '/'
+        || path.len >= sizeof(latency->cgroup)
+        || memchr(path.data, '\0', path.len) != NULL) {
+        return GG_ERR_INVALID;
+    }
+    memcpy(latency->cgroup, path.data, path.len);
+    latency->cgroup[path.len] = '\0';
+    return GG_ERR_OK;
+}
+
+// A class is a preset name, or a map of the individual settings
+static GgError read_latency_class(
+    GgBuffer service, GgObject obj, LatencyClass *latency
+) {
+    if (gg_obj_type(obj) == GG_TYPE_BUF) {
+        GgBuffer name = gg_obj_into_buf(obj);
+        for (size_t i = 0;
+             i < sizeof(LATENCY_PRESETS) / sizeof(LATENCY_PRESETS[0]);
+             i++) {
+            if (gg_buffer_eq(
+                    name,
+                    gg_buffer_from_null_term((char *) LATENCY_PRESETS[i].name)
+                )) {
+                *latency = LATENCY_PRESETS[i].latency;
+                return GG_ERR_OK;
+            }
+        }
+    }
+    if (gg_obj_type(obj) != GG_TYPE_MAP) {
+        GG_LOGE(
+            "Latency class for service %.*s must be \"interactive\", "
+            "\"bulk\" or a map",
+            (int) service.len,
+            service.data
+        );
+        return GG_ERR_INVALID;
+    }
+
+    GgObject *nice_obj = NULL;
+    GgObject *io_class_obj = NULL;
+    GgObject *io_level_obj = NULL;
+    GgObject *cpus_obj = NULL;
+    GgObject *cgroup_obj = NULL;
+    GgError ret = gg_map_validate(
+        gg_obj_into_map(obj),
+        GG_MAP_SCHEMA(
+            { GG_STR("nice"), GG_OPTIONAL, GG_TYPE_NULL, &nice_obj },
+            { GG_STR("ioClass"), GG_OPTIONAL, GG_TYPE_NULL, &io_class_obj },
+            { GG_STR("ioLevel"), GG_OPTIONAL, GG_TYPE_NULL, &io_level_obj },
+            { GG_STR("cpus"), GG_OPTIONAL, GG_TYPE_NULL, &cpus_obj },
+            { GG_STR("cgroup"), GG_OPTIONAL, GG_TYPE_NULL, &cgroup_obj }
+        )
+    );
+    if (ret != GG_ERR_OK) {
+        return ret;
+    }
+
+    *latency = (LatencyClass) { .set = true };
+    int64_t num = 0;
+    if (nice_obj != NULL) {
+        if (read_int_setting(*nice_obj, -20, 19, &num) != GG_ERR_OK) {
+            GG_LOGE(
+                "Latency class nice for service %.*s must be between -20 and "
+                "19",
+                (int) service.len,
+                service.data
+            );
+            return GG_ERR_RANGE;
+        }
+        latency->renice = true;
+        latency->nice = (int8_t) num;
+    }
+    if (io_class_obj != NULL
+        && read_io_class(*io_class_obj, latency) != GG_ERR_OK) {
+        GG_LOGE(
+            "Latency class ioClass for service %.*s must be \"realtime\", "
+            "\"best-effort\" or \"idle\"",
+            (int) service.len,
+            service.data
+        );
+        return GG_ERR_INVALID;
+    }
+    if (io_level_obj != NULL) {
+        if (read_int_setting(*io_level_obj, 0, 7, &num) != GG_ERR_OK) {
+            GG_LOGE(
+                "Latency class ioLevel for service %.*s must be between 0 and "
+                "7",
+                (int) service.len,
+                service.data
+            );
+            return GG_ERR_RANGE;
+        }
+        latency->io_level = (uint8_t) num;
+        if (latency->io_class == LATENCY_IO_INHERIT) {
+            latency->io_class = LATENCY_IO_BEST_EFFORT;
+        }
+    }
+    if (cpus_obj != NULL && read_cpus(*cpus_obj, latency) != GG_ERR_OK) {
+        GG_LOGE(
+            "Latency class cpus for service %.*s must be a non-empty list of "
+            "CPU numbers below 64",
+            (int) service.len,
+            service.data
+        );
+        return GG_ERR_INVALID;
+    }
+    if (cgroup_obj != NULL && read_cgroup(*cgroup_obj, latency) != GG_ERR_OK) {
+        GG_LOGE(
+            "Latency class cgroup for service %.*s must be an absolute path",
+            (int) service.len,
+            service.data
+        );
+        return GG_ERR_INVALID;
+    }
+    return GG_ERR_OK;
+}
+
+static GgError read_latencies(GgMap classes, TunnelSettings *settings) {
+    if (classes.len > TUNNEL_MAX_SERVICE_MAPPINGS) {
+        GG_LOGE(
+            "serviceLatencyClasses cannot exceed %d entries (provided: %zu)",
+            TUNNEL_MAX_SERVICE_MAPPINGS,
+            classes.len
+        );
+        return GG_ERR_RANGE;
+    }
+
+    size_t count = 0;
+    GG_MAP_FOREACH(pair, classes) {
+        GgBuffer name = gg_kv_key(*pair);
+        TunnelServiceLatency *entry = &settings->latencies[count];
+        if (name.len == 0 || name.len >= sizeof(entry->service)) {
+            GG_LOGE("Invalid service name length in serviceLatencyClasses");
+            return GG_ERR_INVALID;
+        }
+        *entry = (TunnelServiceLatency) { 0 };
+        memcpy(entry->service, name.data, name.len);
+        GgError ret = read_latency_class(
+            name, *gg_kv_val(pair), &entry->latency
+        );
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+        count++;
+    }
+    settings->latency_count = count;
+    return GG_ERR_OK;
+}
+
+const LatencyClass *tunnel_settings_find_latency(
+    const TunnelSettings *settings, GgBuffer service
+) {
+    for (size_t i = 0; i < settings->latency_count; i++) {
+        if (gg_buffer_eq(
+                service,
+                gg_buffer_from_null_term(
+                    (char *) settings->latencies[i].service
+                )
+            )) {
+            return &settings->latencies[i].latency;
+        }
+    }
+    return NULL;
+}
+
+const TunnelDestination *tunnel_settings_find_destination(
+    const TunnelSettings *settings, GgBuffer thing_name
+) {
+    for (size_t i = 0; i < settings->destination_count; i++) {
+        if (gg_buffer_eq(
+                thing_name,
+                gg_buffer_from_null_term(
+                    (char *) settings->destinations[i].thing_name
+                )
+            )) {
+            return &settings->destinations[i];
+        }
+    }
+    return NULL;
+}
+
+const GgBuffer TUNNEL_SETTINGS_KEYS[TUNNEL_SETTINGS_KEY_COUNT] = {
+    GG_STR("maxConcurrentTunnels"),
+    GG_STR("tunnelTimeoutSeconds"),
+    GG_STR("serviceMappings"),
+    GG_STR("maxTunnelsPerThing"),
+    GG_STR("launchesPerMinute"),
+    GG_STR("launchBurst"),
+    GG_STR("launchCoalesceMs"),
+    GG_STR("idleTimeoutSeconds"),
+    GG_STR("hostMaxTunnels"),
+    GG_STR("launchPressureThresholds"),
+    GG_STR("launchPressureDeferSeconds"),
+    GG_STR("pressureNice"),
+    GG_STR("destinationClientType"),
+    GG_STR("destinationPreflight"),
+    GG_STR("localproxyHost"),
+    GG_STR("serviceNetworkNamespaces"),
+    GG_STR("serviceLatencyClasses"),
+    GG_STR("gatewayDestinations"),
+};
+
+// Keep the keys read here in TUNNEL_SETTINGS_KEYS
+GgError tunnel_settings_update(GgMap config, TunnelSettings *settings) {
+    TunnelSettings next = *settings;
+    GgObject *val = NULL;
+    int64_t num = 0;
+
+    if (gg_map_get(config, GG_STR("maxConcurrentTunnels"), &val)) {
+        if (read_int_setting(*val, 1, TUNNEL_MAX_SLOTS, &num) != GG_ERR_OK) {
+            GG_LOGE(
+                "maxConcurrentTunnels must be an integer between 1 and %d",
+                TUNNEL_MAX_SLOTS
+            );
+            return GG_ERR_RANGE;
+        }
+        next.max_concurrent_tunnels = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("tunnelTimeoutSeconds"), &val)) {
+        if (read_int_setting(*val, 1, TUNNEL_MAX_TIMEOUT_SECONDS, &num)
+            != GG_ERR_OK) {
+            GG_LOGE(
+                "tunnelTimeoutSeconds must be an integer between 1 and %d",
+                TUNNEL_MAX_TIMEOUT_SECONDS
+            );
+            return GG_ERR_RANGE;
+        }
+        next.tunnel_timeout_seconds = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("serviceMappings"), &val)) {
+        if (gg_obj_type(*val) != GG_TYPE_MAP) {
+            GG_LOGE("serviceMappings must be a map of service name to port");
+            return GG_ERR_INVALID;
+        }
+        GgError ret = read_service_mappings(
+            gg_obj_into_map(*val), next.services, &next.service_count
+        );
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    }
+
+    if (gg_map_get(config, GG_STR("maxTunnelsPerThing"), &val)) {
+        if (read_int_setting(*val, 0, TUNNEL_MAX_SLOTS, &num) != GG_ERR_OK) {
+            GG_LOGE(
+                "maxTunnelsPerThing must be an integer between 0 and %d",
+                TUNNEL_MAX_SLOTS
+            );
+            return GG_ERR_RANGE;
+        }
+        next.max_tunnels_per_thing = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("launchesPerMinute"), &val)) {
+        if (read_int_setting(*val, 0, TUNNEL_MAX_LAUNCHES_PER_MINUTE, &num)
+            != GG_ERR_OK) {
+            GG_LOGE(
+                "launchesPerMinute must be an integer between 0 and %d",
+                TUNNEL_MAX_LAUNCHES_PER_MINUTE
+            );
+            return GG_ERR_RANGE;
+        }
+        next.launches_per_minute = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("launchBurst"), &val)) {
+        if (read_int_setting(*val, 1, TUNNEL_MAX_SLOTS, &num) != GG_ERR_OK) {
+            GG_LOGE(
+                "launchBurst must be an integer between 1 and %d",
+                TUNNEL_MAX_SLOTS
+            );
+            return GG_ERR_RANGE;
+        }
+        next.launch_burst = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("launchCoalesceMs"), &val)) {
+        if (read_int_setting(*val, 0, TUNNEL_MAX_COALESCE_MS, &num)
+            != GG_ERR_OK) {
+            GG_LOGE(
+                "launchCoalesceMs must be an integer between 0 and %d",
+                TUNNEL_MAX_COALESCE_MS
+            );
+            return GG_ERR_RANGE;
+        }
+        next.launch_coalesce_ms = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("idleTimeoutSeconds"), &val)) {
+        if (read_int_setting(*val, 0, TUNNEL_MAX_TIMEOUT_SECONDS, &num)
+            != GG_ERR_OK) {
+            GG_LOGE(
+                "idleTimeoutSeconds must be an integer between 0 and %d",
+                TUNNEL_MAX_TIMEOUT_SECONDS
+            );
+            return GG_ERR_RANGE;
+        }
+        next.idle_timeout_seconds = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("hostMaxTunnels"), &val)) {
+        if (read_int_setting(*val, 0, HOST_BUDGET_MAX_TUNNELS, &num)
+            != GG_ERR_OK) {
+            GG_LOGE(
+                "hostMaxTunnels must be an integer between 0 and %d",
+                HOST_BUDGET_MAX_TUNNELS
+            );
+            return GG_ERR_RANGE;
+        }
+        next.host_max_tunnels = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("launchPressureThresholds"), &val)) {
+        if (gg_obj_type(*val) != GG_TYPE_MAP) {
+            GG_LOGE(
+                "launchPressureThresholds must be a map of resource to "
+                "percentage"
+            );
+            return GG_ERR_INVALID;
+        }
+        GgError ret = read_pressure_thresholds(gg_obj_into_map(*val), &next);
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    }
+
+    if (gg_map_get(config, GG_STR("launchPressureDeferSeconds"), &val)) {
+        if (read_int_setting(*val, 0, TUNNEL_MAX_PRESSURE_DEFER_SECONDS, &num)
+            != GG_ERR_OK) {
+            GG_LOGE(
+                "launchPressureDeferSeconds must be an integer between 0 and "
+                "%d",
+                TUNNEL_MAX_PRESSURE_DEFER_SECONDS
+            );
+            return GG_ERR_RANGE;
+        }
+        next.pressure_defer_seconds = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("pressureNice"), &val)) {
+        if (read_int_setting(*val, 0, 19, &num) != GG_ERR_OK) {
+            GG_LOGE("pressureNice must be an integer between 0 and 19");
+            return GG_ERR_RANGE;
+        }
+        next.pressure_nice = (int) num;
+    }
+
+    if (gg_map_get(config, GG_STR("destinationClientType"), &val)) {
+        GgBuffer type = gg_obj_type(*val) == GG_TYPE_BUF
+            ? gg_obj_into_buf(*val)
+            : GG_STR("");
+        if (gg_buffer_eq(type, GG_STR("auto"))) {
+            next.destination_client_type = TUNNEL_CLIENT_AUTO;
+        } else if (gg_buffer_eq(type, GG_STR("V1"))) {
+            next.destination_client_type = TUNNEL_CLIENT_V1;
+        } else {
+            GG_LOGE("destinationClientType must be \"auto\" or \"V1\"");
+            return GG_ERR_INVALID;
+        }
+    }
+
+    if (gg_map_get(config, GG_STR("destinationPreflight"), &val)) {
+        GgBuffer mode = gg_obj_type(*val) == GG_TYPE_BUF
+            ? gg_obj_into_buf(*val)
+            : GG_STR("");
+        if (gg_buffer_eq(mode, GG_STR("warn"))) {
+            next.destination_preflight = TUNNEL_PREFLIGHT_WARN;
+        } else if (gg_buffer_eq(mode, GG_STR("reject"))) {
+            next.destination_preflight = TUNNEL_PREFLIGHT_REJECT;
+        } else if (gg_buffer_eq(mode, GG_STR("off"))) {
+            next.destination_preflight = TUNNEL_PREFLIGHT_OFF;
+        } else {
+            GG_LOGE(
+                "destinationPreflight must be \"warn\", \"reject\" or \"off\""
+            );
+            return GG_ERR_INVALID;
+        }
+    }
+
+    if (gg_map_get(config, GG_STR("localproxyHost"), &val)
+        && read_bool_setting(*val, &next.proxy_host) != GG_ERR_OK) {
+        GG_LOGE("localproxyHost must be true or false");
+        return GG_ERR_INVALID;
+    }
+
+    if (gg_map_get(config, GG_STR("serviceNetworkNamespaces"), &val)) {
+        if (gg_obj_type(*val) != GG_TYPE_MAP) {
+            GG_LOGE(
+                "serviceNetworkNamespaces must be a map of service name to "
+                "namespace"
+            );
+            return GG_ERR_INVALID;
+        }
+        GgError ret = read_namespaces(gg_obj_into_map(*val), &next);
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    }
+
+    if (gg_map_get(config, GG_STR("serviceLatencyClasses"), &val)) {
+        if (gg_obj_type(*val) != GG_TYPE_MAP) {
+            GG_LOGE(
+                "serviceLatencyClasses must be a map of service name to "
+                "latency class"
+            );
+            return GG_ERR_INVALID;
+        }
+        GgError ret = read_latencies(gg_obj_into_map(*val), &next);
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    }
+
+    if (gg_map_get(config, GG_STR("gatewayDestinations"), &val)) {
+        if (gg_obj_type(*val) != GG_TYPE_MAP) {
+            GG_LOGE("gatewayDestinations must be a map of thing name to host");
+            return GG_ERR_INVALID;
+        }
+        GgError ret = read_destinations(gg_obj_into_map(*val), &next);
+        if (ret != GG_ERR_OK) {
+            return ret;
+        }
+    }
+
+    *settings = next;
+    return GG_ERR_OK;
+}
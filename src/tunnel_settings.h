@@ -0,0 +1,140 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ST_TUNNEL_SETTINGS_H
+#define ST_TUNNEL_SETTINGS_H
+
+#include "host_budget.h"
+#include "latency_class.h"
+#include "pressure.h"
+#include "secure-tunnel.h"
+#include <gg/error.h>
+#include <gg/object.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TUNNEL_MAX_SLOTS 20
+#define TUNNEL_MAX_TIMEOUT_SECONDS 43200
+#define TUNNEL_MAX_SERVICE_MAPPINGS 8
+#define TUNNEL_MAX_GATEWAY_THINGS 16
+#define TUNNEL_MAX_THING_NAME_LEN 128
+#define TUNNEL_MAX_LAUNCHES_PER_MINUTE 6000
+#define TUNNEL_MAX_COALESCE_MS 10000
+#define TUNNEL_MAX_PRESSURE_DEFER_SECONDS 300
+
+#define TUNNEL_SETTINGS_KEY_COUNT 18
+
+// Decoded configuration items for every setting at its maxima. Each map entry
+// or list item takes at most a GgKV and a string as long as a thing name.
+#define TUNNEL_SETTINGS_CONFIG_ITEMS \
+    (32 + TUNNEL_MAX_SERVICE_MAPPINGS * 8 \
+     + TUNNEL_MAX_GATEWAY_THINGS * (4 + TUNNEL_MAX_SERVICE_MAPPINGS))
+#define TUNNEL_SETTINGS_CONFIG_SIZE \
+    (TUNNEL_SETTINGS_CONFIG_ITEMS * (sizeof(GgKV) + TUNNEL_MAX_THING_NAME_LEN))
+
+typedef struct {
+    char name[64];
+    uint16_t port;
+} TunnelServiceMapping;
+
+// Protocol localproxy uses towards the source client
+typedef enum {
+    // Multiplex connections (V2/V3) when the localproxy artifact supports it
+    TUNNEL_CLIENT_AUTO,
+    // One connection per tunnel, for source clients that only speak V1
+    TUNNEL_CLIENT_V1,
+} TunnelClientType;
+
+// What to do when nothing listens on a local destination port
+typedef enum {
+    TUNNEL_PREFLIGHT_WARN, // Launch anyway and log a warning
+    TUNNEL_PREFLIGHT_REJECT,
+    TUNNEL_PREFLIGHT_OFF,
+} TunnelPreflight;
+
+// Network namespace localproxy joins for a service, e.g. a container's
+typedef struct {
+    char service[64];
+    char path[64]; // Namespace file, such as /run/netns/<name>
+} TunnelServiceNamespace;
+
+// Scheduling, IO priority and cgroup applied to a service's localproxy
+typedef struct {
+    char service[64];
+    LatencyClass latency;
+} TunnelServiceLatency;
+
+// Where a gateway forwards tunnels opened for another thing
+typedef struct {
+    char thing_name[TUNNEL_MAX_THING_NAME_LEN];
+    char host[64];
+    size_t service_count; // 0 uses the global service mappings
+    TunnelServiceMapping services[TUNNEL_MAX_SERVICE_MAPPINGS];
+} TunnelDestination;
+
+// Limits and service map applied to new tunnel admissions. Replaced as a whole
+// when the component configuration changes; running tunnels keep the values
+// they were admitted with.
+typedef struct {
+    int max_concurrent_tunnels;
+    int tunnel_timeout_seconds;
+    size_t service_count;
+    TunnelServiceMapping services[TUNNEL_MAX_SERVICE_MAPPINGS];
+    int max_tunnels_per_thing; // 0 for no per-thing limit
+    int launches_per_minute; // 0 for no launch rate limit
+    int launch_burst;
+    int launch_coalesce_ms; // 0 launches every notification immediately
+    int idle_timeout_seconds; // 0 never closes idle tunnels
+    int host_max_tunnels; // 0 for no host-wide limit
+    // Stall percentage that holds back launches, 0 to ignore the resource
+    int pressure_percent[PRESSURE_RESOURCE_COUNT];
+    int pressure_defer_seconds; // 0 rejects launches under pressure
+    int pressure_nice; // 0 leaves running tunnels' priority alone
+    TunnelClientType destination_client_type;
+    TunnelPreflight destination_preflight;
+    bool proxy_host; // Serve tunnels from the artifact's localproxy host
+    size_t namespace_count;
+    TunnelServiceNamespace namespaces[TUNNEL_MAX_SERVICE_MAPPINGS];
+    size_t latency_count;
+    TunnelServiceLatency latencies[TUNNEL_MAX_SERVICE_MAPPINGS];
+    size_t destination_count;
+    TunnelDestination destinations[TUNNEL_MAX_GATEWAY_THINGS];
+} TunnelSettings;
+
+void tunnel_settings_from_args(
+    const SecureTunnelConfig *config, TunnelSettings *settings
+);
+
+// Component configuration keys read by tunnel_settings_update
+extern const GgBuffer TUNNEL_SETTINGS_KEYS[TUNNEL_SETTINGS_KEY_COUNT];
+
+// Overlays values found in the component configuration map onto settings.
+// On error settings is left unmodified.
+GgError tunnel_settings_update(GgMap config, TunnelSettings *settings);
+
+// Returns the gateway destination configured for thing_name, or NULL.
+const TunnelDestination *tunnel_settings_find_destination(
+    const TunnelSettings *settings, GgBuffer thing_name
+);
+
+// Returns the network namespace path configured for service, or NULL when
+// localproxy stays in the component's namespace.
+const char *tunnel_settings_find_namespace(
+    const TunnelSettings *settings, GgBuffer service
+);
+
+// Returns the latency class configured for service, or NULL when localproxy
+// inherits the component's scheduling.
+const LatencyClass *tunnel_settings_find_latency(
+    const TunnelSettings *settings, GgBuffer service
+);
+
+#endif // ST_TUNNEL_SETTINGS_H
@@ -148,6 +148,56 @@ GG_TEST_DEFINE(subscribe_receives_notification) {
     GG_TEST_ASSERT_OK(gg_process_wait(pid));
 }
 
+GG_TEST_DEFINE(subscribe_gateway_things) {
+    pid_t pid = fork();
+    TEST_ASSERT_TRUE_MESSAGE(pid >= 0, "fork failed");
+
+    if (pid == 0) {
+        gg_sdk_init();
+
+        SecureTunnelConfig config = {
+            .thing_name = GG_STR("my-thing"),
+            .region = GG_STR("us-west-2"),
+            .artifact_path = GG_STR("/path/to/localproxy"),
+            .gateway_things = GG_STR("cam-1,my-thing,cam-2,cam-1"),
+            .max_concurrent_tunnels = 1,
+            .tunnel_timeout_seconds = 300,
+        };
+
+        GG_TEST_ASSERT_OK(subscribe_to_aws_tunnel_tokens(&config));
+#ifdef ENABLE_COVERAGE
+        __gcov_dump();
+#endif
+        exit(0);
+    }
+
+    GG_TEST_ASSERT_OK(gg_test_accept_client(1));
+
+    GG_TEST_ASSERT_OK(gg_test_expect_packet_sequence(
+        gg_test_connect_accepted_sequence(gg_test_get_auth_token()), 5
+    ));
+
+    // The component's own thing first, then each gateway thing once
+    const char *topics[] = { "$aws/things/my-thing/tunnels/notify",
+                             "$aws/things/cam-1/tunnels/notify",
+                             "$aws/things/cam-2/tunnels/notify" };
+    for (int i = 0; i < 3; i++) {
+        GG_TEST_ASSERT_OK(gg_test_expect_packet_sequence(
+            gg_test_mqtt_subscribe_accepted_sequence(
+                i + 1,
+                gg_buffer_from_null_term((char *) topics[i]),
+                GG_STR(""),
+                GG_STR("1"),
+                0
+            ),
+            5
+        ));
+    }
+
+    GG_TEST_ASSERT_OK(gg_test_wait_for_client_disconnect(5));
+    GG_TEST_ASSERT_OK(gg_process_wait(pid));
+}
+
 int main(void) {
     return gg_test_run_suite();
 }
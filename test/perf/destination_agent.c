@@ -0,0 +1,310 @@
+/*
+ * In-process destination for the mock tunneling service
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "destination_agent.h"
+#include "tunnel_wire.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509_vfy.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define AGENT_READ_CHUNK 16384
+#define AGENT_IDLE_TIMEOUT_MS 10000
+// Sample nonce from RFC 6455; the service only echoes it back hashed
+#define AGENT_WS_KEY "dGhlIHNhbXBsZSBub25jZQ=="
+
+typedef struct {
+    const DestinationAgentConfig *config;
+    DestinationAgentResult *result;
+    WsConn ws;
+    int local_fd;
+    int32_t stream_id;
+    uint32_t connection_id;
+    bool failed;
+    TwReader reader;
+    uint8_t in[TW_MAX_WS_MESSAGE];
+    uint8_t out[TW_MAX_FRAME + 2];
+    uint8_t chunk[AGENT_READ_CHUNK];
+} Agent;
+
+static void agent_fail(Agent *agent, const char *error) {
+    if (!agent->failed) {
+        snprintf(
+            agent->result->error, sizeof(agent->result->error), "%s", error
+        );
+    }
+    agent->failed = true;
+}
+
+static int connect_loopback(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    struct sockaddr_in addr = { .sin_family = AF_INET,
+                                .sin_port = htons(port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        len -= (size_t) written;
+    }
+    return true;
+}
+
+static bool send_message(Agent *agent, const TunnelMessage *msg) {
+    size_t len = tw_encode(msg, agent->out, sizeof(agent->out));
+    return len > 0 && ws_send(&agent->ws, WS_OP_BINARY, agent->out, len);
+}
+
+static TunnelMessage stream_message(
+    const Agent *agent, TunnelMessageType type
+) {
+    bool with_service = agent->config->protocol_version >= 2;
+    return (TunnelMessage) {
+        .type = type,
+        .stream_id = agent->stream_id,
+        .connection_id = agent->connection_id,
+        .service_id = with_service ? "SSH" : NULL,
+        .service_id_len = with_service ? 3 : 0,
+    };
+}
+
+static void close_local(Agent *agent) {
+    if (agent->local_fd != -1) {
+        close(agent->local_fd);
+        agent->local_fd = -1;
+    }
+}
+
+static void on_message(void *ctx, const TunnelMessage *msg) {
+    Agent *agent = ctx;
+    switch (msg->type) {
+    case TW_MSG_STREAM_START:
+        close_local(agent);
+        agent->stream_id = msg->stream_id;
+        agent->connection_id = msg->connection_id;
+        agent->local_fd = connect_loopback(agent->config->destination_port);
+        if (agent->local_fd == -1) {
+            TunnelMessage reset = stream_message(agent, TW_MSG_STREAM_RESET);
+            (void) send_message(agent, &reset);
+        }
+        break;
+    case TW_MSG_DATA:
+        if (msg->stream_id != agent->stream_id || agent->local_fd == -1) {
+            break;
+        }
+        if (!write_all(agent->local_fd, msg->payload, msg->payload_len)) {
+            agent_fail(agent, "Failed to write to destination");
+            break;
+        }
+        agent->result->bytes_to_destination += msg->payload_len;
+        break;
+    case TW_MSG_STREAM_RESET:
+    case TW_MSG_SESSION_RESET:
+        close_local(agent);
+        break;
+    default:
+        break;
+    }
+}
+
+static bool upgrade(Agent *agent) {
+    char request[2048];
+    int len = snprintf(
+        request,
+        sizeof(request),
+        "GET /tunnel?local-proxy-mode=destination HTTP/1.1\r\n"
+        "Host: 127.0.0.1:%u\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: " AGENT_WS_KEY "\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Protocol: " TW_SUBPROTOCOL_PREFIX "%d.0\r\n"
+        "access-token: %s\r\n\r\n",
+        agent->config->service_port,
+        agent->config->protocol_version,
+        agent->config->access_token
+    );
+    size_t written = 0;
+    if (len < 0 || (size_t) len >= sizeof(request)
+        || SSL_write_ex(agent->ws.ssl, request, (size_t) len, &written)
+            != 1) {
+        return false;
+    }
+
+    char response[2048];
+    char accept_key[64];
+    char expected[64];
+    ws_accept_key(AGENT_WS_KEY, expected, sizeof(expected));
+    return http_read_headers(agent->ws.ssl, response, sizeof(response))
+        && strncmp(response, "HTTP/1.1 101", 12) == 0
+        && http_header(
+               response, "Sec-WebSocket-Accept", accept_key, sizeof(accept_key)
+        )
+        && strcmp(accept_key, expected) == 0;
+}
+
+// Forwards destination output to the service. Returns false once the
+// destination has closed its side.
+static bool forward_local(Agent *agent) {
+    ssize_t len = read(agent->local_fd, agent->chunk, sizeof(agent->chunk));
+    if (len < 0 && errno == EINTR) {
+        return true;
+    }
+    TunnelMessage msg = stream_message(agent, TW_MSG_DATA);
+    if (len <= 0) {
+        msg.type = TW_MSG_STREAM_RESET;
+        (void) send_message(agent, &msg);
+        return false;
+    }
+    msg.payload = agent->chunk;
+    msg.payload_len = (size_t) len;
+    if (!send_message(agent, &msg)) {
+        agent_fail(agent, "Failed to send to service");
+        return false;
+    }
+    agent->result->bytes_from_destination += (uint64_t) len;
+    return true;
+}
+
+static void run_tunnel(Agent *agent) {
+    int ssl_fd = SSL_get_fd(agent->ws.ssl);
+    while (!agent->failed) {
+        bool ssl_ready = SSL_pending(agent->ws.ssl) > 0;
+        bool local_ready = false;
+        if (!ssl_ready) {
+            struct pollfd fds[2] = {
+                { .fd = ssl_fd, .events = POLLIN },
+                { .fd = agent->local_fd, .events = POLLIN },
+            };
+            int ret = poll(fds, 2, AGENT_IDLE_TIMEOUT_MS);
+            if (ret == 0) {
+                agent_fail(agent, "Tunnel idle");
+                return;
+            }
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                agent_fail(agent, "poll failed");
+                return;
+            }
+            ssl_ready = fds[0].revents != 0;
+            local_ready = fds[1].revents != 0;
+        }
+
+        if (ssl_ready) {
+            long len = ws_recv(&agent->ws, agent->in, sizeof(agent->in));
+            if (len == 0) {
+                return; // Service closed the tunnel
+            }
+            if (len < 0
+                || !tw_reader_feed(
+                    &agent->reader, agent->in, (size_t) len, on_message, agent
+                )) {
+                agent_fail(agent, "Failed to read from service");
+                return;
+            }
+        }
+        if (local_ready && agent->local_fd != -1 && !forward_local(agent)) {
+            close_local(agent);
+        }
+    }
+}
+
+static void *agent_thread(void *arg) {
+    Agent *agent = arg;
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    SSL *ssl = NULL;
+    int fd = -1;
+
+    if (ctx == NULL
+        || X509_STORE_add_cert(
+               SSL_CTX_get_cert_store(ctx), agent->config->trust
+           ) != 1) {
+        agent_fail(agent, "Failed to set up TLS");
+    } else if ((fd = connect_loopback(agent->config->service_port)) == -1) {
+        agent_fail(agent, "Failed to connect to service");
+    } else {
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+        ssl = SSL_new(ctx);
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), "127.0.0.1");
+        SSL_set_fd(ssl, fd);
+        agent->ws = (WsConn) { .ssl = ssl, .client = true };
+        if (SSL_connect(ssl) != 1) {
+            agent_fail(agent, "TLS handshake failed");
+        } else if (!upgrade(agent)) {
+            agent_fail(agent, "WebSocket upgrade failed");
+        } else {
+            run_tunnel(agent);
+        }
+    }
+
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    agent->result->cpu_ms
+        = (double) cpu.tv_sec * 1000.0 + (double) cpu.tv_nsec / 1e6;
+    agent->result->ok = !agent->failed;
+
+    close_local(agent);
+    SSL_free(ssl);
+    if (fd != -1) {
+        close(fd);
+    }
+    SSL_CTX_free(ctx);
+    free(agent);
+    return NULL;
+}
+
+bool destination_agent_start(
+    const DestinationAgentConfig *config,
+    DestinationAgentResult *result,
+    pthread_t *thread
+) {
+    Agent *agent = calloc(1, sizeof(Agent));
+    if (agent == NULL) {
+        return false;
+    }
+    *result = (DestinationAgentResult) { 0 };
+    agent->config = config;
+    agent->result = result;
+    agent->local_fd = -1;
+    if (pthread_create(thread, NULL, agent_thread, agent) != 0) {
+        free(agent);
+        return false;
+    }
+    return true;
+}
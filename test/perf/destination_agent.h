@@ -0,0 +1,44 @@
+/*
+ * In-process destination for the mock tunneling service
+ *
+ * Connects to the service the way localproxy does in destination mode and
+ * forwards every stream to a local TCP port, so the data path can be measured
+ * without a localproxy build.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef DESTINATION_AGENT_H
+#define DESTINATION_AGENT_H
+
+#include <openssl/x509.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint16_t service_port;
+    const char *access_token;
+    uint16_t destination_port;
+    X509 *trust; // Certificate the service must present
+    int protocol_version; // 1, 2 or 3
+} DestinationAgentConfig;
+
+typedef struct {
+    bool ok;
+    char error[128];
+    double cpu_ms;
+    uint64_t bytes_to_destination;
+    uint64_t bytes_from_destination;
+} DestinationAgentResult;
+
+// Runs an agent on a new thread until the service closes the tunnel. config
+// and result must outlive the thread.
+bool destination_agent_start(
+    const DestinationAgentConfig *config,
+    DestinationAgentResult *result,
+    pthread_t *thread
+);
+
+#endif // DESTINATION_AGENT_H
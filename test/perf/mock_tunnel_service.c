@@ -0,0 +1,537 @@
+/*
+ * Local stand-in for the AWS IoT secure tunneling service
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "mock_tunnel_service.h"
+#include "tunnel_wire.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MOCK_STREAM_ID 1
+#define MOCK_CONNECTION_ID 1
+#define MOCK_READ_TIMEOUT_SECONDS 10
+
+static SSL_CTX *service_ctx = NULL;
+static EVP_PKEY *service_key = NULL;
+static X509 *service_cert = NULL;
+static int listen_fd = -1;
+static uint16_t service_port = 0;
+static char service_token[1024];
+static MockWorkload service_workload;
+static pthread_t accept_thread;
+static atomic_bool service_stopping = false;
+
+static pthread_mutex_t results_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t results_cond = PTHREAD_COND_INITIALIZER;
+static MockTunnelResult results[MOCK_MAX_TUNNELS];
+static size_t result_count = 0;
+
+typedef struct {
+    WsConn ws;
+    int version;
+    MockTunnelResult *result;
+    uint64_t sent;
+    uint64_t echoed;
+    bool reset;
+    bool corrupt;
+    TwReader reader;
+    uint8_t in[TW_MAX_WS_MESSAGE];
+    uint8_t out[TW_MAX_FRAME + 2];
+    uint8_t chunk[TW_MAX_FRAME];
+} Session;
+
+static int64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static double thread_cpu_ms(void) {
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    return (double) cpu.tv_sec * 1000.0 + (double) cpu.tv_nsec / 1e6;
+}
+
+// Byte at offset of the stream the source sends, so echoes can be checked
+static uint8_t pattern_byte(uint64_t offset) {
+    return (uint8_t) (offset % 251);
+}
+
+static bool create_certificate(void) {
+    service_key = EVP_EC_gen("P-256");
+    service_cert = X509_new();
+    if (service_key == NULL || service_cert == NULL) {
+        return false;
+    }
+    X509_set_version(service_cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(service_cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(service_cert), -60);
+    X509_gmtime_adj(X509_getm_notAfter(service_cert), 24 * 3600);
+    X509_set_pubkey(service_cert, service_key);
+
+    X509_NAME *name = X509_get_subject_name(service_cert);
+    X509_NAME_add_entry_by_txt(
+        name, "CN", MBSTRING_ASC, (const uint8_t *) "localhost", -1, -1, 0
+    );
+    X509_set_issuer_name(service_cert, name);
+
+    // Self-signed and trusted directly, so it is also its own CA
+    static const struct {
+        int nid;
+        const char *value;
+    } EXTENSIONS[] = {
+        { NID_basic_constraints, "critical,CA:TRUE" },
+        { NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1" },
+    };
+    X509V3_CTX ctx;
+    X509V3_set_ctx_nodb(&ctx);
+    X509V3_set_ctx(&ctx, service_cert, service_cert, NULL, NULL, 0);
+    for (size_t i = 0; i < sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]); i++) {
+        X509_EXTENSION *ext = X509V3_EXT_conf_nid(
+            NULL, &ctx, EXTENSIONS[i].nid, EXTENSIONS[i].value
+        );
+        if (ext == NULL) {
+            return false;
+        }
+        X509_add_ext(service_cert, ext, -1);
+        X509_EXTENSION_free(ext);
+    }
+    return X509_sign(service_cert, service_key, EVP_sha256()) > 0;
+}
+
+static void fail(MockTunnelResult *result, const char *error) {
+    if (result->error[0] == '\0') {
+        snprintf(result->error, sizeof(result->error), "%s", error);
+    }
+    result->ok = false;
+}
+
+// Picks the newest protocol version the destination offered
+static int negotiate_version(const char *offered) {
+    int best = 0;
+    for (const char *p = strstr(offered, TW_SUBPROTOCOL_PREFIX); p != NULL;
+         p = strstr(p + 1, TW_SUBPROTOCOL_PREFIX)) {
+        int version = p[strlen(TW_SUBPROTOCOL_PREFIX)] - '0';
+        if (version >= 1 && version <= 3 && version > best) {
+            best = version;
+        }
+    }
+    return best;
+}
+
+static bool accept_websocket(SSL *ssl, Session *session) {
+    char request[4096];
+    char key[64];
+    char token[1024];
+    char protocols[256];
+    if (!http_read_headers(ssl, request, sizeof(request))) {
+        fail(session->result, "Incomplete upgrade request");
+        return false;
+    }
+    if (strncmp(request, "GET /tunnel?", 12) != 0
+        || strstr(request, "local-proxy-mode=destination") == NULL
+        || !http_header(request, "Sec-WebSocket-Key", key, sizeof(key))
+        || !http_header(
+            request, "Sec-WebSocket-Protocol", protocols, sizeof(protocols)
+        )) {
+        fail(session->result, "Not a destination upgrade request");
+        return false;
+    }
+    if (!http_header(request, "access-token", token, sizeof(token))
+        || strcmp(token, service_token) != 0) {
+        const char denied[] = "HTTP/1.1 401 Unauthorized\r\n"
+                              "Content-Length: 0\r\n\r\n";
+        (void) SSL_write(ssl, denied, (int) strlen(denied));
+        fail(session->result, "Invalid access token");
+        return false;
+    }
+    session->version = negotiate_version(protocols);
+    if (session->version == 0) {
+        fail(session->result, "No supported tunnel protocol offered");
+        return false;
+    }
+    snprintf(
+        session->result->protocol,
+        sizeof(session->result->protocol),
+        "%d.0",
+        session->version
+    );
+
+    char accept_key[64];
+    ws_accept_key(key, accept_key, sizeof(accept_key));
+    char response[512];
+    int len = snprintf(
+        response,
+        sizeof(response),
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: %s\r\n"
+        "Sec-WebSocket-Protocol: " TW_SUBPROTOCOL_PREFIX "%d.0\r\n"
+        "channel-id: mock-tunnel\r\n\r\n",
+        accept_key,
+        session->version
+    );
+    size_t written = 0;
+    return SSL_write_ex(ssl, response, (size_t) len, &written) == 1;
+}
+
+static bool send_message(Session *session, const TunnelMessage *msg) {
+    size_t len = tw_encode(msg, session->out, sizeof(session->out));
+    return len > 0
+        && ws_send(&session->ws, WS_OP_BINARY, session->out, len);
+}
+
+static bool send_control(Session *session, TunnelMessageType type) {
+    bool with_service = session->version >= 2;
+    return send_message(
+        session,
+        &(TunnelMessage) {
+            .type = type,
+            .stream_id = MOCK_STREAM_ID,
+            .connection_id = session->version >= 3 ? MOCK_CONNECTION_ID : 0,
+            .service_id = with_service ? MOCK_SERVICE_ID : NULL,
+            .service_id_len = with_service ? strlen(MOCK_SERVICE_ID) : 0,
+        }
+    );
+}
+
+static bool send_data(Session *session, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        session->chunk[i] = pattern_byte(session->sent + i);
+    }
+    session->sent += len;
+    return send_message(
+        session,
+        &(TunnelMessage) {
+            .type = TW_MSG_DATA,
+            .stream_id = MOCK_STREAM_ID,
+            .connection_id = session->version >= 3 ? MOCK_CONNECTION_ID : 0,
+            .payload = session->chunk,
+            .payload_len = len,
+        }
+    );
+}
+
+static void on_message(void *ctx, const TunnelMessage *msg) {
+    Session *session = ctx;
+    if (msg->type == TW_MSG_STREAM_RESET || msg->type == TW_MSG_SESSION_RESET) {
+        session->reset = true;
+        return;
+    }
+    if (msg->type != TW_MSG_DATA || msg->stream_id != MOCK_STREAM_ID) {
+        return;
+    }
+    for (size_t i = 0; i < msg->payload_len; i++) {
+        if (msg->payload[i] != pattern_byte(session->echoed + i)) {
+            session->corrupt = true;
+        }
+    }
+    session->echoed += msg->payload_len;
+}
+
+// Reads one WebSocket message from the destination
+static bool pump(Session *session) {
+    long len = ws_recv(&session->ws, session->in, sizeof(session->in));
+    if (len <= 0) {
+        fail(session->result, "Destination closed the tunnel");
+        return false;
+    }
+    if (!tw_reader_feed(
+            &session->reader,
+            session->in,
+            (size_t) len,
+            on_message,
+            session
+        )) {
+        fail(session->result, "Malformed tunnel frame");
+        return false;
+    }
+    if (session->reset || session->corrupt) {
+        fail(
+            session->result,
+            session->reset ? "Stream reset by destination"
+                           : "Echoed data does not match"
+        );
+        return false;
+    }
+    return true;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static bool run_interactive(Session *session) {
+    int rounds = service_workload.interactive_rounds;
+    if (rounds <= 0) {
+        return true;
+    }
+    double *rtt = calloc((size_t) rounds, sizeof(double));
+    if (rtt == NULL) {
+        fail(session->result, "Out of memory");
+        return false;
+    }
+    bool ok = true;
+    for (int i = 0; i < rounds && ok; i++) {
+        int64_t start = now_us();
+        ok = send_data(session, service_workload.interactive_bytes);
+        while (ok && session->echoed < session->sent) {
+            ok = pump(session);
+        }
+        rtt[i] = (double) (now_us() - start);
+        session->result->rounds = i + 1;
+    }
+    if (ok) {
+        qsort(rtt, (size_t) rounds, sizeof(double), compare_double);
+        session->result->rtt_p50_us = rtt[rounds / 2];
+        session->result->rtt_p99_us = rtt[(rounds * 99) / 100];
+        session->result->rtt_max_us = rtt[rounds - 1];
+    }
+    free(rtt);
+    return ok;
+}
+
+static bool run_bulk(Session *session) {
+    uint64_t target = session->sent + service_workload.bulk_bytes;
+    int64_t start = now_us();
+    bool ok = true;
+    while (ok && session->echoed < target) {
+        uint64_t in_flight = session->sent - session->echoed;
+        if (session->sent < target
+            && in_flight < service_workload.window_bytes) {
+            uint64_t left = target - session->sent;
+            ok = send_data(
+                session,
+                left < service_workload.chunk_bytes
+                    ? (size_t) left
+                    : service_workload.chunk_bytes
+            );
+        } else {
+            ok = pump(session);
+        }
+    }
+    double seconds = (double) (now_us() - start) / 1e6;
+    session->result->bulk_bytes = service_workload.bulk_bytes;
+    if (ok && seconds > 0) {
+        session->result->bulk_mib_per_s
+            = (double) service_workload.bulk_bytes / (1024.0 * 1024.0)
+            / seconds;
+    }
+    return ok;
+}
+
+static void run_session(Session *session) {
+    if (session->version >= 2) {
+        static const char *const SERVICE_IDS[] = { MOCK_SERVICE_ID };
+        if (!send_message(
+                session,
+                &(TunnelMessage) { .type = TW_MSG_SERVICE_IDS,
+                                   .available_service_ids = SERVICE_IDS,
+                                   .available_service_count = 1 }
+            )) {
+            fail(session->result, "Failed to send service IDs");
+            return;
+        }
+    }
+    if (!send_control(session, TW_MSG_STREAM_START)) {
+        fail(session->result, "Failed to start stream");
+        return;
+    }
+    session->result->ok = run_interactive(session) && run_bulk(session);
+
+    (void) send_control(session, TW_MSG_STREAM_RESET);
+    const uint8_t normal_closure[2] = { 0x03, 0xE8 };
+    (void) ws_send(&session->ws, WS_OP_CLOSE, normal_closure, 2);
+}
+
+static void record_result(const MockTunnelResult *result) {
+    pthread_mutex_lock(&results_mutex);
+    if (result_count < MOCK_MAX_TUNNELS) {
+        results[result_count++] = *result;
+    }
+    pthread_cond_broadcast(&results_cond);
+    pthread_mutex_unlock(&results_mutex);
+}
+
+static void *connection_thread(void *arg) {
+    int fd = (int) (intptr_t) arg;
+    MockTunnelResult result = { 0 };
+    Session *session = calloc(1, sizeof(Session));
+    SSL *ssl = SSL_new(service_ctx);
+
+    if (session == NULL || ssl == NULL) {
+        fail(&result, "Out of memory");
+    } else {
+        session->result = &result;
+        session->ws = (WsConn) { .ssl = ssl, .client = false };
+        SSL_set_fd(ssl, fd);
+        if (SSL_accept(ssl) != 1) {
+            fail(&result, "TLS handshake failed");
+        } else if (accept_websocket(ssl, session)) {
+            run_session(session);
+        }
+    }
+    result.service_cpu_ms = thread_cpu_ms();
+    record_result(&result);
+
+    SSL_free(ssl);
+    free(session);
+    close(fd);
+    return NULL;
+}
+
+static void *accept_loop(void *arg) {
+    (void) arg;
+    while (!atomic_load(&service_stopping)) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd == -1) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct timeval timeout = { .tv_sec = MOCK_READ_TIMEOUT_SECONDS };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        pthread_t thread;
+        if (pthread_create(
+                &thread, NULL, connection_thread, (void *) (intptr_t) fd
+            )
+            != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+static bool start_listener(void) {
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        return false;
+    }
+    struct sockaddr_in addr = { .sin_family = AF_INET,
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+        || listen(listen_fd, MOCK_MAX_TUNNELS) != 0
+        || getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len) != 0) {
+        return false;
+    }
+    service_port = ntohs(addr.sin_port);
+    return true;
+}
+
+bool mock_tunnel_service_start(
+    const char *access_token, const MockWorkload *workload
+) {
+    snprintf(service_token, sizeof(service_token), "%s", access_token);
+    service_workload = *workload;
+    result_count = 0;
+    atomic_store(&service_stopping, false);
+
+    if (!create_certificate()) {
+        return false;
+    }
+    service_ctx = SSL_CTX_new(TLS_server_method());
+    if (service_ctx == NULL
+        || SSL_CTX_set_min_proto_version(service_ctx, TLS1_2_VERSION) != 1
+        || SSL_CTX_use_certificate(service_ctx, service_cert) != 1
+        || SSL_CTX_use_PrivateKey(service_ctx, service_key) != 1) {
+        ERR_print_errors_fp(stderr);
+        return false;
+    }
+    if (!start_listener()) {
+        return false;
+    }
+    return pthread_create(&accept_thread, NULL, accept_loop, NULL) == 0;
+}
+
+uint16_t mock_tunnel_service_port(void) {
+    return service_port;
+}
+
+X509 *mock_tunnel_service_cert(void) {
+    return service_cert;
+}
+
+bool mock_tunnel_service_write_ca(const char *dir) {
+    char path[512];
+    snprintf(
+        path,
+        sizeof(path),
+        "%s/%08lx.0",
+        dir,
+        X509_subject_name_hash(service_cert)
+    );
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = PEM_write_X509(f, service_cert) == 1;
+    return fclose(f) == 0 && ok;
+}
+
+size_t mock_tunnel_service_wait(
+    MockTunnelResult *out, size_t count, int timeout_ms
+) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&results_mutex);
+    while (result_count < count) {
+        if (pthread_cond_timedwait(&results_cond, &results_mutex, &deadline)
+            != 0) {
+            break;
+        }
+    }
+    size_t copied = result_count < count ? result_count : count;
+    memcpy(out, results, copied * sizeof(results[0]));
+    pthread_mutex_unlock(&results_mutex);
+    return copied;
+}
+
+void mock_tunnel_service_stop(void) {
+    atomic_store(&service_stopping, true);
+    if (listen_fd != -1) {
+        shutdown(listen_fd, SHUT_RDWR);
+        pthread_join(accept_thread, NULL);
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    SSL_CTX_free(service_ctx);
+    service_ctx = NULL;
+    X509_free(service_cert);
+    service_cert = NULL;
+    EVP_PKEY_free(service_key);
+    service_key = NULL;
+}
@@ -0,0 +1,67 @@
+/*
+ * Local stand-in for the AWS IoT secure tunneling service
+ *
+ * Accepts destination-mode connections over TLS on loopback, plays the source
+ * side of the tunnel and measures the data path to the destination service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MOCK_TUNNEL_SERVICE_H
+#define MOCK_TUNNEL_SERVICE_H
+
+#include <openssl/x509.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOCK_MAX_TUNNELS 20
+#define MOCK_SERVICE_ID "SSH"
+
+// Traffic driven through every tunnel once its stream is started
+typedef struct {
+    int interactive_rounds; // Request/response exchanges, like keystrokes
+    size_t interactive_bytes;
+    size_t bulk_bytes; // One-way transfer echoed back, like scp
+    size_t chunk_bytes; // Largest DATA payload sent
+    size_t window_bytes; // Bulk bytes in flight before waiting for echoes
+} MockWorkload;
+
+typedef struct {
+    bool ok;
+    char error[128];
+    char protocol[8]; // Negotiated protocol version, e.g. "3.0"
+    int rounds;
+    double rtt_p50_us;
+    double rtt_p99_us;
+    double rtt_max_us;
+    uint64_t bulk_bytes;
+    double bulk_mib_per_s;
+    double service_cpu_ms; // Mock service thread, TLS included
+} MockTunnelResult;
+
+// Starts listening on an ephemeral loopback port with a fresh self-signed
+// certificate. Destinations must present access_token.
+bool mock_tunnel_service_start(
+    const char *access_token, const MockWorkload *workload
+);
+
+uint16_t mock_tunnel_service_port(void);
+
+// Certificate destinations should trust
+X509 *mock_tunnel_service_cert(void);
+
+// Writes the certificate to dir as a hashed CA directory entry, usable as
+// localproxy's --capath.
+bool mock_tunnel_service_write_ca(const char *dir);
+
+// Waits for count tunnels to finish their workload and copies their results
+// in completion order. Returns the number of results copied.
+size_t mock_tunnel_service_wait(
+    MockTunnelResult *results, size_t count, int timeout_ms
+);
+
+void mock_tunnel_service_stop(void);
+
+#endif // MOCK_TUNNEL_SERVICE_H
@@ -0,0 +1,219 @@
+/*
+ * Component cold start test
+ *
+ * Starts the component executable against the mock Greengrass IPC server and
+ * measures the time from fork until its tunnel notification subscription is
+ * acknowledged, the first moment a notification could reach it. STARTUP_RUNS
+ * sets how many starts are measured.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gg/buffer.h>
+#include <gg/error.h>
+#include <gg/ipc/mock.h>
+#include <gg/ipc/packet_sequences.h>
+#include <gg/process_wait.h>
+#include <gg/test.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GG_TEST_SOCKET_DIR "/tmp/gg-test-startup"
+#define GG_TEST_AUTH_TOKEN "test-auth-token"
+#define ARTIFACT_DIR GG_TEST_SOCKET_DIR "/artifact"
+#define PHASE_LOG_TIMEOUT_MS 5000
+#define MAX_RUNS 200
+
+static const char *const PHASE_LOG_PREFIX = "Startup phases (ms): ";
+
+static int env_int(const char *name, int fallback) {
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    const char *val = getenv(name);
+    return val != NULL ? atoi(val) : fallback;
+}
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int compare_int64(const void *a, const void *b) {
+    int64_t lhs = *(const int64_t *) a;
+    int64_t rhs = *(const int64_t *) b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// Stands in for localproxy so the component's artifact preflight finds and
+// probes something executable
+static void write_localproxy(void) {
+    (void) mkdir(ARTIFACT_DIR, 0755);
+    FILE *file = fopen(ARTIFACT_DIR "/localproxy", "w");
+    if (file == NULL) {
+        return;
+    }
+    fputs("#!/bin/sh\nexit 0\n", file);
+    fclose(file);
+    (void) chmod(ARTIFACT_DIR "/localproxy", 0755);
+}
+
+void suiteSetUp(void) {
+    GgError ret
+        = gg_test_setup_ipc(GG_TEST_SOCKET_DIR, 0777, GG_TEST_AUTH_TOKEN);
+    if (ret != GG_ERR_OK) {
+        _Exit(1);
+    }
+    write_localproxy();
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+    (void) gg_test_disconnect();
+}
+
+int suiteTearDown(int num_failures) {
+    gg_test_close();
+    return num_failures;
+}
+
+// Runs the component with its log on a pipe, which is returned in log_fd
+static pid_t start_component(int *log_fd) {
+    int log_pipe[2];
+    if (pipe(log_pipe) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(log_pipe[1], STDERR_FILENO);
+        close(log_pipe[0]);
+        close(log_pipe[1]);
+        execl(
+            SECURE_TUNNEL_EXECUTABLE,
+            SECURE_TUNNEL_EXECUTABLE,
+            "--thing-name",
+            "my-thing",
+            "--region",
+            "us-west-2",
+            "--artifact-path",
+            ARTIFACT_DIR,
+            "--journal",
+            "",
+            "--control-socket",
+            "",
+            (char *) NULL
+        );
+        _exit(127);
+    }
+    close(log_pipe[1]);
+    if (pid < 0) {
+        close(log_pipe[0]);
+        return -1;
+    }
+    *log_fd = log_pipe[0];
+    return pid;
+}
+
+// Reads the component's log until the phase breakdown it writes once ready
+// and copies that breakdown into phases
+static bool read_phase_log(int fd, char *phases, size_t size) {
+    static char buf[65536];
+    size_t len = 0;
+    int64_t deadline = now_us() + PHASE_LOG_TIMEOUT_MS * 1000LL;
+
+    while (len < sizeof(buf) - 1) {
+        int64_t remaining_ms = (deadline - now_us()) / 1000;
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (remaining_ms <= 0 || poll(&pfd, 1, (int) remaining_ms) <= 0) {
+            return false;
+        }
+        ssize_t got = read(fd, &buf[len], sizeof(buf) - 1 - len);
+        if (got <= 0) {
+            return false;
+        }
+        len += (size_t) got;
+        buf[len] = '\0';
+
+        char *start = strstr(buf, PHASE_LOG_PREFIX);
+        char *end = start != NULL ? strchr(start, '\n') : NULL;
+        if (end != NULL) {
+            start += strlen(PHASE_LOG_PREFIX);
+            snprintf(phases, size, "%.*s", (int) (end - start), start);
+            return true;
+        }
+    }
+    return false;
+}
+
+GG_TEST_DEFINE(cold_start_to_subscribed) {
+    int runs = env_int("STARTUP_RUNS", 20);
+    if (runs < 1 || runs > MAX_RUNS) {
+        runs = 20;
+    }
+    int64_t ready_us[MAX_RUNS];
+    char phases[256] = "";
+
+    for (int i = 0; i < runs; i++) {
+        int log_fd = -1;
+        int64_t start = now_us();
+        pid_t pid = start_component(&log_fd);
+        TEST_ASSERT_TRUE_MESSAGE(pid > 0, "failed to start component");
+
+        GG_TEST_ASSERT_OK(gg_test_accept_client(5));
+        GG_TEST_ASSERT_OK(gg_test_expect_packet_sequence(
+            gg_test_connect_accepted_sequence(gg_test_get_auth_token()), 5
+        ));
+        GG_TEST_ASSERT_OK(gg_test_expect_packet_sequence(
+            gg_test_mqtt_subscribe_accepted_sequence(
+                1,
+                GG_STR("$aws/things/my-thing/tunnels/notify"),
+                GG_STR(""),
+                GG_STR("1"),
+                0
+            ),
+            5
+        ));
+        ready_us[i] = now_us() - start;
+
+        bool logged = read_phase_log(log_fd, phases, sizeof(phases));
+        close(log_fd);
+        kill(pid, SIGKILL);
+        (void) gg_process_wait(pid);
+        (void) gg_test_disconnect();
+        TEST_ASSERT_TRUE_MESSAGE(logged, "component did not log its phases");
+    }
+
+    qsort(ready_us, (size_t) runs, sizeof(ready_us[0]), compare_int64);
+    char msg[160];
+    snprintf(
+        msg,
+        sizeof(msg),
+        "fork to subscribed over %d runs: min %.1f ms, median %.1f ms, "
+        "p95 %.1f ms, max %.1f ms",
+        runs,
+        (double) ready_us[0] / 1000.0,
+        (double) ready_us[runs / 2] / 1000.0,
+        (double) ready_us[(runs * 95) / 100] / 1000.0,
+        (double) ready_us[runs - 1] / 1000.0
+    );
+    TEST_MESSAGE(msg);
+    char phase_msg[300];
+    snprintf(phase_msg, sizeof(phase_msg), "last run phases: %s", phases);
+    TEST_MESSAGE(phase_msg);
+}
+
+int main(void) {
+    return gg_test_run_suite();
+}
@@ -0,0 +1,331 @@
+/*
+ * Tunnel data-path throughput and latency test
+ *
+ * Runs the mock tunneling service on loopback and drives SSH-like interactive
+ * and bulk traffic through destination tunnels into a local echo service.
+ * Destinations are in-process agents, or real localproxy processes when
+ * LOCALPROXY points at a localproxy binary.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "destination_agent.h"
+#include "mock_tunnel_service.h"
+#include "test_helpers.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_DIR "/tmp/gg-test-perf"
+#define ACCESS_TOKEN "mock-access-token"
+#define RESULT_TIMEOUT_MS 120000
+
+void test_in_process_tunnels(void);
+void test_localproxy_tunnels(void);
+
+static int echo_fd = -1;
+static uint16_t echo_port = 0;
+static MockWorkload workload;
+static int tunnel_count;
+
+static int env_int(const char *name, int fallback) {
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    const char *val = getenv(name);
+    return val != NULL ? atoi(val) : fallback;
+}
+
+// Local destination service: echoes everything back, like an SSH server
+// echoing keystrokes.
+static void *echo_connection(void *arg) {
+    int fd = (int) (intptr_t) arg;
+    uint8_t buf[65536];
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t off = 0; off < len;) {
+            ssize_t written = write(fd, &buf[off], (size_t) (len - off));
+            if (written <= 0 && errno != EINTR) {
+                close(fd);
+                return NULL;
+            }
+            off += written > 0 ? written : 0;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *echo_accept_loop(void *arg) {
+    (void) arg;
+    while (true) {
+        int fd = accept(echo_fd, NULL, NULL);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return NULL;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t thread;
+        if (pthread_create(
+                &thread, NULL, echo_connection, (void *) (intptr_t) fd
+            )
+            == 0) {
+            pthread_detach(thread);
+        } else {
+            close(fd);
+        }
+    }
+}
+
+static void start_echo_service(void) {
+    echo_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    TEST_ASSERT_NOT_EQUAL(-1, echo_fd);
+    struct sockaddr_in addr = { .sin_family = AF_INET,
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    TEST_ASSERT_EQUAL(
+        0, bind(echo_fd, (struct sockaddr *) &addr, sizeof(addr))
+    );
+    TEST_ASSERT_EQUAL(0, listen(echo_fd, MOCK_MAX_TUNNELS));
+    TEST_ASSERT_EQUAL(
+        0, getsockname(echo_fd, (struct sockaddr *) &addr, &addr_len)
+    );
+    echo_port = ntohs(addr.sin_port);
+
+    pthread_t thread;
+    TEST_ASSERT_EQUAL(0, pthread_create(&thread, NULL, echo_accept_loop, NULL));
+    pthread_detach(thread);
+}
+
+static void report_service_results(
+    const MockTunnelResult *results, size_t count
+) {
+    for (size_t i = 0; i < count; i++) {
+        const MockTunnelResult *r = &results[i];
+        char msg[256];
+        snprintf(
+            msg,
+            sizeof(msg),
+            "tunnel %zu (protocol %s): %d rounds rtt p50 %.0f us p99 %.0f us "
+            "max %.0f us, bulk %.1f MiB/s, service cpu %.1f ms%s%s",
+            i,
+            r->protocol,
+            r->rounds,
+            r->rtt_p50_us,
+            r->rtt_p99_us,
+            r->rtt_max_us,
+            r->bulk_mib_per_s,
+            r->service_cpu_ms,
+            r->ok ? "" : ", failed: ",
+            r->error
+        );
+        TEST_MESSAGE(msg);
+    }
+}
+
+static void assert_service_results(
+    const MockTunnelResult *results, size_t count
+) {
+    TEST_ASSERT_EQUAL_size_t((size_t) tunnel_count, count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE_MESSAGE(results[i].ok, results[i].error);
+        TEST_ASSERT_EQUAL_INT(workload.interactive_rounds, results[i].rounds);
+        TEST_ASSERT_TRUE(results[i].bulk_mib_per_s > 0);
+    }
+}
+
+// CPU time of a child process in milliseconds, from /proc/<pid>/stat
+static double process_cpu_ms(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+    char stat[1024];
+    size_t len = fread(stat, 1, sizeof(stat) - 1, f);
+    fclose(f);
+    stat[len] = '\0';
+
+    // Fields after the parenthesized command name start at state (field 3)
+    const char *fields = strrchr(stat, ')');
+    unsigned long utime = 0;
+    unsigned long stime = 0;
+    if (fields == NULL
+        || sscanf(
+               fields + 2,
+               "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+               &utime,
+               &stime
+           )
+            != 2) {
+        return -1;
+    }
+    return (double) (utime + stime) * 1000.0 / (double) sysconf(_SC_CLK_TCK);
+}
+
+static pid_t spawn_localproxy(const char *localproxy) {
+    char endpoint[32];
+    char destination[32];
+    snprintf(
+        endpoint,
+        sizeof(endpoint),
+        "127.0.0.1:%u",
+        mock_tunnel_service_port()
+    );
+    snprintf(destination, sizeof(destination), "127.0.0.1:%u", echo_port);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe)
+        setenv("AWSIOT_TUNNEL_ACCESS_TOKEN", ACCESS_TOKEN, 1);
+        // Same destination options the component uses
+        execl(
+            localproxy,
+            "localproxy",
+            "-e",
+            endpoint,
+            "-d",
+            destination,
+            "-c",
+            TEST_DIR,
+            "--destination-client-type",
+            "V1",
+            "-v",
+            "2",
+            (char *) NULL
+        );
+        _exit(127);
+    }
+    return pid;
+}
+
+void setUp(void) {
+    mkdir(TEST_DIR, 0755);
+    TEST_ASSERT_TRUE(mock_tunnel_service_start(ACCESS_TOKEN, &workload));
+}
+
+void tearDown(void) {
+    mock_tunnel_service_stop();
+    test_remove_directory(TEST_DIR);
+}
+
+void test_in_process_tunnels(void) {
+    DestinationAgentConfig config = {
+        .service_port = mock_tunnel_service_port(),
+        .access_token = ACCESS_TOKEN,
+        .destination_port = echo_port,
+        .trust = mock_tunnel_service_cert(),
+        .protocol_version = env_int("PERF_PROTOCOL", 3),
+    };
+    DestinationAgentResult agents[MOCK_MAX_TUNNELS];
+    pthread_t threads[MOCK_MAX_TUNNELS];
+    for (int i = 0; i < tunnel_count; i++) {
+        TEST_ASSERT_TRUE(
+            destination_agent_start(&config, &agents[i], &threads[i])
+        );
+    }
+
+    MockTunnelResult results[MOCK_MAX_TUNNELS];
+    size_t count = mock_tunnel_service_wait(
+        results, (size_t) tunnel_count, RESULT_TIMEOUT_MS
+    );
+    for (int i = 0; i < tunnel_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    report_service_results(results, count);
+
+    uint64_t expected = (uint64_t) workload.interactive_rounds
+            * workload.interactive_bytes
+        + workload.bulk_bytes;
+    for (int i = 0; i < tunnel_count; i++) {
+        char msg[192];
+        snprintf(
+            msg,
+            sizeof(msg),
+            "destination %d: cpu %.1f ms, %llu bytes forwarded%s%s",
+            i,
+            agents[i].cpu_ms,
+            (unsigned long long) agents[i].bytes_to_destination,
+            agents[i].ok ? "" : ", failed: ",
+            agents[i].error
+        );
+        TEST_MESSAGE(msg);
+        TEST_ASSERT_TRUE_MESSAGE(agents[i].ok, agents[i].error);
+        TEST_ASSERT_EQUAL_UINT64(expected, agents[i].bytes_to_destination);
+        TEST_ASSERT_EQUAL_UINT64(expected, agents[i].bytes_from_destination);
+    }
+    assert_service_results(results, count);
+}
+
+void test_localproxy_tunnels(void) {
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    const char *localproxy = getenv("LOCALPROXY");
+    if (localproxy == NULL) {
+        TEST_IGNORE_MESSAGE("Set LOCALPROXY to a localproxy binary to run");
+        return;
+    }
+    TEST_ASSERT_TRUE(mock_tunnel_service_write_ca(TEST_DIR));
+
+    pid_t pids[MOCK_MAX_TUNNELS];
+    for (int i = 0; i < tunnel_count; i++) {
+        pids[i] = spawn_localproxy(localproxy);
+        TEST_ASSERT_GREATER_THAN(0, pids[i]);
+    }
+
+    MockTunnelResult results[MOCK_MAX_TUNNELS];
+    size_t count = mock_tunnel_service_wait(
+        results, (size_t) tunnel_count, RESULT_TIMEOUT_MS
+    );
+    report_service_results(results, count);
+
+    for (int i = 0; i < tunnel_count; i++) {
+        char msg[96];
+        snprintf(
+            msg,
+            sizeof(msg),
+            "localproxy %d: cpu %.1f ms",
+            i,
+            process_cpu_ms(pids[i])
+        );
+        TEST_MESSAGE(msg);
+        kill(pids[i], SIGTERM);
+        waitpid(pids[i], NULL, 0);
+    }
+    assert_service_results(results, count);
+}
+
+int main(void) {
+    tunnel_count = env_int("PERF_TUNNELS", 4);
+    if (tunnel_count < 1 || tunnel_count > MOCK_MAX_TUNNELS) {
+        tunnel_count = 4;
+    }
+    workload = (MockWorkload) {
+        .interactive_rounds = env_int("PERF_ROUNDS", 1000),
+        .interactive_bytes = 64,
+        .bulk_bytes = (size_t) env_int("PERF_BULK_MIB", 16) * 1024 * 1024,
+        .chunk_bytes = 16384,
+        .window_bytes = 256 * 1024,
+    };
+    signal(SIGPIPE, SIG_IGN);
+
+    UNITY_BEGIN();
+    start_echo_service();
+    RUN_TEST(test_in_process_tunnels);
+    RUN_TEST(test_localproxy_tunnels);
+    return UNITY_END();
+}
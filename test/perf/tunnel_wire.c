@@ -0,0 +1,370 @@
+/*
+ * Secure tunneling wire format for the mock tunneling service
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "tunnel_wire.h"
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+enum {
+    PB_VARINT = 0,
+    PB_FIXED64 = 1,
+    PB_LEN = 2,
+    PB_FIXED32 = 5,
+};
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} PbWriter;
+
+static void pb_byte(PbWriter *w, uint8_t byte) {
+    if (w->len >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = byte;
+}
+
+static void pb_varint(PbWriter *w, uint64_t val) {
+    while (val >= 0x80) {
+        pb_byte(w, (uint8_t) (val | 0x80));
+        val >>= 7;
+    }
+    pb_byte(w, (uint8_t) val);
+}
+
+static void pb_bytes(
+    PbWriter *w, uint32_t field, const void *data, size_t len
+) {
+    pb_varint(w, (field << 3) | PB_LEN);
+    pb_varint(w, len);
+    if (w->size - w->len < len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(&w->buf[w->len], data, len);
+    w->len += len;
+}
+
+size_t tw_encode(const TunnelMessage *msg, uint8_t *out, size_t size) {
+    if (size < 2) {
+        return 0;
+    }
+    PbWriter w = { .buf = &out[2], .size = size - 2 };
+    pb_varint(&w, (1 << 3) | PB_VARINT);
+    pb_varint(&w, (uint64_t) msg->type);
+    if (msg->stream_id != 0) {
+        pb_varint(&w, (2 << 3) | PB_VARINT);
+        // int32 fields sign extend to 64 bits
+        pb_varint(&w, (uint64_t) (int64_t) msg->stream_id);
+    }
+    if (msg->payload_len > 0) {
+        pb_bytes(&w, 4, msg->payload, msg->payload_len);
+    }
+    if (msg->service_id_len > 0) {
+        pb_bytes(&w, 5, msg->service_id, msg->service_id_len);
+    }
+    for (size_t i = 0; i < msg->available_service_count; i++) {
+        const char *id = msg->available_service_ids[i];
+        pb_bytes(&w, 6, id, strlen(id));
+    }
+    if (msg->connection_id != 0) {
+        pb_varint(&w, (7 << 3) | PB_VARINT);
+        pb_varint(&w, msg->connection_id);
+    }
+    if (w.overflow || w.len > TW_MAX_FRAME) {
+        return 0;
+    }
+    out[0] = (uint8_t) (w.len >> 8);
+    out[1] = (uint8_t) w.len;
+    return w.len + 2;
+}
+
+static bool pb_read_varint(
+    const uint8_t *buf, size_t len, size_t *pos, uint64_t *val
+) {
+    *val = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (*pos >= len) {
+            return false;
+        }
+        uint8_t byte = buf[(*pos)++];
+        *val |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool tw_decode(const uint8_t *buf, size_t len, TunnelMessage *msg) {
+    *msg = (TunnelMessage) { 0 };
+    size_t pos = 0;
+    while (pos < len) {
+        uint64_t key = 0;
+        uint64_t val = 0;
+        if (!pb_read_varint(buf, len, &pos, &key)) {
+            return false;
+        }
+        switch (key & 7) {
+        case PB_VARINT:
+            if (!pb_read_varint(buf, len, &pos, &val)) {
+                return false;
+            }
+            if (key >> 3 == 1) {
+                msg->type = (TunnelMessageType) val;
+            } else if (key >> 3 == 2) {
+                msg->stream_id = (int32_t) val;
+            } else if (key >> 3 == 7) {
+                msg->connection_id = (uint32_t) val;
+            }
+            break;
+        case PB_LEN:
+            if (!pb_read_varint(buf, len, &pos, &val) || val > len - pos) {
+                return false;
+            }
+            if (key >> 3 == 4) {
+                msg->payload = &buf[pos];
+                msg->payload_len = (size_t) val;
+            } else if (key >> 3 == 5) {
+                msg->service_id = (const char *) &buf[pos];
+                msg->service_id_len = (size_t) val;
+            }
+            pos += (size_t) val;
+            break;
+        case PB_FIXED64:
+            pos += 8;
+            break;
+        case PB_FIXED32:
+            pos += 4;
+            break;
+        default:
+            return false;
+        }
+    }
+    return pos == len;
+}
+
+bool tw_reader_feed(
+    TwReader *reader,
+    const uint8_t *data,
+    size_t len,
+    TwMessageHandler *handler,
+    void *ctx
+) {
+    if (len > sizeof(reader->buf) - reader->len) {
+        return false;
+    }
+    memcpy(&reader->buf[reader->len], data, len);
+    reader->len += len;
+
+    size_t pos = 0;
+    while (reader->len - pos >= 2) {
+        size_t frame_len
+            = (size_t) reader->buf[pos] << 8 | reader->buf[pos + 1];
+        if (reader->len - pos - 2 < frame_len) {
+            break;
+        }
+        TunnelMessage msg;
+        if (!tw_decode(&reader->buf[pos + 2], frame_len, &msg)) {
+            return false;
+        }
+        handler(ctx, &msg);
+        pos += 2 + frame_len;
+    }
+    memmove(reader->buf, &reader->buf[pos], reader->len - pos);
+    reader->len -= pos;
+    return true;
+}
+
+static bool ssl_write_all(SSL *ssl, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        size_t written = 0;
+        if (SSL_write_ex(ssl, data, len, &written) != 1) {
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+static bool ssl_read_all(SSL *ssl, uint8_t *buf, size_t len) {
+    while (len > 0) {
+        size_t read = 0;
+        if (SSL_read_ex(ssl, buf, len, &read) != 1) {
+            return false;
+        }
+        buf += read;
+        len -= read;
+    }
+    return true;
+}
+
+bool ws_send(
+    const WsConn *ws, WsOpcode opcode, const uint8_t *data, size_t len
+) {
+    uint8_t header[14];
+    size_t header_len = 2;
+    header[0] = (uint8_t) (0x80 | opcode);
+    uint8_t mask_bit = ws->client ? 0x80 : 0;
+    if (len < 126) {
+        header[1] = (uint8_t) (mask_bit | len);
+    } else if (len <= UINT16_MAX) {
+        header[1] = mask_bit | 126;
+        header[2] = (uint8_t) (len >> 8);
+        header[3] = (uint8_t) len;
+        header_len = 4;
+    } else {
+        header[1] = mask_bit | 127;
+        for (int i = 0; i < 8; i++) {
+            header[2 + i] = (uint8_t) ((uint64_t) len >> (56 - 8 * i));
+        }
+        header_len = 10;
+    }
+    if (!ws->client) {
+        return ssl_write_all(ws->ssl, header, header_len)
+            && ssl_write_all(ws->ssl, data, len);
+    }
+
+    // Masking only hides payloads from intermediaries, so a fixed key is fine
+    // for a loopback test peer.
+    static const uint8_t MASK[4] = { 0x37, 0xFA, 0x21, 0x3D };
+    memcpy(&header[header_len], MASK, sizeof(MASK));
+    header_len += sizeof(MASK);
+    if (!ssl_write_all(ws->ssl, header, header_len)) {
+        return false;
+    }
+    uint8_t chunk[16384];
+    for (size_t off = 0; off < len; off += sizeof(chunk)) {
+        size_t n = len - off < sizeof(chunk) ? len - off : sizeof(chunk);
+        for (size_t i = 0; i < n; i++) {
+            chunk[i] = data[off + i] ^ MASK[(off + i) & 3];
+        }
+        if (!ssl_write_all(ws->ssl, chunk, n)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+long ws_recv(const WsConn *ws, uint8_t *buf, size_t size) {
+    size_t total = 0;
+    while (true) {
+        uint8_t header[2];
+        if (!ssl_read_all(ws->ssl, header, 2)) {
+            return -1;
+        }
+        uint8_t opcode = header[0] & 0x0F;
+        bool fin = (header[0] & 0x80) != 0;
+        uint64_t len = header[1] & 0x7F;
+        if (len == 126 || len == 127) {
+            uint8_t ext[8];
+            size_t ext_len = len == 126 ? 2 : 8;
+            if (!ssl_read_all(ws->ssl, ext, ext_len)) {
+                return -1;
+            }
+            len = 0;
+            for (size_t i = 0; i < ext_len; i++) {
+                len = len << 8 | ext[i];
+            }
+        }
+        uint8_t mask[4] = { 0 };
+        bool masked = (header[1] & 0x80) != 0;
+        if (masked && !ssl_read_all(ws->ssl, mask, sizeof(mask))) {
+            return -1;
+        }
+
+        bool control = (opcode & 0x8) != 0;
+        uint8_t control_buf[125];
+        uint8_t *dest = control ? control_buf : &buf[total];
+        size_t room = control ? sizeof(control_buf) : size - total;
+        if (len > room || !ssl_read_all(ws->ssl, dest, (size_t) len)) {
+            return -1;
+        }
+        if (masked) {
+            for (size_t i = 0; i < len; i++) {
+                dest[i] ^= mask[i & 3];
+            }
+        }
+
+        if (opcode == WS_OP_PING) {
+            if (!ws_send(ws, WS_OP_PONG, control_buf, (size_t) len)) {
+                return -1;
+            }
+        } else if (opcode == WS_OP_CLOSE) {
+            (void) ws_send(ws, WS_OP_CLOSE, control_buf, len >= 2 ? 2 : 0);
+            return 0;
+        } else if (!control) {
+            total += (size_t) len;
+            if (fin) {
+                return (long) total;
+            }
+        }
+    }
+}
+
+void ws_accept_key(const char *key, char *out, size_t size) {
+    char input[128];
+    snprintf(input, sizeof(input), "%s" WS_GUID, key);
+    uint8_t digest[SHA_DIGEST_LENGTH];
+    SHA1((const uint8_t *) input, strlen(input), digest);
+    uint8_t encoded[4 * ((SHA_DIGEST_LENGTH + 2) / 3) + 1];
+    EVP_EncodeBlock(encoded, digest, SHA_DIGEST_LENGTH);
+    snprintf(out, size, "%s", (const char *) encoded);
+}
+
+bool http_read_headers(SSL *ssl, char *buf, size_t size) {
+    size_t len = 0;
+    while (len + 1 < size) {
+        if (!ssl_read_all(ssl, (uint8_t *) &buf[len], 1)) {
+            return false;
+        }
+        len++;
+        buf[len] = '\0';
+        if (len >= 4 && memcmp(&buf[len - 4], "\r\n\r\n", 4) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool http_header(
+    const char *headers, const char *name, char *value, size_t size
+) {
+    size_t name_len = strlen(name);
+    for (const char *line = strstr(headers, "\r\n"); line != NULL;
+         line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') {
+            continue;
+        }
+        const char *start = &line[name_len + 1];
+        while (*start == ' ') {
+            start++;
+        }
+        const char *end = strstr(start, "\r\n");
+        size_t len = end != NULL ? (size_t) (end - start) : strlen(start);
+        if (len >= size) {
+            return false;
+        }
+        memcpy(value, start, len);
+        value[len] = '\0';
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,102 @@
+/*
+ * Secure tunneling wire format for the mock tunneling service
+ *
+ * Tunnel messages are protobuf encoded, prefixed with a 2-byte big-endian
+ * length and carried in binary WebSocket messages over TLS.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TUNNEL_WIRE_H
+#define TUNNEL_WIRE_H
+
+#include <openssl/ssl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TW_MAX_FRAME 65535
+#define TW_MAX_WS_MESSAGE (256 * 1024)
+#define TW_SUBPROTOCOL_PREFIX "aws.iot.securetunneling-"
+
+typedef enum {
+    TW_MSG_DATA = 1,
+    TW_MSG_STREAM_START = 2,
+    TW_MSG_STREAM_RESET = 3,
+    TW_MSG_SESSION_RESET = 4,
+    TW_MSG_SERVICE_IDS = 5,
+    TW_MSG_CONNECTION_START = 6,
+    TW_MSG_CONNECTION_RESET = 7,
+} TunnelMessageType;
+
+typedef struct {
+    TunnelMessageType type;
+    int32_t stream_id;
+    uint32_t connection_id; // 0 before protocol 3.0
+    const uint8_t *payload;
+    size_t payload_len;
+    const char *service_id; // Not null terminated
+    size_t service_id_len;
+    const char *const *available_service_ids; // Encode only
+    size_t available_service_count;
+} TunnelMessage;
+
+// Appends msg with its length prefix to out. Returns the bytes written, or 0
+// if it does not fit.
+size_t tw_encode(const TunnelMessage *msg, uint8_t *out, size_t size);
+
+// Decodes one protobuf message body. Unknown fields are skipped.
+bool tw_decode(const uint8_t *buf, size_t len, TunnelMessage *msg);
+
+typedef void TwMessageHandler(void *ctx, const TunnelMessage *msg);
+
+// Reassembles length-prefixed messages that may span WebSocket messages
+typedef struct {
+    uint8_t buf[TW_MAX_WS_MESSAGE + TW_MAX_FRAME];
+    size_t len;
+} TwReader;
+
+// Appends data and calls handler for every complete message. Returns false on
+// a malformed stream.
+bool tw_reader_feed(
+    TwReader *reader,
+    const uint8_t *data,
+    size_t len,
+    TwMessageHandler *handler,
+    void *ctx
+);
+
+typedef enum {
+    WS_OP_CONTINUATION = 0x0,
+    WS_OP_BINARY = 0x2,
+    WS_OP_CLOSE = 0x8,
+    WS_OP_PING = 0x9,
+    WS_OP_PONG = 0xA,
+} WsOpcode;
+
+typedef struct {
+    SSL *ssl;
+    bool client; // Client to server frames are masked
+} WsConn;
+
+bool ws_send(
+    const WsConn *ws, WsOpcode opcode, const uint8_t *data, size_t len
+);
+
+// Reads the next binary message, answering pings and closes on the way.
+// Returns its length, 0 once the peer has closed, or -1 on error.
+long ws_recv(const WsConn *ws, uint8_t *buf, size_t size);
+
+// Computes the Sec-WebSocket-Accept value for key
+void ws_accept_key(const char *key, char *out, size_t size);
+
+// Reads an HTTP header block up to and including the blank line
+bool http_read_headers(SSL *ssl, char *buf, size_t size);
+
+// Finds a header value in a header block. Names are case insensitive.
+bool http_header(
+    const char *headers, const char *name, char *value, size_t size
+);
+
+#endif // TUNNEL_WIRE_H
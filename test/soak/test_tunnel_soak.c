@@ -0,0 +1,351 @@
+/*
+ * Soak test for the tunnel lifecycle
+ *
+ * Drives many open/close cycles through handle_tunnel_notification against a
+ * stub localproxy and checks that process resources return to baseline after
+ * every phase.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <dirent.h>
+#include <gg/arena.h>
+#include <gg/json_decode.h>
+#include <libgen.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_DIR "/tmp/gg-test-soak"
+#define DEFAULT_CYCLES 100000
+#define CYCLES_PER_PHASE 10000
+#define MAX_STUB_DELAY_MS 20
+#define FOOTPRINT_HOLD_MS 2000
+#define SETTLE_TIMEOUT_MS 10000
+#define DEFAULT_RSS_SLACK_KB 512
+
+void test_soak_tunnel_cycles(void);
+void test_per_tunnel_footprint(void);
+
+typedef struct {
+    int fds;
+    int threads;
+    long rss_kb;
+} ResourceBaseline;
+
+static SecureTunnelConfig soak_config = {
+    .thing_name = GG_STR("soak-thing"),
+    .region = GG_STR("us-west-2"),
+    .artifact_path = GG_STR(TEST_DIR),
+    .max_concurrent_tunnels = TUNNEL_MAX_SLOTS,
+    .tunnel_timeout_seconds = 300,
+};
+
+static unsigned int soak_seed = 1;
+
+// The harness binary doubles as the stub localproxy. The access token carries
+// "<exit>:<delay_ms>"; exit codes above 128 are raised as signals instead.
+static int stub_localproxy_main(void) {
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    const char *token = getenv("AWSIOT_TUNNEL_ACCESS_TOKEN");
+    int exit_code = 0;
+    int delay_ms = 0;
+    if (token == NULL || sscanf(token, "%d:%d", &exit_code, &delay_ms) != 2) {
+        return 2;
+    }
+    if (delay_ms > 0) {
+        usleep((useconds_t) delay_ms * 1000U);
+    }
+    if (exit_code > 128) {
+        raise(exit_code - 128);
+    }
+    return exit_code;
+}
+
+static long read_status_field(const char *path, const char *field) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+    char line[256];
+    long value = -1;
+    size_t field_len = strlen(field);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, field, field_len) == 0) {
+            value = strtol(&line[field_len], NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+static int count_dir_entries(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return -1;
+    }
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count - 1; // The directory stream itself
+}
+
+static ResourceBaseline sample_resources(void) {
+    return (ResourceBaseline) {
+        .fds = count_dir_entries("/proc/self/fd"),
+        .threads = (int) read_status_field("/proc/self/status", "Threads:"),
+        .rss_kb = read_status_field("/proc/self/status", "VmRSS:"),
+    };
+}
+
+static bool has_unreaped_children(void) {
+    siginfo_t info = { 0 };
+    int ret = waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT);
+    return ret == 0 && info.si_pid != 0;
+}
+
+static int count_live_children(void) {
+    DIR *dir = opendir("/proc");
+    if (dir == NULL) {
+        return -1;
+    }
+    int count = 0;
+    pid_t self = getpid();
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[288];
+        snprintf(path, sizeof(path), "/proc/%s/status", entry->d_name);
+        if (entry->d_name[0] >= '1' && entry->d_name[0] <= '9'
+            && read_status_field(path, "PPid:") == self) {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static long sum_children_pss_kb(void) {
+    DIR *dir = opendir("/proc");
+    if (dir == NULL) {
+        return -1;
+    }
+    long total = 0;
+    pid_t self = getpid();
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[288];
+        snprintf(path, sizeof(path), "/proc/%s/status", entry->d_name);
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9'
+            || read_status_field(path, "PPid:") != self) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/%s/smaps_rollup", entry->d_name);
+        long pss = read_status_field(path, "Pss:");
+        if (pss > 0) {
+            total += pss;
+        }
+    }
+    closedir(dir);
+    return total;
+}
+
+static int env_int(const char *name, int fallback) {
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    const char *val = getenv(name);
+    return val != NULL ? atoi(val) : fallback;
+}
+
+static GgError submit_tunnel(int exit_code, int delay_ms) {
+    char json[160];
+    snprintf(
+        json,
+        sizeof(json),
+        "{\"clientAccessToken\":\"%d:%d\",\"region\":\"us-west-2\","
+        "\"services\":[\"SSH\"]}",
+        exit_code,
+        delay_ms
+    );
+    uint8_t arena_mem[1024];
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    GgObject obj;
+    GgError ret = gg_json_decode_destructive(
+        gg_buffer_from_null_term(json), &arena, &obj
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+    return handle_tunnel_notification(gg_obj_into_map(obj), &soak_config);
+}
+
+static int random_exit_code(void) {
+    static const int CODES[] = { 0, 0, 0, 1, 2, 128 + SIGSEGV, 128 + SIGTERM };
+    size_t index = (size_t) rand_r(&soak_seed) % (sizeof(CODES) / sizeof(int));
+    return CODES[index];
+}
+
+// Waits for all workers to finish and their threads and children to go away
+static void wait_for_idle(const ResourceBaseline *baseline) {
+    for (int waited = 0; waited < SETTLE_TIMEOUT_MS; waited += 10) {
+        bool idle;
+        {
+            GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+            idle = active_tunnels == 0;
+        }
+        if (idle && sample_resources().threads == baseline->threads
+            && count_live_children() == 0) {
+            return;
+        }
+        usleep(10000);
+    }
+}
+
+static void assert_at_baseline(
+    const ResourceBaseline *baseline, int phase, long rss_slack_kb
+) {
+    ResourceBaseline now = sample_resources();
+    char msg[160];
+    snprintf(
+        msg,
+        sizeof(msg),
+        "phase %d: fds %d/%d threads %d/%d rss %ld/%ld KB",
+        phase,
+        now.fds,
+        baseline->fds,
+        now.threads,
+        baseline->threads,
+        now.rss_kb,
+        baseline->rss_kb
+    );
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL_INT(0, active_tunnels);
+    TEST_ASSERT_EQUAL_UINT32(0, tunnel_slots_mask);
+    TEST_ASSERT_EQUAL_INT(baseline->fds, now.fds);
+    TEST_ASSERT_EQUAL_INT(baseline->threads, now.threads);
+    TEST_ASSERT_FALSE(has_unreaped_children());
+    TEST_ASSERT_LESS_OR_EQUAL(baseline->rss_kb + rss_slack_kb, now.rss_kb);
+}
+
+static void run_phase(int cycles, int *rejected) {
+    for (int i = 0; i < cycles; i++) {
+        int exit_code = random_exit_code();
+        int delay_ms = rand_r(&soak_seed) % (MAX_STUB_DELAY_MS + 1);
+        GgError ret;
+        while ((ret = submit_tunnel(exit_code, delay_ms)) == GG_ERR_NOMEM) {
+            (*rejected)++;
+            usleep(500);
+        }
+        TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+    }
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_soak_tunnel_cycles(void) {
+    int total = env_int("SOAK_CYCLES", DEFAULT_CYCLES);
+    long rss_slack_kb = env_int("SOAK_RSS_SLACK_KB", DEFAULT_RSS_SLACK_KB);
+    int rejected = 0;
+
+    ResourceBaseline baseline = sample_resources();
+    int phase = 0;
+    for (int done = 0; done < total; done += CYCLES_PER_PHASE) {
+        int cycles = total - done < CYCLES_PER_PHASE ? total - done
+                                                     : CYCLES_PER_PHASE;
+        run_phase(cycles, &rejected);
+        wait_for_idle(&baseline);
+
+        // Allocator arenas and thread stacks settle during the first phase
+        if (phase == 0) {
+            baseline.rss_kb = sample_resources().rss_kb;
+        }
+        assert_at_baseline(&baseline, phase, rss_slack_kb);
+        phase++;
+    }
+
+    char msg[96];
+    snprintf(
+        msg, sizeof(msg), "%d cycles, %d admissions deferred", total, rejected
+    );
+    TEST_MESSAGE(msg);
+}
+
+void test_per_tunnel_footprint(void) {
+    ResourceBaseline baseline = sample_resources();
+    long self_pss_before = read_status_field("/proc/self/smaps_rollup", "Pss:");
+
+    for (int i = 0; i < TUNNEL_MAX_SLOTS; i++) {
+        TEST_ASSERT_EQUAL(GG_ERR_OK, submit_tunnel(0, FOOTPRINT_HOLD_MS));
+    }
+    for (int waited = 0; waited < SETTLE_TIMEOUT_MS; waited += 10) {
+        if (count_live_children() == TUNNEL_MAX_SLOTS) {
+            break;
+        }
+        usleep(10000);
+    }
+    TEST_ASSERT_EQUAL_INT(TUNNEL_MAX_SLOTS, count_live_children());
+
+    long self_pss = read_status_field("/proc/self/smaps_rollup", "Pss:");
+    long children_pss = sum_children_pss_kb();
+    long per_tunnel
+        = (self_pss - self_pss_before + children_pss) / TUNNEL_MAX_SLOTS;
+
+    char msg[128];
+    snprintf(
+        msg,
+        sizeof(msg),
+        "per-tunnel PSS: %ld KB (component %ld KB, stub localproxy %ld KB)",
+        per_tunnel,
+        (self_pss - self_pss_before) / TUNNEL_MAX_SLOTS,
+        children_pss / TUNNEL_MAX_SLOTS
+    );
+    TEST_MESSAGE(msg);
+
+    wait_for_idle(&baseline);
+    assert_at_baseline(&baseline, -1, DEFAULT_RSS_SLACK_KB);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 0 && strcmp(basename(argv[0]), "localproxy") == 0) {
+        return stub_localproxy_main();
+    }
+
+    soak_seed = (unsigned int) env_int("SOAK_SEED", 1);
+
+    char self[512];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len <= 0) {
+        return 1;
+    }
+    self[len] = '\0';
+
+    mkdir(TEST_DIR, 0755);
+    unlink(TEST_DIR "/localproxy");
+    if (symlink(self, TEST_DIR "/localproxy") != 0) {
+        return 1;
+    }
+
+    // The tunnel monitor lives as long as the process, so it belongs in the
+    // baselines
+    pthread_once(&timeout_monitor_once, start_timeout_monitor);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_per_tunnel_footprint);
+    RUN_TEST(test_soak_tunnel_cycles);
+    int failures = UNITY_END();
+
+    test_remove_directory(TEST_DIR);
+    return failures;
+}
@@ -8,10 +8,45 @@
 #ifndef TEST_HELPERS_H
 #define TEST_HELPERS_H
 
+#include "secure-tunnel.h"
 #include <gg/buffer.h>
+#include <gg/error.h>
 #include <unity.h>
+#include <stdint.h>
 
 void assert_gg_buffer_equal(GgBuffer expected, GgBuffer actual);
 void test_remove_directory(const char *path);
 
+// Tunnel fixture, for tests that build tunnel.c (see tunnel_fixture.c)
+
+// Component arguments for tests that launch tunnels with the localproxy in
+// artifact_dir
+#define TEST_TUNNEL_CONFIG(artifact_dir) \
+    { \
+        .thing_name = GG_STR("test-thing"), \
+        .region = GG_STR("us-west-2"), \
+        .artifact_path = GG_STR(artifact_dir), \
+        .max_concurrent_tunnels = 20, \
+        .tunnel_timeout_seconds = 300, \
+    }
+
+// Writes an executable localproxy stub into dir that runs script
+void test_install_stub_localproxy(const char *dir, const char *script);
+
+// Delivers a notification opening a tunnel for service to config's thing
+GgError test_notify_tunnel(
+    const SecureTunnelConfig *config, const char *token, const char *service
+);
+
+// Tunnels admitted and not yet closed, whether starting or running
+int test_active_tunnels(void);
+
+// Waits up to timeout_ms until exactly active tunnels are open. Returns how
+// long that took, or -1 on timeout.
+int64_t test_wait_for_active(int active, int64_t timeout_ms);
+
+// Waits for tunnels left by a previous test to close, then applies the
+// settings derived from config's arguments
+void test_reset_tunnels(const SecureTunnelConfig *config);
+
 #endif // TEST_HELPERS_H
@@ -0,0 +1,80 @@
+/*
+ * Tunnel fixture shared by tests that build tunnel.c
+ *
+ * Kept apart from test_helpers.c so tests without tunnel.c do not link it.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+#include "tunnel.h"
+#include "tunnel_clock.h"
+#include <gg/arena.h>
+#include <gg/json_decode.h>
+#include <gg/object.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#define RESET_TIMEOUT_MS 5000
+
+void test_install_stub_localproxy(const char *dir, const char *script) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/localproxy", dir);
+    mkdir(dir, 0755);
+    unlink(path);
+    FILE *f = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "#!/bin/sh\n%s\n", script);
+    fclose(f);
+    chmod(path, 0755);
+}
+
+GgError test_notify_tunnel(
+    const SecureTunnelConfig *config, const char *token, const char *service
+) {
+    char json[160];
+    snprintf(
+        json,
+        sizeof(json),
+        "{\"clientAccessToken\":\"%s\",\"region\":\"us-west-2\","
+        "\"services\":[\"%s\"]}",
+        token,
+        service
+    );
+    uint8_t arena_mem[1024];
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    GgObject obj;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        gg_json_decode_destructive(gg_buffer_from_null_term(json), &arena, &obj)
+    );
+    return handle_tunnel_notification(gg_obj_into_map(obj), config);
+}
+
+int test_active_tunnels(void) {
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    return (int) tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+}
+
+int64_t test_wait_for_active(int active, int64_t timeout_ms) {
+    int64_t start = tunnel_clock_system_ms();
+    while (test_active_tunnels() != active) {
+        if (tunnel_clock_system_ms() - start > timeout_ms) {
+            return -1;
+        }
+        usleep(10000);
+    }
+    return tunnel_clock_system_ms() - start;
+}
+
+void test_reset_tunnels(const SecureTunnelConfig *config) {
+    TEST_ASSERT_TRUE_MESSAGE(
+        test_wait_for_active(0, RESET_TIMEOUT_MS) != -1,
+        "Tunnels from a previous test are still open"
+    );
+    TunnelSettings settings;
+    tunnel_settings_from_args(config, &settings);
+    tunnel_apply_settings(&settings);
+}
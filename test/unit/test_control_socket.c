@@ -0,0 +1,264 @@
+/*
+ * Unit test for the local control socket
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "control_socket.h"
+#include "startup.h"
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <gg/arena.h>
+#include <gg/json_decode.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_SOCKET "/tmp/gg-test-control.sock"
+
+void test_list_empty(void);
+void test_list_shows_tunnel(void);
+void test_metrics_shows_connections(void);
+void test_startup_lists_phases(void);
+void test_close_unknown_slot(void);
+void test_close_signals_localproxy(void);
+void test_drain_rejects_new_tunnels(void);
+void test_invalid_commands(void);
+void test_socket_round_trip(void);
+
+static char out[4096];
+
+static SecureTunnelConfig test_config = {
+    .thing_name = GG_STR("test-thing"),
+    .region = GG_STR("us-west-2"),
+    .artifact_path = GG_STR("/nonexistent"),
+    .max_concurrent_tunnels = 20,
+    .tunnel_timeout_seconds = 300,
+};
+
+static const char *run(const char *command) {
+    size_t len = control_handle_command(
+        gg_buffer_from_null_term((char *) command), out, sizeof(out)
+    );
+    out[len] = '\0';
+    return out;
+}
+
+// Occupies a slot the way admission and the worker would
+static void occupy_slot(int slot, const char *service, pid_t pid, int pidfd) {
+    pthread_mutex_lock(&tunnel_mutex);
+    tunnel_contexts[slot] = (TunnelCreationContext) {
+        .timeout_seconds = 300,
+        .started_ms = monotonic_ms(),
+        .active_ms = monotonic_ms(),
+        .pid = pid,
+        .pidfd = pidfd,
+    };
+    strcpy(tunnel_contexts[slot].service, service);
+    strcpy(tunnel_contexts[slot].thing_name, "test-thing");
+    tunnel_slots_mask |= 1U << slot;
+    active_tunnels++;
+    publish_slot(slot);
+    pthread_mutex_unlock(&tunnel_mutex);
+}
+
+void setUp(void) {
+    pthread_mutex_lock(&tunnel_mutex);
+    active_tunnels = 0;
+    tunnel_slots_mask = 0;
+    tunnel_config = NULL;
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        publish_slot(slot);
+    }
+    pthread_mutex_unlock(&tunnel_mutex);
+    tunnel_set_draining(false);
+}
+
+void tearDown(void) {
+}
+
+void test_list_empty(void) {
+    TEST_ASSERT_EQUAL_STRING("OK\n", run("LIST"));
+}
+
+void test_list_shows_tunnel(void) {
+    occupy_slot(3, "SSH", 1234, -1);
+    TEST_ASSERT_EQUAL_STRING(
+        "3 SSH 1234 0 300 0 0 0 test-thing\nOK\n", run("LIST\n")
+    );
+    TEST_ASSERT_EQUAL_STRING(
+        "active 1\ndraining off\nlog_dropped 0\nlog_suppressed 0\nOK\n",
+        run("STATUS")
+    );
+}
+
+void test_metrics_shows_connections(void) {
+    occupy_slot(3, "SSH", 1234, -1);
+    TEST_ASSERT_EQUAL_STRING("OK\n", run("METRICS"));
+
+    pthread_mutex_lock(&tunnel_mutex);
+    tunnel_contexts[3].net.cloud = (TcpPathMetrics) {
+        .connections = 1,
+        .rtt_us = 42000,
+        .rttvar_us = 3000,
+        .retransmits = 2,
+        .cwnd = 10,
+        .bytes_in_flight = 2896,
+    };
+    publish_slot(3);
+    pthread_mutex_unlock(&tunnel_mutex);
+    TEST_ASSERT_EQUAL_STRING(
+        "3 cloud 1 42000 3000 2 10 2896\nOK\n", run("METRICS")
+    );
+}
+
+void test_startup_lists_phases(void) {
+    TEST_ASSERT_EQUAL_STRING("OK\n", run("STARTUP"));
+
+    // Phases are listed in startup order, whenever they were marked
+    startup_mark(STARTUP_READY);
+    startup_mark(STARTUP_MAIN);
+    long long main_ms = -1;
+    long long ready_ms = -1;
+    int matched = sscanf(
+        run("STARTUP"), "main %lld\nready %lld\n", &main_ms, &ready_ms
+    );
+    TEST_ASSERT_EQUAL_INT(2, matched);
+    TEST_ASSERT_TRUE(ready_ms >= 0 && main_ms >= ready_ms);
+    TEST_ASSERT_EQUAL_STRING("OK\n", &out[strlen(out) - 3]);
+}
+
+void test_close_unknown_slot(void) {
+    TEST_ASSERT_EQUAL_STRING("ERR no tunnel in slot\n", run("CLOSE 2"));
+    TEST_ASSERT_EQUAL_STRING("ERR invalid slot\n", run("CLOSE 20"));
+    TEST_ASSERT_EQUAL_STRING("ERR invalid slot\n", run("CLOSE x"));
+
+    occupy_slot(2, "SSH", 0, -1);
+    TEST_ASSERT_EQUAL_STRING("ERR tunnel still starting\n", run("CLOSE 2"));
+}
+
+void test_close_signals_localproxy(void) {
+    pid_t pid = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    if (pid == 0) {
+        pause();
+        _exit(0);
+    }
+    int pidfd = (int) syscall(SYS_pidfd_open, pid, 0);
+    occupy_slot(0, "SSH", pid, pidfd);
+
+    TEST_ASSERT_EQUAL_STRING("OK\n", run("CLOSE 0"));
+
+    int status = 0;
+    TEST_ASSERT_EQUAL(pid, waitpid(pid, &status, 0));
+    TEST_ASSERT_TRUE(WIFSIGNALED(status));
+    TEST_ASSERT_EQUAL_INT(SIGTERM, WTERMSIG(status));
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+}
+
+void test_drain_rejects_new_tunnels(void) {
+    TEST_ASSERT_EQUAL_STRING("OK\n", run("DRAIN ON"));
+    TEST_ASSERT_TRUE(tunnel_is_draining());
+    TEST_ASSERT_EQUAL_STRING(
+        "active 0\ndraining on\nlog_dropped 0\nlog_suppressed 0\nOK\n",
+        run("STATUS")
+    );
+
+    char json[] = "{\"clientAccessToken\":\"test-token\","
+                  "\"region\":\"us-west-2\",\"services\":[\"SSH\"]}";
+    uint8_t arena_mem[1024];
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    GgObject obj;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        gg_json_decode_destructive(gg_buffer_from_null_term(json), &arena, &obj)
+    );
+    TEST_ASSERT_EQUAL(
+        GG_ERR_BUSY,
+        handle_tunnel_notification(gg_obj_into_map(obj), &test_config)
+    );
+    TEST_ASSERT_EQUAL_UINT32(0, tunnel_slots_mask);
+
+    // So are launches the launch limiter held back before drain mode
+    TunnelCreationContext held = {
+        .service = "SSH",
+        .thing_name = "test-thing",
+        .pidfd = -1,
+        .exit_status = -1,
+        .host_reservation = -1,
+    };
+    TEST_ASSERT_EQUAL(GG_ERR_BUSY, tunnel_launch(&held, &test_config));
+    TEST_ASSERT_EQUAL_UINT32(0, tunnel_slots_mask);
+
+    TEST_ASSERT_EQUAL_STRING("OK\n", run("DRAIN OFF"));
+    TEST_ASSERT_FALSE(tunnel_is_draining());
+}
+
+void test_invalid_commands(void) {
+    TEST_ASSERT_EQUAL_STRING("ERR empty command\n", run(""));
+    TEST_ASSERT_EQUAL_STRING("ERR unknown command\n", run("REBOOT"));
+    TEST_ASSERT_EQUAL_STRING("ERR unknown command\n", run("CLOSE"));
+    TEST_ASSERT_EQUAL_STRING("ERR too many arguments\n", run("CLOSE 1 2"));
+    TEST_ASSERT_EQUAL_STRING("ERR expected ON or OFF\n", run("DRAIN maybe"));
+}
+
+void test_socket_round_trip(void) {
+    mode_t old_umask = umask(0);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, control_socket_start(TEST_SOCKET));
+    umask(old_umask);
+    struct stat st;
+    TEST_ASSERT_EQUAL(0, stat(TEST_SOCKET, &st));
+    TEST_ASSERT_EQUAL_UINT32(0600, st.st_mode & 0777);
+    occupy_slot(1, "VNC", 42, -1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strcpy(addr.sun_path, TEST_SOCKET);
+    TEST_ASSERT_EQUAL(
+        0, connect(fd, (struct sockaddr *) &addr, sizeof(addr))
+    );
+
+    const char request[] = "LIST\nSTATUS\n";
+    TEST_ASSERT_EQUAL(
+        (ssize_t) strlen(request), write(fd, request, strlen(request))
+    );
+    shutdown(fd, SHUT_WR);
+
+    char buf[256];
+    size_t len = 0;
+    ssize_t got;
+    while ((got = read(fd, &buf[len], sizeof(buf) - 1 - len)) > 0) {
+        len += (size_t) got;
+    }
+    buf[len] = '\0';
+    close(fd);
+    unlink(TEST_SOCKET);
+
+    TEST_ASSERT_EQUAL_STRING(
+        "1 VNC 42 0 300 0 0 0 test-thing\nOK\nactive 1\ndraining off\n"
+        "log_dropped 0\nlog_suppressed 0\nOK\n",
+        buf
+    );
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_list_empty);
+    RUN_TEST(test_list_shows_tunnel);
+    RUN_TEST(test_metrics_shows_connections);
+    RUN_TEST(test_startup_lists_phases);
+    RUN_TEST(test_close_unknown_slot);
+    RUN_TEST(test_close_signals_localproxy);
+    RUN_TEST(test_drain_rejects_new_tunnels);
+    RUN_TEST(test_invalid_commands);
+    RUN_TEST(test_socket_round_trip);
+    return UNITY_END();
+}
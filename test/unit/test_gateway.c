@@ -0,0 +1,163 @@
+/*
+ * Unit test for gateway routing and per-thing quotas
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <gg/arena.h>
+#include <gg/json_decode.h>
+#include <string.h>
+#include <unity.h>
+#include <stdio.h>
+
+void test_thing_from_topic(void);
+void test_own_thing_uses_localhost(void);
+void test_gateway_thing_uses_destination(void);
+void test_unknown_thing_rejected(void);
+void test_per_thing_quota(void);
+
+static const SecureTunnelConfig CONFIG = {
+    .thing_name = GG_STR("gateway"),
+    .region = GG_STR("us-west-2"),
+    .artifact_path = GG_STR("/nonexistent"),
+    .max_concurrent_tunnels = 20,
+    .tunnel_timeout_seconds = 300,
+};
+
+static char json_buf[512];
+static uint8_t arena_mem[2048];
+
+static GgMap decode(const char *json) {
+    snprintf(json_buf, sizeof(json_buf), "%s", json);
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    GgObject obj;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        gg_json_decode_destructive(
+            gg_buffer_from_null_term(json_buf), &arena, &obj
+        )
+    );
+    return gg_obj_into_map(obj);
+}
+
+static GgError notify(const char *thing, const char *service) {
+    char json[160];
+    snprintf(
+        json,
+        sizeof(json),
+        "{\"clientAccessToken\":\"token\",\"region\":\"us-west-2\","
+        "\"services\":[\"%s\"]}",
+        service
+    );
+    return handle_tunnel_notification_for_thing(
+        decode(json), gg_buffer_from_null_term((char *) thing), &CONFIG
+    );
+}
+
+static void apply_gateway_settings(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&CONFIG, &settings);
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        tunnel_settings_update(
+            decode(
+                "{\"maxTunnelsPerThing\":1,\"gatewayDestinations\":{"
+                "\"cam-1\":{\"host\":\"10.0.0.5\"},"
+                "\"cam-2\":{\"host\":\"10.0.0.6\","
+                "\"serviceMappings\":{\"SSH\":2222}}}}"
+            ),
+            &settings
+        )
+    );
+    tunnel_apply_settings(&settings);
+}
+
+void setUp(void) {
+    test_reset_tunnels(&CONFIG);
+    apply_gateway_settings();
+}
+
+void tearDown(void) {
+    (void) test_wait_for_active(0, 1000);
+}
+
+void test_thing_from_topic(void) {
+    GgBuffer thing;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        parse_thing_from_topic(
+            GG_STR("$aws/things/cam-1/tunnels/notify"), &thing
+        )
+    );
+    TEST_ASSERT_TRUE(gg_buffer_eq(GG_STR("cam-1"), thing));
+
+    TEST_ASSERT_NOT_EQUAL(
+        GG_ERR_OK,
+        parse_thing_from_topic(GG_STR("$aws/things//tunnels/notify"), &thing)
+    );
+    TEST_ASSERT_NOT_EQUAL(
+        GG_ERR_OK,
+        parse_thing_from_topic(GG_STR("$aws/things/a/b/tunnels/notify"), &thing)
+    );
+    TEST_ASSERT_NOT_EQUAL(
+        GG_ERR_OK,
+        parse_thing_from_topic(GG_STR("$aws/things/cam-1/shadow"), &thing)
+    );
+}
+
+void test_own_thing_uses_localhost(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("gateway", "SSH"));
+    TEST_ASSERT_EQUAL_STRING("localhost", tunnel_contexts[0].host);
+    TEST_ASSERT_EQUAL_UINT16(22, tunnel_contexts[0].port);
+    TEST_ASSERT_EQUAL_STRING("gateway", tunnel_contexts[0].thing_name);
+}
+
+void test_gateway_thing_uses_destination(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("cam-1", "VNC"));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.5", tunnel_contexts[0].host);
+    TEST_ASSERT_EQUAL_UINT16(5900, tunnel_contexts[0].port);
+    (void) test_wait_for_active(0, 1000);
+
+    // Per-thing service mappings replace the global ones
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("cam-2", "SSH"));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.6", tunnel_contexts[0].host);
+    TEST_ASSERT_EQUAL_UINT16(2222, tunnel_contexts[0].port);
+    (void) test_wait_for_active(0, 1000);
+    TEST_ASSERT_EQUAL(GG_ERR_INVALID, notify("cam-2", "VNC"));
+}
+
+void test_unknown_thing_rejected(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_NOENTRY, notify("cam-3", "SSH"));
+    TEST_ASSERT_EQUAL_UINT32(0, tunnel_slots_mask);
+}
+
+void test_per_thing_quota(void) {
+    // Hold a slot for cam-1 as a running tunnel would
+    pthread_mutex_lock(&tunnel_mutex);
+    strcpy(tunnel_contexts[5].thing_name, "cam-1");
+    tunnel_slots_mask |= 1U << 5;
+    active_tunnels++;
+    pthread_mutex_unlock(&tunnel_mutex);
+
+    TEST_ASSERT_EQUAL(GG_ERR_NOMEM, notify("cam-1", "SSH"));
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("cam-2", "SSH"));
+
+    pthread_mutex_lock(&tunnel_mutex);
+    tunnel_slots_mask &= ~(1U << 5);
+    active_tunnels--;
+    pthread_mutex_unlock(&tunnel_mutex);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_thing_from_topic);
+    RUN_TEST(test_own_thing_uses_localhost);
+    RUN_TEST(test_gateway_thing_uses_destination);
+    RUN_TEST(test_unknown_thing_rejected);
+    RUN_TEST(test_per_thing_quota);
+    return UNITY_END();
+}
@@ -0,0 +1,177 @@
+/*
+ * Unit test for the host-wide tunnel budget shared between instances
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unity.h>
+
+void test_reserve_up_to_max(void);
+void test_disabled_budget(void);
+void test_other_instance_counts(void);
+void test_launch_rejected_over_budget(void);
+void test_switch_file_keeps_reservations(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG("");
+
+static char budget_path[] = "/tmp/test_host_budget_XXXXXX";
+
+// Runs another instance holding count of max reservations until killed
+static pid_t hold_in_child(int max, int count) {
+    int ready[2];
+    TEST_ASSERT_EQUAL(0, pipe(ready));
+    pid_t pid = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    if (pid == 0) {
+        close(ready[0]);
+        int reservation;
+        if (host_budget_open(budget_path) != GG_ERR_OK) {
+            _exit(1);
+        }
+        for (int i = 0; i < count; i++) {
+            if (!host_budget_acquire(max, &reservation)) {
+                _exit(1);
+            }
+        }
+        (void) !write(ready[1], "x", 1);
+        pause();
+        _exit(0);
+    }
+    close(ready[1]);
+    char byte;
+    TEST_ASSERT_EQUAL(1, read(ready[0], &byte, 1));
+    close(ready[0]);
+    return pid;
+}
+
+static void kill_child(pid_t pid) {
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+}
+
+static GgError notify(void) {
+    return test_notify_tunnel(&config, "token", "SSH");
+}
+
+void setUp(void) {
+    test_reset_tunnels(&config);
+
+    strcpy(budget_path, "/tmp/test_host_budget_XXXXXX");
+    int fd = mkstemp(budget_path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    close(fd);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, host_budget_open(budget_path));
+}
+
+void tearDown(void) {
+    (void) test_wait_for_active(0, 5000);
+    unlink(budget_path);
+}
+
+void test_reserve_up_to_max(void) {
+    int first;
+    int second;
+    int third;
+    TEST_ASSERT_TRUE(host_budget_acquire(2, &first));
+    TEST_ASSERT_TRUE(host_budget_acquire(2, &second));
+    TEST_ASSERT_NOT_EQUAL(first, second);
+    TEST_ASSERT_FALSE(host_budget_acquire(2, &third));
+
+    host_budget_release(first);
+    TEST_ASSERT_TRUE(host_budget_acquire(2, &third));
+    TEST_ASSERT_EQUAL_INT(first, third);
+    host_budget_release(second);
+    host_budget_release(third);
+}
+
+void test_disabled_budget(void) {
+    int reservation = 0;
+    TEST_ASSERT_TRUE(host_budget_acquire(0, &reservation));
+    TEST_ASSERT_EQUAL_INT(-1, reservation);
+    host_budget_release(reservation);
+}
+
+// A killed instance's reservations return to the budget without cleanup
+void test_other_instance_counts(void) {
+    pid_t child = hold_in_child(3, 2);
+
+    int reservations[3];
+    TEST_ASSERT_TRUE(host_budget_acquire(3, &reservations[0]));
+    TEST_ASSERT_FALSE(host_budget_acquire(3, &reservations[1]));
+
+    kill_child(child);
+    TEST_ASSERT_TRUE(host_budget_acquire(3, &reservations[1]));
+    TEST_ASSERT_TRUE(host_budget_acquire(3, &reservations[2]));
+    for (int i = 0; i < 3; i++) {
+        host_budget_release(reservations[i]);
+    }
+}
+
+void test_launch_rejected_over_budget(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.host_max_tunnels = 1;
+    settings.destination_preflight = TUNNEL_PREFLIGHT_OFF;
+    tunnel_apply_settings(&settings);
+
+    pid_t child = hold_in_child(1, 1);
+    TEST_ASSERT_EQUAL(GG_ERR_NOMEM, notify());
+    TEST_ASSERT_EQUAL_UINT32(0, tunnel_slots_mask);
+    kill_child(child);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    (void) test_wait_for_active(0, 5000);
+
+    // The exited tunnel gave its reservation back
+    int reservation;
+    TEST_ASSERT_TRUE(host_budget_acquire(1, &reservation));
+    host_budget_release(reservation);
+}
+
+// A changed hostBudgetFile still counts the tunnels already running
+void test_switch_file_keeps_reservations(void) {
+    int first;
+    TEST_ASSERT_TRUE(host_budget_acquire(2, &first));
+
+    unlink(budget_path);
+    strcpy(budget_path, "/tmp/test_host_budget_XXXXXX");
+    int fd = mkstemp(budget_path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    close(fd);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, host_budget_open(budget_path));
+
+    // The other instance only finds the slot first does not hold
+    pid_t child = hold_in_child(2, 1);
+    int second;
+    TEST_ASSERT_FALSE(host_budget_acquire(2, &second));
+    host_budget_release(first);
+    TEST_ASSERT_TRUE(host_budget_acquire(2, &second));
+    TEST_ASSERT_EQUAL_INT(first, second);
+    kill_child(child);
+
+    // Closing the file leaves reservations for their tunnels to release
+    host_budget_close();
+    host_budget_release(second);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, host_budget_open(budget_path));
+    TEST_ASSERT_TRUE(host_budget_acquire(1, &first));
+    host_budget_release(first);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_reserve_up_to_max);
+    RUN_TEST(test_disabled_budget);
+    RUN_TEST(test_other_instance_counts);
+    RUN_TEST(test_launch_rejected_over_budget);
+    RUN_TEST(test_switch_file_keeps_reservations);
+    return UNITY_END();
+}
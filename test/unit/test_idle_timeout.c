@@ -0,0 +1,92 @@
+/*
+ * Unit test for idle tunnel detection and traffic accounting
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to test its static helpers
+#include "tunnel.c"
+#include <unistd.h>
+#include <unity.h>
+
+#define TEST_DIR "/tmp/gg-test-idle-timeout"
+
+void test_read_process_io(void);
+void test_idle_tunnel_closed(void);
+void test_idle_timeout_disabled(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+static GgError notify(void) {
+    return test_notify_tunnel(&config, "token", "SSH");
+}
+
+static void apply_idle_timeout(int seconds) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.idle_timeout_seconds = seconds;
+    tunnel_apply_settings(&settings);
+}
+
+void setUp(void) {
+    test_reset_tunnels(&config);
+}
+
+void tearDown(void) {
+    (void) test_wait_for_active(0, 10000);
+    test_remove_directory(TEST_DIR);
+}
+
+void test_read_process_io(void) {
+    uint64_t read_before = 0;
+    uint64_t written_before = 0;
+    TEST_ASSERT_TRUE(read_process_io(getpid(), &read_before, &written_before));
+
+    char buf[8192];
+    int fd = open("/dev/zero", O_RDONLY);
+    TEST_ASSERT_EQUAL((ssize_t) sizeof(buf), read(fd, buf, sizeof(buf)));
+    close(fd);
+
+    uint64_t read_after = 0;
+    uint64_t written_after = 0;
+    TEST_ASSERT_TRUE(read_process_io(getpid(), &read_after, &written_after));
+    TEST_ASSERT_GREATER_OR_EQUAL(read_before + sizeof(buf), read_after);
+
+    TEST_ASSERT_FALSE(read_process_io(0, &read_after, &written_after));
+}
+
+void test_idle_tunnel_closed(void) {
+    test_install_stub_localproxy(TEST_DIR, "exec sleep 30");
+    apply_idle_timeout(2);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+
+    // Sampled every second; loading the stub counts as I/O
+    usleep(1500000);
+    TunnelInfo info;
+    TEST_ASSERT_EQUAL_size_t(1, tunnel_list(&info, 1));
+    TEST_ASSERT_GREATER_THAN(0, info.read_bytes);
+
+    int64_t closed_after = test_wait_for_active(0, 5000);
+    TEST_ASSERT_NOT_EQUAL(-1, closed_after);
+    TEST_ASSERT_EQUAL_size_t(0, tunnel_list(&info, 1));
+}
+
+void test_idle_timeout_disabled(void) {
+    test_install_stub_localproxy(TEST_DIR, "exec sleep 3");
+    apply_idle_timeout(0);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+
+    usleep(2500000);
+    TEST_ASSERT_EQUAL_INT(1, test_active_tunnels());
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 5000));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_read_process_io);
+    RUN_TEST(test_idle_tunnel_closed);
+    RUN_TEST(test_idle_timeout_disabled);
+    return UNITY_END();
+}
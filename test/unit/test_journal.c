@@ -0,0 +1,249 @@
+/*
+ * Unit test for the tunnel event journal
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "journal.h"
+#include "journal_format.h"
+#include "test_helpers.h"
+#include "tunnel_events.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_DIR "/tmp/gg-test-journal"
+#define TEST_JOURNAL TEST_DIR "/tunnels.journal"
+
+void test_events_are_recorded(void);
+void test_append_resumes_after_reopen(void);
+void test_corrupt_record_is_overwritten(void);
+void test_full_journal_rotates(void);
+void test_flusher_rotates_full_journal(void);
+void test_rejects_foreign_file(void);
+void test_long_thing_name_recorded(void);
+void test_older_version_replaced(void);
+
+static JournalRecord read_record(const char *path, uint32_t index) {
+    JournalRecord record = { 0 };
+    int fd = open(path, O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    off_t offset = (off_t) (sizeof(JournalHeader) + index * sizeof(record));
+    TEST_ASSERT_EQUAL(
+        (ssize_t) sizeof(record), pread(fd, &record, sizeof(record), offset)
+    );
+    close(fd);
+    return record;
+}
+
+static void emit_open(const char *service) {
+    tunnel_event_emit(&(TunnelEvent) {
+        .type = TUNNEL_EVENT_OPEN,
+        .slot = 0,
+        .service = service,
+        .thing_name = "test-thing",
+        .port = 22,
+        .exit_status = -1,
+    });
+}
+
+void setUp(void) {
+    test_remove_directory(TEST_DIR);
+    mkdir(TEST_DIR, 0755);
+}
+
+void tearDown(void) {
+    journal_close();
+    test_remove_directory(TEST_DIR);
+}
+
+void test_events_are_recorded(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 16));
+
+    emit_open("SSH");
+    tunnel_event_emit(&(TunnelEvent) {
+        .type = TUNNEL_EVENT_REJECT,
+        .reason = TUNNEL_REJECT_CAPACITY,
+        .slot = -1,
+        .service = "VNC",
+        .thing_name = "test-thing",
+        .exit_status = -1,
+    });
+    tunnel_event_emit(&(TunnelEvent) {
+        .type = TUNNEL_EVENT_EXIT,
+        .slot = 0,
+        .service = "SSH",
+        .thing_name = "test-thing",
+        .port = 22,
+        .exit_status = 0,
+        .lifetime_ms = 65000,
+    });
+    journal_flush();
+
+    JournalRecord open_record = read_record(TEST_JOURNAL, 0);
+    TEST_ASSERT_EQUAL_UINT32(1, open_record.seq);
+    TEST_ASSERT_EQUAL_UINT16(TUNNEL_EVENT_OPEN, open_record.type);
+    TEST_ASSERT_EQUAL_STRING("SSH", open_record.service);
+    TEST_ASSERT_EQUAL_STRING("test-thing", open_record.thing_name);
+    TEST_ASSERT_NOT_EQUAL(0, open_record.wall_ms);
+    TEST_ASSERT_EQUAL_UINT32(
+        journal_record_checksum(&open_record), open_record.checksum
+    );
+
+    JournalRecord reject = read_record(TEST_JOURNAL, 1);
+    TEST_ASSERT_EQUAL_UINT16(TUNNEL_EVENT_REJECT, reject.type);
+    TEST_ASSERT_EQUAL_UINT16(TUNNEL_REJECT_CAPACITY, reject.reason);
+    TEST_ASSERT_EQUAL_UINT8(UINT8_MAX, reject.slot);
+
+    JournalRecord exit_record = read_record(TEST_JOURNAL, 2);
+    TEST_ASSERT_EQUAL_UINT16(TUNNEL_EVENT_EXIT, exit_record.type);
+    TEST_ASSERT_EQUAL_INT(0, exit_record.exit_status);
+    TEST_ASSERT_EQUAL_UINT32(65, exit_record.lifetime_s);
+
+    TEST_ASSERT_EQUAL_UINT32(0, read_record(TEST_JOURNAL, 3).seq);
+}
+
+void test_append_resumes_after_reopen(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 16));
+    emit_open("SSH");
+    emit_open("SSH");
+    journal_close();
+
+    // Capacity of an existing journal is kept
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 4));
+    emit_open("VNC");
+    journal_close();
+
+    JournalRecord record = read_record(TEST_JOURNAL, 2);
+    TEST_ASSERT_EQUAL_UINT32(3, record.seq);
+    TEST_ASSERT_EQUAL_STRING("VNC", record.service);
+
+    struct stat st;
+    TEST_ASSERT_EQUAL(0, stat(TEST_JOURNAL, &st));
+    TEST_ASSERT_EQUAL(
+        (off_t) (sizeof(JournalHeader) + 16 * sizeof(JournalRecord)),
+        st.st_size
+    );
+}
+
+void test_corrupt_record_is_overwritten(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 16));
+    emit_open("SSH");
+    emit_open("SSH");
+    journal_close();
+
+    // Simulate a torn write of the second record
+    int fd = open(TEST_JOURNAL, O_WRONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    off_t offset = (off_t) (sizeof(JournalHeader) + sizeof(JournalRecord)
+                            + offsetof(JournalRecord, service));
+    TEST_ASSERT_EQUAL(1, pwrite(fd, "X", 1, offset));
+    close(fd);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 16));
+    emit_open("VNC");
+    journal_close();
+
+    JournalRecord record = read_record(TEST_JOURNAL, 1);
+    TEST_ASSERT_EQUAL_UINT32(2, record.seq);
+    TEST_ASSERT_EQUAL_STRING("VNC", record.service);
+    TEST_ASSERT_EQUAL_UINT32(journal_record_checksum(&record), record.checksum);
+}
+
+void test_full_journal_rotates(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 4));
+    for (int i = 0; i < 5; i++) {
+        emit_open("SSH");
+    }
+    journal_close();
+
+    TEST_ASSERT_EQUAL_UINT32(4, read_record(TEST_JOURNAL ".1", 3).seq);
+    TEST_ASSERT_EQUAL_UINT32(5, read_record(TEST_JOURNAL, 0).seq);
+    TEST_ASSERT_EQUAL_UINT32(0, read_record(TEST_JOURNAL, 1).seq);
+}
+
+void test_flusher_rotates_full_journal(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 4));
+    for (int i = 0; i < 6; i++) {
+        emit_open("SSH");
+    }
+    // Rotated in the background, without a flush or close
+    for (int waited = 0; waited < 2000 && access(TEST_JOURNAL ".1", F_OK) != 0;
+         waited += 10) {
+        usleep(10000);
+    }
+    TEST_ASSERT_EQUAL(0, access(TEST_JOURNAL ".1", F_OK));
+    journal_flush();
+
+    TEST_ASSERT_EQUAL_UINT32(4, read_record(TEST_JOURNAL ".1", 3).seq);
+    TEST_ASSERT_EQUAL_UINT32(5, read_record(TEST_JOURNAL, 0).seq);
+    TEST_ASSERT_EQUAL_UINT32(6, read_record(TEST_JOURNAL, 1).seq);
+}
+
+void test_rejects_foreign_file(void) {
+    FILE *f = fopen(TEST_JOURNAL, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "not a journal");
+    fclose(f);
+
+    // An unrecognized file is replaced rather than appended to
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 4));
+    emit_open("SSH");
+    journal_close();
+    TEST_ASSERT_EQUAL_UINT32(1, read_record(TEST_JOURNAL, 0).seq);
+}
+
+void test_long_thing_name_recorded(void) {
+    char thing[128];
+    memset(thing, 't', sizeof(thing) - 1);
+    thing[sizeof(thing) - 1] = '\0';
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 4));
+    tunnel_event_emit(&(TunnelEvent) {
+        .type = TUNNEL_EVENT_OPEN,
+        .slot = 0,
+        .service = "SSH",
+        .thing_name = thing,
+        .exit_status = -1,
+    });
+    journal_flush();
+    TEST_ASSERT_EQUAL_STRING(thing, read_record(TEST_JOURNAL, 0).thing_name);
+}
+
+void test_older_version_replaced(void) {
+    JournalHeader header = { .version = 1, .record_size = 128, .capacity = 4 };
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    int fd = open(TEST_JOURNAL, O_WRONLY | O_CREAT, 0600);
+    TEST_ASSERT_EQUAL(
+        (ssize_t) sizeof(header), write(fd, &header, sizeof(header))
+    );
+    TEST_ASSERT_EQUAL(0, ftruncate(fd, (off_t) (sizeof(header) + 4 * 128)));
+    close(fd);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, journal_open(TEST_JOURNAL, 4));
+    journal_close();
+    fd = open(TEST_JOURNAL, O_RDONLY);
+    TEST_ASSERT_EQUAL(
+        (ssize_t) sizeof(header), read(fd, &header, sizeof(header))
+    );
+    close(fd);
+    TEST_ASSERT_EQUAL_UINT32(JOURNAL_VERSION, header.version);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(JournalRecord), header.record_size);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_events_are_recorded);
+    RUN_TEST(test_append_resumes_after_reopen);
+    RUN_TEST(test_corrupt_record_is_overwritten);
+    RUN_TEST(test_full_journal_rotates);
+    RUN_TEST(test_flusher_rotates_full_journal);
+    RUN_TEST(test_rejects_foreign_file);
+    RUN_TEST(test_long_thing_name_recorded);
+    RUN_TEST(test_older_version_replaced);
+    return UNITY_END();
+}
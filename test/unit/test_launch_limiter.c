@@ -0,0 +1,158 @@
+/*
+ * Unit test for launch rate limiting and notification coalescing
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <unistd.h>
+#include <unity.h>
+
+#define TEST_DIR "/tmp/gg-test-launch-limiter"
+#define COALESCE_MS 200
+
+void test_unlimited_by_default(void);
+void test_bucket_allows_burst_then_limits(void);
+void test_rejected_launch_keeps_token(void);
+void test_refund_returns_token(void);
+void test_burst_coalesced_to_newest_token(void);
+void test_different_services_not_coalesced(void);
+void test_held_launch_waits_for_release(void);
+void test_hold_expires(void);
+void test_held_launches_not_coalesced(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+static GgError notify(const char *token, const char *service) {
+    return test_notify_tunnel(&config, token, service);
+}
+
+void setUp(void) {
+    test_reset_tunnels(&config);
+    launch_limiter_configure(0, 1, 0);
+    // Holds its slot briefly so launches can be counted
+    test_install_stub_localproxy(TEST_DIR, "sleep 1");
+}
+
+void tearDown(void) {
+    launch_limiter_release();
+    (void) test_wait_for_active(0, 3000);
+    launch_limiter_configure(0, 1, 0);
+    test_remove_directory(TEST_DIR);
+}
+
+void test_unlimited_by_default(void) {
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_TRUE(launch_limiter_peek());
+        TEST_ASSERT_TRUE(launch_limiter_acquire());
+    }
+}
+
+void test_bucket_allows_burst_then_limits(void) {
+    launch_limiter_configure(60, 2, 0); // One token per second, burst of 2
+
+    TEST_ASSERT_TRUE(launch_limiter_acquire());
+    TEST_ASSERT_TRUE(launch_limiter_peek());
+    TEST_ASSERT_TRUE(launch_limiter_acquire());
+    TEST_ASSERT_FALSE(launch_limiter_peek());
+    TEST_ASSERT_FALSE(launch_limiter_acquire());
+
+    usleep(1100000);
+    TEST_ASSERT_TRUE(launch_limiter_peek());
+    TEST_ASSERT_TRUE(launch_limiter_acquire());
+    TEST_ASSERT_FALSE(launch_limiter_acquire());
+}
+
+void test_rejected_launch_keeps_token(void) {
+    launch_limiter_configure(60, 1, 0);
+
+    // Unsupported service fails admission without spending the token
+    TEST_ASSERT_EQUAL(GG_ERR_INVALID, notify("t1", "FTP"));
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("t2", "SSH"));
+    TEST_ASSERT_EQUAL(GG_ERR_RETRY, notify("t3", "SSH"));
+    TEST_ASSERT_EQUAL_INT(1, test_active_tunnels());
+}
+
+void test_refund_returns_token(void) {
+    launch_limiter_configure(60, 1, 0);
+
+    TEST_ASSERT_TRUE(launch_limiter_acquire());
+    TEST_ASSERT_FALSE(launch_limiter_peek());
+    launch_limiter_refund();
+    TEST_ASSERT_TRUE(launch_limiter_acquire());
+    TEST_ASSERT_FALSE(launch_limiter_acquire());
+}
+
+void test_burst_coalesced_to_newest_token(void) {
+    launch_limiter_configure(0, 1, COALESCE_MS);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("first", "SSH"));
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("second", "SSH"));
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("newest", "SSH"));
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    usleep((COALESCE_MS + 200) * 1000);
+    TEST_ASSERT_EQUAL_INT(1, test_active_tunnels());
+    TEST_ASSERT_EQUAL_STRING("newest", tunnel_contexts[0].access_token);
+}
+
+void test_different_services_not_coalesced(void) {
+    launch_limiter_configure(0, 1, COALESCE_MS);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("ssh", "SSH"));
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("vnc", "VNC"));
+
+    usleep((COALESCE_MS + 200) * 1000);
+    TEST_ASSERT_EQUAL_INT(2, test_active_tunnels());
+}
+
+void test_held_launch_waits_for_release(void) {
+    launch_limiter_hold(5000);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("held", "SSH"));
+    usleep(COALESCE_MS * 1000);
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    launch_limiter_release();
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(1, 1000));
+    TEST_ASSERT_EQUAL_STRING("held", tunnel_contexts[0].access_token);
+}
+
+void test_hold_expires(void) {
+    launch_limiter_hold(COALESCE_MS);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("held", "SSH"));
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+    TEST_ASSERT_GREATER_OR_EQUAL(
+        COALESCE_MS / 2, test_wait_for_active(1, 2000)
+    );
+}
+
+void test_held_launches_not_coalesced(void) {
+    launch_limiter_hold(5000);
+
+    // Without a coalescing window each held notification is its own tunnel
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("first", "SSH"));
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("second", "SSH"));
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    launch_limiter_release();
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(2, 1000));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unlimited_by_default);
+    RUN_TEST(test_bucket_allows_burst_then_limits);
+    RUN_TEST(test_rejected_launch_keeps_token);
+    RUN_TEST(test_refund_returns_token);
+    RUN_TEST(test_burst_coalesced_to_newest_token);
+    RUN_TEST(test_different_services_not_coalesced);
+    RUN_TEST(test_held_launch_waits_for_release);
+    RUN_TEST(test_hold_expires);
+    RUN_TEST(test_held_launches_not_coalesced);
+    return UNITY_END();
+}
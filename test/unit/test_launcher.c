@@ -0,0 +1,380 @@
+/*
+ * Unit test for the localproxy launcher helper
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <dirent.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_DIR "/tmp/gg-test-launcher"
+#define PPID_FILE TEST_DIR "/ppid"
+#define NETNS_FILE TEST_DIR "/netns"
+#define LATENCY_FILE TEST_DIR "/latency"
+
+void test_spawn_child_of_component(void);
+void test_spawn_reports_exec_failure(void);
+void test_spawn_passes_control_socket(void);
+void test_tunnel_through_launcher(void);
+void test_fallback_after_launcher_exit(void);
+void test_tunnel_in_network_namespace(void);
+void test_fallback_in_network_namespace(void);
+void test_tunnel_in_latency_class(void);
+void test_fallback_in_latency_class(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+// Stub localproxy that records its parent, token, network namespace, nice
+// level, IO priority and CPU affinity, then exits with 3
+static void install_stub_localproxy(void) {
+    test_install_stub_localproxy(
+        TEST_DIR,
+        "echo $PPID $AWSIOT_TUNNEL_ACCESS_TOKEN > " PPID_FILE "\n"
+        "readlink /proc/self/ns/net > " NETNS_FILE "\n"
+        "echo $(nice) $(ionice -p $$ | tr -d ' ') "
+        "$(grep Cpus_allowed_list /proc/$$/status | cut -f2) > " LATENCY_FILE
+        "\n"
+        "exit 3"
+    );
+}
+
+static void assert_stub_ran(const char *token) {
+    FILE *f = fopen(PPID_FILE, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    int ppid = 0;
+    char seen_token[64] = { 0 };
+    TEST_ASSERT_EQUAL_INT(2, fscanf(f, "%d %63s", &ppid, seen_token));
+    fclose(f);
+    unlink(PPID_FILE);
+    TEST_ASSERT_EQUAL_INT(getpid(), ppid);
+    TEST_ASSERT_EQUAL_STRING(token, seen_token);
+}
+
+static GgError notify(void) {
+    return test_notify_tunnel(&config, "token", "SSH");
+}
+
+static void wait_for_close(void) {
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 5000));
+}
+
+// Returns the pid of this process's launcher child, or 0
+static pid_t find_launcher(void) {
+    DIR *dir = opendir("/proc");
+    TEST_ASSERT_NOT_NULL(dir);
+    pid_t found = 0;
+    struct dirent *entry;
+    while (found == 0 && (entry = readdir(dir)) != NULL) {
+        char path[288];
+        snprintf(path, sizeof(path), "/proc/%s/status", entry->d_name);
+        FILE *f = fopen(path, "r");
+        if (f == NULL) {
+            continue;
+        }
+        char line[128];
+        bool is_launcher = false;
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (strcmp(line, "Name:\tst-launcher\n") == 0) {
+                is_launcher = true;
+            } else if (is_launcher && strncmp(line, "PPid:", 5) == 0
+                       && atoi(&line[5]) == getpid()) {
+                found = (pid_t) atoi(entry->d_name);
+            }
+        }
+        fclose(f);
+    }
+    closedir(dir);
+    return found;
+}
+
+// Runs a process in a new network namespace until killed. Returns 0 when
+// namespaces cannot be created here.
+static pid_t start_netns_holder(void) {
+    int ready[2];
+    TEST_ASSERT_EQUAL(0, pipe(ready));
+    pid_t pid = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    if (pid == 0) {
+        close(ready[0]);
+        char ok = unshare(CLONE_NEWNET) == 0 ? 'y' : 'n';
+        (void) !write(ready[1], &ok, 1);
+        pause();
+        _exit(0);
+    }
+    close(ready[1]);
+    char ok = 'n';
+    TEST_ASSERT_EQUAL(1, read(ready[0], &ok, 1));
+    close(ready[0]);
+    if (ok != 'y') {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return 0;
+    }
+    return pid;
+}
+
+static void assert_tunnel_in_namespace(void) {
+    pid_t holder = start_netns_holder();
+    if (holder == 0) {
+        TEST_IGNORE_MESSAGE("Cannot create network namespaces");
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/ns/net", (int) holder);
+    char expected[64] = { 0 };
+    char own[64] = { 0 };
+    TEST_ASSERT_GREATER_THAN(0, readlink(path, expected, sizeof(expected) - 1));
+    TEST_ASSERT_GREATER_THAN(
+        0, readlink("/proc/self/ns/net", own, sizeof(own) - 1)
+    );
+    TEST_ASSERT_NOT_EQUAL(0, strcmp(expected, own));
+
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.namespace_count = 1;
+    strcpy(settings.namespaces[0].service, "SSH");
+    strcpy(settings.namespaces[0].path, path);
+    tunnel_apply_settings(&settings);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    wait_for_close();
+    kill(holder, SIGKILL);
+    waitpid(holder, NULL, 0);
+    assert_stub_ran("token");
+
+    FILE *f = fopen(NETNS_FILE, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    char seen[64] = { 0 };
+    TEST_ASSERT_EQUAL_INT(1, fscanf(f, "%63s", seen));
+    fclose(f);
+    TEST_ASSERT_EQUAL_STRING(expected, seen);
+}
+
+static void assert_tunnel_in_latency_class(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.latency_count = 1;
+    strcpy(settings.latencies[0].service, "SSH");
+    settings.latencies[0].latency = (LatencyClass) {
+        .set = true,
+        .renice = true,
+        .nice = 10,
+        .io_class = LATENCY_IO_BEST_EFFORT,
+        .io_level = 7,
+        .cpus = 1,
+    };
+    tunnel_apply_settings(&settings);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    wait_for_close();
+    assert_stub_ran("token");
+
+    FILE *f = fopen(LATENCY_FILE, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    int nice = -1;
+    char ioprio[32] = { 0 };
+    char cpus[32] = { 0 };
+    TEST_ASSERT_EQUAL_INT(3, fscanf(f, "%d %31s %31s", &nice, ioprio, cpus));
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(10, nice);
+    TEST_ASSERT_EQUAL_STRING("best-effort:prio7", ioprio);
+    TEST_ASSERT_EQUAL_STRING("0", cpus);
+}
+
+void setUp(void) {
+    test_reset_tunnels(&config);
+    install_stub_localproxy();
+}
+
+void tearDown(void) {
+    test_remove_directory(TEST_DIR);
+}
+
+void test_spawn_child_of_component(void) {
+    int exe_fd = open(TEST_DIR "/localproxy", O_RDONLY);
+    int exec_pipe[2];
+    TEST_ASSERT_EQUAL(0, pipe2(exec_pipe, O_CLOEXEC));
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    const char *args[] = { "localproxy", "-v", "2", NULL };
+
+    pid_t pid = 0;
+    int pidfd = -1;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        launcher_spawn(
+            exe_fd,
+            args,
+            "spawned",
+            null_fd,
+            exec_pipe[1],
+            -1,
+            -1,
+            NULL,
+            &pid,
+            &pidfd
+        )
+    );
+    close(exec_pipe[1]);
+    close(null_fd);
+    close(exe_fd);
+    TEST_ASSERT_GREATER_THAN(0, pid);
+    TEST_ASSERT_NOT_EQUAL(-1, pidfd);
+    TEST_ASSERT_TRUE(await_exec(exec_pipe[0]));
+    close(exec_pipe[0]);
+
+    int status = 0;
+    TEST_ASSERT_EQUAL(pid, waitpid(pid, &status, 0));
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(3, WEXITSTATUS(status));
+    close(pidfd);
+    assert_stub_ran("spawned");
+}
+
+void test_spawn_reports_exec_failure(void) {
+    chmod(TEST_DIR "/localproxy", 0644);
+    int exe_fd = open(TEST_DIR "/localproxy", O_RDONLY);
+    int exec_pipe[2];
+    TEST_ASSERT_EQUAL(0, pipe2(exec_pipe, O_CLOEXEC));
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    const char *args[] = { "localproxy", NULL };
+
+    pid_t pid = 0;
+    int pidfd = -1;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        launcher_spawn(
+            exe_fd,
+            args,
+            "token",
+            null_fd,
+            exec_pipe[1],
+            -1,
+            -1,
+            NULL,
+            &pid,
+            &pidfd
+        )
+    );
+    close(exec_pipe[1]);
+    close(null_fd);
+    close(exe_fd);
+    TEST_ASSERT_FALSE(await_exec(exec_pipe[0]));
+    close(exec_pipe[0]);
+    TEST_ASSERT_EQUAL(pid, waitpid(pid, NULL, 0));
+    close(pidfd);
+}
+
+void test_spawn_passes_control_socket(void) {
+    int exe_fd = open("/bin/sh", O_RDONLY | O_CLOEXEC);
+    int socks[2];
+    TEST_ASSERT_EQUAL(
+        0, socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks)
+    );
+    int exec_pipe[2];
+    TEST_ASSERT_EQUAL(0, pipe2(exec_pipe, O_CLOEXEC));
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    const char *args[] = { "sh", "-c", "printf control >&3", NULL };
+
+    pid_t pid = 0;
+    int pidfd = -1;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        launcher_spawn(
+            exe_fd,
+            args,
+            "",
+            null_fd,
+            exec_pipe[1],
+            -1,
+            socks[1],
+            NULL,
+            &pid,
+            &pidfd
+        )
+    );
+    close(socks[1]);
+    close(exec_pipe[1]);
+    close(null_fd);
+    close(exe_fd);
+    TEST_ASSERT_TRUE(await_exec(exec_pipe[0]));
+    close(exec_pipe[0]);
+
+    char message[16] = { 0 };
+    TEST_ASSERT_EQUAL(7, recv(socks[0], message, sizeof(message) - 1, 0));
+    TEST_ASSERT_EQUAL_STRING("control", message);
+    int status = 0;
+    TEST_ASSERT_EQUAL(pid, waitpid(pid, &status, 0));
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+    close(socks[0]);
+    close(pidfd);
+}
+
+void test_tunnel_through_launcher(void) {
+    TEST_ASSERT_NOT_EQUAL(0, find_launcher());
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    wait_for_close();
+    assert_stub_ran("token");
+}
+
+void test_fallback_after_launcher_exit(void) {
+    pid_t launcher = find_launcher();
+    TEST_ASSERT_NOT_EQUAL(0, launcher);
+    kill(launcher, SIGKILL);
+    usleep(100000);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    wait_for_close();
+    assert_stub_ran("token");
+    TEST_ASSERT_EQUAL(0, find_launcher());
+}
+
+void test_tunnel_in_network_namespace(void) {
+    TEST_ASSERT_NOT_EQUAL(0, find_launcher());
+    assert_tunnel_in_namespace();
+}
+
+// Runs after test_fallback_after_launcher_exit stopped the launcher
+void test_fallback_in_network_namespace(void) {
+    TEST_ASSERT_EQUAL(0, find_launcher());
+    assert_tunnel_in_namespace();
+}
+
+void test_tunnel_in_latency_class(void) {
+    TEST_ASSERT_NOT_EQUAL(0, find_launcher());
+    assert_tunnel_in_latency_class();
+}
+
+// Runs after test_fallback_after_launcher_exit stopped the launcher
+void test_fallback_in_latency_class(void) {
+    TEST_ASSERT_EQUAL(0, find_launcher());
+    assert_tunnel_in_latency_class();
+}
+
+int main(void) {
+    if (launcher_start() != GG_ERR_OK) {
+        return 1;
+    }
+    UNITY_BEGIN();
+    RUN_TEST(test_spawn_child_of_component);
+    RUN_TEST(test_spawn_reports_exec_failure);
+    RUN_TEST(test_spawn_passes_control_socket);
+    RUN_TEST(test_tunnel_through_launcher);
+    RUN_TEST(test_tunnel_in_network_namespace);
+    RUN_TEST(test_tunnel_in_latency_class);
+    RUN_TEST(test_fallback_after_launcher_exit);
+    RUN_TEST(test_fallback_in_network_namespace);
+    RUN_TEST(test_fallback_in_latency_class);
+    return UNITY_END();
+}
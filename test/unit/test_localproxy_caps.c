@@ -0,0 +1,127 @@
+/*
+ * Unit test for localproxy protocol detection and launch arguments
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to build it into the test
+#include "tunnel.c"
+#include <unistd.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_DIR "/tmp/gg-test-localproxy-caps"
+#define ARGS_FILE TEST_DIR "/args"
+
+void test_probe_protocol(void);
+void test_probe_detects_replaced_binary(void);
+void test_multiplexed_launch(void);
+void test_forced_v1_launch(void);
+void test_v1_only_localproxy(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+// Stub localproxy that records its arguments. markers is embedded in the
+// script the same way the option and field names are in a real binary.
+static void install_stub_localproxy(const char *markers) {
+    char script[256];
+    snprintf(
+        script, sizeof(script), "# %s\necho \"$@\" > " ARGS_FILE, markers
+    );
+    test_install_stub_localproxy(TEST_DIR, script);
+}
+
+static LocalproxyProtocol probe_stub(void) {
+    int fd = open(TEST_DIR "/localproxy", O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    LocalproxyProtocol protocol = localproxy_probe(fd);
+    close(fd);
+    return protocol;
+}
+
+static void apply_client_type(TunnelClientType type) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.destination_client_type = type;
+    tunnel_apply_settings(&settings);
+}
+
+// Launches an SSH tunnel and returns the arguments localproxy was given
+static void launch_and_read_args(char *args, size_t len) {
+    unlink(ARGS_FILE);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, test_notify_tunnel(&config, "token", "SSH"));
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 5000));
+
+    FILE *f = fopen(ARGS_FILE, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_NOT_NULL(fgets(args, (int) len, f));
+    fclose(f);
+}
+
+void setUp(void) {
+    test_reset_tunnels(&config);
+}
+
+void tearDown(void) {
+    test_remove_directory(TEST_DIR);
+}
+
+void test_probe_protocol(void) {
+    install_stub_localproxy("");
+    TEST_ASSERT_EQUAL(LOCALPROXY_PROTOCOL_V1, probe_stub());
+
+    install_stub_localproxy("destination-client-type");
+    TEST_ASSERT_EQUAL(LOCALPROXY_PROTOCOL_V2, probe_stub());
+
+    install_stub_localproxy("destination-client-type connection_id");
+    TEST_ASSERT_EQUAL(LOCALPROXY_PROTOCOL_V3, probe_stub());
+}
+
+void test_probe_detects_replaced_binary(void) {
+    install_stub_localproxy("destination-client-type connection_id");
+    TEST_ASSERT_EQUAL(LOCALPROXY_PROTOCOL_V3, probe_stub());
+
+    install_stub_localproxy("destination-client-type");
+    TEST_ASSERT_EQUAL(LOCALPROXY_PROTOCOL_V2, probe_stub());
+}
+
+void test_multiplexed_launch(void) {
+    install_stub_localproxy("destination-client-type connection_id");
+    apply_client_type(TUNNEL_CLIENT_AUTO);
+
+    char args[256];
+    launch_and_read_args(args, sizeof(args));
+    TEST_ASSERT_EQUAL_STRING("-r us-west-2 -d SSH=localhost:22 -v 2\n", args);
+}
+
+void test_forced_v1_launch(void) {
+    install_stub_localproxy("destination-client-type connection_id");
+    apply_client_type(TUNNEL_CLIENT_V1);
+
+    char args[256];
+    launch_and_read_args(args, sizeof(args));
+    TEST_ASSERT_EQUAL_STRING(
+        "-r us-west-2 -d localhost:22 -v 2 --destination-client-type V1\n", args
+    );
+}
+
+void test_v1_only_localproxy(void) {
+    install_stub_localproxy("");
+    apply_client_type(TUNNEL_CLIENT_AUTO);
+
+    char args[256];
+    launch_and_read_args(args, sizeof(args));
+    TEST_ASSERT_EQUAL_STRING("-r us-west-2 -d localhost:22 -v 2\n", args);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_probe_protocol);
+    RUN_TEST(test_probe_detects_replaced_binary);
+    RUN_TEST(test_multiplexed_launch);
+    RUN_TEST(test_forced_v1_launch);
+    RUN_TEST(test_v1_only_localproxy);
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/*
+ * Unit test for the asynchronous log ring
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Include log_ring.c directly to access static variables
+#include "log_ring.c"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+void test_lines_written_in_order(void);
+void test_repeated_call_site_suppressed(void);
+void test_full_ring_drops_without_blocking(void);
+
+static int out_pipe[2];
+static char output[64 * 1024];
+
+static void emit(GgLogLevel level, int line, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// Each line number is its own call site for the rate limit
+static void emit(GgLogLevel level, int line, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_ring_vlog(level, "site.c", line, "test", format, args);
+    va_end(args);
+}
+
+// Appends what the flusher wrote so far to output after len
+static size_t read_output(size_t len) {
+    ssize_t got;
+    while (len < sizeof(output) - 1
+           && (got = read(out_pipe[0], &output[len], sizeof(output) - 1 - len))
+               > 0) {
+        len += (size_t) got;
+    }
+    output[len] = '\0';
+    return len;
+}
+
+// Returns everything the flusher wrote since the last call
+static const char *collect(void) {
+    log_ring_flush();
+    read_output(0);
+    return output;
+}
+
+static size_t count_lines(const char *text) {
+    size_t lines = 0;
+    for (const char *c = text; *c != '\0'; c++) {
+        lines += *c == '\n' ? 1 : 0;
+    }
+    return lines;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_lines_written_in_order(void) {
+    emit(GG_LOG_INFO, 1, "first %d", 1);
+    emit(GG_LOG_INFO, 2, "second");
+    emit(GG_LOG_ERROR, 3, "third");
+    TEST_ASSERT_EQUAL_STRING(
+        "[I][test] site.c:1: first 1\n"
+        "[I][test] site.c:2: second\n"
+        "[E][test] site.c:3: third\n",
+        collect()
+    );
+
+    char long_message[LOG_RING_LINE_SIZE * 2];
+    memset(long_message, 'x', sizeof(long_message) - 1);
+    long_message[sizeof(long_message) - 1] = '\0';
+    emit(GG_LOG_INFO, 4, "%s", long_message);
+    const char *truncated = collect();
+    TEST_ASSERT_EQUAL_size_t(LOG_RING_LINE_SIZE - 1, strlen(truncated));
+    TEST_ASSERT_EQUAL_INT('\n', truncated[LOG_RING_LINE_SIZE - 2]);
+}
+
+void test_repeated_call_site_suppressed(void) {
+    LogRingStats before;
+    log_ring_stats(&before);
+    for (int i = 0; i < LOG_RATE_BURST + 15; i++) {
+        emit(GG_LOG_ERROR, 100, "Maximum concurrent tunnels reached");
+    }
+    TEST_ASSERT_EQUAL_size_t(LOG_RATE_BURST, count_lines(collect()));
+    LogRingStats after;
+    log_ring_stats(&after);
+    TEST_ASSERT_TRUE(after.suppressed - before.suppressed == 15);
+
+    // Other call sites keep their own budget
+    emit(GG_LOG_INFO, 101, "other");
+    TEST_ASSERT_EQUAL_STRING("[I][test] site.c:101: other\n", collect());
+
+    // The first line of the next window reports what was held back
+    for (size_t i = 0; i < LOG_RATE_SITES; i++) {
+        log_rate_sites[i].window_ms -= LOG_RATE_WINDOW_MS;
+    }
+    emit(GG_LOG_ERROR, 100, "Maximum concurrent tunnels reached");
+    TEST_ASSERT_EQUAL_STRING(
+        "[E][test] site.c:100: Maximum concurrent tunnels reached (15 similar "
+        "messages suppressed)\n",
+        collect()
+    );
+}
+
+void test_full_ring_drops_without_blocking(void) {
+    // Stop draining the output so the flusher blocks in write
+    TEST_ASSERT_EQUAL(0, fcntl(out_pipe[0], F_SETFL, 0));
+    TEST_ASSERT_GREATER_THAN(0, fcntl(out_pipe[1], F_SETPIPE_SZ, 4096));
+    LogRingStats before;
+    log_ring_stats(&before);
+
+    int64_t start = tunnel_clock_system_ms();
+    for (int i = 0; i < LOG_RING_SLOTS * 4; i++) {
+        emit(GG_LOG_INFO, 1000 + i, "%0200d", i);
+    }
+    TEST_ASSERT_TRUE(tunnel_clock_system_ms() - start < 1000);
+    LogRingStats after;
+    log_ring_stats(&after);
+    TEST_ASSERT_TRUE(after.dropped > before.dropped);
+
+    // Once the output drains, the flusher reports the loss
+    TEST_ASSERT_EQUAL(0, fcntl(out_pipe[0], F_SETFL, O_NONBLOCK));
+    size_t len = 0;
+    for (int i = 0; i < 200 && strstr(output, "log messages\n") == NULL; i++) {
+        usleep(10000);
+        len = read_output(len);
+    }
+    TEST_ASSERT_NOT_NULL(strstr(output, "Dropped "));
+}
+
+int main(void) {
+    if (pipe2(out_pipe, O_CLOEXEC) != 0
+        || fcntl(out_pipe[0], F_SETFL, O_NONBLOCK) != 0
+        || log_ring_start(out_pipe[1]) != GG_ERR_OK) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_lines_written_in_order);
+    RUN_TEST(test_repeated_call_site_suppressed);
+    RUN_TEST(test_full_ring_drops_without_blocking);
+    return UNITY_END();
+}
@@ -0,0 +1,289 @@
+/*
+ * Unit test for receiving tunnel notifications over a direct MQTT connection,
+ * against a local broker stand-in
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include mqtt_transport.c and tunnel.c directly to access static variables
+#include "mqtt_transport.c"
+#include "subscriptions.h"
+#include "tunnel.c"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_DIR "/tmp/gg-test-mqtt-transport"
+#define TOPIC "$aws/things/test-thing/tunnels/notify"
+#define GATEWAY_TOPIC "$aws/things/camera-1/tunnels/notify"
+#define NOTIFICATION \
+    "{\"clientAccessToken\":\"token\",\"region\":\"us-west-2\"," \
+    "\"services\":[\"SSH\"]}"
+
+void test_topic_filter_wildcards(void);
+void test_bad_credentials_rejected(void);
+void test_notification_delivered(void);
+void test_resubscribes_after_reconnect(void);
+void test_gateway_things_change_resubscribes(void);
+void test_client_id_change_reconnects(void);
+void test_bad_credentials_keep_connection(void);
+void test_failed_switch_keeps_mqtt(void);
+
+static char endpoint[32];
+static int listen_fd = -1;
+static int client_fd = -1;
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+// Broker stand-in: reads one packet, returning its type and body length
+static uint8_t broker_read(uint8_t *body, size_t *len) {
+    uint8_t type;
+    TEST_ASSERT_EQUAL(1, recv(client_fd, &type, 1, MSG_WAITALL));
+    size_t remaining = 0;
+    for (size_t shift = 0;; shift += 7) {
+        uint8_t byte;
+        TEST_ASSERT_EQUAL(1, recv(client_fd, &byte, 1, MSG_WAITALL));
+        remaining |= (size_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    TEST_ASSERT_TRUE(remaining <= 512);
+    if (remaining > 0) {
+        TEST_ASSERT_EQUAL(
+            (ssize_t) remaining, recv(client_fd, body, remaining, MSG_WAITALL)
+        );
+    }
+    *len = remaining;
+    return type;
+}
+
+static void broker_write(const uint8_t *data, size_t len) {
+    TEST_ASSERT_EQUAL((ssize_t) len, send(client_fd, data, len, MSG_NOSIGNAL));
+}
+
+// Accepts the transport's connection and completes CONNECT from id
+static void broker_connect_as(const char *id) {
+    struct timeval timeout = { .tv_sec = 5 };
+    setsockopt(listen_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    client_fd = accept(listen_fd, NULL, NULL);
+    TEST_ASSERT_NOT_EQUAL(-1, client_fd);
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    uint8_t body[512];
+    size_t len;
+    TEST_ASSERT_EQUAL_UINT8(MQTT_CONNECT, broker_read(body, &len));
+    TEST_ASSERT_EQUAL_size_t(12 + strlen(id), len);
+    TEST_ASSERT_EQUAL_MEMORY(id, &body[12], strlen(id));
+    uint8_t connack[] = { MQTT_CONNACK, 2, 0, 0 };
+    broker_write(connack, sizeof(connack));
+}
+
+static void broker_connect(void) {
+    broker_connect_as("test-thing-secure-tunnel");
+}
+
+static void broker_expect_subscribe(const char *topic) {
+    uint8_t body[512];
+    size_t len;
+    TEST_ASSERT_EQUAL_UINT8(MQTT_SUBSCRIBE, broker_read(body, &len));
+    TEST_ASSERT_EQUAL_size_t(2 + 2 + strlen(topic) + 1, len);
+    TEST_ASSERT_EQUAL_MEMORY(topic, &body[4], strlen(topic));
+    TEST_ASSERT_EQUAL_UINT8(1, body[len - 1]);
+    uint8_t suback[] = { MQTT_SUBACK, 3, body[0], body[1], 1 };
+    broker_write(suback, sizeof(suback));
+}
+
+// Accepts the transport's connection and completes CONNECT and SUBSCRIBE
+static void broker_accept(void) {
+    broker_connect();
+    broker_expect_subscribe(TOPIC);
+}
+
+// Waits for the transport to end the connection, as it does to resubscribe
+static void broker_expect_reconnect(void) {
+    uint8_t byte;
+    TEST_ASSERT_EQUAL(0, recv(client_fd, &byte, 1, 0));
+    close(client_fd);
+}
+
+static void broker_publish(uint8_t qos, uint16_t packet_id) {
+    uint8_t msg[512];
+    size_t topic_len = sizeof(TOPIC) - 1;
+    size_t payload_len = sizeof(NOTIFICATION) - 1;
+    size_t body_len = 2 + topic_len + (qos > 0 ? 2 : 0) + payload_len;
+    size_t pos = 0;
+    msg[pos++] = (uint8_t) (MQTT_PUBLISH | (qos << 1));
+    pos += encode_remaining_length(&msg[pos], body_len);
+    msg[pos++] = 0;
+    msg[pos++] = (uint8_t) topic_len;
+    memcpy(&msg[pos], TOPIC, topic_len);
+    pos += topic_len;
+    if (qos > 0) {
+        msg[pos++] = (uint8_t) (packet_id >> 8);
+        msg[pos++] = (uint8_t) packet_id;
+    }
+    memcpy(&msg[pos], NOTIFICATION, payload_len);
+    broker_write(msg, pos + payload_len);
+}
+
+void setUp(void) {
+    // Holds its slot briefly so launches can be counted
+    test_install_stub_localproxy(TEST_DIR, "sleep 1");
+}
+
+void tearDown(void) {
+    (void) test_wait_for_active(0, 3000);
+    test_remove_directory(TEST_DIR);
+}
+
+void test_topic_filter_wildcards(void) {
+    GgBuffer topic = GG_STR(TOPIC);
+    TEST_ASSERT_TRUE(topic_matches(topic, topic));
+    TEST_ASSERT_TRUE(topic_matches(GG_STR("$aws/things/+/tunnels/+"), topic));
+    TEST_ASSERT_TRUE(topic_matches(GG_STR("$aws/things/#"), topic));
+    TEST_ASSERT_FALSE(topic_matches(GG_STR("$aws/things/+/jobs/+"), topic));
+    TEST_ASSERT_FALSE(topic_matches(GG_STR("$aws/things/+/tunnels"), topic));
+}
+
+void test_bad_credentials_rejected(void) {
+    MqttTransportOptions options = {
+        .endpoint = endpoint,
+        .client_id = "test-thing-secure-tunnel",
+        .cert_path = TEST_DIR "/missing.pem",
+        .key_path = TEST_DIR "/missing.key",
+        .root_ca_path = "",
+    };
+    TEST_ASSERT_EQUAL(GG_ERR_CONFIG, mqtt_transport_start(&options));
+    TEST_ASSERT_FALSE(transport_started);
+}
+
+void test_notification_delivered(void) {
+    config.mqtt_endpoint = gg_buffer_from_null_term(endpoint);
+    // Greengrass IPC is not running, which only disables IPC features
+    TEST_ASSERT_EQUAL(GG_ERR_OK, subscribe_to_aws_tunnel_tokens(&config));
+    broker_accept();
+
+    broker_publish(1, 7);
+    uint8_t body[512];
+    size_t len;
+    TEST_ASSERT_EQUAL_UINT8(MQTT_PUBACK, broker_read(body, &len));
+    TEST_ASSERT_EQUAL_size_t(2, len);
+    TEST_ASSERT_EQUAL_UINT8(0, body[0]);
+    TEST_ASSERT_EQUAL_UINT8(7, body[1]);
+
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(1, 3000));
+}
+
+void test_resubscribes_after_reconnect(void) {
+    close(client_fd);
+    broker_accept();
+
+    broker_publish(0, 0);
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(1, 3000));
+}
+
+void test_gateway_things_change_resubscribes(void) {
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, update_gateway_subscriptions(&config, GG_STR("camera-1"))
+    );
+    broker_expect_reconnect();
+    broker_connect();
+    broker_expect_subscribe(TOPIC);
+    broker_expect_subscribe(GATEWAY_TOPIC);
+
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, update_gateway_subscriptions(&config, GG_STR(""))
+    );
+    broker_expect_reconnect();
+    broker_accept();
+}
+
+void test_client_id_change_reconnects(void) {
+    MqttTransportOptions options = {
+        .endpoint = endpoint,
+        .client_id = "renamed",
+        .cert_path = "",
+        .key_path = "",
+        .root_ca_path = "",
+    };
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, update_notification_transport(&config, &options)
+    );
+    broker_expect_reconnect();
+    broker_connect_as("renamed");
+    broker_expect_subscribe(TOPIC);
+
+    // An empty client ID goes back to the default
+    options.client_id = "";
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, update_notification_transport(&config, &options)
+    );
+    broker_expect_reconnect();
+    broker_accept();
+}
+
+void test_bad_credentials_keep_connection(void) {
+    MqttTransportOptions options = {
+        .endpoint = endpoint,
+        .client_id = "",
+        .cert_path = TEST_DIR "/missing.pem",
+        .key_path = TEST_DIR "/missing.key",
+        .root_ca_path = "",
+    };
+    TEST_ASSERT_EQUAL(
+        GG_ERR_CONFIG, update_notification_transport(&config, &options)
+    );
+
+    broker_publish(0, 0);
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(1, 3000));
+}
+
+// Greengrass IPC is not running, so moving back to it fails part way
+void test_failed_switch_keeps_mqtt(void) {
+    MqttTransportOptions options = {
+        .endpoint = "",
+        .client_id = "",
+        .cert_path = "",
+        .key_path = "",
+        .root_ca_path = "",
+    };
+    TEST_ASSERT_NOT_EQUAL(
+        GG_ERR_OK, update_notification_transport(&config, &options)
+    );
+    TEST_ASSERT_EQUAL_size_t(1, subscription_count);
+
+    broker_publish(0, 0);
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(1, 3000));
+}
+
+int main(void) {
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET,
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    if (listen_fd == -1
+        || bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+        || listen(listen_fd, 1) != 0
+        || getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len) != 0) {
+        return 1;
+    }
+    snprintf(endpoint, sizeof(endpoint), "127.0.0.1:%u", ntohs(addr.sin_port));
+
+    UNITY_BEGIN();
+    RUN_TEST(test_topic_filter_wildcards);
+    RUN_TEST(test_bad_credentials_rejected);
+    RUN_TEST(test_notification_delivered);
+    RUN_TEST(test_resubscribes_after_reconnect);
+    RUN_TEST(test_gateway_things_change_resubscribes);
+    RUN_TEST(test_client_id_change_reconnects);
+    RUN_TEST(test_bad_credentials_keep_connection);
+    RUN_TEST(test_failed_switch_keeps_mqtt);
+    return UNITY_END();
+}
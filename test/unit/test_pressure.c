@@ -0,0 +1,136 @@
+/*
+ * Unit test for holding back tunnel launches under host pressure
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include pressure.c and tunnel.c directly to access static variables
+#include "pressure.c"
+#include "tunnel.c"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <unity.h>
+
+#define TEST_DIR "/tmp/gg-test-pressure"
+
+void test_launch_rejected_under_pressure(void);
+void test_launch_deferred_until_pressure_clears(void);
+void test_deferred_launch_rejected_after_deadline(void);
+void test_running_tunnels_reniced(void);
+void test_trigger_armed(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+static GgError notify(void) {
+    return test_notify_tunnel(&config, "token", "SSH");
+}
+
+static void set_pressure(PressureResource resource, int64_t hold_ms) {
+    atomic_store(
+        &pressure_until_ms[resource], tunnel_clock_system_ms() + hold_ms
+    );
+}
+
+static void clear_pressure(void) {
+    for (int i = 0; i < PRESSURE_RESOURCE_COUNT; i++) {
+        atomic_store(&pressure_until_ms[i], 0);
+    }
+}
+
+void setUp(void) {
+    test_reset_tunnels(&config);
+    launch_limiter_configure(0, 1, 0);
+    launch_limiter_set_pressure_defer(0);
+    clear_pressure();
+    // Holds its slot briefly so launches can be counted
+    test_install_stub_localproxy(TEST_DIR, "sleep 1");
+}
+
+void tearDown(void) {
+    clear_pressure();
+    launch_limiter_set_pressure_defer(0);
+    atomic_store(&pressure_nice, 0);
+    (void) test_wait_for_active(0, 3000);
+    test_remove_directory(TEST_DIR);
+}
+
+void test_launch_rejected_under_pressure(void) {
+    set_pressure(PRESSURE_MEMORY, 10000);
+
+    TEST_ASSERT_EQUAL(GG_ERR_RETRY, notify());
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    clear_pressure();
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    TEST_ASSERT_EQUAL_INT(1, test_active_tunnels());
+}
+
+void test_launch_deferred_until_pressure_clears(void) {
+    launch_limiter_set_pressure_defer(5000);
+    set_pressure(PRESSURE_IO, 10000);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    usleep(700000);
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    clear_pressure();
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(1, 3000));
+}
+
+void test_deferred_launch_rejected_after_deadline(void) {
+    launch_limiter_set_pressure_defer(300);
+    set_pressure(PRESSURE_CPU, 10000);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    usleep(1200000);
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    // Nothing is left queued to launch once pressure clears
+    clear_pressure();
+    usleep(700000);
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+}
+
+void test_running_tunnels_reniced(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    TunnelInfo info = { 0 };
+    for (int i = 0; i < 300 && info.pid == 0; i++) {
+        (void) tunnel_list(&info, 1);
+        usleep(10000);
+    }
+    TEST_ASSERT_NOT_EQUAL(0, info.pid);
+
+    int percent[PRESSURE_RESOURCE_COUNT] = { 0 };
+    pressure_configure(percent, 10);
+    on_pressure(PRESSURE_CPU, 50);
+
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, (id_t) info.pid);
+    TEST_ASSERT_EQUAL_INT(0, errno);
+    TEST_ASSERT_EQUAL_INT(10, nice);
+    PressureResource resource;
+    TEST_ASSERT_TRUE(pressure_active(&resource));
+    TEST_ASSERT_EQUAL(PRESSURE_CPU, resource);
+}
+
+void test_trigger_armed(void) {
+    if (access("/proc/pressure/memory", W_OK) != 0) {
+        TEST_IGNORE_MESSAGE("PSI triggers not available");
+        return;
+    }
+    int fd = arm_trigger(PRESSURE_MEMORY, 10);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    close(fd);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_launch_rejected_under_pressure);
+    RUN_TEST(test_launch_deferred_until_pressure_clears);
+    RUN_TEST(test_deferred_launch_rejected_after_deadline);
+    RUN_TEST(test_running_tunnels_reniced);
+    RUN_TEST(test_trigger_armed);
+    return UNITY_END();
+}
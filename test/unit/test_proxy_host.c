@@ -0,0 +1,326 @@
+/*
+ * Unit test for tunnels served by a shared localproxy host
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <libgen.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_DIR "/tmp/gg-test-proxy-host"
+#define OPEN_LOG TEST_DIR "/opens"
+
+void test_tunnels_share_host(void);
+void test_close_hosted_tunnel(void);
+void test_hosted_tunnel_timeout(void);
+void test_host_restarted_after_exit(void);
+void test_abandon_kills_host(void);
+void test_host_disabled_by_default(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+// The harness binary doubles as the stub host. The access token is
+// "<exit code>:<delay ms>" to end the tunnel on its own, "late:<delay ms>" to
+// also ignore CLOSE, "hold" to keep it open until closed, or "crash" to exit
+// the host.
+typedef struct {
+    unsigned long long id; // 0 for a free entry
+    int exit_code;
+    int64_t due_ms; // 0 while held open
+    bool ignore_close;
+} StubTunnel;
+
+static StubTunnel *find_stub_tunnel(
+    StubTunnel *tunnels, unsigned long long id
+) {
+    for (int i = 0; i < TUNNEL_MAX_SLOTS; i++) {
+        if (tunnels[i].id == id) {
+            return &tunnels[i];
+        }
+    }
+    return NULL;
+}
+
+static void open_stub_tunnel(
+    StubTunnel *tunnels, unsigned long long id, const char *token
+) {
+    StubTunnel *tunnel = find_stub_tunnel(tunnels, 0);
+    *tunnel = (StubTunnel) { .id = id };
+    int delay_ms = 0;
+    if (sscanf(token, "late:%d", &delay_ms) == 1) {
+        tunnel->ignore_close = true;
+        tunnel->due_ms = monotonic_ms() + delay_ms;
+    } else if (sscanf(token, "%d:%d", &tunnel->exit_code, &delay_ms) == 2) {
+        tunnel->due_ms = monotonic_ms() + delay_ms;
+    }
+}
+
+static int stub_host_main(void) {
+    StubTunnel tunnels[TUNNEL_MAX_SLOTS] = { 0 };
+    char message[1536];
+
+    while (true) {
+        int64_t now = monotonic_ms();
+        int timeout = -1;
+        for (int i = 0; i < TUNNEL_MAX_SLOTS; i++) {
+            StubTunnel *tunnel = &tunnels[i];
+            if (tunnel->id != 0 && tunnel->due_ms != 0
+                && tunnel->due_ms <= now) {
+                int len = snprintf(
+                    message,
+                    sizeof(message),
+                    "EXIT %llu %d",
+                    tunnel->id,
+                    tunnel->exit_code
+                );
+                (void) send(3, message, (size_t) len, 0);
+                tunnel->id = 0;
+            } else if (tunnel->id != 0 && tunnel->due_ms != 0
+                       && (timeout == -1 || tunnel->due_ms - now < timeout)) {
+                timeout = (int) (tunnel->due_ms - now);
+            }
+        }
+
+        struct pollfd pfd = { .fd = 3, .events = POLLIN };
+        if (poll(&pfd, 1, timeout) <= 0) {
+            continue;
+        }
+        ssize_t len = recv(3, message, sizeof(message) - 1, 0);
+        if (len <= 0) {
+            return 0;
+        }
+        message[len] = '\0';
+
+        unsigned long long id = 0;
+        char token[64];
+        if (sscanf(message, "CLOSE %llu", &id) == 1) {
+            StubTunnel *tunnel = find_stub_tunnel(tunnels, id);
+            if (tunnel != NULL && !tunnel->ignore_close) {
+                tunnel->exit_code = 143;
+                tunnel->due_ms = monotonic_ms();
+            }
+        } else if (sscanf(message, "OPEN %llu %*s %*s %*s %63s", &id, token)
+                   == 2) {
+            FILE *log = fopen(OPEN_LOG, "a");
+            fprintf(log, "%s\n", message);
+            fclose(log);
+            if (strcmp(token, "crash") == 0) {
+                return 1;
+            }
+            open_stub_tunnel(tunnels, id, token);
+        }
+    }
+}
+
+// Applies the default settings with the localproxy host enabled
+static void enable_proxy_host(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.proxy_host = true;
+    tunnel_apply_settings(&settings);
+}
+
+static GgError notify(const char *token) {
+    return test_notify_tunnel(&config, token, "SSH");
+}
+
+// Waits until count tunnels are running in the host and returns them
+static size_t wait_for_hosted(TunnelInfo *tunnels, size_t count) {
+    for (int waited = 0; waited < 5000; waited += 10) {
+        size_t found = tunnel_list(tunnels, TUNNEL_MAX_SLOTS);
+        size_t running = 0;
+        for (size_t i = 0; i < found; i++) {
+            running += tunnels[i].pid != 0 ? 1U : 0U;
+        }
+        if (running == count) {
+            return found;
+        }
+        usleep(10000);
+    }
+    return 0;
+}
+
+static int count_log_lines(void) {
+    FILE *f = fopen(OPEN_LOG, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    int lines = 0;
+    char line[1536];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lines++;
+    }
+    fclose(f);
+    return lines;
+}
+
+void setUp(void) {
+    test_reset_tunnels(&config);
+    enable_proxy_host();
+    unlink(OPEN_LOG);
+}
+
+void tearDown(void) {
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 10000));
+}
+
+void test_tunnels_share_host(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("0:500"));
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("3:500"));
+
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    TEST_ASSERT_EQUAL_size_t(2, wait_for_hosted(tunnels, 2));
+    TEST_ASSERT_EQUAL_INT(tunnels[0].pid, tunnels[1].pid);
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 5000));
+
+    FILE *f = fopen(OPEN_LOG, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    char line[256];
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), f));
+    fclose(f);
+    TEST_ASSERT_EQUAL_STRING(
+        "OPEN 1 us-west-2 SSH=localhost:22 auto 0:500\n", line
+    );
+}
+
+void test_close_hosted_tunnel(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("hold"));
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    TEST_ASSERT_EQUAL_size_t(1, wait_for_hosted(tunnels, 1));
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_close(tunnels[0].slot));
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 2000));
+}
+
+void test_hosted_tunnel_timeout(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.tunnel_timeout_seconds = 1;
+    settings.proxy_host = true;
+    tunnel_apply_settings(&settings);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("hold"));
+    int64_t closed_after = test_wait_for_active(0, 5000);
+    TEST_ASSERT_GREATER_OR_EQUAL(900, closed_after);
+    TEST_ASSERT_LESS_THAN(3000, closed_after);
+}
+
+void test_host_restarted_after_exit(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("hold"));
+    TunnelInfo tunnels[TUNNEL_MAX_SLOTS];
+    TEST_ASSERT_EQUAL_size_t(1, wait_for_hosted(tunnels, 1));
+    pid_t first_host = tunnels[0].pid;
+
+    // The crash takes the held tunnel down with the host
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("crash"));
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 5000));
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("hold"));
+    TEST_ASSERT_EQUAL_size_t(1, wait_for_hosted(tunnels, 1));
+    TEST_ASSERT_NOT_EQUAL(first_host, tunnels[0].pid);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_close(tunnels[0].slot));
+    TEST_ASSERT_EQUAL_INT(3, count_log_lines());
+}
+
+static void open_hosted(int slot, const char *token, pid_t *host) {
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        proxy_host_open(
+            config.artifact_path,
+            slot,
+            token,
+            "us-west-2",
+            "localhost:22",
+            false,
+            host
+        )
+    );
+}
+
+// A host that ignores CLOSE is killed with every tunnel it serves, and the
+// next tunnel starts a new host
+void test_abandon_kills_host(void) {
+    int slot = TUNNEL_MAX_SLOTS - 1;
+    int other = TUNNEL_MAX_SLOTS - 2;
+    pid_t host = 0;
+    pid_t other_host = 0;
+    open_hosted(slot, "late:5000", &host);
+    open_hosted(other, "hold", &other_host);
+    TEST_ASSERT_EQUAL_INT(host, other_host);
+    // Killed before reading them, the host would never log the opens
+    for (int waited = 0; waited < 2000 && count_log_lines() < 2; waited += 10) {
+        usleep(10000);
+    }
+    TEST_ASSERT_EQUAL_INT(2, count_log_lines());
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, proxy_host_close(slot));
+    proxy_host_abandon(slot);
+    int status = 0;
+    TEST_ASSERT_TRUE(proxy_host_wait(slot, -1, &status));
+    TEST_ASSERT_TRUE(WIFSIGNALED(status));
+    TEST_ASSERT_EQUAL_INT(SIGKILL, WTERMSIG(status));
+    TEST_ASSERT_TRUE(proxy_host_wait(other, -1, &status));
+    TEST_ASSERT_EQUAL_INT(SIGKILL, WTERMSIG(status));
+    for (int waited = 0; waited < 2000 && kill(host, 0) == 0; waited += 10) {
+        usleep(10000);
+    }
+    TEST_ASSERT_EQUAL_INT(-1, kill(host, 0));
+
+    pid_t new_host = 0;
+    open_hosted(slot, "hold", &new_host);
+    TEST_ASSERT_NOT_EQUAL(host, new_host);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, proxy_host_close(slot));
+    TEST_ASSERT_TRUE(proxy_host_wait(slot, monotonic_ms() + 2000, &status));
+    TEST_ASSERT_EQUAL_INT(143 << 8, status);
+    TEST_ASSERT_EQUAL_INT(3, count_log_lines());
+}
+
+void test_host_disabled_by_default(void) {
+    test_reset_tunnels(&config);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("0:0"));
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 5000));
+    TEST_ASSERT_EQUAL_INT(0, count_log_lines());
+}
+
+int main(int argc, char **argv) {
+    if (argc > 0 && strcmp(basename(argv[0]), PROXY_HOST_BINARY) == 0) {
+        return stub_host_main();
+    }
+
+    char self[512];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len <= 0) {
+        return 1;
+    }
+    self[len] = '\0';
+    if (launcher_start() != GG_ERR_OK) {
+        return 1;
+    }
+    mkdir(TEST_DIR, 0755);
+    unlink(TEST_DIR "/" PROXY_HOST_BINARY);
+    if (symlink(self, TEST_DIR "/" PROXY_HOST_BINARY) != 0) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_tunnels_share_host);
+    RUN_TEST(test_close_hosted_tunnel);
+    RUN_TEST(test_hosted_tunnel_timeout);
+    RUN_TEST(test_host_restarted_after_exit);
+    RUN_TEST(test_abandon_kills_host);
+    RUN_TEST(test_host_disabled_by_default);
+    int failures = UNITY_END();
+
+    test_remove_directory(TEST_DIR);
+    return failures;
+}
@@ -0,0 +1,275 @@
+/*
+ * Unit test for tunnel commands received over MQTT
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include the sources directly to access static variables
+#include "remote_control.c"
+#include "tunnel.c"
+#include <string.h>
+#include <sys/wait.h>
+#include <unity.h>
+#include <stdio.h>
+
+void test_list_empty(void);
+void test_list_shows_tunnel(void);
+void test_list_fits_every_slot(void);
+void test_reply_too_large(void);
+void test_close_errors(void);
+void test_close_signals_localproxy(void);
+void test_close_all(void);
+void test_invalid_commands(void);
+void test_queue_bounded(void);
+void test_reply_topic_kept(void);
+void test_set_topic(void);
+
+static uint8_t response_buf[REMOTE_MAX_RESPONSE + 1];
+
+static const char *run(const char *json) {
+    char payload[REMOTE_MAX_COMMAND];
+    strcpy(payload, json);
+    GgByteVec vec = { .buf = { .data = response_buf },
+                      .capacity = REMOTE_MAX_RESPONSE };
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, handle_command(gg_buffer_from_null_term(payload), &vec)
+    );
+    response_buf[vec.buf.len] = '\0';
+    return (const char *) response_buf;
+}
+
+// Occupies a slot the way admission and the worker would
+static void occupy_slot(int slot, const char *service, pid_t pid, int pidfd) {
+    pthread_mutex_lock(&tunnel_mutex);
+    tunnel_contexts[slot] = (TunnelCreationContext) {
+        .timeout_seconds = 300,
+        .started_ms = monotonic_ms(),
+        .active_ms = monotonic_ms(),
+        .pid = pid,
+        .pidfd = pidfd,
+    };
+    strcpy(tunnel_contexts[slot].service, service);
+    strcpy(tunnel_contexts[slot].thing_name, "test-thing");
+    tunnel_slots_mask |= 1U << slot;
+    active_tunnels++;
+    publish_slot(slot);
+    pthread_mutex_unlock(&tunnel_mutex);
+}
+
+// Occupies slot with a real process that waits for SIGTERM
+static pid_t occupy_with_process(int slot, int *pidfd) {
+    pid_t pid = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    if (pid == 0) {
+        pause();
+        _exit(0);
+    }
+    *pidfd = (int) syscall(SYS_pidfd_open, pid, 0);
+    occupy_slot(slot, "SSH", pid, *pidfd);
+    return pid;
+}
+
+static void assert_terminated(pid_t pid, int pidfd) {
+    int status = 0;
+    TEST_ASSERT_EQUAL(pid, waitpid(pid, &status, 0));
+    TEST_ASSERT_TRUE(WIFSIGNALED(status));
+    TEST_ASSERT_EQUAL_INT(SIGTERM, WTERMSIG(status));
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+}
+
+void setUp(void) {
+    pthread_mutex_lock(&tunnel_mutex);
+    active_tunnels = 0;
+    tunnel_slots_mask = 0;
+    tunnel_config = NULL;
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        publish_slot(slot);
+    }
+    pthread_mutex_unlock(&tunnel_mutex);
+}
+
+void tearDown(void) {
+}
+
+void test_list_empty(void) {
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"requestId\":\"r1\",\"result\":\"ok\",\"tunnels\":[]}",
+        run("{\"requestId\":\"r1\",\"command\":\"list\"}")
+    );
+}
+
+void test_list_shows_tunnel(void) {
+    occupy_slot(3, "SSH", 1234, -1);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"result\":\"ok\",\"tunnels\":[{\"slot\":3,\"service\":\"SSH\","
+        "\"thing\":\"test-thing\",\"pid\":1234,\"ageSeconds\":0,"
+        "\"remainingSeconds\":300,\"readBytes\":0,\"writtenBytes\":0,"
+        "\"idleSeconds\":0}]}",
+        run("{\"command\":\"list\"}")
+    );
+}
+
+// Every slot with names that double in size when escaped
+void test_list_fits_every_slot(void) {
+    char service[64];
+    memset(service, '"', sizeof(service) - 1);
+    service[sizeof(service) - 1] = '\0';
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        occupy_slot(slot, service, INT32_MAX, -1);
+        pthread_mutex_lock(&tunnel_mutex);
+        memset(
+            tunnel_contexts[slot].thing_name, '\\', TUNNEL_MAX_THING_NAME_LEN
+        );
+        tunnel_contexts[slot].thing_name[TUNNEL_MAX_THING_NAME_LEN - 1] = '\0';
+        publish_slot(slot);
+        pthread_mutex_unlock(&tunnel_mutex);
+    }
+    const char *ok = "{\"requestId\":\"all\",\"result\":\"ok\"";
+    const char *reply = run("{\"requestId\":\"all\",\"command\":\"list\"}");
+    TEST_ASSERT_EQUAL_INT(0, strncmp(reply, ok, strlen(ok)));
+}
+
+void test_reply_too_large(void) {
+    occupy_slot(0, "SSH", 1234, -1);
+    char payload[] = "{\"requestId\":\"big\",\"command\":\"list\"}";
+    char small[80];
+    GgByteVec vec = { .buf = { .data = (uint8_t *) small },
+                      .capacity = sizeof(small) - 1 };
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, handle_command(gg_buffer_from_null_term(payload), &vec)
+    );
+    small[vec.buf.len] = '\0';
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"requestId\":\"big\",\"result\":\"error\","
+        "\"error\":\"reply too large\"}",
+        small
+    );
+}
+
+void test_close_errors(void) {
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"result\":\"error\",\"error\":\"no tunnel in slot\"}",
+        run("{\"command\":\"close\",\"slot\":2}")
+    );
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"result\":\"error\",\"error\":\"invalid slot\"}",
+        run("{\"command\":\"close\",\"slot\":20}")
+    );
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"result\":\"error\",\"error\":\"invalid slot\"}",
+        run("{\"command\":\"close\"}")
+    );
+
+    occupy_slot(2, "SSH", 0, -1);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"result\":\"error\",\"error\":\"tunnel still starting\"}",
+        run("{\"command\":\"close\",\"slot\":2}")
+    );
+}
+
+void test_close_signals_localproxy(void) {
+    int pidfd = -1;
+    pid_t pid = occupy_with_process(0, &pidfd);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"requestId\":\"c\",\"result\":\"ok\"}",
+        run("{\"requestId\":\"c\",\"command\":\"close\",\"slot\":0}")
+    );
+    assert_terminated(pid, pidfd);
+}
+
+void test_close_all(void) {
+    int pidfds[2];
+    pid_t first = occupy_with_process(0, &pidfds[0]);
+    pid_t second = occupy_with_process(5, &pidfds[1]);
+    occupy_slot(7, "VNC", 0, -1);
+
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"result\":\"ok\",\"closed\":2,\"starting\":1}",
+        run("{\"command\":\"closeAll\"}")
+    );
+    assert_terminated(first, pidfds[0]);
+    assert_terminated(second, pidfds[1]);
+}
+
+void test_invalid_commands(void) {
+    const char *invalid
+        = "{\"result\":\"error\",\"error\":\"invalid command\"}";
+    TEST_ASSERT_EQUAL_STRING(invalid, run("CLOSE 1"));
+    TEST_ASSERT_EQUAL_STRING(invalid, run("[\"list\"]"));
+    TEST_ASSERT_EQUAL_STRING(invalid, run("{\"requestId\":\"x\"}"));
+    TEST_ASSERT_EQUAL_STRING(
+        invalid, run("{\"command\":\"close\",\"slot\":\"1\"}")
+    );
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"requestId\":\"q\",\"result\":\"error\","
+        "\"error\":\"unknown command\"}",
+        run("{\"requestId\":\"q\",\"command\":\"reboot\"}")
+    );
+}
+
+// Commands arriving faster than they are handled are dropped, not queued
+// without bound
+void test_queue_bounded(void) {
+    char json[] = "{\"command\":\"list\"}";
+    GgIpcSubscriptionHandle handle = { 0 };
+    for (int i = 0; i < REMOTE_QUEUE_LEN + 2; i++) {
+        on_command(
+            NULL, GG_STR("topic"), gg_buffer_from_null_term(json), handle
+        );
+    }
+    TEST_ASSERT_EQUAL_size_t(REMOTE_QUEUE_LEN, remote_count);
+
+    static RemoteCommand command;
+    take_command(&command);
+    TEST_ASSERT_EQUAL_size_t(strlen(json), command.len);
+    TEST_ASSERT_EQUAL_MEMORY(json, command.data, command.len);
+    remote_head = 0;
+    remote_count = 0;
+}
+
+// A command is answered on its own topic after controlTopic changes
+void test_reply_topic_kept(void) {
+    char json[] = "{\"command\":\"list\"}";
+    GgIpcSubscriptionHandle handle = { 0 };
+    on_command(
+        NULL, GG_STR("control/old"), gg_buffer_from_null_term(json), handle
+    );
+    on_command(
+        NULL, GG_STR("control/new"), gg_buffer_from_null_term(json), handle
+    );
+
+    static RemoteCommand command;
+    take_command(&command);
+    TEST_ASSERT_EQUAL_size_t(strlen("control/old"), command.topic_len);
+    TEST_ASSERT_EQUAL_MEMORY("control/old", command.topic, command.topic_len);
+    take_command(&command);
+    TEST_ASSERT_EQUAL_MEMORY("control/new", command.topic, command.topic_len);
+}
+
+void test_set_topic(void) {
+    TEST_ASSERT_EQUAL(
+        GG_ERR_INVALID, remote_control_set_topic(GG_STR("control/+"))
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, remote_control_set_topic(GG_STR("")));
+    TEST_ASSERT_FALSE(remote_subscribed);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_list_empty);
+    RUN_TEST(test_list_shows_tunnel);
+    RUN_TEST(test_list_fits_every_slot);
+    RUN_TEST(test_reply_too_large);
+    RUN_TEST(test_close_errors);
+    RUN_TEST(test_close_signals_localproxy);
+    RUN_TEST(test_close_all);
+    RUN_TEST(test_invalid_commands);
+    RUN_TEST(test_queue_bounded);
+    RUN_TEST(test_reply_topic_kept);
+    RUN_TEST(test_set_topic);
+    return UNITY_END();
+}
@@ -11,6 +11,7 @@
 
 void test_run_secure_tunnel_success(void);
 void test_run_secure_tunnel_subscription_failure(void);
+void test_run_secure_tunnel_config_subscription_failure(void);
 
 void setUp(void) {
     Mocksubscriptions_Init();
@@ -28,7 +29,9 @@ void test_run_secure_tunnel_success(void) {
                                   .max_concurrent_tunnels = 5,
                                   .tunnel_timeout_seconds = 3600 };
 
+    hold_launches_for_config_Expect();
     subscribe_to_aws_tunnel_tokens_ExpectAndReturn(&config, GG_ERR_OK);
+    subscribe_to_config_updates_ExpectAndReturn(&config, GG_ERR_OK);
 
     GgError ret = run_secure_tunnel(&config);
 
@@ -42,6 +45,7 @@ void test_run_secure_tunnel_subscription_failure(void) {
                                   .max_concurrent_tunnels = 5,
                                   .tunnel_timeout_seconds = 3600 };
 
+    hold_launches_for_config_Expect();
     subscribe_to_aws_tunnel_tokens_ExpectAndReturn(&config, GG_ERR_FAILURE);
 
     GgError ret = run_secure_tunnel(&config);
@@ -49,11 +53,28 @@ void test_run_secure_tunnel_subscription_failure(void) {
     TEST_ASSERT_EQUAL(GG_ERR_FAILURE, ret);
 }
 
+void test_run_secure_tunnel_config_subscription_failure(void) {
+    SecureTunnelConfig config = { .thing_name = GG_STR("test-thing"),
+                                  .region = GG_STR("us-west-2"),
+                                  .artifact_path = GG_STR("/opt/localproxy"),
+                                  .max_concurrent_tunnels = 5,
+                                  .tunnel_timeout_seconds = 3600 };
+
+    hold_launches_for_config_Expect();
+    subscribe_to_aws_tunnel_tokens_ExpectAndReturn(&config, GG_ERR_OK);
+    subscribe_to_config_updates_ExpectAndReturn(&config, GG_ERR_NOCONN);
+
+    GgError ret = run_secure_tunnel(&config);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
     RUN_TEST(test_run_secure_tunnel_success);
     RUN_TEST(test_run_secure_tunnel_subscription_failure);
+    RUN_TEST(test_run_secure_tunnel_config_subscription_failure);
 
     return UNITY_END();
 }
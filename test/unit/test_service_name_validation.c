@@ -19,6 +19,7 @@ static void reset_tunnel_state(void) {
     active_tunnels = 0;
     tunnel_slots_mask = 0;
     tunnel_config = NULL;
+    tunnel_settings_applied = false;
     pthread_mutex_unlock(&tunnel_mutex);
 }
 
@@ -113,6 +114,26 @@ static void test_empty_service_rejected(void) {
     );
 }
 
+static void test_applied_service_mapping_used(void) {
+    uint8_t arena_mem[1024];
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.service_count = 1;
+    strcpy(settings.services[0].name, "HTTP");
+    settings.services[0].port = 8080;
+    tunnel_apply_settings(&settings);
+
+    GgMap notification = create_notification(arena_mem, "HTTP");
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, handle_tunnel_notification(notification, &config)
+    );
+
+    notification = create_notification(arena_mem, "SSH");
+    TEST_ASSERT_EQUAL(
+        GG_ERR_INVALID, handle_tunnel_notification(notification, &config)
+    );
+}
+
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_ssh_service_accepted);
@@ -122,5 +143,6 @@ int main(void) {
     RUN_TEST(test_vnc_service_accepted);
     RUN_TEST(test_random_service_rejected);
     RUN_TEST(test_empty_service_rejected);
+    RUN_TEST(test_applied_service_mapping_used);
     return UNITY_END();
 }
@@ -0,0 +1,170 @@
+/*
+ * Unit test for the sock_diag listener snapshot and destination preflight
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+
+void test_listener_snapshot(void);
+void test_wildcard_listener(void);
+void test_preflight_rejects_missing_listener(void);
+void test_preflight_warn_launches(void);
+void test_process_metrics(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG("");
+
+// Returns a listening socket on an ephemeral port of addr, once the listener
+// snapshot is old enough to be refreshed when the port is looked up.
+static int listen_on(const char *addr, uint16_t *port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    struct sockaddr_in sa = { .sin_family = AF_INET };
+    inet_pton(AF_INET, addr, &sa.sin_addr);
+    TEST_ASSERT_EQUAL(0, bind(fd, (struct sockaddr *) &sa, sizeof(sa)));
+    TEST_ASSERT_EQUAL(0, listen(fd, 1));
+    socklen_t len = sizeof(sa);
+    getsockname(fd, (struct sockaddr *) &sa, &len);
+    *port = ntohs(sa.sin_port);
+    usleep(300000);
+    return fd;
+}
+
+static void skip_without_sock_diag(void) {
+    if (sock_diag_local_listener(1) == LISTENER_UNKNOWN) {
+        TEST_IGNORE_MESSAGE("sock_diag is not available");
+    }
+}
+
+static void apply_preflight(TunnelPreflight mode, uint16_t ssh_port) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.services[0].port = ssh_port;
+    settings.destination_preflight = mode;
+    tunnel_apply_settings(&settings);
+}
+
+static GgError notify(void) {
+    return test_notify_tunnel(&config, "token", "SSH");
+}
+
+void setUp(void) {
+    test_reset_tunnels(&config);
+}
+
+void tearDown(void) {
+    (void) test_wait_for_active(0, 5000);
+}
+
+void test_listener_snapshot(void) {
+    skip_without_sock_diag();
+    uint16_t closed_port = 0;
+    close(listen_on("127.0.0.1", &closed_port));
+
+    uint16_t port = 0;
+    int fd = listen_on("127.0.0.1", &port);
+    TEST_ASSERT_EQUAL(LISTENER_PRESENT, sock_diag_local_listener(port));
+    TEST_ASSERT_EQUAL(LISTENER_ABSENT, sock_diag_local_listener(closed_port));
+    close(fd);
+}
+
+// Wildcard listeners accept connections to localhost
+void test_wildcard_listener(void) {
+    skip_without_sock_diag();
+    uint16_t port = 0;
+    int fd = listen_on("127.0.0.1", &port);
+    close(fd);
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in sa = { .sin_family = AF_INET,
+                              .sin_port = htons(port),
+                              .sin_addr.s_addr = htonl(INADDR_ANY) };
+    TEST_ASSERT_EQUAL(0, bind(fd, (struct sockaddr *) &sa, sizeof(sa)));
+    TEST_ASSERT_EQUAL(0, listen(fd, 1));
+    usleep(300000);
+    TEST_ASSERT_EQUAL(LISTENER_PRESENT, sock_diag_local_listener(port));
+    close(fd);
+}
+
+void test_preflight_rejects_missing_listener(void) {
+    skip_without_sock_diag();
+    uint16_t port = 0;
+    int fd = listen_on("127.0.0.1", &port);
+    close(fd);
+
+    apply_preflight(TUNNEL_PREFLIGHT_REJECT, port);
+    TEST_ASSERT_EQUAL(GG_ERR_NOCONN, notify());
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+    TEST_ASSERT_EQUAL_UINT32(0, tunnel_slots_mask);
+
+    fd = listen_on("127.0.0.1", &port);
+    apply_preflight(TUNNEL_PREFLIGHT_REJECT, port);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+    close(fd);
+}
+
+void test_preflight_warn_launches(void) {
+    skip_without_sock_diag();
+    uint16_t port = 0;
+    int fd = listen_on("127.0.0.1", &port);
+    close(fd);
+
+    apply_preflight(TUNNEL_PREFLIGHT_WARN, port);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify());
+}
+
+// This process holds both ends of a loopback connection to the listener. The
+// end connected to the destination port is local; the accepted end's peer
+// port is ephemeral, so it counts as the cloud side.
+void test_process_metrics(void) {
+    skip_without_sock_diag();
+    uint16_t port = 0;
+    int listener = listen_on("127.0.0.1", &port);
+    int client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in sa = { .sin_family = AF_INET,
+                              .sin_port = htons(port),
+                              .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    TEST_ASSERT_EQUAL(0, connect(client, (struct sockaddr *) &sa, sizeof(sa)));
+    int server = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    TEST_ASSERT_NOT_EQUAL(-1, server);
+    char data[4096] = { 0 };
+    TEST_ASSERT_EQUAL(sizeof(data), write(client, data, sizeof(data)));
+    TEST_ASSERT_EQUAL(
+        sizeof(data), recv(server, data, sizeof(data), MSG_WAITALL)
+    );
+
+    TunnelNetMetrics net;
+    TEST_ASSERT_TRUE(sock_diag_process_metrics(getpid(), port, &net));
+    TEST_ASSERT_EQUAL_UINT32(1, net.local.connections);
+    TEST_ASSERT_EQUAL_UINT32(1, net.cloud.connections);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, net.local.rtt_us);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, net.local.cwnd);
+    TEST_ASSERT_EQUAL_UINT32(0, net.local.retransmits);
+    TEST_ASSERT_EQUAL_UINT64(0, net.local.bytes_in_flight);
+
+    // Closed connections drop out of the next sample
+    close(client);
+    close(server);
+    TEST_ASSERT_TRUE(sock_diag_process_metrics(getpid(), port, &net));
+    TEST_ASSERT_EQUAL_UINT32(0, net.local.connections);
+    TEST_ASSERT_EQUAL_UINT32(0, net.cloud.connections);
+    close(listener);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_listener_snapshot);
+    RUN_TEST(test_wildcard_listener);
+    RUN_TEST(test_preflight_rejects_missing_listener);
+    RUN_TEST(test_preflight_warn_launches);
+    RUN_TEST(test_process_metrics);
+    return UNITY_END();
+}
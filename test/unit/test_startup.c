@@ -0,0 +1,63 @@
+/*
+ * Unit test for startup phase timing
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Include startup.c directly to access static variables
+#include "startup.c"
+#include <unity.h>
+
+void test_phases_count_from_process_start(void);
+void test_first_mark_counts(void);
+void test_invalid_phase(void);
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_phases_count_from_process_start(void) {
+    TEST_ASSERT_EQUAL_INT64(-1, startup_phase_ms(STARTUP_MAIN));
+    startup_mark(STARTUP_MAIN);
+    int64_t main_ms = startup_phase_ms(STARTUP_MAIN);
+    TEST_ASSERT_TRUE(main_ms >= 0);
+
+    // The base is when the kernel started this process, not the first mark
+    int64_t start_ms = read_process_start_ms();
+    TEST_ASSERT_TRUE(start_ms > 0);
+    TEST_ASSERT_EQUAL_INT64(start_ms, process_start_ms);
+
+    usleep(20000);
+    startup_mark(STARTUP_READY);
+    TEST_ASSERT_TRUE(startup_phase_ms(STARTUP_READY) >= main_ms + 20);
+}
+
+void test_first_mark_counts(void) {
+    startup_mark(STARTUP_CONFIG);
+    int64_t first = startup_phase_ms(STARTUP_CONFIG);
+    usleep(20000);
+    startup_mark(STARTUP_CONFIG);
+    TEST_ASSERT_EQUAL_INT64(first, startup_phase_ms(STARTUP_CONFIG));
+}
+
+void test_invalid_phase(void) {
+    startup_mark(STARTUP_PHASE_COUNT);
+    TEST_ASSERT_EQUAL_INT64(-1, startup_phase_ms(STARTUP_PHASE_COUNT));
+    TEST_ASSERT_EQUAL_STRING(
+        "unknown", startup_phase_name(STARTUP_PHASE_COUNT)
+    );
+    TEST_ASSERT_EQUAL_STRING(
+        "preflight", startup_phase_name(STARTUP_PREFLIGHT)
+    );
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_phases_count_from_process_start);
+    RUN_TEST(test_first_mark_counts);
+    RUN_TEST(test_invalid_phase);
+    return UNITY_END();
+}
@@ -0,0 +1,234 @@
+/*
+ * Unit test for batched tunnel status messages
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include status_publisher.c directly to access static variables
+#include "status_publisher.c"
+#include "tunnel.c"
+#include <signal.h>
+#include <string.h>
+#include <unity.h>
+
+void test_disabled_by_default(void);
+void test_batch_format(void);
+void test_rejections_counted(void);
+void test_batch_overflow(void);
+void test_names_escaped(void);
+void test_active_read_from_tunnels(void);
+void test_full_batch_fits(void);
+void test_topic_change(void);
+
+#define TEST_DIR "/tmp/gg-test-status-publisher"
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+static uint8_t payload[STATUS_MAX_PAYLOAD + 1];
+
+static void emit(TunnelEventType type, const char *service, int exit_status) {
+    tunnel_event_emit(&(TunnelEvent) {
+        .type = type,
+        .slot = type == TUNNEL_EVENT_REJECT ? -1 : 0,
+        .service = service,
+        .thing_name = "test-thing",
+        .port = 22,
+        .exit_status = exit_status,
+        .lifetime_ms = 65000,
+    });
+}
+
+static void reject(TunnelRejectReason reason) {
+    tunnel_event_emit(&(TunnelEvent) {
+        .type = TUNNEL_EVENT_REJECT,
+        .reason = reason,
+        .slot = -1,
+        .service = "SSH",
+        .thing_name = "test-thing",
+        .exit_status = -1,
+    });
+}
+
+// Takes the pending batch without waiting out the window
+static const char *take_payload(void) {
+    StatusBatch batch;
+    status_batch_ms = 0;
+    take_batch(&batch);
+    for (size_t i = 0; i < batch.count; i++) {
+        batch.events[i].wall_ms = 1000;
+    }
+    // Leave room for a terminator
+    GgByteVec vec = { .buf = { .data = payload },
+                      .capacity = STATUS_MAX_PAYLOAD };
+    TEST_ASSERT_EQUAL(GG_ERR_OK, format_batch(&batch, &vec));
+    payload[vec.buf.len] = '\0';
+    return (const char *) payload;
+}
+
+void setUp(void) {
+    pthread_cond_init(&status_cond, NULL);
+    status_batch = (StatusBatch) { 0 };
+    status_pending = false;
+    strcpy(status_thing, "gateway");
+    atomic_store(&status_enabled, true);
+}
+
+void tearDown(void) {
+    atomic_store(&status_enabled, false);
+}
+
+void test_disabled_by_default(void) {
+    atomic_store(&status_enabled, false);
+    emit(TUNNEL_EVENT_OPEN, "SSH", -1);
+    TEST_ASSERT_FALSE(status_pending);
+    TEST_ASSERT_EQUAL_size_t(0, status_batch.count);
+}
+
+void test_batch_format(void) {
+    emit(TUNNEL_EVENT_OPEN, "SSH", -1);
+    emit(TUNNEL_EVENT_OPEN, "VNC", -1);
+    emit(TUNNEL_EVENT_EXIT, "SSH", 0);
+    emit(TUNNEL_EVENT_EXIT, "VNC", SIGTERM);
+    TEST_ASSERT_TRUE(status_pending);
+
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"thing\":\"gateway\",\"active\":0,\"events\":["
+        "{\"type\":\"open\",\"time\":1000,\"slot\":0,\"service\":\"SSH\","
+        "\"thing\":\"test-thing\"},"
+        "{\"type\":\"open\",\"time\":1000,\"slot\":0,\"service\":\"VNC\","
+        "\"thing\":\"test-thing\"},"
+        "{\"type\":\"exit\",\"time\":1000,\"slot\":0,\"service\":\"SSH\","
+        "\"thing\":\"test-thing\",\"exitCode\":0,\"lifetimeSeconds\":65},"
+        "{\"type\":\"exit\",\"time\":1000,\"slot\":0,\"service\":\"VNC\","
+        "\"thing\":\"test-thing\",\"signal\":15,\"lifetimeSeconds\":65}],"
+        "\"rejected\":{},\"droppedEvents\":0}",
+        take_payload()
+    );
+    TEST_ASSERT_FALSE(status_pending);
+}
+
+void test_rejections_counted(void) {
+    emit(TUNNEL_EVENT_OPEN, "SSH", -1);
+    for (int i = 0; i < 500; i++) {
+        reject(TUNNEL_REJECT_CAPACITY);
+    }
+    reject(TUNNEL_REJECT_RATE_LIMIT);
+
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"thing\":\"gateway\",\"active\":0,\"events\":["
+        "{\"type\":\"open\",\"time\":1000,\"slot\":0,\"service\":\"SSH\","
+        "\"thing\":\"test-thing\"}],"
+        "\"rejected\":{\"capacity\":500,\"rate_limit\":1},"
+        "\"droppedEvents\":0}",
+        take_payload()
+    );
+
+    emit(TUNNEL_EVENT_EXIT, "SSH", 256);
+    TEST_ASSERT_NOT_NULL(strstr(take_payload(), "\"exitCode\":1"));
+}
+
+void test_batch_overflow(void) {
+    for (int i = 0; i < STATUS_MAX_EVENTS + 8; i++) {
+        emit(TUNNEL_EVENT_OPEN, "SSH", -1);
+    }
+    TEST_ASSERT_NOT_NULL(strstr(take_payload(), "\"droppedEvents\":8}"));
+}
+
+void test_names_escaped(void) {
+    emit(TUNNEL_EVENT_OPEN, "a\"b\\c\n", -1);
+    TEST_ASSERT_NOT_NULL(
+        strstr(take_payload(), "\"service\":\"a\\\"b\\\\c\",")
+    );
+}
+
+void test_active_read_from_tunnels(void) {
+    // Opened before publishing started, so its open event was never seen
+    atomic_store(&status_enabled, false);
+    test_reset_tunnels(&config);
+    test_install_stub_localproxy(TEST_DIR, "sleep 2");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, test_notify_tunnel(&config, "token", "SSH"));
+    atomic_store(&status_enabled, true);
+
+    reject(TUNNEL_REJECT_CAPACITY);
+    TEST_ASSERT_NOT_NULL(strstr(take_payload(), "\"active\":1"));
+
+    TEST_ASSERT_NOT_EQUAL(-1, test_wait_for_active(0, 10000));
+    test_remove_directory(TEST_DIR);
+}
+
+void test_full_batch_fits(void) {
+    char service[STATUS_MAX_SERVICE];
+    char thing[STATUS_MAX_THING_NAME];
+    memset(service, '"', sizeof(service) - 1);
+    service[sizeof(service) - 1] = '\0';
+    memset(thing, '\\', sizeof(thing) - 1);
+    thing[sizeof(thing) - 1] = '\0';
+    memset(status_thing, '"', sizeof(status_thing) - 1);
+    status_thing[sizeof(status_thing) - 1] = '\0';
+
+    for (int i = 0; i < STATUS_MAX_EVENTS; i++) {
+        tunnel_event_emit(&(TunnelEvent) {
+            .type = TUNNEL_EVENT_EXIT,
+            .slot = TUNNEL_MAX_SLOTS - 1,
+            .service = service,
+            .thing_name = thing,
+            .exit_status = -1,
+            .lifetime_ms = INT64_MAX,
+        });
+    }
+    for (uint32_t reason = 0; reason < TUNNEL_REJECT_REASON_COUNT; reason++) {
+        for (int i = 0; i < 3; i++) {
+            reject((TunnelRejectReason) reason);
+        }
+    }
+    take_payload();
+    TEST_ASSERT_NOT_NULL(
+        strstr((const char *) payload, "\"droppedEvents\":0}")
+    );
+}
+
+void test_topic_change(void) {
+    // Stands in for the publisher thread so batches stay in place
+    status_started = true;
+
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        status_publisher_set_topic(
+            GG_STR("tunnels/status"), GG_STR("gateway"), 0
+        )
+    );
+    emit(TUNNEL_EVENT_OPEN, "SSH", -1);
+    TEST_ASSERT_TRUE(status_pending);
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        status_publisher_set_topic(GG_STR("tunnels/other"), GG_STR(""), 0)
+    );
+    TEST_ASSERT_EQUAL_size_t(strlen("tunnels/other"), status_topic_len);
+    TEST_ASSERT_EQUAL_MEMORY("tunnels/other", status_topic, status_topic_len);
+    // The batch in progress goes to the new topic
+    TEST_ASSERT_EQUAL_size_t(1, status_batch.count);
+
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, status_publisher_set_topic(GG_STR(""), GG_STR(""), 0)
+    );
+    TEST_ASSERT_FALSE(atomic_load(&status_enabled));
+    TEST_ASSERT_FALSE(status_pending);
+    TEST_ASSERT_EQUAL_size_t(0, status_batch.count);
+    emit(TUNNEL_EVENT_OPEN, "SSH", -1);
+    TEST_ASSERT_FALSE(status_pending);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_disabled_by_default);
+    RUN_TEST(test_batch_format);
+    RUN_TEST(test_rejections_counted);
+    RUN_TEST(test_batch_overflow);
+    RUN_TEST(test_names_escaped);
+    RUN_TEST(test_active_read_from_tunnels);
+    RUN_TEST(test_full_batch_fits);
+    RUN_TEST(test_topic_change);
+    return UNITY_END();
+}
@@ -0,0 +1,125 @@
+/*
+ * Unit tests for the trace ring buffer
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "trace.h"
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WRITER_THREADS 4
+#define EVENTS_PER_WRITER 5000
+
+void test_trace_ids_are_unique(void);
+void test_export_contains_spans(void);
+void test_ring_keeps_newest_events(void);
+void test_concurrent_writers(void);
+
+static char export_buf[256 * 1024];
+
+static size_t export_to_buffer(void) {
+    FILE *f = tmpfile();
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, trace_export_chrome(fileno(f)));
+    rewind(f);
+    size_t len = fread(export_buf, 1, sizeof(export_buf) - 1, f);
+    export_buf[len] = '\0';
+    fclose(f);
+    return len;
+}
+
+static size_t count_occurrences(const char *needle) {
+    size_t count = 0;
+    for (const char *p = export_buf; (p = strstr(p, needle)) != NULL; p++) {
+        count++;
+    }
+    return count;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_trace_ids_are_unique(void) {
+    uint32_t first = trace_begin();
+    TEST_ASSERT_EQUAL_UINT32(first, trace_current());
+    uint32_t second = trace_begin();
+    TEST_ASSERT_NOT_EQUAL(first, second);
+    TEST_ASSERT_NOT_EQUAL(0, second);
+}
+
+void test_export_contains_spans(void) {
+    uint32_t id = trace_begin();
+    trace_record_current(TRACE_IPC_CALLBACK);
+    trace_record_current(TRACE_JSON_DECODE);
+    trace_record(id, TRACE_FORK);
+
+    export_to_buffer();
+    TEST_ASSERT_EQUAL('[', export_buf[0]);
+    TEST_ASSERT_NOT_NULL(strstr(export_buf, "\"name\":\"ipc_callback\""));
+    TEST_ASSERT_NOT_NULL(strstr(export_buf, "\"name\":\"json_decode\""));
+    TEST_ASSERT_NOT_NULL(strstr(export_buf, "\"name\":\"fork\""));
+    TEST_ASSERT_NOT_NULL(strstr(export_buf, "\"ph\":\"X\""));
+    TEST_ASSERT_NOT_NULL(strstr(export_buf, "\n]\n"));
+}
+
+void test_ring_keeps_newest_events(void) {
+    // Trace 0 is never recorded
+    trace_record(0, TRACE_EXIT);
+
+    uint32_t id = trace_begin();
+    for (int i = 0; i < 3000; i++) {
+        trace_record(id, TRACE_DISPATCH);
+    }
+    trace_record(id, TRACE_EXIT);
+
+    export_to_buffer();
+    TEST_ASSERT_EQUAL_size_t(1024, count_occurrences("\"name\""));
+    TEST_ASSERT_EQUAL_size_t(1, count_occurrences("\"name\":\"exit\""));
+}
+
+static void *writer_thread(void *arg) {
+    (void) arg;
+    uint32_t id = trace_begin();
+    for (int i = 0; i < EVENTS_PER_WRITER; i++) {
+        trace_record(id, (TracePoint) (i % TRACE_POINT_COUNT));
+    }
+    return NULL;
+}
+
+void test_concurrent_writers(void) {
+    pthread_t threads[WRITER_THREADS];
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        TEST_ASSERT_EQUAL(
+            0, pthread_create(&threads[i], NULL, writer_thread, NULL)
+        );
+    }
+    // Exporting while writers are active must only yield whole entries
+    export_to_buffer();
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    size_t len = export_to_buffer();
+    TEST_ASSERT_GREATER_THAN(0, len);
+    TEST_ASSERT_EQUAL_size_t(1024, count_occurrences("\"name\""));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_trace_ids_are_unique);
+    RUN_TEST(test_export_contains_spans);
+    RUN_TEST(test_ring_keeps_newest_events);
+    RUN_TEST(test_concurrent_writers);
+
+    return UNITY_END();
+}
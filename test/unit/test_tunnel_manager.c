@@ -0,0 +1,237 @@
+/*
+ * Unit test for hosting the tunnel manager library in another process
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "secure-tunnel-manager.h"
+#include "test_helpers.h"
+#include <gg/arena.h>
+#include <gg/json_decode.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_DIR "/tmp/gg-test-tunnel-manager"
+#define TOPIC "$aws/things/test-thing/tunnels/notify"
+#define MAX_EVENTS 8
+
+void test_second_manager_rejected(void);
+void test_notification_started_by_spawn_hook(void);
+void test_spawn_hook_may_decline(void);
+void test_rejection_reported(void);
+void test_configure_applies_limits(void);
+void test_deinit_waits_for_tunnels(void);
+
+static SecureTunnelConfig config = TEST_TUNNEL_CONFIG(TEST_DIR);
+
+static SecureTunnelManager manager;
+
+static pthread_mutex_t record_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int spawn_calls = 0;
+static bool spawn_declines = false;
+static char spawn_token[64];
+static SecureTunnelEventType event_types[MAX_EVENTS];
+static char event_reasons[MAX_EVENTS][32];
+static int event_count = 0;
+
+// Starts localproxy the way a host with its own process supervisor would
+static GgError host_spawn(
+    void *ctx, const SecureTunnelSpawn *spawn, pid_t *pid, int *pidfd
+) {
+    TEST_ASSERT_EQUAL_PTR(&manager, ctx);
+    pthread_mutex_lock(&record_mutex);
+    spawn_calls++;
+    snprintf(spawn_token, sizeof(spawn_token), "%s", spawn->access_token);
+    bool decline = spawn_declines;
+    pthread_mutex_unlock(&record_mutex);
+    if (decline) {
+        return GG_ERR_UNSUPPORTED;
+    }
+
+    pid_t child = fork();
+    if (child == -1) {
+        return GG_ERR_FAILURE;
+    }
+    if (child == 0) {
+        dup2(spawn->output_fd, STDOUT_FILENO);
+        dup2(spawn->output_fd, STDERR_FILENO);
+        setenv("AWSIOT_TUNNEL_ACCESS_TOKEN", spawn->access_token, 1);
+        fexecve(spawn->exe_fd, (char *const *) spawn->args, environ);
+        int exec_errno = errno;
+        (void) !write(spawn->status_fd, &exec_errno, sizeof(exec_errno));
+        _exit(1);
+    }
+    *pid = child;
+    *pidfd = -1;
+    return GG_ERR_OK;
+}
+
+static void host_notify(void *ctx, const SecureTunnelEvent *event) {
+    TEST_ASSERT_EQUAL_PTR(&manager, ctx);
+    pthread_mutex_lock(&record_mutex);
+    if (event_count < MAX_EVENTS) {
+        event_types[event_count] = event->type;
+        snprintf(
+            event_reasons[event_count],
+            sizeof(event_reasons[event_count]),
+            "%s",
+            event->reason != NULL ? event->reason : ""
+        );
+        event_count++;
+    }
+    pthread_mutex_unlock(&record_mutex);
+}
+
+static GgError notify(const char *token, const char *service) {
+    char json[160];
+    snprintf(
+        json,
+        sizeof(json),
+        "{\"clientAccessToken\":\"%s\",\"region\":\"us-west-2\","
+        "\"services\":[\"%s\"]}",
+        token,
+        service
+    );
+    return secure_tunnel_manager_notify(
+        &manager, GG_STR(TOPIC), gg_buffer_from_null_term(json)
+    );
+}
+
+static GgError configure(char *json) {
+    uint8_t arena_mem[1024];
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    GgObject obj;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        gg_json_decode_destructive(gg_buffer_from_null_term(json), &arena, &obj)
+    );
+    return secure_tunnel_manager_configure(&manager, gg_obj_into_map(obj));
+}
+
+static void wait_for_active(size_t active) {
+    for (int i = 0; i < 300; i++) {
+        if (secure_tunnel_manager_active(&manager) == active) {
+            return;
+        }
+        usleep(10000);
+    }
+}
+
+static int recorded_events(void) {
+    pthread_mutex_lock(&record_mutex);
+    int count = event_count;
+    pthread_mutex_unlock(&record_mutex);
+    return count;
+}
+
+void setUp(void) {
+    pthread_mutex_lock(&record_mutex);
+    spawn_calls = 0;
+    spawn_declines = false;
+    spawn_token[0] = '\0';
+    event_count = 0;
+    pthread_mutex_unlock(&record_mutex);
+    // Holds its slot briefly so launches can be counted
+    test_install_stub_localproxy(TEST_DIR, "sleep 1");
+}
+
+void tearDown(void) {
+    wait_for_active(0);
+    test_remove_directory(TEST_DIR);
+}
+
+void test_second_manager_rejected(void) {
+    SecureTunnelManager other;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_BUSY, secure_tunnel_manager_init(&other, &config, NULL)
+    );
+}
+
+void test_notification_started_by_spawn_hook(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("host-token", "SSH"));
+    TEST_ASSERT_EQUAL_size_t(1, secure_tunnel_manager_active(&manager));
+
+    wait_for_active(0);
+    TEST_ASSERT_EQUAL_INT(1, spawn_calls);
+    TEST_ASSERT_EQUAL_STRING("host-token", spawn_token);
+    TEST_ASSERT_EQUAL_INT(2, recorded_events());
+    TEST_ASSERT_EQUAL(SECURE_TUNNEL_OPENED, event_types[0]);
+    TEST_ASSERT_EQUAL(SECURE_TUNNEL_EXITED, event_types[1]);
+}
+
+void test_spawn_hook_may_decline(void) {
+    spawn_declines = true;
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("token", "SSH"));
+    wait_for_active(0);
+    TEST_ASSERT_EQUAL_INT(1, spawn_calls);
+    TEST_ASSERT_EQUAL_INT(2, recorded_events());
+    TEST_ASSERT_EQUAL(SECURE_TUNNEL_EXITED, event_types[1]);
+}
+
+void test_rejection_reported(void) {
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, notify("token", "FTP"));
+    TEST_ASSERT_EQUAL_INT(0, spawn_calls);
+    TEST_ASSERT_EQUAL_INT(1, recorded_events());
+    TEST_ASSERT_EQUAL(SECURE_TUNNEL_REJECTED, event_types[0]);
+    TEST_ASSERT_EQUAL_STRING("unsupported_service", event_reasons[0]);
+}
+
+void test_configure_applies_limits(void) {
+    char limit[] = "{\"maxConcurrentTunnels\":1}";
+    TEST_ASSERT_EQUAL(GG_ERR_OK, configure(limit));
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("t1", "SSH"));
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, notify("t2", "SSH"));
+    TEST_ASSERT_EQUAL_STRING("capacity", event_reasons[1]);
+
+    char invalid[] = "{\"maxConcurrentTunnels\":0}";
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, configure(invalid));
+    char reset[] = "{}";
+    TEST_ASSERT_EQUAL(GG_ERR_OK, configure(reset));
+}
+
+void test_deinit_waits_for_tunnels(void) {
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("t1", "SSH"));
+    TEST_ASSERT_EQUAL(GG_ERR_BUSY, secure_tunnel_manager_deinit(&manager));
+
+    wait_for_active(0);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, secure_tunnel_manager_deinit(&manager));
+    SecureTunnelManager other;
+    TEST_ASSERT_EQUAL(GG_ERR_INVALID, secure_tunnel_manager_deinit(&other));
+
+    // The next manager starts localproxy without the hooks
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK, secure_tunnel_manager_init(&manager, &config, NULL)
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, notify("t2", "SSH"));
+    wait_for_active(0);
+    TEST_ASSERT_EQUAL_INT(1, spawn_calls);
+    TEST_ASSERT_EQUAL_INT(2, recorded_events());
+}
+
+int main(void) {
+    SecureTunnelHooks hooks = {
+        .spawn = host_spawn,
+        .notify = host_notify,
+        .ctx = &manager,
+    };
+    if (secure_tunnel_manager_init(&manager, &config, &hooks) != GG_ERR_OK) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_second_manager_rejected);
+    RUN_TEST(test_notification_started_by_spawn_hook);
+    RUN_TEST(test_spawn_hook_may_decline);
+    RUN_TEST(test_rejection_reported);
+    RUN_TEST(test_configure_applies_limits);
+    RUN_TEST(test_deinit_waits_for_tunnels);
+    return UNITY_END();
+}
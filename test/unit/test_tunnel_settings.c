@@ -0,0 +1,465 @@
+/*
+ * Unit tests for tunnel settings parsing
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "tunnel_settings.h"
+#include <gg/arena.h>
+#include <gg/json_decode.h>
+#include <string.h>
+#include <unity.h>
+#include <stdio.h>
+
+void test_defaults_from_args(void);
+void test_update_limits(void);
+void test_update_service_mappings(void);
+void test_update_numeric_strings(void);
+void test_update_rejects_out_of_range(void);
+void test_update_rejects_bad_port(void);
+void test_update_ignores_unrelated_keys(void);
+void test_settings_keys_are_read(void);
+void test_update_gateway_destinations(void);
+void test_update_rejects_bad_destination(void);
+void test_update_launch_limits(void);
+void test_update_idle_timeout(void);
+void test_update_destination_client_type(void);
+void test_update_destination_preflight(void);
+void test_update_localproxy_host(void);
+void test_update_host_max_tunnels(void);
+void test_update_pressure_limits(void);
+void test_update_service_network_namespaces(void);
+void test_update_service_latency_classes(void);
+
+static const SecureTunnelConfig ARGS = {
+    .thing_name = GG_STR("test-thing"),
+    .region = GG_STR("us-west-2"),
+    .artifact_path = GG_STR("/opt/localproxy"),
+    .max_concurrent_tunnels = 5,
+    .tunnel_timeout_seconds = 3600,
+};
+
+static char json_buf[512];
+static uint8_t arena_mem[2048];
+
+static GgMap decode_config(const char *json) {
+    snprintf(json_buf, sizeof(json_buf), "%s", json);
+    GgArena arena = gg_arena_init(GG_BUF(arena_mem));
+    GgObject obj;
+    TEST_ASSERT_EQUAL(
+        GG_ERR_OK,
+        gg_json_decode_destructive(
+            gg_buffer_from_null_term(json_buf), &arena, &obj
+        )
+    );
+    return gg_obj_into_map(obj);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_defaults_from_args(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    TEST_ASSERT_EQUAL_INT(5, settings.max_concurrent_tunnels);
+    TEST_ASSERT_EQUAL_INT(3600, settings.tunnel_timeout_seconds);
+    TEST_ASSERT_EQUAL_size_t(2, settings.service_count);
+    TEST_ASSERT_EQUAL_STRING("SSH", settings.services[0].name);
+    TEST_ASSERT_EQUAL_UINT16(22, settings.services[0].port);
+    TEST_ASSERT_EQUAL_STRING("VNC", settings.services[1].name);
+    TEST_ASSERT_EQUAL_UINT16(5900, settings.services[1].port);
+}
+
+void test_update_limits(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    GgMap config = decode_config(
+        "{\"maxConcurrentTunnels\":3,\"tunnelTimeoutSeconds\":600}"
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+
+    TEST_ASSERT_EQUAL_INT(3, settings.max_concurrent_tunnels);
+    TEST_ASSERT_EQUAL_INT(600, settings.tunnel_timeout_seconds);
+    TEST_ASSERT_EQUAL_size_t(2, settings.service_count);
+}
+
+void test_update_service_mappings(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    GgMap config
+        = decode_config("{\"serviceMappings\":{\"SSH\":2222,\"HTTP\":8080}}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+
+    TEST_ASSERT_EQUAL_size_t(2, settings.service_count);
+    TEST_ASSERT_EQUAL_STRING("SSH", settings.services[0].name);
+    TEST_ASSERT_EQUAL_UINT16(2222, settings.services[0].port);
+    TEST_ASSERT_EQUAL_STRING("HTTP", settings.services[1].name);
+    TEST_ASSERT_EQUAL_UINT16(8080, settings.services[1].port);
+}
+
+void test_update_numeric_strings(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    GgMap config = decode_config("{\"maxConcurrentTunnels\":\"7\"}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(7, settings.max_concurrent_tunnels);
+}
+
+void test_update_rejects_out_of_range(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    // A rejected update must leave every field untouched
+    GgMap config = decode_config(
+        "{\"tunnelTimeoutSeconds\":60,\"maxConcurrentTunnels\":21}"
+    );
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(5, settings.max_concurrent_tunnels);
+    TEST_ASSERT_EQUAL_INT(3600, settings.tunnel_timeout_seconds);
+
+    config = decode_config("{\"tunnelTimeoutSeconds\":43201}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(3600, settings.tunnel_timeout_seconds);
+
+    // Too large for int64, so it must be rejected before any cast
+    config = decode_config("{\"tunnelTimeoutSeconds\":1e300}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(3600, settings.tunnel_timeout_seconds);
+}
+
+void test_update_rejects_bad_port(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    GgMap config = decode_config("{\"serviceMappings\":{\"SSH\":70000}}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+
+    config = decode_config("{\"serviceMappings\":{}}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+
+    TEST_ASSERT_EQUAL_size_t(2, settings.service_count);
+    TEST_ASSERT_EQUAL_UINT16(22, settings.services[0].port);
+}
+
+void test_update_ignores_unrelated_keys(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    GgMap config = decode_config("{\"accessControl\":{}}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(5, settings.max_concurrent_tunnels);
+}
+
+// Only TUNNEL_SETTINGS_KEYS are fetched on reload, so each must be one that
+// tunnel_settings_update reads
+void test_settings_keys_are_read(void) {
+    for (size_t i = 0; i < TUNNEL_SETTINGS_KEY_COUNT; i++) {
+        TunnelSettings settings;
+        tunnel_settings_from_args(&ARGS, &settings);
+        char json[96];
+        snprintf(
+            json,
+            sizeof(json),
+            "{\"%.*s\":[[]]}",
+            (int) TUNNEL_SETTINGS_KEYS[i].len,
+            TUNNEL_SETTINGS_KEYS[i].data
+        );
+        GgError ret = tunnel_settings_update(decode_config(json), &settings);
+        TEST_ASSERT_TRUE_MESSAGE(ret != GG_ERR_OK, json);
+    }
+}
+
+void test_update_gateway_destinations(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    GgMap config = decode_config(
+        "{\"maxTunnelsPerThing\":2,\"gatewayDestinations\":{"
+        "\"cam-1\":{\"host\":\"10.0.0.5\"},"
+        "\"cam-2\":{\"host\":\"cam-2.local\","
+        "\"serviceMappings\":{\"SSH\":2222}}}}"
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+
+    TEST_ASSERT_EQUAL_INT(2, settings.max_tunnels_per_thing);
+    TEST_ASSERT_EQUAL_size_t(2, settings.destination_count);
+
+    const TunnelDestination *cam1
+        = tunnel_settings_find_destination(&settings, GG_STR("cam-1"));
+    TEST_ASSERT_NOT_NULL(cam1);
+    TEST_ASSERT_EQUAL_STRING("10.0.0.5", cam1->host);
+    TEST_ASSERT_EQUAL_size_t(0, cam1->service_count);
+
+    const TunnelDestination *cam2
+        = tunnel_settings_find_destination(&settings, GG_STR("cam-2"));
+    TEST_ASSERT_NOT_NULL(cam2);
+    TEST_ASSERT_EQUAL_STRING("cam-2.local", cam2->host);
+    TEST_ASSERT_EQUAL_size_t(1, cam2->service_count);
+    TEST_ASSERT_EQUAL_UINT16(2222, cam2->services[0].port);
+
+    TEST_ASSERT_NULL(
+        tunnel_settings_find_destination(&settings, GG_STR("cam-3"))
+    );
+}
+
+void test_update_rejects_bad_destination(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+
+    GgMap config = decode_config(
+        "{\"gatewayDestinations\":{\"cam-1\":{\"host\":\"-oProxy\"}}}"
+    );
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+
+    config = decode_config("{\"gatewayDestinations\":{\"cam-1\":{}}}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+
+    config = decode_config("{\"maxTunnelsPerThing\":21}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+
+    TEST_ASSERT_EQUAL_size_t(0, settings.destination_count);
+    TEST_ASSERT_EQUAL_INT(0, settings.max_tunnels_per_thing);
+}
+
+void test_update_launch_limits(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_EQUAL_INT(0, settings.launches_per_minute);
+    TEST_ASSERT_EQUAL_INT(5, settings.launch_burst);
+    TEST_ASSERT_EQUAL_INT(0, settings.launch_coalesce_ms);
+
+    GgMap config = decode_config(
+        "{\"launchesPerMinute\":30,\"launchBurst\":3,"
+        "\"launchCoalesceMs\":500}"
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(30, settings.launches_per_minute);
+    TEST_ASSERT_EQUAL_INT(3, settings.launch_burst);
+    TEST_ASSERT_EQUAL_INT(500, settings.launch_coalesce_ms);
+
+    config = decode_config("{\"launchBurst\":0}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    config = decode_config("{\"launchCoalesceMs\":10001}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(3, settings.launch_burst);
+}
+
+void test_update_idle_timeout(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_EQUAL_INT(0, settings.idle_timeout_seconds);
+
+    GgMap config = decode_config("{\"idleTimeoutSeconds\":\"900\"}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(900, settings.idle_timeout_seconds);
+
+    config = decode_config("{\"idleTimeoutSeconds\":-1}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(900, settings.idle_timeout_seconds);
+}
+
+void test_update_destination_client_type(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_EQUAL(TUNNEL_CLIENT_AUTO, settings.destination_client_type);
+
+    GgMap config = decode_config("{\"destinationClientType\":\"V1\"}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL(TUNNEL_CLIENT_V1, settings.destination_client_type);
+
+    config = decode_config("{\"destinationClientType\":\"V2\"}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL(TUNNEL_CLIENT_V1, settings.destination_client_type);
+
+    config = decode_config("{\"destinationClientType\":\"auto\"}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL(TUNNEL_CLIENT_AUTO, settings.destination_client_type);
+}
+
+void test_update_destination_preflight(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_EQUAL(TUNNEL_PREFLIGHT_WARN, settings.destination_preflight);
+
+    GgMap config = decode_config("{\"destinationPreflight\":\"reject\"}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL(TUNNEL_PREFLIGHT_REJECT, settings.destination_preflight);
+
+    config = decode_config("{\"destinationPreflight\":true}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL(TUNNEL_PREFLIGHT_REJECT, settings.destination_preflight);
+
+    config = decode_config("{\"destinationPreflight\":\"off\"}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL(TUNNEL_PREFLIGHT_OFF, settings.destination_preflight);
+}
+
+void test_update_localproxy_host(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_FALSE(settings.proxy_host);
+
+    GgMap config = decode_config("{\"localproxyHost\":true}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_TRUE(settings.proxy_host);
+
+    config = decode_config("{\"localproxyHost\":\"yes\"}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_TRUE(settings.proxy_host);
+
+    config = decode_config("{\"localproxyHost\":\"false\"}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_FALSE(settings.proxy_host);
+}
+
+void test_update_host_max_tunnels(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_EQUAL_INT(0, settings.host_max_tunnels);
+
+    GgMap config = decode_config("{\"hostMaxTunnels\":40}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(40, settings.host_max_tunnels);
+
+    config = decode_config("{\"hostMaxTunnels\":1025}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(40, settings.host_max_tunnels);
+}
+
+void test_update_pressure_limits(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_EQUAL_INT(0, settings.pressure_percent[PRESSURE_CPU]);
+    TEST_ASSERT_EQUAL_INT(0, settings.pressure_defer_seconds);
+
+    GgMap config = decode_config(
+        "{\"launchPressureThresholds\":{\"memory\":20,\"io\":40},"
+        "\"launchPressureDeferSeconds\":30,\"pressureNice\":10}"
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(0, settings.pressure_percent[PRESSURE_CPU]);
+    TEST_ASSERT_EQUAL_INT(20, settings.pressure_percent[PRESSURE_MEMORY]);
+    TEST_ASSERT_EQUAL_INT(40, settings.pressure_percent[PRESSURE_IO]);
+    TEST_ASSERT_EQUAL_INT(30, settings.pressure_defer_seconds);
+    TEST_ASSERT_EQUAL_INT(10, settings.pressure_nice);
+
+    config = decode_config("{\"launchPressureThresholds\":{\"cpu\":101}}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    config = decode_config("{\"pressureNice\":20}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_INT(20, settings.pressure_percent[PRESSURE_MEMORY]);
+    TEST_ASSERT_EQUAL_INT(10, settings.pressure_nice);
+}
+
+void test_update_service_network_namespaces(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_NULL(tunnel_settings_find_namespace(&settings, GG_STR("SSH")));
+
+    GgMap config = decode_config(
+        "{\"serviceNetworkNamespaces\":{\"SSH\":\"/run/netns/sshd\","
+        "\"VNC\":4242}}"
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_STRING(
+        "/run/netns/sshd",
+        tunnel_settings_find_namespace(&settings, GG_STR("SSH"))
+    );
+    TEST_ASSERT_EQUAL_STRING(
+        "/proc/4242/ns/net",
+        tunnel_settings_find_namespace(&settings, GG_STR("VNC"))
+    );
+
+    config = decode_config(
+        "{\"serviceNetworkNamespaces\":{\"SSH\":\"run/netns/sshd\"}}"
+    );
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    config = decode_config("{\"serviceNetworkNamespaces\":{\"SSH\":0}}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_size_t(2, settings.namespace_count);
+
+    config = decode_config("{\"serviceNetworkNamespaces\":{}}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_NULL(tunnel_settings_find_namespace(&settings, GG_STR("SSH")));
+}
+
+void test_update_service_latency_classes(void) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&ARGS, &settings);
+    TEST_ASSERT_NULL(tunnel_settings_find_latency(&settings, GG_STR("SSH")));
+
+    GgMap config = decode_config(
+        "{\"serviceLatencyClasses\":{\"SSH\":\"interactive\","
+        "\"VNC\":{\"nice\":5,\"ioClass\":\"idle\",\"cpus\":[1,3],"
+        "\"cgroup\":\"/sys/fs/cgroup/tunnels/vnc\"}}}"
+    );
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    const LatencyClass *ssh
+        = tunnel_settings_find_latency(&settings, GG_STR("SSH"));
+    TEST_ASSERT_NOT_NULL(ssh);
+    TEST_ASSERT_FALSE(ssh->renice);
+    TEST_ASSERT_EQUAL_UINT8(LATENCY_IO_BEST_EFFORT, ssh->io_class);
+    TEST_ASSERT_EQUAL_UINT8(0, ssh->io_level);
+    const LatencyClass *vnc
+        = tunnel_settings_find_latency(&settings, GG_STR("VNC"));
+    TEST_ASSERT_NOT_NULL(vnc);
+    TEST_ASSERT_TRUE(vnc->renice);
+    TEST_ASSERT_EQUAL_INT(5, vnc->nice);
+    TEST_ASSERT_EQUAL_UINT8(LATENCY_IO_IDLE, vnc->io_class);
+    TEST_ASSERT_TRUE(vnc->cpus == 0xA);
+    TEST_ASSERT_EQUAL_STRING("/sys/fs/cgroup/tunnels/vnc", vnc->cgroup);
+
+    config = decode_config("{\"serviceLatencyClasses\":{\"SSH\":\"fast\"}}");
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    config = decode_config(
+        "{\"serviceLatencyClasses\":{\"SSH\":{\"nice\":-21}}}"
+    );
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    config = decode_config(
+        "{\"serviceLatencyClasses\":{\"SSH\":{\"cpus\":[64]}}}"
+    );
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    config = decode_config(
+        "{\"serviceLatencyClasses\":{\"SSH\":{\"cgroup\":\"tunnels\"}}}"
+    );
+    TEST_ASSERT_NOT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_EQUAL_size_t(2, settings.latency_count);
+
+    config = decode_config("{\"serviceLatencyClasses\":{}}");
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_settings_update(config, &settings));
+    TEST_ASSERT_NULL(tunnel_settings_find_latency(&settings, GG_STR("SSH")));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_defaults_from_args);
+    RUN_TEST(test_update_limits);
+    RUN_TEST(test_update_service_mappings);
+    RUN_TEST(test_update_numeric_strings);
+    RUN_TEST(test_update_rejects_out_of_range);
+    RUN_TEST(test_update_rejects_bad_port);
+    RUN_TEST(test_update_ignores_unrelated_keys);
+    RUN_TEST(test_settings_keys_are_read);
+    RUN_TEST(test_update_gateway_destinations);
+    RUN_TEST(test_update_rejects_bad_destination);
+    RUN_TEST(test_update_launch_limits);
+    RUN_TEST(test_update_idle_timeout);
+    RUN_TEST(test_update_destination_client_type);
+    RUN_TEST(test_update_destination_preflight);
+    RUN_TEST(test_update_localproxy_host);
+    RUN_TEST(test_update_host_max_tunnels);
+    RUN_TEST(test_update_pressure_limits);
+    RUN_TEST(test_update_service_network_namespaces);
+    RUN_TEST(test_update_service_latency_classes);
+
+    return UNITY_END();
+}
@@ -0,0 +1,615 @@
+/*
+ * Simulated clock harness for tunnel lifetimes, idle timeouts and launch
+ * rate limits
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "test_helpers.h"
+// Include tunnel.c directly to access static variables
+#include "tunnel.c"
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unity.h>
+#include <stdio.h>
+
+#define TEST_DIR "/tmp/gg-test-tunnel-simulation"
+#define SIM_EPOCH_MS 1000000000LL // On the sampling grid; 0 means not stopping
+#define SETTLE_TIMEOUT_MS 5000
+#define MAX_EXITS 64
+#define DEFAULT_SIM_DAYS 2
+#define MEAN_ARRIVAL_MS (240 * 1000)
+
+void test_lifetime_expires_on_time(void);
+void test_stop_escalates_after_grace(void);
+void test_close_escalates_after_grace(void);
+void test_idle_tunnel_closed_on_sample(void);
+void test_launch_tokens_refill_on_clock(void);
+void test_days_of_churn(void);
+
+// Virtual time, advanced by the test. The tunnel monitor is the only thread
+// that sleeps on the tunnel clock.
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int64_t now_ms;
+    bool sleeping;
+    bool woken;
+    int64_t sleep_deadline_ms;
+    uint64_t wakeups;
+} VirtualClock;
+
+typedef struct {
+    int slot;
+    int64_t lifetime_ms;
+    int exit_status;
+} TunnelExit;
+
+static VirtualClock vclock = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .now_ms = SIM_EPOCH_MS,
+};
+
+static pthread_mutex_t exits_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TunnelExit exits[MAX_EXITS];
+static size_t exit_count = 0;
+
+static bool stub_ignores_term = false;
+static pid_t stubborn_pid = 0;
+static unsigned int sim_seed = 1;
+
+static SecureTunnelConfig config = {
+    .thing_name = GG_STR("test-thing"),
+    .region = GG_STR("us-west-2"),
+    .artifact_path = GG_STR(TEST_DIR),
+    .max_concurrent_tunnels = TUNNEL_MAX_SLOTS,
+    .tunnel_timeout_seconds = 43200,
+};
+
+static int64_t virtual_now_ms(void *ctx) {
+    (void) ctx;
+    GG_MTX_SCOPE_GUARD(&vclock.mutex);
+    return vclock.now_ms;
+}
+
+static void virtual_sleep_until(void *ctx, int64_t deadline_ms) {
+    (void) ctx;
+    GG_MTX_SCOPE_GUARD(&vclock.mutex);
+    vclock.wakeups++;
+    while (!vclock.woken && vclock.now_ms < deadline_ms) {
+        vclock.sleeping = true;
+        vclock.sleep_deadline_ms = deadline_ms;
+        pthread_cond_broadcast(&vclock.cond);
+        pthread_cond_wait(&vclock.cond, &vclock.mutex);
+    }
+    vclock.sleeping = false;
+    vclock.woken = false;
+}
+
+static void virtual_wake(void *ctx) {
+    (void) ctx;
+    GG_MTX_SCOPE_GUARD(&vclock.mutex);
+    vclock.woken = true;
+    vclock.sleeping = false;
+    pthread_cond_broadcast(&vclock.cond);
+}
+
+static const TunnelClock virtual_clock = {
+    .now_ms = virtual_now_ms,
+    .sleep_until = virtual_sleep_until,
+    .wake = virtual_wake,
+};
+
+// Stub localproxy: a forked child that carries no traffic and runs until it
+// is signalled
+static GgError spawn_stub(
+    void *ctx, const SecureTunnelSpawn *spawn, pid_t *pid, int *pidfd
+) {
+    (void) ctx;
+    bool ignore_term = stub_ignores_term;
+    pid_t child = fork();
+    if (child == 0) {
+        if (ignore_term) {
+            signal(SIGTERM, SIG_IGN);
+        }
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        dup2(spawn->output_fd, STDOUT_FILENO);
+        // Closing status_fd reports a successful start
+        close_range(STDERR_FILENO + 1, ~0U, 0);
+        while (true) {
+            pause();
+        }
+    }
+    if (child == -1) {
+        return GG_ERR_FAILURE;
+    }
+    *pid = child;
+    *pidfd = (int) syscall(SYS_pidfd_open, child, 0);
+    if (ignore_term) {
+        stubborn_pid = child;
+    }
+    return GG_ERR_OK;
+}
+
+static const SecureTunnelHooks stub_hooks = { .spawn = spawn_stub };
+
+// Called with tunnel_mutex held
+static void record_exit(const TunnelEvent *event) {
+    if (event->type != TUNNEL_EVENT_EXIT) {
+        return;
+    }
+    GG_MTX_SCOPE_GUARD(&exits_mutex);
+    if (exit_count < MAX_EXITS) {
+        exits[exit_count++] = (TunnelExit) {
+            .slot = event->slot,
+            .lifetime_ms = event->lifetime_ms,
+            .exit_status = event->exit_status,
+        };
+    }
+}
+
+// Moves the exits recorded so far to out
+static size_t take_exits(TunnelExit *out) {
+    GG_MTX_SCOPE_GUARD(&exits_mutex);
+    size_t count = exit_count;
+    memcpy(out, exits, count * sizeof(*exits));
+    exit_count = 0;
+    return count;
+}
+
+static int64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static bool slot_occupied(int slot) {
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    return (tunnel_slots_mask & (1U << slot)) != 0;
+}
+
+// Whether a tunnel is still starting, or was stopped by the monitor and has
+// not exited yet. A stub ignoring SIGTERM counts once it was killed.
+static bool tunnels_unsettled(void) {
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        const TunnelCreationContext *ctx = &tunnel_contexts[slot];
+        if ((tunnel_slots_mask & (1U << slot)) == 0) {
+            continue;
+        }
+        if (ctx->pid == 0
+            || (ctx->stop_ms != 0
+                && (ctx->killed || ctx->pid != stubborn_pid))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Waits in real time for tunnel workers to act on the current virtual time
+static void settle(void) {
+    for (int waited = 0; waited < SETTLE_TIMEOUT_MS * 10; waited++) {
+        if (!tunnels_unsettled()) {
+            return;
+        }
+        usleep(100);
+    }
+    TEST_FAIL_MESSAGE("Tunnels did not settle");
+}
+
+// Caller holds vclock.mutex
+static void wait_for_monitor_sleep(void) {
+    while (!vclock.sleeping) {
+        pthread_cond_wait(&vclock.cond, &vclock.mutex);
+    }
+}
+
+// Steps the virtual clock through each monitor deadline up to target_ms,
+// letting the monitor and tunnel workers finish before the next step
+static void advance_to(int64_t target_ms) {
+    while (true) {
+        {
+            GG_MTX_SCOPE_GUARD(&vclock.mutex);
+            wait_for_monitor_sleep();
+            if (vclock.sleep_deadline_ms > target_ms) {
+                vclock.now_ms = target_ms;
+                return;
+            }
+            vclock.now_ms = vclock.sleep_deadline_ms;
+            vclock.sleeping = false;
+            pthread_cond_broadcast(&vclock.cond);
+            wait_for_monitor_sleep();
+        }
+        settle();
+    }
+}
+
+static void set_limits(int timeout_seconds, int idle_timeout_seconds) {
+    GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+    tunnel_settings.tunnel_timeout_seconds = timeout_seconds;
+    tunnel_settings.idle_timeout_seconds = idle_timeout_seconds;
+}
+
+static void apply_settings(int launches_per_minute) {
+    TunnelSettings settings;
+    tunnel_settings_from_args(&config, &settings);
+    settings.destination_preflight = TUNNEL_PREFLIGHT_OFF;
+    settings.launches_per_minute = launches_per_minute;
+    settings.launch_burst = 1;
+    tunnel_apply_settings(&settings);
+}
+
+// Returns the slot of the new tunnel once its stub runs, or -1 with the
+// admission error in ret
+static int open_tunnel(GgError *ret) {
+    uint32_t before;
+    {
+        GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+        before = tunnel_slots_mask;
+    }
+    *ret = test_notify_tunnel(&config, "token", "SSH");
+    if (*ret != GG_ERR_OK) {
+        return -1;
+    }
+    uint32_t added;
+    {
+        GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+        added = tunnel_slots_mask & ~before;
+    }
+    TEST_ASSERT_TRUE(added != 0);
+    settle();
+    return __builtin_ctz(added);
+}
+
+static int env_int(const char *name, int fallback) {
+    // NOLINTNEXTLINE(concurrency-mt-unsafe)
+    const char *val = getenv(name);
+    return val != NULL ? atoi(val) : fallback;
+}
+
+void setUp(void) {
+    apply_settings(0);
+    stub_ignores_term = false;
+    TunnelExit discarded[MAX_EXITS];
+    (void) take_exits(discarded);
+}
+
+void tearDown(void) {
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+}
+
+void test_lifetime_expires_on_time(void) {
+    GgError ret;
+    int slot = open_tunnel(&ret);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+    int64_t start = virtual_now_ms(NULL);
+
+    advance_to(start + 3600 * 1000);
+    TunnelInfo info;
+    TEST_ASSERT_EQUAL_size_t(1, tunnel_list(&info, 1));
+    TEST_ASSERT_EQUAL_INT64(3600, info.age_seconds);
+    TEST_ASSERT_EQUAL_INT64(43200 - 3600, info.remaining_seconds);
+
+    advance_to(start + 43200 * 1000 - 1);
+    TEST_ASSERT_EQUAL_INT(1, test_active_tunnels());
+    advance_to(start + 43200 * 1000);
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    TunnelExit ended[MAX_EXITS];
+    TEST_ASSERT_EQUAL_size_t(1, take_exits(ended));
+    TEST_ASSERT_EQUAL_INT(slot, ended[0].slot);
+    TEST_ASSERT_EQUAL_INT64(43200 * 1000, ended[0].lifetime_ms);
+    TEST_ASSERT_TRUE(WIFSIGNALED(ended[0].exit_status));
+    TEST_ASSERT_EQUAL_INT(SIGTERM, WTERMSIG(ended[0].exit_status));
+}
+
+void test_stop_escalates_after_grace(void) {
+    set_limits(60, 0);
+    stub_ignores_term = true;
+    GgError ret;
+    (void) open_tunnel(&ret);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+    int64_t start = virtual_now_ms(NULL);
+
+    advance_to(start + 60 * 1000);
+    TunnelInfo info;
+    TEST_ASSERT_EQUAL_size_t(1, tunnel_list(&info, 1));
+    TEST_ASSERT_TRUE(info.stopping);
+    advance_to(start + 60 * 1000 + LOCALPROXY_STOP_GRACE_MS - 1);
+    TEST_ASSERT_EQUAL_INT(1, test_active_tunnels());
+    advance_to(start + 60 * 1000 + LOCALPROXY_STOP_GRACE_MS);
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    TunnelExit ended[MAX_EXITS];
+    TEST_ASSERT_EQUAL_size_t(1, take_exits(ended));
+    TEST_ASSERT_EQUAL_INT64(
+        60 * 1000 + LOCALPROXY_STOP_GRACE_MS, ended[0].lifetime_ms
+    );
+    TEST_ASSERT_TRUE(WIFSIGNALED(ended[0].exit_status));
+    TEST_ASSERT_EQUAL_INT(SIGKILL, WTERMSIG(ended[0].exit_status));
+}
+
+void test_close_escalates_after_grace(void) {
+    stub_ignores_term = true;
+    GgError ret;
+    int slot = open_tunnel(&ret);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+    int64_t closed = virtual_now_ms(NULL);
+
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_close(slot));
+    TunnelInfo info;
+    TEST_ASSERT_EQUAL_size_t(1, tunnel_list(&info, 1));
+    TEST_ASSERT_TRUE(info.stopping);
+    advance_to(closed + LOCALPROXY_STOP_GRACE_MS - 1);
+    // Closing again must not cut the grace period short
+    TEST_ASSERT_EQUAL(GG_ERR_OK, tunnel_close(slot));
+    TEST_ASSERT_EQUAL_INT(1, test_active_tunnels());
+    advance_to(closed + LOCALPROXY_STOP_GRACE_MS);
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    TunnelExit ended[MAX_EXITS];
+    TEST_ASSERT_EQUAL_size_t(1, take_exits(ended));
+    TEST_ASSERT_TRUE(WIFSIGNALED(ended[0].exit_status));
+    TEST_ASSERT_EQUAL_INT(SIGKILL, WTERMSIG(ended[0].exit_status));
+}
+
+// Idleness is judged on samples, which fall on multiples of the interval
+void test_idle_tunnel_closed_on_sample(void) {
+    set_limits(43200, 300);
+    advance_to(virtual_now_ms(NULL) + 4321);
+    GgError ret;
+    (void) open_tunnel(&ret);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+    int64_t start = virtual_now_ms(NULL);
+    int64_t idle_sample = (start + 300 * 1000 + TUNNEL_SAMPLE_INTERVAL_MS - 1)
+        / TUNNEL_SAMPLE_INTERVAL_MS * TUNNEL_SAMPLE_INTERVAL_MS;
+
+    advance_to(idle_sample - 1);
+    TunnelInfo info;
+    TEST_ASSERT_EQUAL_size_t(1, tunnel_list(&info, 1));
+    TEST_ASSERT_EQUAL_UINT64(0, info.read_bytes);
+    advance_to(idle_sample);
+    TEST_ASSERT_EQUAL_INT(0, test_active_tunnels());
+
+    TunnelExit ended[MAX_EXITS];
+    TEST_ASSERT_EQUAL_size_t(1, take_exits(ended));
+    TEST_ASSERT_EQUAL_INT64(idle_sample - start, ended[0].lifetime_ms);
+}
+
+void test_launch_tokens_refill_on_clock(void) {
+    apply_settings(2);
+    set_limits(600, 0);
+    GgError ret;
+    (void) open_tunnel(&ret);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+    (void) open_tunnel(&ret);
+    TEST_ASSERT_EQUAL(GG_ERR_RETRY, ret);
+
+    // Two launches per minute refill a token every 30 seconds
+    int64_t start = virtual_now_ms(NULL);
+    advance_to(start + 30 * 1000 - 1);
+    (void) open_tunnel(&ret);
+    TEST_ASSERT_EQUAL(GG_ERR_RETRY, ret);
+    advance_to(start + 30 * 1000);
+    (void) open_tunnel(&ret);
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+
+    advance_to(start + 630 * 1000);
+    TunnelExit ended[MAX_EXITS];
+    TEST_ASSERT_EQUAL_size_t(2, take_exits(ended));
+}
+
+typedef struct {
+    bool open;
+    pid_t pid;
+    int64_t start_ms;
+    int64_t due_ms; // When the monitor or the client ends the tunnel
+    bool client_closes;
+} SimTunnel;
+
+typedef struct {
+    size_t opened;
+    size_t rejected;
+    size_t closed;
+    size_t client_closed;
+    int peak_active;
+    int64_t max_deviation_ms;
+} SimStats;
+
+static int64_t random_ms(int64_t max_ms) {
+    double fraction = (double) rand_r(&sim_seed) / RAND_MAX;
+    return 1 + (int64_t) (fraction * (double) max_ms);
+}
+
+// When the monitor ends a tunnel that never carries traffic
+static int64_t expected_end_ms(int64_t start, int timeout, int idle_timeout) {
+    int64_t end = start + timeout * 1000LL;
+    if (idle_timeout > 0) {
+        int64_t interval = TUNNEL_SAMPLE_INTERVAL_MS;
+        int64_t idle_end
+            = (start + idle_timeout * 1000LL + interval - 1) / interval
+            * interval;
+        end = idle_end < end ? idle_end : end;
+    }
+    return end;
+}
+
+static void open_sim_tunnel(SimTunnel *tunnels, SimStats *stats) {
+    static const int TIMEOUTS[] = { 600, 3600, 43200 };
+    static const int IDLE_TIMEOUTS[] = { 0, 0, 300, 1800 };
+    int timeout = TIMEOUTS[rand_r(&sim_seed) % 3];
+    int idle_timeout = IDLE_TIMEOUTS[rand_r(&sim_seed) % 4];
+    set_limits(timeout, idle_timeout);
+
+    GgError ret;
+    int slot = open_tunnel(&ret);
+    if (ret == GG_ERR_NOMEM) {
+        stats->rejected++;
+        return;
+    }
+    TEST_ASSERT_EQUAL(GG_ERR_OK, ret);
+    stats->opened++;
+    int64_t now = virtual_now_ms(NULL);
+    SimTunnel *tunnel = &tunnels[slot];
+    *tunnel = (SimTunnel) {
+        .open = true,
+        .start_ms = now,
+        .due_ms = expected_end_ms(now, timeout, idle_timeout),
+    };
+    {
+        GG_MTX_SCOPE_GUARD(&tunnel_mutex);
+        tunnel->pid = tunnel_contexts[slot].pid;
+    }
+    // Half the clients disconnect, some before the tunnel would time out
+    int64_t client_close = now + random_ms(2 * 3600 * 1000);
+    if (rand_r(&sim_seed) % 2 == 0 && client_close < tunnel->due_ms) {
+        tunnel->due_ms = client_close;
+        tunnel->client_closes = true;
+    }
+    int active = test_active_tunnels();
+    stats->peak_active
+        = active > stats->peak_active ? active : stats->peak_active;
+}
+
+// Compares each exit with when the tunnel was due to end
+static void check_exits(SimTunnel *tunnels, SimStats *stats) {
+    TunnelExit ended[MAX_EXITS];
+    size_t count = take_exits(ended);
+    for (size_t i = 0; i < count; i++) {
+        SimTunnel *tunnel = &tunnels[ended[i].slot];
+        TEST_ASSERT_TRUE(tunnel->open);
+        int64_t deviation
+            = tunnel->start_ms + ended[i].lifetime_ms - tunnel->due_ms;
+        deviation = deviation < 0 ? -deviation : deviation;
+        stats->max_deviation_ms = deviation > stats->max_deviation_ms
+            ? deviation
+            : stats->max_deviation_ms;
+        stats->client_closed += tunnel->client_closes ? 1 : 0;
+        tunnel->open = false;
+    }
+    stats->closed += count;
+}
+
+// Ends the tunnel in slot from the client side, as if localproxy lost its
+// peer and exited
+static void client_close(const SimTunnel *tunnels, int slot) {
+    TEST_ASSERT_EQUAL(0, kill(tunnels[slot].pid, SIGTERM));
+    for (int waited = 0; waited < SETTLE_TIMEOUT_MS * 10 && slot_occupied(slot);
+         waited++) {
+        usleep(100);
+    }
+    TEST_ASSERT_FALSE(slot_occupied(slot));
+}
+
+// Returns the open tunnel whose client disconnects first, before limit_ms,
+// or -1
+static int next_client_close(const SimTunnel *tunnels, int64_t limit_ms) {
+    int next = -1;
+    for (int slot = 0; slot < TUNNEL_MAX_SLOTS; slot++) {
+        const SimTunnel *tunnel = &tunnels[slot];
+        if (tunnel->open && tunnel->client_closes && tunnel->due_ms < limit_ms
+            && (next == -1 || tunnel->due_ms < tunnels[next].due_ms)) {
+            next = slot;
+        }
+    }
+    return next;
+}
+
+// Advances to the next client disconnect before limit_ms, or to limit_ms
+static void run_until(SimTunnel *tunnels, SimStats *stats, int64_t limit_ms) {
+    int slot = next_client_close(tunnels, limit_ms);
+    while (slot >= 0) {
+        advance_to(tunnels[slot].due_ms);
+        check_exits(tunnels, stats);
+        if (tunnels[slot].open) {
+            client_close(tunnels, slot);
+            check_exits(tunnels, stats);
+        }
+        slot = next_client_close(tunnels, limit_ms);
+    }
+    advance_to(limit_ms);
+    check_exits(tunnels, stats);
+}
+
+// Days of random tunnel arrivals, often with every slot taken. Every tunnel
+// must end exactly when its lifetime, idle timeout or client says so.
+void test_days_of_churn(void) {
+    int days = env_int("SIM_DAYS", DEFAULT_SIM_DAYS);
+    sim_seed = (unsigned int) env_int("SIM_SEED", 1);
+    SimTunnel tunnels[TUNNEL_MAX_SLOTS] = { 0 };
+    SimStats stats = { 0 };
+    uint64_t wakeups_before;
+    {
+        GG_MTX_SCOPE_GUARD(&vclock.mutex);
+        wakeups_before = vclock.wakeups;
+    }
+    int64_t wall_start = wall_ms();
+
+    int64_t start = virtual_now_ms(NULL);
+    int64_t end = start + days * 86400LL * 1000;
+    for (int64_t arrival = start; arrival < end;
+         arrival += random_ms(2 * MEAN_ARRIVAL_MS)) {
+        run_until(tunnels, &stats, arrival);
+        open_sim_tunnel(tunnels, &stats);
+    }
+    // Let the remaining tunnels run out
+    run_until(tunnels, &stats, end + 43200 * 1000);
+
+    int64_t wall = wall_ms() - wall_start;
+    uint64_t wakeups;
+    {
+        GG_MTX_SCOPE_GUARD(&vclock.mutex);
+        wakeups = vclock.wakeups - wakeups_before;
+    }
+    char msg[256];
+    snprintf(
+        msg,
+        sizeof(msg),
+        "%d days: %zu tunnels (%zu closed by client), %zu rejected, peak %d; "
+        "max deviation %lld ms; %llu monitor wakeups in %lld ms",
+        days,
+        stats.opened,
+        stats.client_closed,
+        stats.rejected,
+        stats.peak_active,
+        (long long) stats.max_deviation_ms,
+        (unsigned long long) wakeups,
+        (long long) wall
+    );
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL_size_t(stats.opened, stats.closed);
+    TEST_ASSERT_EQUAL_INT64(0, stats.max_deviation_ms);
+}
+
+int main(void) {
+    mkdir(TEST_DIR, 0755);
+    FILE *f = fopen(TEST_DIR "/localproxy", "w");
+    if (f == NULL) {
+        return 1;
+    }
+    fclose(f);
+    chmod(TEST_DIR "/localproxy", 0755);
+
+    tunnel_clock_set(&virtual_clock);
+    tunnel_set_hooks(&stub_hooks);
+    tunnel_events_set_observer(record_exit);
+    pthread_once(&timeout_monitor_once, start_timeout_monitor);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_lifetime_expires_on_time);
+    RUN_TEST(test_stop_escalates_after_grace);
+    RUN_TEST(test_close_escalates_after_grace);
+    RUN_TEST(test_idle_tunnel_closed_on_sample);
+    RUN_TEST(test_launch_tokens_refill_on_clock);
+    RUN_TEST(test_days_of_churn);
+    int failures = UNITY_END();
+
+    test_remove_directory(TEST_DIR);
+    return failures;
+}
@@ -0,0 +1,281 @@
+/*
+ * aws.greengrass.SecureTunneling - AWS Greengrass component for secure
+ * tunneling to IoT devices using AWS IoT Device Management Secure Tunneling
+ * service.
+ *
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Summarizes or lists the binary tunnel journal written by the component.
+//
+// Usage: secure-tunnel-journal [--list] <journal>...
+
+#include "journal_format.h"
+#include "tunnel_events.h"
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define MAX_SERVICES 32
+
+typedef struct {
+    char name[32];
+    uint64_t opens;
+    uint64_t rejects;
+} ServiceSummary;
+
+typedef struct {
+    uint64_t records;
+    uint64_t skipped;
+    uint64_t opens;
+    uint64_t exits;
+    uint64_t exits_clean;
+    uint64_t exits_failed;
+    uint64_t exits_signaled;
+    uint64_t never_started;
+    uint64_t rejects[TUNNEL_REJECT_REASON_COUNT + 1];
+    uint64_t lifetime_total_s;
+    uint32_t lifetime_max_s;
+    uint64_t first_ms;
+    uint64_t last_ms;
+    size_t service_count;
+    ServiceSummary services[MAX_SERVICES];
+} Summary;
+
+static void format_time(uint64_t wall_ms, char *out, size_t size) {
+    time_t secs = (time_t) (wall_ms / 1000U);
+    struct tm tm;
+    gmtime_r(&secs, &tm);
+    strftime(out, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+static const char *event_name(uint16_t type) {
+    switch (type) {
+    case TUNNEL_EVENT_OPEN:
+        return "open";
+    case TUNNEL_EVENT_REJECT:
+        return "reject";
+    case TUNNEL_EVENT_EXIT:
+        return "exit";
+    default:
+        return "unknown";
+    }
+}
+
+static ServiceSummary *service_entry(Summary *summary, const char *name) {
+    for (size_t i = 0; i < summary->service_count; i++) {
+        if (strncmp(summary->services[i].name, name, 31) == 0) {
+            return &summary->services[i];
+        }
+    }
+    if (summary->service_count == MAX_SERVICES) {
+        return NULL;
+    }
+    ServiceSummary *entry = &summary->services[summary->service_count++];
+    strncpy(entry->name, name, sizeof(entry->name) - 1);
+    return entry;
+}
+
+static void print_record(const JournalRecord *record) {
+    char when[32];
+    format_time(record->wall_ms, when, sizeof(when));
+    printf(
+        "%u %s %-6s slot=%d service=%.32s thing=%.128s port=%u",
+        record->seq,
+        when,
+        event_name(record->type),
+        record->slot == UINT8_MAX ? -1 : (int) record->slot,
+        record->service,
+        record->thing_name,
+        record->port
+    );
+    if (record->type == TUNNEL_EVENT_REJECT) {
+        printf(" reason=%s", tunnel_reject_reason_name(record->reason));
+    } else if (record->type == TUNNEL_EVENT_EXIT) {
+        printf(
+            " status=%d lifetime=%us", record->exit_status, record->lifetime_s
+        );
+    }
+    printf("\n");
+}
+
+static void add_record(Summary *summary, const JournalRecord *record) {
+    summary->records++;
+    if (summary->first_ms == 0 || record->wall_ms < summary->first_ms) {
+        summary->first_ms = record->wall_ms;
+    }
+    if (record->wall_ms > summary->last_ms) {
+        summary->last_ms = record->wall_ms;
+    }
+
+    char service[33] = { 0 };
+    memcpy(service, record->service, sizeof(record->service));
+    ServiceSummary *per_service = service_entry(summary, service);
+
+    switch (record->type) {
+    case TUNNEL_EVENT_OPEN:
+        summary->opens++;
+        if (per_service != NULL) {
+            per_service->opens++;
+        }
+        break;
+    case TUNNEL_EVENT_REJECT: {
+        uint16_t reason = record->reason < TUNNEL_REJECT_REASON_COUNT
+            ? record->reason
+            : TUNNEL_REJECT_REASON_COUNT;
+        summary->rejects[reason]++;
+        if (per_service != NULL) {
+            per_service->rejects++;
+        }
+        break;
+    }
+    case TUNNEL_EVENT_EXIT: {
+        summary->exits++;
+        int status = record->exit_status;
+        if (status == -1) {
+            summary->never_started++;
+        } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            summary->exits_clean++;
+        } else if (WIFSIGNALED(status)) {
+            summary->exits_signaled++;
+        } else {
+            summary->exits_failed++;
+        }
+        summary->lifetime_total_s += record->lifetime_s;
+        if (record->lifetime_s > summary->lifetime_max_s) {
+            summary->lifetime_max_s = record->lifetime_s;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static int read_journal(const char *path, bool list, Summary *summary) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 1;
+    }
+
+    JournalHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1
+        || memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not a tunnel journal\n", path);
+        fclose(f);
+        return 1;
+    }
+    if (header.version != JOURNAL_VERSION
+        || header.record_size != sizeof(JournalRecord)) {
+        fprintf(
+            stderr,
+            "%s: journal version %u, expected %u\n",
+            path,
+            header.version,
+            JOURNAL_VERSION
+        );
+        fclose(f);
+        return 1;
+    }
+
+    JournalRecord record;
+    for (uint32_t i = 0; i < header.capacity; i++) {
+        if (fread(&record, sizeof(record), 1, f) != 1 || record.seq == 0) {
+            break;
+        }
+        if (record.checksum != journal_record_checksum(&record)) {
+            summary->skipped++;
+            continue;
+        }
+        if (list) {
+            print_record(&record);
+        }
+        add_record(summary, &record);
+    }
+    fclose(f);
+    return 0;
+}
+
+static void print_summary(const Summary *summary) {
+    char first[32] = "-";
+    char last[32] = "-";
+    if (summary->records > 0) {
+        format_time(summary->first_ms, first, sizeof(first));
+        format_time(summary->last_ms, last, sizeof(last));
+    }
+
+    printf("records:        %llu", (unsigned long long) summary->records);
+    if (summary->skipped > 0) {
+        printf(" (%llu corrupt)", (unsigned long long) summary->skipped);
+    }
+    printf("\nspan:           %s .. %s\n", first, last);
+    printf("opened:         %llu\n", (unsigned long long) summary->opens);
+    printf(
+        "exited:         %llu (clean %llu, failed %llu, signaled %llu, "
+        "never started %llu)\n",
+        (unsigned long long) summary->exits,
+        (unsigned long long) summary->exits_clean,
+        (unsigned long long) summary->exits_failed,
+        (unsigned long long) summary->exits_signaled,
+        (unsigned long long) summary->never_started
+    );
+    if (summary->exits > 0) {
+        printf(
+            "lifetime:       avg %llus, max %us\n",
+            (unsigned long long) (summary->lifetime_total_s / summary->exits),
+            summary->lifetime_max_s
+        );
+    }
+
+    printf("rejected:\n");
+    for (uint32_t reason = 0; reason <= TUNNEL_REJECT_REASON_COUNT; reason++) {
+        if (summary->rejects[reason] > 0) {
+            printf(
+                "  %-22s %llu\n",
+                tunnel_reject_reason_name(reason),
+                (unsigned long long) summary->rejects[reason]
+            );
+        }
+    }
+
+    printf("services:\n");
+    for (size_t i = 0; i < summary->service_count; i++) {
+        printf(
+            "  %-22s opened %llu, rejected %llu\n",
+            summary->services[i].name[0] != '\0' ? summary->services[i].name
+                                                 : "(none)",
+            (unsigned long long) summary->services[i].opens,
+            (unsigned long long) summary->services[i].rejects
+        );
+    }
+}
+
+int main(int argc, char **argv) {
+    bool list = false;
+    int first_path = 1;
+    if (argc > 1 && strcmp(argv[1], "--list") == 0) {
+        list = true;
+        first_path = 2;
+    }
+    if (first_path >= argc) {
+        fprintf(stderr, "Usage: %s [--list] <journal>...\n", argv[0]);
+        return 2;
+    }
+
+    // Pass rotated files first (journal.1 journal) to keep records in order
+    static Summary summary;
+    int ret = 0;
+    for (int i = first_path; i < argc; i++) {
+        ret |= read_journal(argv[i], list, &summary);
+    }
+    if (!list) {
+        print_summary(&summary);
+    }
+    return ret;
+}